@@ -0,0 +1,404 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+
+#include <cxxopts.hpp>
+#include <json.hpp>
+
+#include "FBX2glTF.h"
+#include "utils/Memory_Utils.h"
+#include "utils/Thread_Utils.h"
+#include "PVRTGeometry.h"
+#include "RawModel.h"
+#include "Raw2Cross.h"
+
+bool verboseOutput = false;
+
+/**
+ * Times the stages of the geometry pipeline on synthetic models, so they can be measured without FBX files:
+ *
+ *   grid       a flat grid with normals and texture coordinates, most vertices shared by six triangles
+ *   dense      a displaced grid with per-vertex colors and the triangles shuffled, like a scanned mesh
+ *   materials  a grid split into blocks of many materials, every block a surface of its own
+ *   skinned    a grid bound to a chain of joints, every vertex weighted to the two nearest
+ */
+enum class BenchmarkConfig {
+	GRID,
+	DENSE,
+	MATERIALS,
+	SKINNED,
+};
+
+struct BenchmarkOptions
+{
+	/** Triangles in the generated model, rounded to a square grid. */
+	int triangleCount { 1000000 };
+	/** Materials of the materials configuration. */
+	int materialCount { 256 };
+	/** Joints of the skinned configuration. */
+	int jointCount { 64 };
+	/** Runs of every stage, the fastest one is reported. */
+	int iterations { 3 };
+	/** Worker threads for the stages that use them, zero means one per hardware thread. */
+	int jobs { 1 };
+	/** Scratch file ExportMesh writes to, removed afterwards. */
+	std::string meshFileName { "benchmark.mesh" };
+};
+
+struct StageResult
+{
+	std::string name;
+	double      seconds { 0.0 };
+	size_t      allocations { 0 };
+};
+
+static const char *GetConfigName(BenchmarkConfig config)
+{
+	switch (config) {
+	case BenchmarkConfig::GRID:      return "grid";
+	case BenchmarkConfig::DENSE:     return "dense";
+	case BenchmarkConfig::MATERIALS: return "materials";
+	case BenchmarkConfig::SKINNED:   return "skinned";
+	}
+	return "unknown";
+}
+
+// Deterministic, so every run benchmarks the same model
+static uint32_t NextRandom(uint32_t &state)
+{
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+static std::shared_ptr<RawMatProps> CreateMaterialInfo(int index)
+{
+	const float shade = (float)(index % 16) / 15.0f;
+	return std::make_shared<RawTraditionalMatProps>(
+		RAW_SHADING_MODEL_LAMBERT, Vec3f(0.0f), Vec4f(shade, 1.0f - shade, 0.5f, 1.0f), Vec3f(0.0f), Vec3f(0.0f), 0.0f);
+}
+
+// Adds the vertices and triangles of the configuration, as Fbx2Raw would while reading a mesh
+static void GenerateModel(RawModel &rawModel, BenchmarkConfig config, const BenchmarkOptions &options)
+{
+	const int side = std::max(1, (int)std::sqrt(options.triangleCount / 2.0));
+	const long rootNodeId = 1;
+	const long meshNodeId = 2;
+	const long firstJointId = 100;
+
+	rawModel.AddNode(rootNodeId, "RootNode", 0);
+	rawModel.SetRootNode(rootNodeId);
+	rawModel.AddNode(meshNodeId, "Mesh", rootNodeId);
+	rawModel.GetNode(rawModel.GetNodeById(rootNodeId)).childIds.push_back(meshNodeId);
+
+	rawModel.AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_POSITION);
+	rawModel.AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_NORMAL);
+	if (config == BenchmarkConfig::DENSE) {
+		rawModel.AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_COLOR);
+	}
+	else {
+		rawModel.AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_UV0);
+	}
+	if (config == BenchmarkConfig::SKINNED) {
+		rawModel.AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_JOINT_INDICES);
+		rawModel.AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS);
+	}
+
+	int textures[RAW_TEXTURE_USAGE_MAX];
+	std::fill(std::begin(textures), std::end(textures), -1);
+
+	// The materials configuration has a surface per block of the grid, the others a single surface
+	const int blocksPerSide = config == BenchmarkConfig::MATERIALS ? std::max(1, (int)std::ceil(std::sqrt((double)options.materialCount))) : 1;
+	const int blockSize = (side + blocksPerSide - 1) / blocksPerSide;
+	std::vector<int> blockSurfaces(blocksPerSide * blocksPerSide);
+	std::vector<int> blockMaterials(blocksPerSide * blocksPerSide);
+	for (int block = 0; block < (int)blockSurfaces.size(); block++) {
+		const long surfaceId = 1000 + block;
+		blockSurfaces[block] = rawModel.AddSurface(("surface" + std::to_string(block)).c_str(), surfaceId);
+		rawModel.GetSurface(blockSurfaces[block]).skeletonRootId = meshNodeId;
+
+		const RawMaterialType type = config == BenchmarkConfig::SKINNED ? RAW_MATERIAL_TYPE_SKINNED_OPAQUE : RAW_MATERIAL_TYPE_OPAQUE;
+		const int materialIndex = block % std::max(1, options.materialCount);
+		blockMaterials[block] = rawModel.AddMaterial(("material" + std::to_string(materialIndex)).c_str(), type, textures, CreateMaterialInfo(materialIndex));
+	}
+	rawModel.GetNode(rawModel.GetNodeById(meshNodeId)).surfaceId = rawModel.GetSurface(blockSurfaces[0]).id;
+
+	if (config == BenchmarkConfig::SKINNED) {
+		// A chain of joints along x, each bound at its own position
+		RawSurface &surface = rawModel.GetSurface(blockSurfaces[0]);
+		surface.skeletonRootId = firstJointId;
+		for (int joint = 0; joint < options.jointCount; joint++) {
+			const long jointId = firstJointId + joint;
+			const long parentId = joint == 0 ? rootNodeId : jointId - 1;
+			const float x = (float)joint / std::max(1, options.jointCount - 1);
+
+			RawNode &node = rawModel.GetNode(rawModel.AddNode(jointId, ("joint" + std::to_string(joint)).c_str(), parentId));
+			node.isJoint = true;
+			node.translation = Vec3f(joint == 0 ? 0.0f : 1.0f / (options.jointCount - 1), 0.0f, 0.0f);
+			rawModel.GetNode(rawModel.GetNodeById(parentId)).childIds.push_back(jointId);
+
+			surface.jointIds.push_back(jointId);
+			surface.inverseBindMatrices.push_back(Mat4f::FromTranslationVector(Vec3f(-x, 0.0f, 0.0f)));
+			surface.jointGeometryMins.push_back(Vec3f(x, 0.0f, 0.0f));
+			surface.jointGeometryMaxs.push_back(Vec3f(x, 0.0f, 1.0f));
+		}
+	}
+
+	const auto makeVertex = [&](int x, int z) {
+		RawVertex vertex;
+		const float u = (float)x / side;
+		const float v = (float)z / side;
+		vertex.position = Vec3f(u, 0.0f, v);
+		vertex.normal = Vec3f(0.0f, 1.0f, 0.0f);
+
+		if (config == BenchmarkConfig::DENSE) {
+			// Scanned surfaces are bumpy everywhere, every vertex has a normal and color of its own
+			const float du = std::cos(u * 97.0f) * std::sin(v * 61.0f) * 0.01f;
+			const float dv = std::sin(u * 83.0f) * std::cos(v * 71.0f) * 0.01f;
+			vertex.position[1] = std::sin(u * 97.0f) * std::sin(v * 61.0f) * 0.01f;
+			vertex.normal = Vec3f(-du, 1.0f, -dv).Normalized();
+			vertex.color = Vec4f(u, v, 1.0f - u, 1.0f);
+		}
+		else {
+			vertex.uv0 = Vec2f(u, v);
+		}
+
+		if (config == BenchmarkConfig::SKINNED) {
+			const float jointPosition = u * (options.jointCount - 1);
+			const int joint = std::min((int)jointPosition, std::max(0, options.jointCount - 2));
+			const float weight = std::min(1.0f, jointPosition - joint);
+			vertex.jointIndices = Vec4i((uint16_t)joint, (uint16_t)std::min(joint + 1, options.jointCount - 1), 0, 0);
+			vertex.jointWeights = Vec4f(1.0f - weight, weight, 0.0f, 0.0f);
+		}
+		return vertex;
+	};
+
+	std::vector<int> quads(side * side);
+	for (int quad = 0; quad < (int)quads.size(); quad++) {
+		quads[quad] = quad;
+	}
+	if (config == BenchmarkConfig::DENSE) {
+		uint32_t state = 12345;
+		for (int quad = (int)quads.size() - 1; quad > 0; quad--) {
+			std::swap(quads[quad], quads[NextRandom(state) % (quad + 1)]);
+		}
+	}
+
+	for (const int quad : quads) {
+		const int x = quad % side;
+		const int z = quad / side;
+		const int block = (z / blockSize) * blocksPerSide + (x / blockSize);
+
+		const RawVertex corners[4] = { makeVertex(x, z), makeVertex(x + 1, z), makeVertex(x + 1, z + 1), makeVertex(x, z + 1) };
+		int vertices[4];
+		for (int corner = 0; corner < 4; corner++) {
+			vertices[corner] = rawModel.AddVertex(corners[corner]);
+			rawModel.GetSurface(blockSurfaces[block]).bounds.AddPoint(corners[corner].position);
+		}
+		rawModel.AddTriangle(vertices[0], vertices[2], vertices[1], blockMaterials[block], blockSurfaces[block]);
+		rawModel.AddTriangle(vertices[0], vertices[3], vertices[2], blockMaterials[block], blockSurfaces[block]);
+	}
+}
+
+// Runs the stage iterations times on a fresh input from prepare, keeping the fastest time and the allocations of a run
+static StageResult RunStage(const char *name, int iterations, const std::function<void()> &prepare, const std::function<void()> &stage)
+{
+	StageResult result;
+	result.name = name;
+	for (int iteration = 0; iteration < iterations; iteration++) {
+		prepare();
+
+		const size_t allocations = MemoryUtils::GetAllocationCount();
+		const auto start = std::chrono::steady_clock::now();
+		stage();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (iteration == 0 || seconds < result.seconds) {
+			result.seconds = seconds;
+		}
+		result.allocations = MemoryUtils::GetAllocationCount() - allocations;
+	}
+	return result;
+}
+
+static std::vector<StageResult> RunBenchmark(BenchmarkConfig config, const BenchmarkOptions &options, int &triangleCount)
+{
+	std::vector<StageResult> results;
+	CrossOptions crossOptions;
+	crossOptions.jobs = options.jobs;
+
+	RawModel rawModel;
+	results.push_back(RunStage("addVertex", options.iterations,
+		[&]() { rawModel = RawModel(); },
+		[&]() { GenerateModel(rawModel, config, options); }));
+	triangleCount = rawModel.GetTriangleCount();
+
+	RawModel condensedModel;
+	results.push_back(RunStage("condense", options.iterations,
+		[&]() { condensedModel = rawModel; },
+		[&]() { condensedModel.Condense(); }));
+
+	std::vector<RawModel> rawMaterialModels;
+	results.push_back(RunStage("createMaterialModels", options.iterations,
+		[&]() { rawMaterialModels.clear(); },
+		[&]() { condensedModel.CreateMaterialModels(rawMaterialModels, false, -1, true, options.jobs); }));
+
+	// The vertex cache sort of every submesh, on copies of their vertices and indices as ExportMesh makes them
+	std::vector<std::vector<RawVertex>> subMeshVertices(rawMaterialModels.size());
+	std::vector<std::vector<unsigned int>> subMeshIndices(rawMaterialModels.size());
+	results.push_back(RunStage("pvrtGeometrySort", options.iterations,
+		[&]() {
+			for (size_t indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+				const RawModel &rawMaterialModel = rawMaterialModels[indexMesh];
+				subMeshVertices[indexMesh].resize(rawMaterialModel.GetVertexCount());
+				for (int indexVertex = 0; indexVertex < rawMaterialModel.GetVertexCount(); indexVertex++) {
+					subMeshVertices[indexMesh][indexVertex] = rawMaterialModel.GetVertex(indexVertex);
+				}
+				subMeshIndices[indexMesh].resize(3 * rawMaterialModel.GetTriangleCount());
+				for (int indexTriangle = 0; indexTriangle < rawMaterialModel.GetTriangleCount(); indexTriangle++) {
+					for (int corner = 0; corner < 3; corner++) {
+						subMeshIndices[indexMesh][3 * indexTriangle + corner] = rawMaterialModel.GetTriangle(indexTriangle).verts[corner];
+					}
+				}
+			}
+		},
+		[&]() {
+			// Like the export, every worker reuses the working memory of the sorter for the run
+			std::vector<std::unique_ptr<PVRTGeometrySortContext, void (*)(PVRTGeometrySortContext *)>> contexts;
+			for (int worker = 0; worker < ThreadUtils::GetJobCount(options.jobs); worker++) {
+				contexts.emplace_back(PVRTGeometryCreateSortContext(), PVRTGeometryDeleteSortContext);
+			}
+			ThreadUtils::ParallelForWorker((int)rawMaterialModels.size(), options.jobs, [&](int indexMesh, int worker) {
+				const int subMeshVertexCount = (int)subMeshVertices[indexMesh].size();
+				const int subMeshTriangleCount = (int)subMeshIndices[indexMesh].size() / 3;
+				PVRTGeometrySort(subMeshVertices[indexMesh].data(), subMeshIndices[indexMesh].data(), sizeof(RawVertex),
+					subMeshVertexCount, subMeshTriangleCount, subMeshVertexCount, subMeshTriangleCount, PVRTGEOMETRY_SORT_VERTEXCACHE, contexts[worker].get());
+			});
+		}));
+	subMeshVertices.clear();
+	subMeshIndices.clear();
+
+	results.push_back(RunStage("exportMesh", options.iterations,
+		[&]() {},
+		[&]() {
+			if (ExportMesh(options.meshFileName.c_str(), condensedModel, rawMaterialModels, crossOptions) == false) {
+				fmt::fprintf(stderr, "ERROR:: Failed to export mesh: %s\n", options.meshFileName.c_str());
+			}
+		}));
+	remove(options.meshFileName.c_str());
+
+	return results;
+}
+
+int main(int argc, char *argv[])
+{
+	BenchmarkOptions benchmarkOptions;
+	std::vector<std::string> configNames;
+	std::string reportPath;
+
+	cxxopts::Options options(
+		"FBX2MeshBenchmark",
+		"FBX2MeshBenchmark: Time the geometry pipeline of FBX2Mesh on synthetic models.");
+
+	options.add_options()
+		("config", "Model to generate, may be repeated (grid|dense|materials|skinned|all).", cxxopts::value<std::vector<std::string>>(configNames))
+		("triangles", "Number of triangles of the generated model.", cxxopts::value<int>(benchmarkOptions.triangleCount))
+		("materials", "Number of materials of the materials model.", cxxopts::value<int>(benchmarkOptions.materialCount))
+		("joints", "Number of joints of the skinned model.", cxxopts::value<int>(benchmarkOptions.jointCount))
+		("iterations", "Runs of every stage, the fastest is reported.", cxxopts::value<int>(benchmarkOptions.iterations))
+		("j,jobs", "Number of worker threads, 0 uses one per hardware thread.", cxxopts::value<int>(benchmarkOptions.jobs))
+		("mesh-file", "Scratch file the mesh export stage writes to.", cxxopts::value<std::string>(benchmarkOptions.meshFileName))
+		("report", "Write the results as JSON to the given file, to compare runs.", cxxopts::value<std::string>(reportPath))
+		("h,help", "Show this help.");
+
+	options.parse(argc, argv);
+
+	if (options.count("help")) {
+		fmt::printf(options.help());
+		return 0;
+	}
+
+	if (benchmarkOptions.triangleCount < 2 || benchmarkOptions.materialCount < 1 || benchmarkOptions.jointCount < 2 ||
+		benchmarkOptions.iterations < 1) {
+		fmt::fprintf(stderr, "ERROR:: Benchmarks need at least 2 triangles, 1 material, 2 joints and 1 iteration\n");
+		return 1;
+	}
+
+	std::vector<BenchmarkConfig> configs;
+	for (const std::string &choice : configNames.empty() ? std::vector<std::string>{ "all" } : configNames) {
+		if (choice == "grid") {
+			configs.push_back(BenchmarkConfig::GRID);
+		}
+		else if (choice == "dense") {
+			configs.push_back(BenchmarkConfig::DENSE);
+		}
+		else if (choice == "materials") {
+			configs.push_back(BenchmarkConfig::MATERIALS);
+		}
+		else if (choice == "skinned") {
+			configs.push_back(BenchmarkConfig::SKINNED);
+		}
+		else if (choice == "all") {
+			configs.insert(configs.end(), { BenchmarkConfig::GRID, BenchmarkConfig::DENSE, BenchmarkConfig::MATERIALS, BenchmarkConfig::SKINNED });
+		}
+		else {
+			fmt::printf("Unknown --config: %s\n", choice);
+			fmt::printf(options.help());
+			return 1;
+		}
+	}
+
+	MemoryUtils::SetAllocationCounting(true);
+
+	nlohmann::json report = nlohmann::json::array();
+	for (const BenchmarkConfig config : configs) {
+		int triangleCount = 0;
+		const std::vector<StageResult> results = RunBenchmark(config, benchmarkOptions, triangleCount);
+
+		fmt::printf("%s: %d triangles\n", GetConfigName(config), triangleCount);
+		fmt::printf("    %-22s %12s %16s %14s\n", "stage", "ms", "triangles/s", "allocations");
+
+		nlohmann::json stages = nlohmann::json::array();
+		for (const StageResult &result : results) {
+			const double trianglesPerSecond = result.seconds > 0.0 ? triangleCount / result.seconds : 0.0;
+			fmt::printf("    %-22s %12.2f %16.0f %14zu\n", result.name, result.seconds * 1000.0, trianglesPerSecond, result.allocations);
+			stages.push_back({
+				{ "name", result.name },
+				{ "seconds", result.seconds },
+				{ "trianglesPerSecond", trianglesPerSecond },
+				{ "allocations", result.allocations }
+			});
+		}
+
+		report.push_back({
+			{ "config", GetConfigName(config) },
+			{ "triangles", triangleCount },
+			{ "jobs", ThreadUtils::GetJobCount(benchmarkOptions.jobs) },
+			{ "stages", stages }
+		});
+	}
+
+	if (reportPath.empty() == false) {
+		std::ofstream stream(reportPath, std::ios::trunc);
+		stream << report.dump(1) << std::endl;
+		if (!stream.good()) {
+			fmt::fprintf(stderr, "ERROR:: Failed to write report: %s\n", reportPath.c_str());
+			return 1;
+		}
+	}
+
+	return 0;
+}
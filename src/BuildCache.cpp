@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <fstream>
+#include <random>
+
+#include <sys/stat.h>
+
+#include <json.hpp>
+
+#include "FBX2glTF.h"
+#include "utils/File_Utils.h"
+#include "utils/Hash_Utils.h"
+#include "BuildCache.h"
+
+// Bumped whenever the entries or the conversion change in a way the key doesn't capture
+static const int BUILD_CACHE_VERSION = 1;
+
+static bool GetFileStamp(const std::string &filePath, int64_t &modified, int64_t &size)
+{
+	struct stat info;
+	if (stat(filePath.c_str(), &info) != 0) {
+		return false;
+	}
+	modified = (int64_t)info.st_mtime;
+	size = (int64_t)info.st_size;
+	return true;
+}
+
+static bool HashFile(const std::string &filePath, uint64_t &hash)
+{
+	std::ifstream stream(filePath, std::ios::binary);
+	if (!stream.good()) {
+		return false;
+	}
+
+	// Chunks chain through the seed, so the hash doesn't depend on holding the whole file
+	std::vector<char> buffer(1024 * 1024);
+	hash = 0;
+	while (stream) {
+		stream.read(buffer.data(), buffer.size());
+		if (stream.gcount() > 0) {
+			hash = HashUtils::HashBytes(buffer.data(), (size_t)stream.gcount(), hash);
+		}
+	}
+	return stream.eof();
+}
+
+// A file as it was when the entry was written; its content is only hashed again when the stamp changed
+static nlohmann::json DescribeFile(const std::string &filePath, bool &success)
+{
+	int64_t modified = -1, size = -1;
+	uint64_t hash = 0;
+	success = GetFileStamp(filePath, modified, size) && HashFile(filePath, hash);
+
+	return {
+		{ "path", filePath },
+		{ "modified", modified },
+		{ "size", size },
+		{ "hash", HashUtils::ToHexString(hash) }
+	};
+}
+
+static bool IsFileUnchanged(nlohmann::json &file)
+{
+	const std::string filePath = file.value("path", std::string());
+	int64_t modified, size;
+	if (GetFileStamp(filePath, modified, size) == false) {
+		return false;
+	}
+	if (modified == file.value("modified", (int64_t)-1) && size == file.value("size", (int64_t)-1)) {
+		return true;
+	}
+
+	uint64_t hash;
+	if (size != file.value("size", (int64_t)-1) || HashFile(filePath, hash) == false || HashUtils::ToHexString(hash) != file.value("hash", std::string())) {
+		return false;
+	}
+
+	// Touched but the same, remember the new stamp so it isn't hashed every time
+	file["modified"] = modified;
+	return true;
+}
+
+static std::string GetEntryFileName(const std::string &cachePath, uint64_t key)
+{
+	return cachePath + "/" + HashUtils::ToHexString(key) + ".json";
+}
+
+static bool WriteEntry(const std::string &cachePath, uint64_t key, const nlohmann::json &entry)
+{
+	const std::string fileName = GetEntryFileName(cachePath, key);
+	const std::string tempFileName = fileName + ".tmp" + std::to_string(std::random_device()());
+	{
+		std::ofstream stream(tempFileName, std::ios::trunc);
+		stream << entry.dump(1) << std::endl;
+		if (!stream.good()) {
+			remove(tempFileName.c_str());
+			return false;
+		}
+	}
+	if (FileUtils::RenameFile(tempFileName, fileName) == false) {
+		remove(tempFileName.c_str());
+		return false;
+	}
+	return true;
+}
+
+namespace BuildCache {
+	bool GetKey(const std::string &inputPath, const std::string &description, uint64_t &key)
+	{
+		uint64_t hash;
+		if (HashFile(inputPath, hash) == false) {
+			return false;
+		}
+		key = HashUtils::HashString(description, HashUtils::HashBytes(&hash, sizeof(hash), BUILD_CACHE_VERSION));
+		return true;
+	}
+
+	bool Restore(const std::string &cachePath, uint64_t key, std::vector<std::string> &outputFiles)
+	{
+		outputFiles.clear();
+		std::ifstream stream(GetEntryFileName(cachePath, key));
+		if (!stream.good()) {
+			return false;
+		}
+		nlohmann::json entry;
+		try {
+			stream >> entry;
+		} catch (const std::exception &) {
+			return false;
+		}
+		stream.close();
+		if (!entry.is_object() || entry.value("version", 0) != BUILD_CACHE_VERSION || !entry["textures"].is_array() || !entry["outputs"].is_array()) {
+			return false;
+		}
+
+		for (nlohmann::json &texture : entry["textures"]) {
+			if (IsFileUnchanged(texture) == false) {
+				return false;
+			}
+		}
+
+		// Outputs deleted or overwritten since are copied back from the cache
+		for (nlohmann::json &output : entry["outputs"]) {
+			if (IsFileUnchanged(output)) {
+				continue;
+			}
+			const std::string filePath = output.value("path", std::string());
+			const std::string copyPath = cachePath + "/" + output.value("copy", std::string());
+			if (FileUtils::CreatePath(filePath.c_str()) == false || FileUtils::CopyFile(copyPath, filePath) == false) {
+				return false;
+			}
+			bool success;
+			const nlohmann::json restored = DescribeFile(filePath, success);
+			if (success == false || restored["hash"] != output["hash"]) {
+				return false;
+			}
+			output["modified"] = restored["modified"];
+		}
+
+		for (const nlohmann::json &output : entry["outputs"]) {
+			outputFiles.push_back(output.value("path", std::string()));
+		}
+
+		// The stamps of touched and restored files changed, failing to save them only costs hashing them again
+		WriteEntry(cachePath, key, entry);
+		return true;
+	}
+
+	bool Store(const std::string &cachePath, uint64_t key, const std::vector<std::string> &textureFiles, const std::vector<std::string> &outputFiles)
+	{
+		const std::string copyFolder = HashUtils::ToHexString(key) + "/";
+		if (FileUtils::CreatePath((cachePath + "/" + copyFolder).c_str()) == false) {
+			return false;
+		}
+
+		nlohmann::json textures = nlohmann::json::array();
+		for (const std::string &textureFile : textureFiles) {
+			bool success;
+			textures.push_back(DescribeFile(textureFile, success));
+			if (success == false) {
+				return false;
+			}
+		}
+
+		nlohmann::json outputs = nlohmann::json::array();
+		for (size_t index = 0; index < outputFiles.size(); index++) {
+			bool success;
+			nlohmann::json output = DescribeFile(outputFiles[index], success);
+			output["copy"] = copyFolder + std::to_string(index);
+			if (success == false || FileUtils::CopyFile(outputFiles[index], cachePath + "/" + copyFolder + std::to_string(index)) == false) {
+				return false;
+			}
+			outputs.push_back(output);
+		}
+
+		const nlohmann::json entry = {
+			{ "version", BUILD_CACHE_VERSION },
+			{ "textures", textures },
+			{ "outputs", outputs }
+		};
+		return WriteEntry(cachePath, key, entry);
+	}
+}
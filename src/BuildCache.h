@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef __BUILDCACHE_H__
+#define __BUILDCACHE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Remembers what converting an FBX file produced, so converting it again unchanged with the same
+ * options only checks the outputs are in place. The cache folder holds an entry per conversion,
+ * <key>.json lists the textures the conversion read and the files it wrote, and <key>/ keeps a
+ * copy of every output to restore outputs that were deleted or changed since.
+ */
+namespace BuildCache {
+	// Hashes the content of the FBX file with the description of the conversion, the options and the output
+	// folder; false if the file can't be read
+	bool GetKey(const std::string &inputPath, const std::string &description, uint64_t &key);
+
+	// True when the entry of the key exists and none of its textures changed, every output is then in place and
+	// listed in outputFiles
+	bool Restore(const std::string &cachePath, uint64_t key, std::vector<std::string> &outputFiles);
+
+	// Records the textures and outputs of a conversion under the key, copying the outputs into the cache
+	bool Store(const std::string &cachePath, uint64_t key, const std::vector<std::string> &textureFiles, const std::vector<std::string> &outputFiles);
+}
+
+#endif // !__BUILDCACHE_H__
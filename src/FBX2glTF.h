@@ -19,7 +19,27 @@
 #endif
 
 #include <fmt/printf.h>
+
+#if defined ( FBX2MESH_NO_FBXSDK )
+// Targets that never read FBX files build without the SDK, these stand in for what the rest of the code uses of it
+#include <cassert>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <math.h>
+
+#ifndef _MAX_PATH
+#define _MAX_PATH 260
+#endif
+
+template<class T>
+inline T FbxClamp(const T value, const T min, const T max)
+{
+    return value < min ? min : (value > max ? max : value);
+}
+#else
 #include <fbxsdk.h>
+#endif
 
 #include "mathfu.h"
 
@@ -17,26 +17,31 @@
 #include <cstdint>
 #include <cstdio>
 #include <cassert>
+#include <mutex>
+#include <atomic>
+#include <memory>
 
 #include "FBX2glTF.h"
 #include "utils/File_Utils.h"
 #include "utils/String_Utils.h"
+#include "utils/Thread_Utils.h"
+#include "utils/Profile_Utils.h"
 #include "RawModel.h"
 #include "Fbx2Raw.h"
 
 extern bool verboseOutput;
 
 float scaleFactor;
+static std::once_flag scaleFactorFlag;
 
+// The elements and indices are copied out of the layer, so reading them later doesn't call into the FBX SDK.
 template<typename _type_>
 class FbxLayerElementAccess
 {
 public:
 
     FbxLayerElementAccess(const FbxLayerElementTemplate<_type_> *layer, int count) :
-        mappingMode(FbxGeometryElement::eNone),
-        elements(nullptr),
-        indices(nullptr)
+        mappingMode(FbxGeometryElement::eNone)
     {
         if (count <= 0 || layer == nullptr) {
             return;
@@ -46,10 +51,21 @@ public:
             newMappingMode == FbxGeometryElement::eByPolygonVertex ||
             newMappingMode == FbxGeometryElement::eByPolygon) {
             mappingMode = newMappingMode;
-            elements    = &layer->GetDirectArray();
-            indices     = (
-                layer->GetReferenceMode() == FbxGeometryElement::eIndexToDirect ||
-                layer->GetReferenceMode() == FbxGeometryElement::eIndex) ? &layer->GetIndexArray() : nullptr;
+
+            const FbxLayerElementArrayTemplate<_type_> &directArray = layer->GetDirectArray();
+            elements.resize(directArray.GetCount());
+            for (int index = 0; index < directArray.GetCount(); index++) {
+                elements[index] = directArray.GetAt(index);
+            }
+            if (layer->GetReferenceMode() == FbxGeometryElement::eIndexToDirect ||
+                layer->GetReferenceMode() == FbxGeometryElement::eIndex) {
+                const FbxLayerElementArrayTemplate<int> &indexArray = layer->GetIndexArray();
+                indices.resize(indexArray.GetCount());
+                for (int index = 0; index < indexArray.GetCount(); index++) {
+                    indices[index] = indexArray.GetAt(index);
+                }
+                hasIndices = true;
+            }
         }
     }
 
@@ -63,8 +79,8 @@ public:
         if (mappingMode != FbxGeometryElement::eNone) {
             int index = (mappingMode == FbxGeometryElement::eByControlPoint) ? controlPointIndex :
                         ((mappingMode == FbxGeometryElement::eByPolygonVertex) ? polygonVertexIndex : polygonIndex);
-            index = (indices != nullptr) ? (*indices)[index] : index;
-            _type_ element = elements->GetAt(index);
+            index = hasIndices ? indices[index] : index;
+            _type_ element = elements[index];
             return element;
         }
         return defaultValue;
@@ -85,9 +101,10 @@ public:
     }
 
 private:
-    FbxGeometryElement::EMappingMode           mappingMode;
-    const FbxLayerElementArrayTemplate<_type_> *elements;
-    const FbxLayerElementArrayTemplate<int>    *indices;
+    FbxGeometryElement::EMappingMode mappingMode;
+    std::vector<_type_>              elements;
+    std::vector<int>                 indices;
+    bool                             hasIndices { false };
 };
 
 struct FbxMaterialInfo {
@@ -331,9 +348,7 @@ class FbxMaterialsAccess
 public:
 
     FbxMaterialsAccess(const FbxMesh *pMesh, const std::map<const FbxTexture *, FbxString> &textureLocations) :
-        mappingMode(FbxGeometryElement::eNone),
-        mesh(nullptr),
-        indices(nullptr)
+        mappingMode(FbxGeometryElement::eNone)
     {
         if (pMesh->GetElementMaterialCount() <= 0) {
             return;
@@ -349,12 +364,16 @@ public:
             return;
         }
 
+        // Copied, so that looking up the material of a polygon doesn't call into the FBX SDK
+        const FbxLayerElementArrayTemplate<int> &indexArray = pMesh->GetElementMaterial()->GetIndexArray();
         mappingMode = materialMappingMode;
-        mesh        = pMesh;
-        indices     = &pMesh->GetElementMaterial()->GetIndexArray();
+        indices.resize(indexArray.GetCount());
+        for (int ii = 0; ii < indexArray.GetCount(); ii++) {
+            indices[ii] = indexArray.GetAt(ii);
+        }
 
-        for (int ii = 0; ii < indices->GetCount(); ii++) {
-            int materialNum = indices->GetAt(ii);
+        for (int ii = 0; ii < (int) indices.size(); ii++) {
+            int materialNum = indices[ii];
             if (materialNum < 0) {
                 continue;
             }
@@ -364,7 +383,7 @@ public:
             auto summary = summaries[materialNum];
             if (summary == nullptr) {
                 summary = summaries[materialNum] = GetMaterialInfo(
-                    mesh->GetNode()->GetSrcObject<FbxSurfaceMaterial>(materialNum),
+                    pMesh->GetNode()->GetSrcObject<FbxSurfaceMaterial>(materialNum),
                     textureLocations);
             }
         }
@@ -373,7 +392,7 @@ public:
     const std::shared_ptr<FbxMaterialInfo> GetMaterial(const int polygonIndex) const
     {
         if (mappingMode != FbxGeometryElement::eNone) {
-            const int materialNum = indices->GetAt((mappingMode == FbxGeometryElement::eByPolygon) ? polygonIndex : 0);
+            const int materialNum = indices[(mappingMode == FbxGeometryElement::eByPolygon) ? polygonIndex : 0];
             if (materialNum < 0) {
                 return nullptr;
             }
@@ -385,8 +404,7 @@ public:
 private:
     FbxGeometryElement::EMappingMode              mappingMode;
     std::vector<std::shared_ptr<FbxMaterialInfo>> summaries {};
-    const FbxMesh                                 *mesh;
-    const FbxLayerElementArrayTemplate<int>       *indices;
+    std::vector<int>                              indices;
 };
 
 class FbxSkinningAccess
@@ -691,26 +709,39 @@ GetMaterialType(const RawModel &raw, const int textures[RAW_TEXTURE_USAGE_MAX],
     return skinned ? RAW_MATERIAL_TYPE_SKINNED_OPAQUE : RAW_MATERIAL_TYPE_OPAQUE;
 }
 
-static void ReadMesh(RawModel &raw, FbxScene *pScene, FbxNode *pNode, const std::map<const FbxTexture *, FbxString> &textureLocations)
+// Textures are shared by many meshes, the image of each one is only read once however many mesh shards add it.
+class TextureCache
 {
-    FbxGeometryConverter meshConverter(pScene->GetFbxManager());
-    meshConverter.Triangulate(pNode->GetNodeAttribute(), true);
-    FbxMesh *pMesh = pNode->GetMesh();
+public:
+    int AddTexture(RawModel &raw, const std::string &name, const std::string &fileName, const std::string &fileLocation, RawTextureUsage usage)
+    {
+        RawTexture texture;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const int textureIndex = textures.AddTexture(name, fileName, fileLocation, usage);
+            if (textureIndex < 0) {
+                return -1;
+            }
+            texture = textures.GetTexture(textureIndex);
+        }
+        return raw.AddTexture(texture);
+    }
 
-    // Obtains the surface Id
-    const long surfaceId = pMesh->GetUniqueID();
+private:
+    std::mutex mutex;
+    RawModel   textures;
+};
 
-    // Associate the node to this surface
-    int nodeId = raw.GetNodeById(pNode->GetUniqueID());
-    if (nodeId >= 0) {
-        RawNode &node = raw.GetNode(nodeId);
-        node.surfaceId = surfaceId;
-    }
+// Reads one triangulated mesh into a model of its own. The FBX SDK is only called under sdkMutex: the layers, polygon
+// vertices and material indices are copied into plain arrays while it is held, so the per polygon work reads only
+// those and runs concurrently with other meshes, even ones sharing the FbxMesh. The scene model provides the node names.
+static void ReadMesh(
+    RawModel &raw, const RawModel &scene, FbxScene *pScene, FbxNode *pNode, const long surfaceId, const int meshIndex,
+    const std::map<const FbxTexture *, FbxString> &textureLocations, TextureCache &textureCache, std::mutex &sdkMutex)
+{
+    std::unique_lock<std::mutex> sdkLock(sdkMutex);
 
-    if (raw.GetSurfaceById(surfaceId) >= 0) {
-        // This surface is already loaded
-        return;
-    }
+    FbxMesh *pMesh = pNode->GetMesh();
 
     const char *meshName = (pNode->GetName()[0] != '\0') ? pNode->GetName() : pMesh->GetName();
     const int rawSurfaceIndex = raw.AddSurface(meshName, surfaceId);
@@ -728,8 +759,8 @@ static void ReadMesh(RawModel &raw, FbxScene *pScene, FbxNode *pNode, const std:
 
     if (verboseOutput) {
         fmt::printf(
-            "mesh %d: %s (skinned: %s)\n", rawSurfaceIndex, meshName,
-            skinning.IsSkinned() ? raw.GetNode(raw.GetNodeById(skinning.GetRootNode())).name.c_str() : "NO");
+            "mesh %d: %s (skinned: %s)\n", meshIndex, meshName,
+            skinning.IsSkinned() ? scene.GetNode(scene.GetNodeById(skinning.GetRootNode())).name.c_str() : "NO");
     }
 
     // The FbxNode geometric transformation describes how a FbxNodeAttribute is offset from
@@ -748,6 +779,19 @@ static void ReadMesh(RawModel &raw, FbxScene *pScene, FbxNode *pNode, const std:
     const FbxMatrix  normalTransform(FbxVector4(), meshRotation, meshScaling);
     const FbxMatrix  inverseTransposeTransform = normalTransform.Inverse().Transpose();
 
+    const int polygonCount = pMesh->GetPolygonCount();
+    std::vector<int> polygonVertices(polygonCount * 3);
+    for (int polygonIndex = 0; polygonIndex < polygonCount; polygonIndex++) {
+        FBX_ASSERT(pMesh->GetPolygonSize(polygonIndex) == 3);
+        for (int vertexIndex = 0; vertexIndex < 3; vertexIndex++) {
+            polygonVertices[polygonIndex * 3 + vertexIndex] = pMesh->GetPolygonVertex(polygonIndex, vertexIndex);
+        }
+    }
+
+    const long nodeId = pNode->GetUniqueID();
+
+    sdkLock.unlock();
+
     raw.AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_POSITION);
     if (normalLayer.LayerPresent()) { raw.AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_NORMAL); }
     if (binormalLayer.LayerPresent()) { raw.AddVertexAttribute(RAW_VERTEX_ATTRIBUTE_BINORMAL); }
@@ -764,11 +808,10 @@ static void ReadMesh(RawModel &raw, FbxScene *pScene, FbxNode *pNode, const std:
     Mat4f scaleMatrix = Mat4f::FromScaleVector(Vec3f(scaleFactor, scaleFactor, scaleFactor));
     Mat4f invScaleMatrix = scaleMatrix.Inverse();
 
-    rawSurface.skeletonRootId = (skinning.IsSkinned()) ? skinning.GetRootNode() : pNode->GetUniqueID();
+    rawSurface.skeletonRootId = (skinning.IsSkinned()) ? skinning.GetRootNode() : nodeId;
     for (int jointIndex = 0; jointIndex < skinning.GetNodeCount(); jointIndex++) {
+        // The joint nodes are flagged when the mesh is merged into the scene.
         const long jointId = skinning.GetJointId(jointIndex);
-        raw.GetNode(raw.GetNodeById(jointId)).isJoint = true;
-
         rawSurface.jointIds.emplace_back(jointId);
         rawSurface.inverseBindMatrices.push_back(invScaleMatrix * toMat4f(skinning.GetInverseBindMatrix(jointIndex)) * scaleMatrix);
         rawSurface.jointGeometryMins.emplace_back(FLT_MAX, FLT_MAX, FLT_MAX);
@@ -790,77 +833,103 @@ static void ReadMesh(RawModel &raw, FbxScene *pScene, FbxNode *pNode, const std:
         }
     }
 
+    // Raw materials are resolved once per FbxMaterialInfo rather than once per polygon; the
+    // only per-polygon input to the material is vertex transparency, so each entry keeps
+    // one raw material index for the opaque and one for the transparent variant.
+    struct MeshMaterial
+    {
+        int                          textures[RAW_TEXTURE_USAGE_MAX];
+        FbxString                    name;
+        std::shared_ptr<RawMatProps> props;
+        int                          materialIndices[2] = { -1, -1 };
+    };
+    std::unordered_map<const FbxMaterialInfo *, MeshMaterial> meshMaterials;
+
+    // Reused across polygons, so the blend vectors keep their capacity instead of being allocated per corner.
+    RawVertex rawVertices[3];
+
     int polygonVertexIndex = 0;
-    for (int polygonIndex = 0; polygonIndex < pMesh->GetPolygonCount(); polygonIndex++) {
-        FBX_ASSERT(pMesh->GetPolygonSize(polygonIndex) == 3);
+    for (int polygonIndex = 0; polygonIndex < polygonCount; polygonIndex++) {
         const std::shared_ptr<FbxMaterialInfo> fbxMaterial = materials.GetMaterial(polygonIndex);
 
-        int textures[RAW_TEXTURE_USAGE_MAX];
-        std::fill_n(textures, (int) RAW_TEXTURE_USAGE_MAX, -1);
+        auto materialIt = meshMaterials.find(fbxMaterial.get());
+        if (materialIt == meshMaterials.end()) {
+            materialIt = meshMaterials.emplace(fbxMaterial.get(), MeshMaterial()).first;
 
-        std::shared_ptr<RawMatProps> rawMatProps;
-        FbxString materialName;
+            int (&textures)[RAW_TEXTURE_USAGE_MAX] = materialIt->second.textures;
+            std::fill_n(textures, (int) RAW_TEXTURE_USAGE_MAX, -1);
 
-        if (fbxMaterial == nullptr) {
-            materialName = "DefaultMaterial";
-            rawMatProps.reset(new RawTraditionalMatProps(RAW_SHADING_MODEL_LAMBERT,
-                Vec3f(0, 0, 0), Vec4f(.5, .5, .5, 1), Vec3f(0, 0, 0), Vec3f(0, 0, 0), 0.5));
+            std::shared_ptr<RawMatProps> &rawMatProps = materialIt->second.props;
+            FbxString &materialName = materialIt->second.name;
 
-        } else {
-            materialName = fbxMaterial->name;
+            if (fbxMaterial == nullptr) {
+                materialName = "DefaultMaterial";
+                rawMatProps.reset(new RawTraditionalMatProps(RAW_SHADING_MODEL_LAMBERT,
+                    Vec3f(0, 0, 0), Vec4f(.5, .5, .5, 1), Vec3f(0, 0, 0), Vec3f(0, 0, 0), 0.5));
 
-            const auto maybeAddTexture = [&](const FbxFileTexture *tex, RawTextureUsage usage) {
-                if (tex != nullptr) {
-                    // dig out the inferred filename from the textureLocations map
-                    FbxString inferredPath = textureLocations.find(tex)->second;
-                    textures[usage] = raw.AddTexture(tex->GetName(), tex->GetFileName(), inferredPath.Buffer(), usage);
-                }
-            };
-
-            std::shared_ptr<RawMatProps> matInfo;
-            if (fbxMaterial->shadingModel == FbxRoughMetMaterialInfo::FBX_SHADER_METROUGH) {
-                FbxRoughMetMaterialInfo *fbxMatInfo = static_cast<FbxRoughMetMaterialInfo *>(fbxMaterial.get());
-
-                maybeAddTexture(fbxMatInfo->texColor, RAW_TEXTURE_USAGE_ALBEDO);
-                maybeAddTexture(fbxMatInfo->texNormal, RAW_TEXTURE_USAGE_NORMAL);
-                maybeAddTexture(fbxMatInfo->texEmissive, RAW_TEXTURE_USAGE_EMISSIVE);
-                maybeAddTexture(fbxMatInfo->texRoughness, RAW_TEXTURE_USAGE_ROUGHNESS);
-                maybeAddTexture(fbxMatInfo->texMetallic, RAW_TEXTURE_USAGE_METALLIC);
-                maybeAddTexture(fbxMatInfo->texAmbientOcclusion, RAW_TEXTURE_USAGE_OCCLUSION);
-                rawMatProps.reset(new RawMetRoughMatProps(
-                    RAW_SHADING_MODEL_PBR_MET_ROUGH, toVec4f(fbxMatInfo->colBase), toVec3f(fbxMatInfo->colEmissive),
-                    fbxMatInfo->emissiveIntensity, fbxMatInfo->metallic, fbxMatInfo->roughness));
             } else {
+                materialName = fbxMaterial->name;
+
+                const auto maybeAddTexture = [&](const FbxFileTexture *tex, RawTextureUsage usage) {
+                    if (tex != nullptr) {
+                        // dig out the inferred filename from the textureLocations map
+                        FbxString inferredPath = textureLocations.find(tex)->second;
+                        std::string name, fileName;
+                        {
+                            std::lock_guard<std::mutex> lock(sdkMutex);
+                            name = tex->GetName();
+                            fileName = tex->GetFileName();
+                        }
+                        textures[usage] = textureCache.AddTexture(raw, name, fileName, inferredPath.Buffer(), usage);
+                    }
+                };
 
-                FbxTraditionalMaterialInfo *fbxMatInfo = static_cast<FbxTraditionalMaterialInfo *>(fbxMaterial.get());
-                RawShadingModel shadingModel;
-                if (fbxMaterial->shadingModel == "Lambert") {
-                    shadingModel = RAW_SHADING_MODEL_LAMBERT;
-                } else if (fbxMaterial->shadingModel == "Blinn") {
-                    shadingModel = RAW_SHADING_MODEL_BLINN;
-                } else if (fbxMaterial->shadingModel == "Phong") {
-                    shadingModel = RAW_SHADING_MODEL_PHONG;
-                } else if (fbxMaterial->shadingModel == "Constant") {
-                    shadingModel = RAW_SHADING_MODEL_PHONG;
+                std::shared_ptr<RawMatProps> matInfo;
+                if (fbxMaterial->shadingModel == FbxRoughMetMaterialInfo::FBX_SHADER_METROUGH) {
+                    FbxRoughMetMaterialInfo *fbxMatInfo = static_cast<FbxRoughMetMaterialInfo *>(fbxMaterial.get());
+
+                    maybeAddTexture(fbxMatInfo->texColor, RAW_TEXTURE_USAGE_ALBEDO);
+                    maybeAddTexture(fbxMatInfo->texNormal, RAW_TEXTURE_USAGE_NORMAL);
+                    maybeAddTexture(fbxMatInfo->texEmissive, RAW_TEXTURE_USAGE_EMISSIVE);
+                    maybeAddTexture(fbxMatInfo->texRoughness, RAW_TEXTURE_USAGE_ROUGHNESS);
+                    maybeAddTexture(fbxMatInfo->texMetallic, RAW_TEXTURE_USAGE_METALLIC);
+                    maybeAddTexture(fbxMatInfo->texAmbientOcclusion, RAW_TEXTURE_USAGE_OCCLUSION);
+                    rawMatProps.reset(new RawMetRoughMatProps(
+                        RAW_SHADING_MODEL_PBR_MET_ROUGH, toVec4f(fbxMatInfo->colBase), toVec3f(fbxMatInfo->colEmissive),
+                        fbxMatInfo->emissiveIntensity, fbxMatInfo->metallic, fbxMatInfo->roughness));
                 } else {
-                    shadingModel = RAW_SHADING_MODEL_UNKNOWN;
+
+                    FbxTraditionalMaterialInfo *fbxMatInfo = static_cast<FbxTraditionalMaterialInfo *>(fbxMaterial.get());
+                    RawShadingModel shadingModel;
+                    if (fbxMaterial->shadingModel == "Lambert") {
+                        shadingModel = RAW_SHADING_MODEL_LAMBERT;
+                    } else if (fbxMaterial->shadingModel == "Blinn") {
+                        shadingModel = RAW_SHADING_MODEL_BLINN;
+                    } else if (fbxMaterial->shadingModel == "Phong") {
+                        shadingModel = RAW_SHADING_MODEL_PHONG;
+                    } else if (fbxMaterial->shadingModel == "Constant") {
+                        shadingModel = RAW_SHADING_MODEL_PHONG;
+                    } else {
+                        shadingModel = RAW_SHADING_MODEL_UNKNOWN;
+                    }
+                    maybeAddTexture(fbxMatInfo->texDiffuse, RAW_TEXTURE_USAGE_DIFFUSE);
+                    maybeAddTexture(fbxMatInfo->texNormal, RAW_TEXTURE_USAGE_NORMAL);
+                    maybeAddTexture(fbxMatInfo->texEmissive, RAW_TEXTURE_USAGE_EMISSIVE);
+                    maybeAddTexture(fbxMatInfo->texShininess, RAW_TEXTURE_USAGE_SHININESS);
+                    maybeAddTexture(fbxMatInfo->texAmbient, RAW_TEXTURE_USAGE_AMBIENT);
+                    maybeAddTexture(fbxMatInfo->texSpecular, RAW_TEXTURE_USAGE_SPECULAR);
+                    rawMatProps.reset(new RawTraditionalMatProps(shadingModel,
+                        toVec3f(fbxMatInfo->colAmbient), toVec4f(fbxMatInfo->colDiffuse), toVec3f(fbxMatInfo->colEmissive),
+                        toVec3f(fbxMatInfo->colSpecular), fbxMatInfo->shininess));
                 }
-                maybeAddTexture(fbxMatInfo->texDiffuse, RAW_TEXTURE_USAGE_DIFFUSE);
-                maybeAddTexture(fbxMatInfo->texNormal, RAW_TEXTURE_USAGE_NORMAL);
-                maybeAddTexture(fbxMatInfo->texEmissive, RAW_TEXTURE_USAGE_EMISSIVE);
-                maybeAddTexture(fbxMatInfo->texShininess, RAW_TEXTURE_USAGE_SHININESS);
-                maybeAddTexture(fbxMatInfo->texAmbient, RAW_TEXTURE_USAGE_AMBIENT);
-                maybeAddTexture(fbxMatInfo->texSpecular, RAW_TEXTURE_USAGE_SPECULAR);
-                rawMatProps.reset(new RawTraditionalMatProps(shadingModel,
-                    toVec3f(fbxMatInfo->colAmbient), toVec4f(fbxMatInfo->colDiffuse), toVec3f(fbxMatInfo->colEmissive),
-                    toVec3f(fbxMatInfo->colSpecular), fbxMatInfo->shininess));
             }
         }
+        const MeshMaterial &meshMaterial = materialIt->second;
+        const int *textures = meshMaterial.textures;
 
-        RawVertex rawVertices[3];
         bool vertexTransparency = false;
         for (int vertexIndex = 0; vertexIndex < 3; vertexIndex++, polygonVertexIndex++) {
-            const int controlPointIndex = pMesh->GetPolygonVertex(polygonIndex, vertexIndex);
+            const int controlPointIndex = polygonVertices[polygonVertexIndex];
 
             // Note that the default values here must be the same as the RawVertex default values!
             const FbxVector4 fbxPosition = transform.MultNormalize(controlPoints[controlPointIndex]);
@@ -906,6 +975,7 @@ static void ReadMesh(RawModel &raw, FbxScene *pScene, FbxNode *pNode, const std:
 
             rawSurface.bounds.AddPoint(vertex.position);
 
+            vertex.blends.clear();
             if (!targetShapes.empty()) {
                 vertex.blendSurfaceIx = rawSurfaceIndex;
                 for (const auto *targetShape : targetShapes) {
@@ -981,8 +1051,11 @@ static void ReadMesh(RawModel &raw, FbxScene *pScene, FbxNode *pNode, const std:
             rawVertexIndices[vertexIndex] = raw.AddVertex(rawVertices[vertexIndex]);
         }
 
-        const RawMaterialType materialType = GetMaterialType(raw, textures, vertexTransparency, skinning.IsSkinned());
-        const int rawMaterialIndex = raw.AddMaterial(materialName, materialType, textures, rawMatProps);
+        int &rawMaterialIndex = materialIt->second.materialIndices[vertexTransparency ? 1 : 0];
+        if (rawMaterialIndex < 0) {
+            const RawMaterialType materialType = GetMaterialType(raw, textures, vertexTransparency, skinning.IsSkinned());
+            rawMaterialIndex = raw.AddMaterial(meshMaterial.name, materialType, textures, meshMaterial.props);
+        }
 
         raw.AddTriangle(rawVertexIndices[0], rawVertexIndices[1], rawVertexIndices[2], rawMaterialIndex, rawSurfaceIndex);
     }
@@ -1004,15 +1077,92 @@ static void ReadCamera(RawModel &raw, FbxScene *pScene, FbxNode *pNode)
     }
 }
 
+// A mesh to read and the id of the surface it becomes.
+struct MeshNode
+{
+    FbxNode *pNode;
+    long    surfaceId;
+};
+
+// The nodes to import when only some subtrees are: true for the nodes of those subtrees, false for their ancestors,
+// which only keep their transforms. Empty when the whole scene is imported.
+typedef std::unordered_map<const FbxNode *, bool> FbxNodeSelection;
+
+static bool IsNodeSelected(const FbxNodeSelection &selection, const FbxNode *pNode)
+{
+    return selection.empty() || selection.find(pNode) != selection.end();
+}
+
+static bool IsNodeContentSelected(const FbxNodeSelection &selection, const FbxNode *pNode)
+{
+    auto it = selection.find(pNode);
+    return selection.empty() || (it != selection.end() && it->second);
+}
+
+static void SelectSubtree(FbxNodeSelection &selection, FbxNode *pNode)
+{
+    selection[pNode] = true;
+    for (int child = 0; child < pNode->GetChildCount(); child++) {
+        SelectSubtree(selection, pNode->GetChild(child));
+    }
+}
+
+static void SelectAncestors(FbxNodeSelection &selection, FbxNode *pNode)
+{
+    for (FbxNode *pParent = pNode->GetParent(); pParent != nullptr; pParent = pParent->GetParent()) {
+        selection.emplace(pParent, false);
+    }
+}
+
+// The skins of a subtree bind joints that may lie outside of it, those keep their transforms so the skins resolve.
+static void SelectSkinJoints(FbxNodeSelection &selection, FbxNode *pNode)
+{
+    const FbxGeometry *pGeometry = FbxCast<FbxGeometry>(pNode->GetNodeAttribute());
+    if (pGeometry != nullptr) {
+        for (int deformerIndex = 0; deformerIndex < pGeometry->GetDeformerCount(FbxDeformer::eSkin); deformerIndex++) {
+            FbxSkin *skin = static_cast<FbxSkin *>(pGeometry->GetDeformer(deformerIndex, FbxDeformer::eSkin));
+            for (int clusterIndex = 0; clusterIndex < skin->GetClusterCount(); clusterIndex++) {
+                FbxNode *pLink = skin->GetCluster(clusterIndex)->GetLink();
+                if (pLink != nullptr) {
+                    selection.emplace(pLink, false);
+                    SelectAncestors(selection, pLink);
+                }
+            }
+        }
+    }
+    for (int child = 0; child < pNode->GetChildCount(); child++) {
+        SelectSkinJoints(selection, pNode->GetChild(child));
+    }
+}
+
+static bool SelectNodes(FbxNodeSelection &selection, FbxScene *pScene, const std::vector<std::string> &nodeNames)
+{
+    for (const std::string &nodeName : nodeNames) {
+        FbxNode *pNode = pScene->FindNodeByName(nodeName.c_str());
+        if (pNode == nullptr) {
+            fmt::fprintf(stderr, "ERROR:: No node named %s\n", nodeName);
+            return false;
+        }
+        SelectSubtree(selection, pNode);
+        SelectAncestors(selection, pNode);
+    }
+    // After every subtree, so a joint in one of them keeps its content
+    for (const std::string &nodeName : nodeNames) {
+        SelectSkinJoints(selection, pScene->FindNodeByName(nodeName.c_str()));
+    }
+    return true;
+}
+
 static void ReadNodeAttributes(
-    RawModel &raw, FbxScene *pScene, FbxNode *pNode, const std::map<const FbxTexture *, FbxString> &textureLocations)
+    RawModel &raw, FbxScene *pScene, FbxNode *pNode, const FbxNodeSelection &selection, const FbxLoadOptions &options,
+    std::vector<MeshNode> &meshNodes, std::unordered_map<long, FbxAMatrix> &meshTransforms)
 {
-    if (!pNode->GetVisibility()) {
+    if (!pNode->GetVisibility() || !IsNodeSelected(selection, pNode)) {
         return;
     }
 
     FbxNodeAttribute *pNodeAttribute = pNode->GetNodeAttribute();
-    if (pNodeAttribute != nullptr) {
+    if (pNodeAttribute != nullptr && IsNodeContentSelected(selection, pNode)) {
         const FbxNodeAttribute::EType attributeType = pNodeAttribute->GetAttributeType();
         switch (attributeType) {
             case FbxNodeAttribute::eMesh:
@@ -1020,11 +1170,39 @@ static void ReadNodeAttributes(
             case FbxNodeAttribute::eNurbsSurface:
             case FbxNodeAttribute::eTrimNurbsSurface:
             case FbxNodeAttribute::ePatch: {
-                ReadMesh(raw, pScene, pNode, textureLocations);
+                // Triangulating replaces the node attribute, so it happens here rather than on the mesh readers.
+                FbxGeometryConverter meshConverter(pScene->GetFbxManager());
+                meshConverter.Triangulate(pNode->GetNodeAttribute(), true);
+                const long meshId = pNode->GetMesh()->GetUniqueID();
+
+                // Nodes that share a mesh share its surface, which is read once and drawn by all of them, as long as
+                // they agree on the geometric transform baked into the vertices. A node that doesn't gets its own copy.
+                const FbxAMatrix geometricTransform(
+                    pNode->GetGeometricTranslation(FbxNode::eSourcePivot),
+                    pNode->GetGeometricRotation(FbxNode::eSourcePivot),
+                    pNode->GetGeometricScaling(FbxNode::eSourcePivot));
+                auto it = meshTransforms.emplace(meshId, geometricTransform);
+
+                long surfaceId = meshId;
+                if (it.second) {
+                    meshNodes.push_back(MeshNode { pNode, surfaceId });
+                } else if (it.first->second != geometricTransform) {
+                    surfaceId = pNode->GetUniqueID();
+                    meshNodes.push_back(MeshNode { pNode, surfaceId });
+                }
+
+                // Associate the node to this surface
+                int nodeId = raw.GetNodeById(pNode->GetUniqueID());
+                if (nodeId >= 0) {
+                    RawNode &node = raw.GetNode(nodeId);
+                    node.surfaceId = surfaceId;
+                }
                 break;
             }
             case FbxNodeAttribute::eCamera: {
-                ReadCamera(raw, pScene, pNode);
+                if (options.importCameras) {
+                    ReadCamera(raw, pScene, pNode);
+                }
                 break;
             }
             case FbxNodeAttribute::eUnknown:
@@ -1049,7 +1227,47 @@ static void ReadNodeAttributes(
     }
 
     for (int child = 0; child < pNode->GetChildCount(); child++) {
-        ReadNodeAttributes(raw, pScene, pNode->GetChild(child), textureLocations);
+        ReadNodeAttributes(raw, pScene, pNode->GetChild(child), selection, options, meshNodes, meshTransforms);
+    }
+}
+
+static void ReadNodeAttributes(
+    RawModel &raw, FbxScene *pScene, FbxNode *pNode, const std::map<const FbxTexture *, FbxString> &textureLocations,
+    const FbxNodeSelection &selection, const FbxLoadOptions &options)
+{
+    std::vector<MeshNode> meshNodes;
+    std::unordered_map<long, FbxAMatrix> meshTransforms;
+    ReadNodeAttributes(raw, pScene, pNode, selection, options, meshNodes, meshTransforms);
+    const int jobs = options.jobs;
+
+    if (verboseOutput) {
+        int meshNodeCount = 0;
+        for (int nodeIndex = 0; nodeIndex < raw.GetNodeCount(); nodeIndex++) {
+            meshNodeCount += (raw.GetNode(nodeIndex).surfaceId != 0) ? 1 : 0;
+        }
+        fmt::printf("%d mesh nodes share %d meshes.\n", meshNodeCount, (int) meshNodes.size());
+    }
+
+    // Every mesh is read into a shard of its own on up to jobs threads. The shards are merged in scene order,
+    // which gives the same model as reading the meshes one after the other into the scene model.
+    std::vector<RawModel> shards(meshNodes.size());
+    TextureCache textureCache;
+    std::mutex sdkMutex;
+
+    ThreadUtils::ParallelFor((int) meshNodes.size(), jobs, [&](int meshIndex) {
+        const MeshNode &meshNode = meshNodes[meshIndex];
+        ProfileUtils::ScopedTimer timer("readMesh");
+        ReadMesh(shards[meshIndex], raw, pScene, meshNode.pNode, meshNode.surfaceId, meshIndex, textureLocations, textureCache, sdkMutex);
+    });
+
+    for (RawModel &shard : shards) {
+        for (int surfaceIndex = 0; surfaceIndex < shard.GetSurfaceCount(); surfaceIndex++) {
+            for (const long jointId : shard.GetSurface(surfaceIndex).jointIds) {
+                raw.GetNode(raw.GetNodeById(jointId)).isJoint = true;
+            }
+        }
+        raw.Append(shard);
+        shard = RawModel();
     }
 }
 
@@ -1057,13 +1275,11 @@ static void ReadNodeAttributes(
  * Compute the local scale vector to use for a given node. This is an imperfect hack to cope with
  * the FBX node transform's eInheritRrs inheritance type, in which ancestral scale is ignored
  */
-static FbxVector4 computeLocalScale(FbxNode *pNode, FbxTime pTime = FBXSDK_TIME_INFINITE)
+static FbxVector4 computeLocalScale(FbxNode *pNode, const FbxAMatrix &localTransform)
 {
-    const FbxVector4 lScale = pNode->EvaluateLocalTransform(pTime).GetS();
-
     if (pNode->GetParent() == nullptr ||
         pNode->GetTransform().GetInheritType() != FbxTransform::eInheritRrs) {
-        return lScale;
+        return localTransform.GetS();
     }
     // This is a very partial fix that is only correct for models that use identity scale in their rig's joints.
     // We could write better support that compares local scale to parent's global scale and apply the ratio to
@@ -1072,8 +1288,13 @@ static FbxVector4 computeLocalScale(FbxNode *pNode, FbxTime pTime = FBXSDK_TIME_
     return FbxVector4(1, 1, 1, 1);
 }
 
+static FbxVector4 computeLocalScale(FbxNode *pNode, FbxTime pTime = FBXSDK_TIME_INFINITE)
+{
+    return computeLocalScale(pNode, pNode->EvaluateLocalTransform(pTime));
+}
+
 static void ReadNodeHierarchy(
-    RawModel &raw, FbxScene *pScene, FbxNode *pNode,
+    RawModel &raw, FbxScene *pScene, FbxNode *pNode, const FbxNodeSelection &selection,
     const long parentId, const std::string &path)
 {
     const FbxUInt64 nodeId = pNode->GetUniqueID();
@@ -1089,8 +1310,8 @@ static void ReadNodeHierarchy(
         fmt::printf("node %d: %s\n", nodeIndex, newPath.c_str());
     }
 
-    static int warnRrSsCount = 0;
-    static int warnRrsCount  = 0;
+    static std::atomic<int> warnRrSsCount(0);
+    static std::atomic<int> warnRrsCount(0);
     if (lInheritType == FbxTransform::eInheritRrSs && parentId) {
         if (++warnRrSsCount == 1) {
             fmt::printf("Warning: node %s uses unsupported transform inheritance type 'eInheritRrSs'.\n", newPath);
@@ -1130,15 +1351,180 @@ static void ReadNodeHierarchy(
     }
 
     for (int child = 0; child < pNode->GetChildCount(); child++) {
-        ReadNodeHierarchy(raw, pScene, pNode->GetChild(child), nodeId, newPath);
+        if (IsNodeSelected(selection, pNode->GetChild(child))) {
+            ReadNodeHierarchy(raw, pScene, pNode->GetChild(child), selection, nodeId, newPath);
+        }
+    }
+}
+
+// A node that has curves in the current animation stack, gathered before any of it is sampled.
+struct AnimatedNode
+{
+    FbxNode                               *pNode;
+    int                                   nodeIndex;
+    bool                                  hasTransformCurves;
+    std::shared_ptr<FbxBlendShapesAccess> blendShapes;
+    std::vector<FbxAnimCurve *>           shapeCurves; // one per blend channel, may be null
+};
+
+static bool HasTransformCurves(FbxNode *pNode, FbxAnimStack *pAnimStack)
+{
+    FbxProperty properties[] = {
+        pNode->LclTranslation, pNode->LclRotation, pNode->LclScaling,
+        pNode->PreRotation, pNode->PostRotation,
+        pNode->RotationOffset, pNode->RotationPivot, pNode->ScalingOffset, pNode->ScalingPivot
+    };
+    for (FbxProperty &property : properties) {
+        if (property.GetCurveNode(pAnimStack) != nullptr) {
+            return true;
+        }
     }
+    return false;
 }
 
-static void ReadAnimations(RawModel &raw, FbxScene *pScene)
-{    
-    FbxTime::EMode eMode = FbxTime::eFrames24;
+// Samples one node at the given times, returns whether anything of it changes. Only the given evaluator and the
+// curves of this node are used, so different nodes can be sampled concurrently with an evaluator each.
+static bool SampleAnimatedNode(RawChannel &channel, const AnimatedNode &animatedNode, FbxAnimEvaluator *evaluator, const std::vector<FbxTime> &sampleTimes)
+{
     const double epsilon = 1e-5f;
 
+    FbxNode *pNode = animatedNode.pNode;
+    bool hasTranslation = false;
+    bool hasRotation    = false;
+    bool hasScale       = false;
+    bool hasMorphs      = false;
+
+    channel.nodeIndex = animatedNode.nodeIndex;
+
+    if (animatedNode.hasTransformCurves) {
+        const FbxAMatrix    baseTransform   = evaluator->GetNodeLocalTransform(pNode, FBXSDK_TIME_INFINITE);
+        const FbxVector4    baseTranslation = baseTransform.GetT();
+        const FbxQuaternion baseRotation    = baseTransform.GetQ();
+        const FbxVector4    baseScaling     = computeLocalScale(pNode, baseTransform);
+
+        for (const FbxTime &pTime : sampleTimes) {
+            const FbxAMatrix    localTransform   = evaluator->GetNodeLocalTransform(pNode, pTime);
+            const FbxVector4    localTranslation = localTransform.GetT();
+            const FbxQuaternion localRotation    = localTransform.GetQ();
+            const FbxVector4    localScale       = computeLocalScale(pNode, localTransform);
+
+            hasTranslation |= (
+                fabs(localTranslation[0] - baseTranslation[0]) > epsilon ||
+                fabs(localTranslation[1] - baseTranslation[1]) > epsilon ||
+                fabs(localTranslation[2] - baseTranslation[2]) > epsilon);
+            hasRotation |= (
+                fabs(localRotation[0] - baseRotation[0]) > epsilon ||
+                fabs(localRotation[1] - baseRotation[1]) > epsilon ||
+                fabs(localRotation[2] - baseRotation[2]) > epsilon ||
+                fabs(localRotation[3] - baseRotation[3]) > epsilon);
+            hasScale |= (
+                fabs(localScale[0] - baseScaling[0]) > epsilon ||
+                fabs(localScale[1] - baseScaling[1]) > epsilon ||
+                fabs(localScale[2] - baseScaling[2]) > epsilon);
+
+            channel.translations.push_back(toVec3f(localTranslation) * scaleFactor);
+            channel.rotations.push_back(toQuatf(localRotation));
+            channel.scales.push_back(toVec3f(localScale));
+        }
+    }
+
+    if (animatedNode.blendShapes != nullptr) {
+        const FbxBlendShapesAccess &blendShapes = *animatedNode.blendShapes;
+        // The last key of every curve, passed in so the curves keep no evaluation state of their own
+        std::vector<int> lastKeys(blendShapes.GetChannelCount(), 0);
+
+        for (const FbxTime &pTime : sampleTimes) {
+            for (size_t channelIx = 0; channelIx < blendShapes.GetChannelCount(); channelIx++) {
+                FbxAnimCurve *curve = animatedNode.shapeCurves[channelIx];
+                float influence = (curve != nullptr) ? curve->Evaluate(pTime, &lastKeys[channelIx]) : 0; // 0-100
+
+                int targetCount = static_cast<int>(blendShapes.GetTargetShapeCount(channelIx));
+
+                // the target shape 'fullWeight' values are a strictly ascending list of floats (between
+                // 0 and 100), forming a sequence of intervals -- this convenience function figures out if
+                // 'p' lays between some certain target fullWeights, and if so where (from 0 to 1).
+                auto findInInterval = [&](const double p, const int n) {
+                    if (n >= targetCount) {
+                        // p is certainly completely left of this interval
+                        return NAN;
+                    }
+                    double leftWeight = 0;
+                    if (n >= 0) {
+                        leftWeight = blendShapes.GetTargetShape(channelIx, n).fullWeight;
+                        if (p < leftWeight) {
+                            return NAN;
+                        }
+                        // the first interval implicitly includes all lesser influence values
+                    }
+                    double rightWeight = blendShapes.GetTargetShape(channelIx, n+1).fullWeight;
+                    if (p > rightWeight && n+1 < targetCount-1) {
+                        return NAN;
+                        // the last interval implicitly includes all greater influence values
+                    }
+                    // transform p linearly such that [leftWeight, rightWeight] => [0, 1]
+                    return static_cast<float>((p - leftWeight) / (rightWeight - leftWeight));
+                };
+
+                for (int targetIx = 0; targetIx < targetCount; targetIx++) {
+                    if (curve) {
+                        float result = findInInterval(influence, targetIx-1);
+                        if (!isnan(result)) {
+                            // we're transitioning into targetIx
+                            channel.weights.push_back(result);
+                            hasMorphs = true;
+                            continue;
+                        }
+                        if (targetIx != targetCount-1) {
+                            result = findInInterval(influence, targetIx);
+                            if (!isnan(result)) {
+                                // we're transitioning AWAY from targetIx
+                                channel.weights.push_back(1.0f - result);
+                                hasMorphs = true;
+                                continue;
+                            }
+                        }
+                    }
+
+                    // this is here because we have to fill in a weight for every channelIx/targetIx permutation,
+                    // regardless of whether or not they participate in this animation.
+                    channel.weights.push_back(0.0f);
+                }
+            }
+        }
+    }
+
+    if (!hasTranslation) {
+        channel.translations.clear();
+    }
+    if (!hasRotation) {
+        channel.rotations.clear();
+    }
+    if (!hasScale) {
+        channel.scales.clear();
+    }
+    if (!hasMorphs) {
+        channel.weights.clear();
+    }
+    return hasTranslation || hasRotation || hasScale || hasMorphs;
+}
+
+static double GetAnimationFrameRate(FbxScene *pScene, const double frameRate)
+{
+    if (frameRate > 0.0) {
+        return frameRate;
+    }
+    const FbxTime::EMode timeMode = pScene->GetGlobalSettings().GetTimeMode();
+    if (timeMode == FbxTime::eCustom) {
+        return pScene->GetGlobalSettings().GetCustomFrameRate();
+    }
+    const double sourceFrameRate = FbxTime::GetFrameRate(timeMode);
+    return (sourceFrameRate > 0.0) ? sourceFrameRate : 24.0;
+}
+
+static void ReadAnimations(RawModel &raw, FbxScene *pScene, const FbxLoadOptions &options)
+{
+    const double frameRate = GetAnimationFrameRate(pScene, options.animationFrameRate);
+
     const int animationCount = pScene->GetSrcObjectCount<FbxAnimStack>();
     for (size_t animIx = 0; animIx < animationCount; animIx++) {
         FbxAnimStack *pAnimStack = pScene->GetSrcObject<FbxAnimStack>(animIx);
@@ -1146,6 +1532,11 @@ static void ReadAnimations(RawModel &raw, FbxScene *pScene)
 
         pScene->SetCurrentAnimationStack(pAnimStack);
 
+        if (!options.takeNames.empty() &&
+            std::find(options.takeNames.begin(), options.takeNames.end(), std::string(animStackName)) == options.takeNames.end()) {
+            continue;
+        }
+
         FbxTakeInfo *takeInfo = pScene->GetTakeInfo(animStackName);
         if (takeInfo == nullptr) {
             fmt::printf("Warning:: animation '%s' has no Take information. Skipping.\n", animStackName);
@@ -1162,195 +1553,140 @@ static void ReadAnimations(RawModel &raw, FbxScene *pScene)
         RawAnimation animation;
         animation.name = animStackName;
 
-        FbxLongLong firstFrameIndex = start.GetFrameCount(eMode);
-        FbxLongLong lastFrameIndex  = end.GetFrameCount(eMode);
-        for (FbxLongLong frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; frameIndex++) {
-            FbxTime pTime;
-            // first frame is always at t = 0.0
-            pTime.SetFrame(frameIndex - firstFrameIndex, eMode);
-            animation.times.emplace_back((float) pTime.GetSecondDouble());
+        // Samples at the frame rate, the first frame is always at t = 0.0
+        const double startSeconds = start.GetSecondDouble();
+        const int frameCount = (int) floor((end.GetSecondDouble() - startSeconds) * frameRate + 1e-6) + 1;
+        std::vector<FbxTime> sampleTimes(std::max(frameCount, 1));
+        for (int frameIndex = 0; frameIndex < (int) sampleTimes.size(); frameIndex++) {
+            sampleTimes[frameIndex].SetSecondDouble(startSeconds + frameIndex / frameRate);
+            animation.times.emplace_back((float) (frameIndex / frameRate));
         }
 
-        size_t totalSizeInBytes = 0;
-
+        // Only nodes with curves in this stack are sampled; collecting them touches the scene, so it is serial.
+        std::vector<AnimatedNode> animatedNodes;
         const int nodeCount = pScene->GetNodeCount();
         for (int nodeIndex = 0; nodeIndex < nodeCount; nodeIndex++) {
             FbxNode *pNode = pScene->GetNode(nodeIndex);
-            const FbxAMatrix    baseTransform   = pNode->EvaluateLocalTransform();
-            const FbxVector4    baseTranslation = baseTransform.GetT();
-            const FbxQuaternion baseRotation    = baseTransform.GetQ();
-            const FbxVector4    baseScaling     = computeLocalScale(pNode);
-            bool hasTranslation = false;
-            bool hasRotation    = false;
-            bool hasScale       = false;
-            bool hasMorphs      = false;
-
-            RawChannel channel;
-            channel.nodeIndex = raw.GetNodeById(pNode->GetUniqueID());
-
-            for (FbxLongLong frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; frameIndex++) {
-                FbxTime pTime;
-                pTime.SetFrame(frameIndex, eMode);
-
-                const FbxAMatrix    localTransform   = pNode->EvaluateLocalTransform(pTime);
-                const FbxVector4    localTranslation = localTransform.GetT();
-                const FbxQuaternion localRotation    = localTransform.GetQ();
-                const FbxVector4    localScale       = computeLocalScale(pNode, pTime);
-
-                hasTranslation |= (
-                    fabs(localTranslation[0] - baseTranslation[0]) > epsilon ||
-                    fabs(localTranslation[1] - baseTranslation[1]) > epsilon ||
-                    fabs(localTranslation[2] - baseTranslation[2]) > epsilon);
-                hasRotation |= (
-                    fabs(localRotation[0] - baseRotation[0]) > epsilon ||
-                    fabs(localRotation[1] - baseRotation[1]) > epsilon ||
-                    fabs(localRotation[2] - baseRotation[2]) > epsilon ||
-                    fabs(localRotation[3] - baseRotation[3]) > epsilon);
-                hasScale |= (
-                    fabs(localScale[0] - baseScaling[0]) > epsilon ||
-                    fabs(localScale[1] - baseScaling[1]) > epsilon ||
-                    fabs(localScale[2] - baseScaling[2]) > epsilon);
-
-                channel.translations.push_back(toVec3f(localTranslation) * scaleFactor);
-                channel.rotations.push_back(toQuatf(localRotation));
-                channel.scales.push_back(toVec3f(localScale));
+
+            AnimatedNode animatedNode;
+            animatedNode.pNode = pNode;
+            animatedNode.nodeIndex = raw.GetNodeById(pNode->GetUniqueID());
+            if (animatedNode.nodeIndex < 0) {
+                // not imported
+                continue;
             }
+            animatedNode.hasTransformCurves = HasTransformCurves(pNode, pAnimStack);
 
-            std::vector<FbxAnimCurve *> shapeAnimCurves;
             FbxNodeAttribute *nodeAttr = pNode->GetNodeAttribute();
             if (nodeAttr != nullptr && nodeAttr->GetAttributeType() == FbxNodeAttribute::EType::eMesh) {
-                // it's inelegant to recreate this same access class multiple times, but it's also dirt cheap...
-                FbxBlendShapesAccess blendShapes(static_cast<FbxMesh *>(nodeAttr));
-
-                for (FbxLongLong frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex; frameIndex++) {
-                    FbxTime pTime;
-                    pTime.SetFrame(frameIndex, eMode);
-
-                    for (size_t channelIx = 0; channelIx < blendShapes.GetChannelCount(); channelIx++) {
-                        FbxAnimCurve *curve = blendShapes.GetAnimation(channelIx, animIx);
-                        float influence = (curve != nullptr) ? curve->Evaluate(pTime) : 0; // 0-100
-
-                        int targetCount = static_cast<int>(blendShapes.GetTargetShapeCount(channelIx));
-
-                        // the target shape 'fullWeight' values are a strictly ascending list of floats (between
-                        // 0 and 100), forming a sequence of intervals -- this convenience function figures out if
-                        // 'p' lays between some certain target fullWeights, and if so where (from 0 to 1).
-                        auto findInInterval = [&](const double p, const int n) {
-                            if (n >= targetCount) {
-                                // p is certainly completely left of this interval
-                                return NAN;
-                            }
-                            double leftWeight = 0;
-                            if (n >= 0) {
-                                leftWeight = blendShapes.GetTargetShape(channelIx, n).fullWeight;
-                                if (p < leftWeight) {
-                                    return NAN;
-                                }
-                                // the first interval implicitly includes all lesser influence values
-                            }
-                            double rightWeight = blendShapes.GetTargetShape(channelIx, n+1).fullWeight;
-                            if (p > rightWeight && n+1 < targetCount-1) {
-                                return NAN;
-                                // the last interval implicitly includes all greater influence values
-                            }
-                            // transform p linearly such that [leftWeight, rightWeight] => [0, 1]
-                            return static_cast<float>((p - leftWeight) / (rightWeight - leftWeight));
-                        };
-
-                        for (int targetIx = 0; targetIx < targetCount; targetIx++) {
-                            if (curve) {
-                                float result = findInInterval(influence, targetIx-1);
-                                if (!isnan(result)) {
-                                    // we're transitioning into targetIx
-                                    channel.weights.push_back(result);
-                                    hasMorphs = true;
-                                    continue;
-                                }
-                                if (targetIx != targetCount-1) {
-                                    result = findInInterval(influence, targetIx);
-                                    if (!isnan(result)) {
-                                        // we're transitioning AWAY from targetIx
-                                        channel.weights.push_back(1.0f - result);
-                                        hasMorphs = true;
-                                        continue;
-                                    }
-                                }
-                            }
-
-                            // this is here because we have to fill in a weight for every channelIx/targetIx permutation,
-                            // regardless of whether or not they participate in this animation.
-                            channel.weights.push_back(0.0f);
-                        }
-                    }
+                animatedNode.blendShapes = std::make_shared<FbxBlendShapesAccess>(static_cast<FbxMesh *>(nodeAttr));
+                for (size_t channelIx = 0; channelIx < animatedNode.blendShapes->GetChannelCount(); channelIx++) {
+                    animatedNode.shapeCurves.push_back(animatedNode.blendShapes->GetAnimation(channelIx, animIx));
+                }
+                if (animatedNode.shapeCurves.empty()) {
+                    animatedNode.blendShapes.reset();
                 }
             }
 
-            if (hasTranslation || hasRotation || hasScale || hasMorphs) {
-                if (!hasTranslation) {
-                    channel.translations.clear();
-                }
-                if (!hasRotation) {
-                    channel.rotations.clear();
-                }
-                if (!hasScale) {
-                    channel.scales.clear();
-                }
-                if (!hasMorphs) {
-                    channel.weights.clear();
-                }
+            if (animatedNode.hasTransformCurves || animatedNode.blendShapes != nullptr) {
+                animatedNodes.push_back(animatedNode);
+            }
+        }
+
+        // Every worker samples whole nodes with an evaluator of its own, so no evaluation cache is shared
+        const int workerCount = std::max(std::min(ThreadUtils::GetJobCount(options.jobs), (int) animatedNodes.size()), 1);
+        std::vector<FbxAnimEvaluator *> evaluators(workerCount);
+        evaluators[0] = pScene->GetAnimationEvaluator();
+        for (int worker = 1; worker < workerCount; worker++) {
+            evaluators[worker] = FbxAnimEvalClassic::Create(pScene, "");
+        }
 
-                animation.channels.emplace_back(channel);
+        std::vector<RawChannel> channels(animatedNodes.size());
+        std::vector<uint8_t> animated(animatedNodes.size(), 0);
+        std::atomic<int> nextNode(0);
+        std::atomic<int> sampledNodes(0);
 
-                totalSizeInBytes += channel.translations.size() * sizeof(channel.translations[0]) +
-                                    channel.rotations.size() * sizeof(channel.rotations[0]) +
-                                    channel.scales.size() * sizeof(channel.scales[0]) +
-                                    channel.weights.size() * sizeof(channel.weights[0]);
+        ThreadUtils::ParallelFor(workerCount, workerCount, [&](int worker) {
+            for (int index = nextNode++; index < (int) animatedNodes.size(); index = nextNode++) {
+                animated[index] = SampleAnimatedNode(channels[index], animatedNodes[index], evaluators[worker], sampleTimes) ? 1 : 0;
+
+                const int sampled = ++sampledNodes;
+                if (verboseOutput && worker == 0) {
+                    fmt::printf("\ranimation %d: %s (%d%%)", animIx, (const char *) animStackName, sampled * 100 / (int) animatedNodes.size());
+                }
             }
+        });
 
-            if (verboseOutput) {
-                fmt::printf("\ranimation %d: %s (%d%%)", animIx, (const char *) animStackName, nodeIndex * 100 / nodeCount);
+        for (int worker = 1; worker < workerCount; worker++) {
+            evaluators[worker]->Destroy();
+        }
+
+        // Channels keep the order of the scene nodes, whichever worker sampled them
+        size_t totalSizeInBytes = 0;
+        for (size_t index = 0; index < channels.size(); index++) {
+            if (animated[index] == 0) {
+                continue;
             }
+            const RawChannel &channel = channels[index];
+            totalSizeInBytes += channel.translations.size() * sizeof(channel.translations[0]) +
+                                channel.rotations.size() * sizeof(channel.rotations[0]) +
+                                channel.scales.size() * sizeof(channel.scales[0]) +
+                                channel.weights.size() * sizeof(channel.weights[0]);
+            animation.channels.emplace_back(std::move(channels[index]));
         }
 
         raw.AddAnimation(animation);
 
         if (verboseOutput) {
             fmt::printf(
-                "\ranimation %d: %s (%d channels, %3.1f MB)\n", animIx, (const char *) animStackName,
-                (int) animation.channels.size(), (float) totalSizeInBytes * 1e-6f);
+                "\ranimation %d: %s (%d of %d nodes animated, %d channels, %3.1f MB)\n", animIx, (const char *) animStackName,
+                (int) animatedNodes.size(), nodeCount, (int) animation.channels.size(), (float) totalSizeInBytes * 1e-6f);
         }
     }
 }
 
-static std::string GetInferredFileName(const std::string &fbxFileName, const std::string &directory, const std::vector<std::string> &directoryFileList)
+// Case folded lookup of texture files by file name and by extension-less base name, built once per load.
+// Folders added first win, and within the index any file name match wins over a base name match.
+class TextureFileIndex
 {
-    if (FileUtils::FileExists(fbxFileName)) {
-        return fbxFileName;
+public:
+    void AddFolder(const std::string &folder, const std::vector<std::string> &fileList)
+    {
+        for (const std::string &file : fileList) {
+            const std::string path = folder + file;
+            const std::string fileName = StringUtils::GetFileNameString(file);
+            fileNames.emplace(StringUtils::ToLower(fileName), path);
+            fileBases.emplace(StringUtils::ToLower(StringUtils::GetFileBaseString(fileName)), path);
+        }
     }
-    // Get the file name with file extension.
-    const std::string fileName = StringUtils::GetFileNameString(StringUtils::GetCleanPathString(fbxFileName));
 
-    // Try to find a match with extension.
-    for (const auto &file : directoryFileList) {
-        if (StringUtils::CompareNoCase(fileName, file) == 0) {
-            return std::string(directory) + file;
+    std::string Find(const std::string &fbxFileName) const
+    {
+        if (FileUtils::FileExists(fbxFileName)) {
+            return fbxFileName;
         }
-    }
+        // Get the file name with file extension.
+        const std::string fileName = StringUtils::GetFileNameString(StringUtils::GetCleanPathString(fbxFileName));
 
-    // Get the file name without file extension.
-    const std::string fileBase = StringUtils::GetFileBaseString(fileName);
+        // Try to find a match with extension.
+        auto it = fileNames.find(StringUtils::ToLower(fileName));
+        if (it != fileNames.end()) {
+            return it->second;
+        }
 
-    // Try to find a match without file extension.
-    for (const auto &file : directoryFileList) {
-        // If the two extension-less base names match.
-        if (StringUtils::CompareNoCase(fileBase, StringUtils::GetFileBaseString(file)) == 0) {
-            // Return the name with extension of the file in the directory.
-            return std::string(directory) + file;
+        // Try to find a match without file extension, and return the name with extension of the file in the directory.
+        it = fileBases.find(StringUtils::ToLower(StringUtils::GetFileBaseString(fileName)));
+        if (it != fileBases.end()) {
+            return it->second;
         }
+
+        return "";
     }
 
-    return "";
-}
+private:
+    std::unordered_map<std::string, std::string> fileNames;
+    std::unordered_map<std::string, std::string> fileBases;
+};
 
 /*
     The texture file names inside of the FBX often contain some long author-specific
@@ -1363,7 +1699,8 @@ static std::string GetInferredFileName(const std::string &fbxFileName, const std
 */
 static void
 FindFbxTextures(
-    FbxScene *pScene, const char *fbxFileName, const char *extensions, std::map<const FbxTexture *, FbxString> &textureLocations)
+    FbxScene *pScene, const char *fbxFileName, const char *extensions, const std::vector<std::string> &textureSearchPaths,
+    std::map<const FbxTexture *, FbxString> &textureLocations)
 {
     // Get the folder the FBX file is in.
     const std::string folder = StringUtils::GetFolderString(fbxFileName);
@@ -1374,8 +1711,16 @@ FindFbxTextures(
     // Search either in the folder with embedded textures or in the same folder as the FBX file.
     const std::string searchFolder = FileUtils::FolderExists(fbmFolderName) ? fbmFolderName : folder;
 
-    // Get a list with all the texture files from either the folder with embedded textures or the same folder as the FBX file.
-    std::vector<std::string> fileList = FileUtils::ListFolderFiles(searchFolder.c_str(), extensions);
+    // Index all the texture files from either the folder with embedded textures or the same folder as the FBX file,
+    // then those anywhere below the configured texture search paths.
+    TextureFileIndex fileIndex;
+    fileIndex.AddFolder(searchFolder, FileUtils::ListFolderFiles(searchFolder.c_str(), extensions));
+    for (std::string searchPath : textureSearchPaths) {
+        if (!searchPath.empty() && searchPath.back() != '/' && searchPath.back() != '\\') {
+            searchPath += '/';
+        }
+        fileIndex.AddFolder(searchPath, FileUtils::ListFolderFilesRecursive(searchPath.c_str(), extensions));
+    }
 
     // Try to match the FBX texture names with the actual files on disk.
     for (int i = 0; i < pScene->GetTextureCount(); i++) {
@@ -1383,7 +1728,7 @@ FindFbxTextures(
         if (pFileTexture == nullptr) {
             continue;
         }
-        const std::string inferredName = GetInferredFileName(pFileTexture->GetFileName(), searchFolder, fileList);
+        const std::string inferredName = fileIndex.Find(pFileTexture->GetFileName());
         if (inferredName.empty()) {
             fmt::printf("Warning: could not find a local image file for texture: %s.\n"
             "Original filename: %s\n", pFileTexture->GetName(), pFileTexture->GetFileName());
@@ -1393,11 +1738,39 @@ FindFbxTextures(
     }
 }
 
-bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExtensions)
+// The manager a thread keeps between files, destroyed when the thread exits
+struct FbxThreadManager
+{
+    FbxManager *pManager { nullptr };
+
+    ~FbxThreadManager()
+    {
+        if (pManager != nullptr) {
+            pManager->Destroy();
+        }
+    }
+};
+
+static thread_local FbxThreadManager threadManager;
+
+bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExtensions, const FbxLoadOptions &options)
 {
-    FbxManager    *pManager    = FbxManager::Create();
-    FbxIOSettings *pIoSettings = FbxIOSettings::Create(pManager, IOSROOT);
-    pManager->SetIOSettings(pIoSettings);
+    // Creating a manager loads the SDK plugins, which costs more than reading a small file
+    FbxManager *pManager = options.reuseManager ? threadManager.pManager : nullptr;
+    if (pManager == nullptr) {
+        pManager = FbxManager::Create();
+        pManager->SetIOSettings(FbxIOSettings::Create(pManager, IOSROOT));
+        if (options.reuseManager) {
+            threadManager.pManager = pManager;
+        }
+    }
+    FbxIOSettings *pIoSettings = pManager->GetIOSettings();
+
+    auto releaseManager = [&]() {
+        if (options.reuseManager == false) {
+            pManager->Destroy();
+        }
+    };
 
     FbxImporter *pImporter = FbxImporter::Create(pManager, "");
 
@@ -1406,44 +1779,76 @@ bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExte
             fmt::printf("%s\n", pImporter->GetStatus().GetErrorString());
         }
         pImporter->Destroy();
-        pManager->Destroy();
+        releaseManager();
         return false;
     }
 
+    // Takes that aren't wanted are never read from the file
+    pIoSettings->SetBoolProp(IMP_FBX_ANIMATION, options.importAnimations);
+    if (options.importAnimations && !options.takeNames.empty()) {
+        for (int takeIndex = 0; takeIndex < pImporter->GetAnimStackCount(); takeIndex++) {
+            FbxTakeInfo *takeInfo = pImporter->GetTakeInfo(takeIndex);
+            takeInfo->mSelect = std::find(
+                options.takeNames.begin(), options.takeNames.end(), std::string(takeInfo->mName.Buffer())) != options.takeNames.end();
+        }
+    }
+
     FbxScene *pScene = FbxScene::Create(pManager, "fbxScene");
-    pImporter->Import(pScene);
+    {
+        ProfileUtils::ScopedTimer timer("fbxImport");
+        pImporter->Import(pScene);
+    }
     pImporter->Destroy();
 
     if (pScene == nullptr) {
-        pImporter->Destroy();
-        pManager->Destroy();
+        releaseManager();
         return false;
     }
 
-    std::map<const FbxTexture *, FbxString> textureLocations;
-    FindFbxTextures(pScene, fbxFileName, textureExtensions, textureLocations);
+    FbxNodeSelection selection;
+    if (!SelectNodes(selection, pScene, options.nodeNames)) {
+        pScene->Destroy();
+        releaseManager();
+        return false;
+    }
 
-    // Use Y up for glTF
-    FbxAxisSystem::MayaYUp.ConvertScene(pScene);
+    std::map<const FbxTexture *, FbxString> textureLocations;
+    FindFbxTextures(pScene, fbxFileName, textureExtensions, options.textureSearchPaths, textureLocations);
 
-    // FBX's internal unscaled unit is centimetres, and if you choose not to work in that unit,
-    // you will find scaling transfgrms on all the children of the root node. Those transforms are
-    // superfluous and cause a lot of people a lot of trouble. Luckily we can get rid of them by
-    // converting to CM here (which just gets rid of the scaling), and then we pre-multiply the
-    // scale factor into every vertex position (and related attributes) instead.
-    FbxSystemUnit sceneSystemUnit = pScene->GetGlobalSettings().GetSystemUnit();
-    if (sceneSystemUnit != FbxSystemUnit::cm) {
-        FbxSystemUnit::cm.ConvertScene(pScene);
+    {
+        ProfileUtils::ScopedTimer timer("convertScene");
+
+        // Use Y up for glTF
+        FbxAxisSystem::MayaYUp.ConvertScene(pScene);
+
+        // FBX's internal unscaled unit is centimetres, and if you choose not to work in that unit,
+        // you will find scaling transfgrms on all the children of the root node. Those transforms are
+        // superfluous and cause a lot of people a lot of trouble. Luckily we can get rid of them by
+        // converting to CM here (which just gets rid of the scaling), and then we pre-multiply the
+        // scale factor into every vertex position (and related attributes) instead.
+        FbxSystemUnit sceneSystemUnit = pScene->GetGlobalSettings().GetSystemUnit();
+        if (sceneSystemUnit != FbxSystemUnit::cm) {
+            FbxSystemUnit::cm.ConvertScene(pScene);
+        }
+        // this is always 0.01, but let's opt for clarity. Set once, files may be loaded on several threads.
+        std::call_once(scaleFactorFlag, []() { scaleFactor = FbxSystemUnit::m.GetConversionFactorFrom(FbxSystemUnit::cm); });
     }
-    // this is always 0.01, but let's opt for clarity.
-    scaleFactor = FbxSystemUnit::m.GetConversionFactorFrom(FbxSystemUnit::cm);
 
-    ReadNodeHierarchy(raw, pScene, pScene->GetRootNode(), 0, "");
-    ReadNodeAttributes(raw, pScene, pScene->GetRootNode(), textureLocations);
-    ReadAnimations(raw, pScene);
+    {
+        ProfileUtils::ScopedTimer timer("readNodeHierarchy");
+        ReadNodeHierarchy(raw, pScene, pScene->GetRootNode(), selection, 0, "");
+    }
+    {
+        ProfileUtils::ScopedTimer timer("readNodeAttributes");
+        ReadNodeAttributes(raw, pScene, pScene->GetRootNode(), textureLocations, selection, options);
+    }
+    if (options.importAnimations) {
+        ProfileUtils::ScopedTimer timer("readAnimations");
+        ReadAnimations(raw, pScene, options);
+    }
 
     pScene->Destroy();
-    pManager->Destroy();
+    releaseManager();
 
     return true;
 }
@@ -12,6 +12,29 @@
 
 #include "RawModel.h"
 
-bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExtensions);
+/**
+ * User-supplied options that dictate how an FBX file is read into a RawModel.
+ */
+struct FbxLoadOptions
+{
+    /** Number of threads to read meshes and sample animations on, zero or less uses one per hardware thread. */
+    int jobs { 1 };
+    /** Frames per second to sample animations at, zero samples at the frame rate of the source. */
+    double animationFrameRate { 0.0 };
+    /** Folders searched recursively for textures not found next to the FBX file. */
+    std::vector<std::string> textureSearchPaths;
+    /** Whether to read the animation takes of the file. */
+    bool importAnimations { true };
+    /** Whether to read the cameras of the scene. */
+    bool importCameras { true };
+    /** Names of the nodes whose subtrees are imported, their ancestors only keep their transforms; empty imports all. */
+    std::vector<std::string> nodeNames;
+    /** Names of the animation takes to import; empty imports all. */
+    std::vector<std::string> takeNames;
+    /** Whether the FbxManager of the calling thread is kept for the next file it loads, rather than made per file. */
+    bool reuseManager { false };
+};
+
+bool LoadFBXFile(RawModel &raw, const char *fbxFileName, const char *textureExtensions, const FbxLoadOptions &options = FbxLoadOptions());
 
 #endif // !__FBX2RAW_H__
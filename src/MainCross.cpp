@@ -12,41 +12,641 @@
 #include <map>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <cctype>
+#include <exception>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+#include <mutex>
+#include <future>
 
 #if defined( __unix__ ) || defined( __APPLE__ )
 
 #include <sys/stat.h>
+#include <unistd.h>
 
 #define _stricmp strcasecmp
 #endif
 
+#if defined( _WIN32 )
+#include <io.h>
+#endif
+
 #include <cxxopts.hpp>
+#include <json.hpp>
 
 #include "FBX2glTF.h"
 #include "utils/String_Utils.h"
 #include "utils/File_Utils.h"
+#include "utils/Image_Utils.h"
+#include "utils/Memory_Utils.h"
+#include "utils/Profile_Utils.h"
+#include "utils/Thread_Utils.h"
 #include "Fbx2Raw.h"
 #include "Raw2Cross.h"
+#include "Raw2Gltf.h"
+#include "BuildCache.h"
 
 bool verboseOutput = true;
 
-int main(int argc, char *argv[])
+struct ConvertJob
 {
 	std::string inputPath;
 	std::string outputPath;
-	std::vector<std::function<Vec2f(Vec2f)>> texturesTransforms;
+};
+
+// The files a conversion read besides the FBX file, and the files it wrote
+struct ConvertRecord
+{
+	std::vector<std::string> textureFiles;
+	std::vector<std::string> outputFiles;
+};
+
+static bool ReadManifest(const std::string &manifestPath, std::vector<std::string> &inputPaths)
+{
+	std::ifstream stream(manifestPath);
+	if (!stream.good()) {
+		return false;
+	}
+
+	// One FBX file or folder per line, blank lines and lines starting with # are skipped
+	std::string line;
+	while (std::getline(stream, line)) {
+		line.erase(std::find_if(line.rbegin(), line.rend(), [](char c) { return !isspace((unsigned char)c); }).base(), line.end());
+		line.erase(line.begin(), std::find_if(line.begin(), line.end(), [](char c) { return !isspace((unsigned char)c); }));
+		if (line.empty() == false && line[0] != '#') {
+			inputPaths.push_back(line);
+		}
+	}
+	return true;
+}
+
+// Folders are searched recursively for FBX files, with an output folder their layout is mirrored in it
+static bool CreateConvertJobs(const std::vector<std::string> &inputPaths, const std::string &outputPath, std::vector<ConvertJob> &jobs)
+{
+	for (const std::string &inputPath : inputPaths) {
+		if (FileUtils::FolderExists(inputPath) == false) {
+			jobs.push_back({ inputPath, outputPath.empty() ? StringUtils::GetFolderString(inputPath) : outputPath });
+			continue;
+		}
+
+		std::vector<std::string> fileNames = FileUtils::ListFolderFilesRecursive(inputPath.c_str(), "fbx");
+		if (fileNames.empty()) {
+			fmt::fprintf(stderr, "ERROR:: No FBX files in folder: %s\n", inputPath.c_str());
+			return false;
+		}
+		std::sort(fileNames.begin(), fileNames.end());
+
+		for (const std::string &fileName : fileNames) {
+			const std::string folderName = StringUtils::GetFolderString(fileName);
+			jobs.push_back({ inputPath + "/" + fileName, outputPath.empty() ? inputPath + "/" + folderName : outputPath + "/" + folderName });
+		}
+	}
+
+	for (ConvertJob &job : jobs) {
+		if (job.outputPath.empty()) {
+			job.outputPath = "./";
+		}
+	}
+	return true;
+}
+
+/**
+ * The arguments that shape the outputs of a conversion, part of its build cache key. The inputs, the output folder and
+ * the options that only change how the run goes are left out.
+ */
+static std::string DescribeConversion(const std::vector<std::string> &arguments, const std::vector<std::string> &inputPaths)
+{
+	static const char *skippedOptions[] = {
+		"-i", "--input", "-o", "--output", "--manifest", "--batch-jobs", "-j", "--jobs", "--profile", "--texture-cache", "--build-cache"
+	};
+	static const char *skippedFlags[] = { "--server" };
+
+	std::string description = "FBX2Mesh 1.0";
+	for (size_t index = 0; index < arguments.size(); index++) {
+		const std::string &argument = arguments[index];
+		const std::string name = argument.substr(0, argument.find('='));
+
+		if (std::find(std::begin(skippedOptions), std::end(skippedOptions), name) != std::end(skippedOptions)) {
+			// The value is the next argument unless given as --name=value
+			index += argument.find('=') == std::string::npos ? 1 : 0;
+			continue;
+		}
+		if (std::find(std::begin(skippedFlags), std::end(skippedFlags), argument) != std::end(skippedFlags) ||
+			std::find(inputPaths.begin(), inputPaths.end(), argument) != inputPaths.end()) {
+			continue;
+		}
+		description += "\n" + argument;
+	}
+	return description;
+}
+
+static bool IsSnapshotFile(const std::string &path)
+{
+	return StringUtils::CompareNoCase(StringUtils::GetFileSuffixString(path), "rawmodel") == 0;
+}
+
+// With writeSnapshot the imported model is also written as <name>.rawmodel next to the outputs
+static bool ConvertFile(const std::string &inputPath, const std::string &outputPath, const CrossOptions &crossOptions, const FbxLoadOptions &loadOptions, const RawTextureTransform &texturesTransform, bool writeSnapshot, ConvertRecord &record)
+{
+	RawModel rawModel;
+
+	// A snapshot is the model as an earlier run imported it, the FBX SDK is not involved and the load options are
+	// the ones of that run
+	const bool fromSnapshot = IsSnapshotFile(inputPath);
+	if (fromSnapshot) {
+		if (verboseOutput) {
+			fmt::printf("Loading snapshot: %s\n", inputPath);
+		}
+
+		ProfileUtils::ScopedTimer timer("loadSnapshot");
+		if (rawModel.LoadSnapshot(inputPath.c_str()) == false) {
+			fmt::fprintf(stderr, "ERROR:: Failed to load snapshot: %s\n", inputPath.c_str());
+			return false;
+		}
+	}
+	else {
+		if (verboseOutput) {
+			fmt::printf("Loading FBX File: %s\n", inputPath);
+		}
+
+		if (LoadFBXFile(rawModel, inputPath.c_str(), "tga;bmp;png;jpg;jpeg", loadOptions) == false) {
+			fmt::fprintf(stderr, "ERROR:: Failed to parse FBX: %s\n", inputPath.c_str());
+			return false;
+		}
+	}
+
+	// Before any export option touches the model, so the snapshot can be exported with any of them
+	const std::string snapshotFileName = outputPath + "/" + StringUtils::GetFileBaseString(inputPath) + ".rawmodel";
+	if (writeSnapshot && fromSnapshot == false) {
+		ProfileUtils::ScopedTimer timer("saveSnapshot");
+		if (rawModel.SaveSnapshot(snapshotFileName.c_str()) == false) {
+			fmt::fprintf(stderr, "ERROR:: Failed to write snapshot: %s\n", snapshotFileName.c_str());
+			return false;
+		}
+	}
+
+	for (int indexTexture = 0; indexTexture < rawModel.GetTextureCount(); indexTexture++) {
+		const std::string &fileLocation = rawModel.GetTexture(indexTexture).fileLocation;
+		if (fileLocation.empty() == false && std::find(record.textureFiles.begin(), record.textureFiles.end(), fileLocation) == record.textureFiles.end()) {
+			record.textureFiles.push_back(fileLocation);
+		}
+	}
+
+	rawModel.TransformTextures(texturesTransform);
+
+	if (crossOptions.animationTolerance > 0.0f) {
+		ProfileUtils::ScopedTimer timer("reduceKeyframes");
+		const size_t droppedKeys = rawModel.ReduceKeyframes(crossOptions.animationTolerance, crossOptions.animationWeightTolerance, crossOptions.jobs);
+		if (verboseOutput) {
+			fmt::printf("Dropped %zu animation keys\n", droppedKeys);
+		}
+	}
+
+	if (crossOptions.weldPositionTolerance > 0.0f) {
+		ProfileUtils::ScopedTimer timer("weldVertices");
+		const size_t weldedCount = rawModel.WeldVertices(crossOptions.weldPositionTolerance, crossOptions.weldNormalAngle, crossOptions.weldTexcoordTolerance);
+		if (verboseOutput) {
+			fmt::printf("Welded %zu vertices\n", weldedCount);
+		}
+	}
+
+	if (crossOptions.removeDegenerateTriangles) {
+		ProfileUtils::ScopedTimer timer("removeDegenerateTriangles");
+		std::vector<int> surfaceDropCounts;
+		const size_t droppedCount = rawModel.RemoveDegenerateTriangles(crossOptions.degenerateMinArea, crossOptions.degenerateMinAngle, surfaceDropCounts);
+		if (verboseOutput) {
+			for (int indexSurface = 0; indexSurface < rawModel.GetSurfaceCount(); indexSurface++) {
+				if (surfaceDropCounts[indexSurface] > 0) {
+					fmt::printf("Dropped %d degenerate triangles from %s\n", surfaceDropCounts[indexSurface], rawModel.GetSurface(indexSurface).name);
+				}
+			}
+			fmt::printf("Dropped %zu degenerate triangles\n", droppedCount);
+		}
+		ProfileUtils::AddCount("degenerateTriangles", droppedCount);
+	}
+
+	{
+		ProfileUtils::ScopedTimer timer("condense");
+		rawModel.Condense();
+	}
+	{
+		ProfileUtils::ScopedTimer timer("transformGeometry");
+		rawModel.TransformGeometry(crossOptions.computeNormals, crossOptions.computeTangents, crossOptions.jobs);
+	}
+
+	char szFName[_MAX_PATH] = { 0 };
+	char szFileName[_MAX_PATH] = { 0 };
+	char szMeshBinFileName[_MAX_PATH] = { 0 };
+	char szMeshXMLFileName[_MAX_PATH] = { 0 };
+	char szSceneFileName[_MAX_PATH] = { 0 };
+	splitfilename(inputPath.c_str(), szFName, NULL);
+	sprintf(szFileName, "%s.mesh", szFName);
+	sprintf(szMeshBinFileName, "%s/%s.mesh", outputPath.c_str(), szFName);
+	sprintf(szMeshXMLFileName, "%s/%s.xml", outputPath.c_str(), szFName);
+	sprintf(szSceneFileName, "%s/%s.scene", outputPath.c_str(), szFName);
+
+	if (crossOptions.atlasMaxTextureSize > 0) {
+		ProfileUtils::ScopedTimer timer("createTextureAtlases");
+		const bool flipV = texturesTransform.m[1][1] < 0.0f;
+		const int atlasedCount = CreateTextureAtlases(rawModel, (outputPath + "/").c_str(), szFName, flipV, crossOptions);
+		if (verboseOutput) {
+			fmt::printf("Moved %d materials to texture atlases\n", atlasedCount);
+		}
+	}
+
+	if (crossOptions.staticBatching) {
+		ProfileUtils::ScopedTimer timer("createStaticBatches");
+		const int batchedCount = CreateStaticBatches(rawModel, crossOptions);
+		rawModel.Condense();
+		if (verboseOutput) {
+			fmt::printf("Batched %d static nodes\n", batchedCount);
+		}
+	}
+
+	if (crossOptions.flattenHierarchy) {
+		ProfileUtils::ScopedTimer timer("flattenHierarchy");
+		const int flattenedCount = FlattenHierarchy(rawModel, crossOptions);
+		if (verboseOutput) {
+			fmt::printf("Flattened %d nodes\n", flattenedCount);
+		}
+	}
+
+	ProfileUtils::AddCount("vertices", rawModel.GetVertexCount());
+	ProfileUtils::AddCount("triangles", rawModel.GetTriangleCount());
+	ProfileUtils::AddCount("nodes", rawModel.GetNodeCount());
+	ProfileUtils::AddCount("animations", rawModel.GetAnimationCount());
+
+	// The glTF model is built from the same processed model as the Cross files, which only read it from here on until
+	// streaming releases its geometry; a deferred export runs when its result is asked for
+	std::vector<std::string> gltfFiles;
+	std::future<bool> gltfExport;
+	if (crossOptions.gltfFormat != GltfFormatOptions::NONE) {
+		GltfOptions gltfOptions = crossOptions.gltfOptions;
+		gltfOptions.outputBinary = crossOptions.gltfFormat == GltfFormatOptions::GLB;
+		gltfOptions.useLongIndices = crossOptions.useLongIndices;
+		gltfOptions.jobs = crossOptions.jobs;
+		const std::string gltfFolder = gltfOptions.outputBinary ? std::string() : outputPath + "/" + szFName + "_gltf/";
+		const std::string gltfFileName = gltfOptions.outputBinary ? outputPath + "/" + szFName + ".glb" : gltfFolder + szFName + ".gltf";
+
+		// FBX2glTF always flips V while the Cross files only do with --flip-v, the other exports keep reading the model
+		// so the glTF model flips a copy
+		const bool flipV = texturesTransform.m[1][1] > 0.0f;
+
+		gltfExport = std::async(crossOptions.parallelExports ? std::launch::async : std::launch::deferred, [&rawModel, &gltfFiles, gltfOptions, gltfFolder, gltfFileName, flipV]() {
+			ProfileUtils::ScopedTimer timer("exportGltf");
+			if (FileUtils::CreatePath(gltfFileName.c_str()) == false) {
+				fmt::fprintf(stderr, "ERROR:: Failed to create folder: %s\n", gltfFileName.c_str());
+				return false;
+			}
+			if (flipV) {
+				RawModel gltfModel(rawModel);
+				gltfModel.TransformTextures(RawTextureTransform::FlipV());
+				return ExportGltf(gltfFileName, gltfFolder, gltfModel, gltfOptions, gltfFiles);
+			}
+			return ExportGltf(gltfFileName, gltfFolder, rawModel, gltfOptions, gltfFiles);
+		});
+	}
+
+	std::vector<RawModel> rawMaterialModels;
+	{
+		ProfileUtils::ScopedTimer timer("createMaterialModels");
+		// Normals and colors are read by every material, the texture coordinates and binormals only by textured ones
+		const int keepAttribs = crossOptions.subMeshFormats ?
+			RAW_VERTEX_ATTRIBUTE_AUTO | RAW_VERTEX_ATTRIBUTE_POSITION | RAW_VERTEX_ATTRIBUTE_NORMAL | RAW_VERTEX_ATTRIBUTE_COLOR : -1;
+		rawModel.CreateMaterialModels(rawMaterialModels, crossOptions.useLongIndices == UseLongIndicesOptions::NEVER, keepAttribs, true, crossOptions.jobs, crossOptions.maxPaletteJoints);
+	}
+
+	if (crossOptions.sortSubMeshes) {
+		ProfileUtils::ScopedTimer timer("sortSubMeshes");
+		SortSubMeshes(rawModel, rawMaterialModels, crossOptions);
+	}
+
+	if (crossOptions.streaming) {
+		// Only the material models are exported, the nodes, surfaces and materials are still needed
+		if (gltfExport.valid()) {
+			gltfExport.wait();
+		}
+		rawModel.ReleaseGeometry();
+	}
+
+	std::vector<int> materialModelLODs;
+	{
+		ProfileUtils::ScopedTimer timer("createLODModels");
+		CreateLODModels(rawMaterialModels, materialModelLODs, rawModel, crossOptions);
+	}
+	ProfileUtils::AddCount("submeshes", rawMaterialModels.size());
+
+	if (verboseOutput) {
+		for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+			if (materialModelLODs[indexMesh] > 0) {
+				fmt::printf("Generated %s: %d triangles\n", rawMaterialModels[indexMesh].GetSurface(0).name, rawMaterialModels[indexMesh].GetTriangleCount());
+			}
+		}
+	}
+
+	// Streaming releases the geometry the format is selected from
+	const unsigned int meshFormat = GetMeshFormat(rawModel, rawMaterialModels, crossOptions);
+	const std::vector<unsigned int> materialFormats = GetMaterialFormats(meshFormat, rawModel, rawMaterialModels, crossOptions);
+
+	{
+		ProfileUtils::ScopedTimer timer("exportMesh");
+		if (ExportMesh(szMeshBinFileName, rawModel, rawMaterialModels, crossOptions) == false) {
+			fmt::fprintf(stderr, "ERROR:: Failed to export mesh: %s\n", szMeshBinFileName);
+			return false;
+		}
+	}
+
+	std::vector<std::string> textureFileNames;
+	std::vector<std::string> materialFileNames;
+	ExportTextures(outputPath.c_str(), rawModel, crossOptions, textureFileNames);
+	ClearImagePixels();
+
+	{
+		ProfileUtils::ScopedTimer timer("exportMaterial");
+		ExportMaterial(outputPath.c_str(), rawModel, materialFormats, textureFileNames, crossOptions, materialFileNames);
+	}
+
+	std::vector<std::string> animationFileNames;
+	for (int indexAnimation = 0; indexAnimation < rawModel.GetAnimationCount(); indexAnimation++) {
+		const RawAnimation &animation = rawModel.GetAnimation(indexAnimation);
+		const std::string animationFileName = GetAnimationFileName((outputPath + "/").c_str(), szFName, animation);
+
+		ProfileUtils::ScopedTimer timer("exportAnimation");
+		if (ExportAnimation(animationFileName.c_str(), rawModel, animation, crossOptions) == false) {
+			fmt::fprintf(stderr, "ERROR:: Failed to export animation: %s\n", animationFileName.c_str());
+			return false;
+		}
+
+		animationFileNames.push_back(GetAnimationFileName("", szFName, animation));
+	}
+
+	std::shared_ptr<SceneGraph> pScene;
+	{
+		ProfileUtils::ScopedTimer timer("createSceneGraph");
+		pScene = CreateSceneGraph(szFileName, rawModel, rawMaterialModels, materialModelLODs, materialFileNames, animationFileNames, crossOptions);
+	}
+
+	if (crossOptions.sceneFormat != SceneFormatOptions::BINARY) {
+		ProfileUtils::ScopedTimer timer("exportMeshXML");
+		if (ExportMeshXML(szMeshXMLFileName, *pScene, crossOptions) == false) {
+			fmt::fprintf(stderr, "ERROR:: Failed to export mesh XML: %s\n", szMeshXMLFileName);
+			return false;
+		}
+	}
+
+	if (crossOptions.sceneFormat != SceneFormatOptions::XML) {
+		ProfileUtils::ScopedTimer timer("exportScene");
+		if (ExportScene(szSceneFileName, *pScene, crossOptions) == false) {
+			fmt::fprintf(stderr, "ERROR:: Failed to export scene: %s\n", szSceneFileName);
+			return false;
+		}
+	}
+
+	if (gltfExport.valid() && gltfExport.get() == false) {
+		fmt::fprintf(stderr, "ERROR:: Failed to export glTF: %s\n", inputPath.c_str());
+		return false;
+	}
+
+	// Materials and textures without a library are named relative to the output folder, atlases are textures that
+	// were not read from the FBX file
+	std::vector<std::string> outputFiles = { szMeshBinFileName };
+	if (crossOptions.meshMetrics) {
+		outputFiles.push_back(GetMeshMetricsFileName(szMeshBinFileName));
+	}
+	if (writeSnapshot && fromSnapshot == false) {
+		outputFiles.push_back(snapshotFileName);
+	}
+	if (crossOptions.sceneFormat != SceneFormatOptions::BINARY) {
+		outputFiles.push_back(szMeshXMLFileName);
+		outputFiles.push_back(StringUtils::GetFolderString(szMeshXMLFileName) + szFName + ".instances");
+	}
+	if (crossOptions.sceneFormat != SceneFormatOptions::XML) {
+		outputFiles.push_back(szSceneFileName);
+	}
+	outputFiles.insert(outputFiles.end(), gltfFiles.begin(), gltfFiles.end());
+	for (const std::string &animationFileName : animationFileNames) {
+		outputFiles.push_back(outputPath + "/" + animationFileName);
+	}
+	for (const std::string &fileName : materialFileNames) {
+		outputFiles.push_back(crossOptions.libraryPath.empty() ? outputPath + fileName : fileName);
+	}
+	for (const std::string &fileName : textureFileNames) {
+		outputFiles.push_back(crossOptions.libraryPath.empty() ? outputPath + fileName : fileName);
+	}
+	for (int indexTexture = 0; indexTexture < rawModel.GetTextureCount(); indexTexture++) {
+		const std::string &fileLocation = rawModel.GetTexture(indexTexture).fileLocation;
+		if (std::find(record.textureFiles.begin(), record.textureFiles.end(), fileLocation) == record.textureFiles.end()) {
+			outputFiles.push_back(fileLocation);
+		}
+	}
+
+	for (const std::string &fileName : outputFiles) {
+		if (fileName.empty() == false && FileUtils::FileExists(fileName) &&
+			std::find(record.outputFiles.begin(), record.outputFiles.end(), fileName) == record.outputFiles.end()) {
+			record.outputFiles.push_back(fileName);
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Converts the jobs read from stdin until it ends, one JSON object per line: {"id": <any>, "input": <path>, "output":
+ * <folder>}, id and output being optional. The input is a file or a folder, as with --input, and every file of a job is
+ * reported on its own. Up to workerCount files convert at once, a worker reads the next line once it is free. Progress
+ * and results are written to stdout as one JSON object per line, whatever else is printed goes to stderr:
+ *
+ *   {"event": "ready", "workers": <count>}
+ *   {"event": "started", "id": <id>, "input": <file>}
+ *   {"event": "finished", "id": <id>, "input": <file>, "success": <bool>, "upToDate": <bool>, "seconds": <time>, "outputs": [<file>]}
+ *   {"event": "error", "id": <id>, "message": <text>}
+ */
+static void RunServer(int workerCount, const std::function<bool(const ConvertJob &, ConvertRecord &, bool &)> &runJob)
+{
+	fflush(stdout);
+	FILE *protocol = fdopen(dup(fileno(stdout)), "w");
+	if (protocol == nullptr || dup2(fileno(stderr), fileno(stdout)) < 0) {
+		fmt::fprintf(stderr, "ERROR:: Failed to set up the server output\n");
+		return;
+	}
+
+	std::mutex inputMutex;
+	std::mutex outputMutex;
+	const auto send = [&](const nlohmann::json &message) {
+		std::lock_guard<std::mutex> lock(outputMutex);
+		fmt::fprintf(protocol, "%s\n", message.dump());
+		fflush(protocol);
+	};
+
+	send({ { "event", "ready" }, { "workers", workerCount } });
+
+	ThreadUtils::ParallelFor(workerCount, workerCount, [&](int) {
+		std::string line;
+		for (;;) {
+			{
+				std::lock_guard<std::mutex> lock(inputMutex);
+				if (!std::getline(std::cin, line)) {
+					return;
+				}
+			}
+			if (line.find_first_not_of(" \t\r") == std::string::npos) {
+				continue;
+			}
+
+			nlohmann::json request;
+			try {
+				request = nlohmann::json::parse(line);
+			} catch (const std::exception &exception) {
+				send({ { "event", "error" }, { "id", nullptr }, { "message", std::string("Invalid JSON: ") + exception.what() } });
+				continue;
+			}
+
+			const nlohmann::json id = (request.is_object() && request.find("id") != request.end()) ? request["id"] : nlohmann::json();
+			if (request.is_object() == false || request.find("input") == request.end() || request["input"].is_string() == false ||
+				(request.find("output") != request.end() && request["output"].is_string() == false)) {
+				send({ { "event", "error" }, { "id", id }, { "message", "A job is an object with an input path and an optional output folder" } });
+				continue;
+			}
+
+			std::vector<ConvertJob> jobs;
+			const std::string output = request.find("output") != request.end() ? request["output"].get<std::string>() : std::string();
+			if (CreateConvertJobs({ request["input"].get<std::string>() }, output, jobs) == false) {
+				send({ { "event", "error" }, { "id", id }, { "message", "No FBX files in folder" } });
+				continue;
+			}
+
+			for (const ConvertJob &job : jobs) {
+				send({ { "event", "started" }, { "id", id }, { "input", job.inputPath } });
+				const auto start = std::chrono::steady_clock::now();
+
+				ConvertRecord record;
+				bool upToDate;
+				const bool success = runJob(job, record, upToDate);
+				send({
+					{ "event", "finished" },
+					{ "id", id },
+					{ "input", job.inputPath },
+					{ "success", success },
+					{ "upToDate", upToDate },
+					{ "seconds", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() },
+					{ "outputs", record.outputFiles }
+				});
+			}
+		}
+	});
+
+	fclose(protocol);
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> inputPaths;
+	std::string outputPath;
+	std::string manifestPath;
+	std::string buildCachePath;
+	bool writeSnapshot = false;
+	bool server = false;
+	int batchJobs = 0;
+	RawTextureTransform texturesTransform;
+	CrossOptions crossOptions;
+	FbxLoadOptions loadOptions;
+	std::string profilePath;
+	std::string textureCachePath;
 
 	cxxopts::Options options(
 		"FBX2Mesh",
 		"FBX2Mesh 1.0: Generate a Mesh representation of an FBX model.");
 
 	options.add_options()
-		("i,input", "The FBX model to convert.", cxxopts::value<std::string>(inputPath))
+		("i,input", "The FBX models or .rawmodel snapshots to convert, or folders of FBX models; may be repeated.", cxxopts::value<std::vector<std::string>>(inputPaths))
 		("o,output", "Where to generate the output, without suffix.", cxxopts::value<std::string>(outputPath))
+		("manifest", "File listing the FBX models or folders to convert, one per line.", cxxopts::value<std::string>(manifestPath))
+		("batch-jobs", "Number of files converted at once, 0 uses one per hardware thread.", cxxopts::value<int>(batchJobs))
+		("server", "Keep running and convert the jobs read from stdin, one JSON object per line, reporting on stdout.", cxxopts::value<bool>(server))
+		("build-cache", "Folder remembering the outputs of every conversion; unchanged files converted the same way are skipped.", cxxopts::value<std::string>(buildCachePath))
+		("snapshot", "Also write the imported model as a .rawmodel file, which converts again as input without the FBX SDK.", cxxopts::value<bool>(writeSnapshot))
 		("flip-u", "Flip all U texture coordinates.")
 		("flip-v", "Flip all V texture coordinates (default behaviour!)")
+		("mesh-version", "Version of the mesh file: 1 (legacy packed layout) or 2 (aligned sections).", cxxopts::value<int>(crossOptions.meshVersion))
+		("mesh-alignment", "Alignment in bytes of the mesh file sections, a power of two (16 or 4096 for pages).", cxxopts::value<unsigned int>(crossOptions.meshAlignment))
+		("mesh-page-size", "Group the indices and vertices of every submesh into pages of this many bytes, a power of two (mesh version 2).", cxxopts::value<unsigned int>(crossOptions.meshPageSize))
+		("long-indices", "Whether to use 32-bit indices per submesh (never|auto|always).", cxxopts::value<std::vector<std::string>>())
+		("position-format", "Encoding of vertex positions (float|snorm16|unorm16).", cxxopts::value<std::vector<std::string>>())
+		("position-stream", "Separate position stream for depth only passes (none|split|indexed).", cxxopts::value<std::vector<std::string>>())
+		("submesh-formats", "Give every submesh a vertex format of only the attributes its material reads (mesh version 2).", cxxopts::value<bool>(crossOptions.subMeshFormats))
+		("texcoord-format", "Encoding of vertex texture coordinates (float|half|unorm16).", cxxopts::value<std::vector<std::string>>())
+		("normal-format", "Encoding of vertex normals and binormals (snorm8|snorm10|oct8|oct16|qtangent).", cxxopts::value<std::vector<std::string>>())
+		("compute-normals", "When to compute normals for vertices (never|broken|missing|always).", cxxopts::value<std::vector<std::string>>())
+		("compute-tangents", "When to compute tangents for vertices from their normals and UV0 (never|missing|always).", cxxopts::value<std::vector<std::string>>())
+		("position-tolerance", "Largest position error before keeping float positions.", cxxopts::value<float>(crossOptions.positionTolerance))
+		("texcoord-tolerance", "Largest texture coordinate error before keeping float texture coordinates.", cxxopts::value<float>(crossOptions.texcoordTolerance))
+		("normal-tolerance", "Largest normal component error before keeping snorm8 normals.", cxxopts::value<float>(crossOptions.normalTolerance))
+		("no-animation", "Skip the animations of the FBX file.")
+		("no-cameras", "Skip the cameras of the FBX file.")
+		("node", "Import only the subtree of the named node, may be repeated.", cxxopts::value<std::vector<std::string>>(loadOptions.nodeNames))
+		("take", "Import only the named animation take, may be repeated.", cxxopts::value<std::vector<std::string>>(loadOptions.takeNames))
+		("texture-path", "Folder searched recursively for textures not found next to the FBX file, may be repeated.", cxxopts::value<std::vector<std::string>>(loadOptions.textureSearchPaths))
+		("weld-tolerance", "Weld vertices closer than this before building submeshes, 0 welds only equal vertices.", cxxopts::value<float>(crossOptions.weldPositionTolerance))
+		("weld-normal-angle", "Largest angle in degrees between the normals of welded vertices.", cxxopts::value<float>(crossOptions.weldNormalAngle))
+		("weld-texcoord-tolerance", "Largest texture coordinate distance between welded vertices.", cxxopts::value<float>(crossOptions.weldTexcoordTolerance))
+		("remove-degenerates", "Drop triangles that repeat a vertex, have no area or repeat another triangle before building submeshes.", cxxopts::value<bool>(crossOptions.removeDegenerateTriangles))
+		("degenerate-min-area", "Area up to which --remove-degenerates drops triangles.", cxxopts::value<float>(crossOptions.degenerateMinArea))
+		("degenerate-min-angle", "Angle in degrees below which --remove-degenerates drops triangles.", cxxopts::value<float>(crossOptions.degenerateMinAngle))
+		("anim-tolerance", "Largest position error animation keys may be dropped for, 0 keeps every key.", cxxopts::value<float>(crossOptions.animationTolerance))
+		("anim-weight-tolerance", "Largest morph weight error animation keys may be dropped for.", cxxopts::value<float>(crossOptions.animationWeightTolerance))
+		("anim-framerate", "Frames per second to sample animations at, 0 uses the frame rate of the FBX file.", cxxopts::value<double>(loadOptions.animationFrameRate))
+		("max-palette-joints", "Largest number of joints a skinned submesh binds, larger ones are split; 0 never splits.", cxxopts::value<int>(crossOptions.maxPaletteJoints))
+		("j,jobs", "Number of worker threads, 0 uses one per hardware thread.", cxxopts::value<int>(crossOptions.jobs))
+		("atomic-write", "Write the mesh to a temporary file and rename it into place.", cxxopts::value<bool>(crossOptions.atomicWrite))
+		("streaming", "Write the mesh a batch of submeshes at a time, releasing their geometry once written.", cxxopts::value<bool>(crossOptions.streaming))
+		("texture-cache", "File remembering the size and transparency of every texture between runs; unchanged textures are not decoded again.", cxxopts::value<std::string>(textureCachePath))
+		("memory-budget", "Peak memory in MiB to size the streaming batches for, 0 makes one submesh per job a batch.", cxxopts::value<unsigned int>(crossOptions.memoryBudget))
+		("atlas-max-texture-size", "Pack albedo textures of at most this many texels wide and high into shared atlases, merging their materials.", cxxopts::value<int>(crossOptions.atlasMaxTextureSize))
+		("atlas-size", "Width and largest height of a texture atlas.", cxxopts::value<int>(crossOptions.atlasSize))
+		("static-batching", "Merge static nodes sharing a material into pre-transformed submeshes.", cxxopts::value<bool>(crossOptions.staticBatching))
+		("batch-max-extent", "Size of the grid cells bounding a static batch, 0 for no bound.", cxxopts::value<float>(crossOptions.batchMaxExtent))
+		("batch-max-vertices", "Largest number of vertices in a static batch.", cxxopts::value<int>(crossOptions.batchMaxVertices))
+		("flatten-hierarchy", "Fold empty nodes into their children, keeping animated nodes, joints and cameras.", cxxopts::value<bool>(crossOptions.flattenHierarchy))
+		("flatten-keep", "Comma separated names of nodes flattening keeps.", cxxopts::value<std::vector<std::string>>(crossOptions.flattenKeepNodes))
+		("sort-submeshes", "Order submeshes by vertex format, texture and material, opaque ones first, to reduce state changes.", cxxopts::value<bool>(crossOptions.sortSubMeshes))
+		("instancing", "Group static draws of the same submesh and material into instanced draws.", cxxopts::value<bool>(crossOptions.instancing))
+		("instance-min-count", "Fewest draws of a submesh and material that are instanced.", cxxopts::value<int>(crossOptions.instanceMinCount))
+		("library", "Folder shared by all converted models for textures and materials named by their content.", cxxopts::value<std::string>(crossOptions.libraryPath))
+		("texture-format", "Convert albedo textures with their mip chain to .ktx (none|rgba8|bc).", cxxopts::value<std::vector<std::string>>())
+		("scene-format", "Scene files to write next to the mesh (xml|binary|both).", cxxopts::value<std::vector<std::string>>())
+		("gltf-format", "glTF model to also write from the same import, next to the mesh (none|gltf|glb).", cxxopts::value<std::vector<std::string>>())
+		("gltf-draco", "Compress the glTF geometry with KHR_draco_mesh_compression.", cxxopts::value<bool>(crossOptions.gltfOptions.useDraco))
+		("gltf-unlit", "Describe the glTF materials with KHR_materials_unlit.", cxxopts::value<bool>(crossOptions.gltfOptions.useKHRMatUnlit))
+		("gltf-pbr-metallic-roughness", "Describe the glTF materials with pbrMetallicRoughness.", cxxopts::value<bool>(crossOptions.gltfOptions.usePBRMetRough))
+		("parallel-exports", "Write the glTF model on its own thread while the Cross files are written.", cxxopts::value<bool>(crossOptions.parallelExports))
+		("vertex-cache-optimizer", "Triangle ordering for the vertex cache (none|pvrt|forsyth).", cxxopts::value<std::vector<std::string>>())
+		("optimize-overdraw", "Reorder triangle clusters to reduce overdraw.", cxxopts::value<bool>(crossOptions.optimizeOverdraw))
+		("overdraw-threshold", "Largest ACMR increase allowed to the overdraw optimizer.", cxxopts::value<float>(crossOptions.overdrawThreshold))
+		("optimize-vertex-fetch", "Reorder vertices by first use for memory locality.", cxxopts::value<bool>(crossOptions.optimizeVertexFetch))
+		("optimizer-stats", "Print ACMR/ATVR per submesh before and after optimization.", cxxopts::value<bool>(crossOptions.printOptimizerStats))
+		("mesh-metrics", "Write the cache, overdraw and vertex fetch efficiency of every submesh to a .metrics.json file next to the mesh.", cxxopts::value<bool>(crossOptions.meshMetrics))
+		("metrics-cache-size", "Number of vertices in the post-transform cache the mesh metrics simulate.", cxxopts::value<int>(crossOptions.metricsCacheSize))
+		("draco", "Compress the indices and vertices of every submesh with Draco (mesh version 2).", cxxopts::value<bool>(crossOptions.useDraco))
+		("draco-speed", "Draco encoding speed from 0 to 10, slower compresses better.", cxxopts::value<int>(crossOptions.dracoSpeed))
+		("draco-position-bits", "Quantization bits of Draco positions.", cxxopts::value<int>(crossOptions.dracoPositionBits))
+		("draco-normal-bits", "Quantization bits of Draco normals.", cxxopts::value<int>(crossOptions.dracoNormalBits))
+		("draco-texcoord-bits", "Quantization bits of Draco texture coordinates.", cxxopts::value<int>(crossOptions.dracoTexcoordBits))
+		("draco-color-bits", "Quantization bits of Draco colors.", cxxopts::value<int>(crossOptions.dracoColorBits))
+		("draco-generic-bits", "Quantization bits of Draco tangents and joint weights.", cxxopts::value<int>(crossOptions.dracoGenericBits))
+		("meshlets", "Split submeshes into meshlets with culling bounds (mesh version 2).", cxxopts::value<bool>(crossOptions.buildMeshlets))
+		("meshlet-max-vertices", "Largest number of vertices in a meshlet, at most 256.", cxxopts::value<int>(crossOptions.meshletMaxVertices))
+		("meshlet-max-triangles", "Largest number of triangles in a meshlet.", cxxopts::value<int>(crossOptions.meshletMaxTriangles))
+		("lod-count", "Number of LODs to generate for meshes without authored LODs, at most 7.", cxxopts::value<int>(crossOptions.lodCount))
+		("lod-ratio", "Triangle ratio between consecutive generated LODs.", cxxopts::value<float>(crossOptions.lodRatio))
+		("lod-error", "Largest LOD error relative to the mesh extent, 0 for no limit.", cxxopts::value<float>(crossOptions.lodError))
+		("profile", "Write the time spent in every phase and the model counts as JSON to the given file.", cxxopts::value<std::string>(profilePath))
 		("h,help", "Show this help.");
 
+	// Parsing takes the options out of argv
+	const std::vector<std::string> arguments(argv + 1, argv + argc);
+
 	options.parse_positional("input");
 	options.parse(argc, argv);
 
@@ -55,61 +655,477 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
-	if (options.count("input") == false) {
+	if (manifestPath.empty() == false && ReadManifest(manifestPath, inputPaths) == false) {
+		fmt::fprintf(stderr, "ERROR:: Failed to read manifest: %s\n", manifestPath.c_str());
+		return 1;
+	}
+
+	if (server && inputPaths.empty() == false) {
+		fmt::fprintf(stderr, "ERROR:: The server reads the files to convert from stdin, not from --input or --manifest\n");
+		return 1;
+	}
+
+	if (inputPaths.empty() && server == false) {
 		fmt::printf("You must supply a FBX file to convert.\n");
 		fmt::printf(options.help());
 		return 1;
 	}
 
-	if (options.count("output") == 0) {
-		outputPath = StringUtils::GetFolderString(inputPath);
+	std::vector<ConvertJob> convertJobs;
+	if (CreateConvertJobs(inputPaths, outputPath, convertJobs) == false) {
+		return 1;
+	}
+
+	if (crossOptions.meshVersion != 1 && crossOptions.meshVersion != 2) {
+		fmt::fprintf(stderr, "ERROR:: Unsupported mesh version: %d\n", crossOptions.meshVersion);
+		return 1;
+	}
+
+	if (loadOptions.animationFrameRate < 0.0) {
+		fmt::fprintf(stderr, "ERROR:: Animation frame rate must not be negative: %g\n", loadOptions.animationFrameRate);
+		return 1;
+	}
+
+	if (crossOptions.maxPaletteJoints != 0 && crossOptions.maxPaletteJoints < 12) {
+		// A single triangle binds up to 12 joints
+		fmt::fprintf(stderr, "ERROR:: Palettes must hold at least 12 joints: %d\n", crossOptions.maxPaletteJoints);
+		return 1;
+	}
+
+	if (crossOptions.batchMaxVertices < 3 || crossOptions.batchMaxExtent < 0.0f) {
+		fmt::fprintf(stderr, "ERROR:: Static batches must hold at least 3 vertices and have a positive extent\n");
+		return 1;
+	}
+
+	while (crossOptions.libraryPath.empty() == false && (crossOptions.libraryPath.back() == '/' || crossOptions.libraryPath.back() == '\\')) {
+		crossOptions.libraryPath.pop_back();
+	}
+
+	if (crossOptions.atlasSize < 64 || (crossOptions.atlasSize & (crossOptions.atlasSize - 1)) != 0) {
+		fmt::fprintf(stderr, "ERROR:: Atlas size must be a power of two of at least 64: %d\n", crossOptions.atlasSize);
+		return 1;
+	}
+
+	if (crossOptions.meshAlignment == 0 || (crossOptions.meshAlignment & (crossOptions.meshAlignment - 1)) != 0) {
+		fmt::fprintf(stderr, "ERROR:: Mesh alignment must be a power of two: %u\n", crossOptions.meshAlignment);
+		return 1;
+	}
+
+	if ((crossOptions.meshPageSize & (crossOptions.meshPageSize - 1)) != 0) {
+		fmt::fprintf(stderr, "ERROR:: Mesh page size must be a power of two: %u\n", crossOptions.meshPageSize);
+		return 1;
+	}
+
+	if (crossOptions.meshletMaxVertices < 3 || crossOptions.meshletMaxVertices > 256 || crossOptions.meshletMaxTriangles < 1) {
+		fmt::fprintf(stderr, "ERROR:: Meshlets need 3 to 256 vertices and at least one triangle: %d/%d\n", crossOptions.meshletMaxVertices, crossOptions.meshletMaxTriangles);
+		return 1;
+	}
+
+	if (crossOptions.lodCount < 0 || crossOptions.lodCount > 7 || crossOptions.lodRatio <= 0.0f || crossOptions.lodRatio >= 1.0f) {
+		fmt::fprintf(stderr, "ERROR:: LODs need a count of 0 to 7 and a ratio between 0 and 1: %d/%f\n", crossOptions.lodCount, crossOptions.lodRatio);
+		return 1;
+	}
+
+	if (crossOptions.weldPositionTolerance < 0.0f || crossOptions.weldNormalAngle < 0.0f || crossOptions.weldNormalAngle > 180.0f || crossOptions.weldTexcoordTolerance < 0.0f) {
+		fmt::fprintf(stderr, "ERROR:: Weld tolerances must not be negative and the angle at most 180 degrees: %g/%g/%g\n", crossOptions.weldPositionTolerance, crossOptions.weldNormalAngle, crossOptions.weldTexcoordTolerance);
+		return 1;
+	}
+
+	if (crossOptions.degenerateMinArea < 0.0f || crossOptions.degenerateMinAngle < 0.0f || crossOptions.degenerateMinAngle > 60.0f) {
+		fmt::fprintf(stderr, "ERROR:: Degenerate triangles need an area of at least 0 and an angle of 0 to 60 degrees: %g/%g\n", crossOptions.degenerateMinArea, crossOptions.degenerateMinAngle);
+		return 1;
+	}
+
+	if (crossOptions.metricsCacheSize < 1) {
+		fmt::fprintf(stderr, "ERROR:: The metrics cache needs at least one vertex: %d\n", crossOptions.metricsCacheSize);
+		return 1;
+	}
+
+	for (int bits : { crossOptions.dracoPositionBits, crossOptions.dracoNormalBits, crossOptions.dracoTexcoordBits, crossOptions.dracoColorBits, crossOptions.dracoGenericBits }) {
+		if (bits < 1 || bits > 30) {
+			fmt::fprintf(stderr, "ERROR:: Draco quantization needs 1 to 30 bits: %d\n", bits);
+			return 1;
+		}
+	}
+
+	if (crossOptions.dracoSpeed < 0 || crossOptions.dracoSpeed > 10) {
+		fmt::fprintf(stderr, "ERROR:: Draco speed must be between 0 and 10: %d\n", crossOptions.dracoSpeed);
+		return 1;
+	}
+
+	if (crossOptions.useDraco && crossOptions.meshVersion == 1) {
+		fmt::printf("Warning: Draco compression needs mesh version 2, ignoring --draco\n");
+		crossOptions.useDraco = false;
+	}
+
+	if (crossOptions.meshPageSize > 0 && crossOptions.meshVersion == 1) {
+		fmt::printf("Warning: Mesh pages need mesh version 2, ignoring --mesh-page-size\n");
+		crossOptions.meshPageSize = 0;
+	}
+
+	if (crossOptions.meshPageSize > 0 && crossOptions.useDraco) {
+		fmt::printf("Warning: Draco streams are not paged, ignoring --mesh-page-size\n");
+		crossOptions.meshPageSize = 0;
+	}
+
+	if (crossOptions.buildMeshlets && crossOptions.meshVersion == 1) {
+		fmt::printf("Warning: Meshlets need mesh version 2, ignoring --meshlets\n");
+		crossOptions.buildMeshlets = false;
+	}
+
+	if (options.count("long-indices") > 0) {
+		for (const std::string &choice : options["long-indices"].as<std::vector<std::string>>()) {
+			if (choice == "never") {
+				crossOptions.useLongIndices = UseLongIndicesOptions::NEVER;
+			}
+			else if (choice == "auto") {
+				crossOptions.useLongIndices = UseLongIndicesOptions::AUTO;
+			}
+			else if (choice == "always") {
+				crossOptions.useLongIndices = UseLongIndicesOptions::ALWAYS;
+			}
+			else {
+				fmt::printf("Unknown --long-indices: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
+
+	if (options.count("position-format") > 0) {
+		for (const std::string &choice : options["position-format"].as<std::vector<std::string>>()) {
+			if (choice == "float") {
+				crossOptions.positionFormat = PositionFormatOptions::FLOAT;
+			}
+			else if (choice == "snorm16") {
+				crossOptions.positionFormat = PositionFormatOptions::SNORM16;
+			}
+			else if (choice == "unorm16") {
+				crossOptions.positionFormat = PositionFormatOptions::UNORM16;
+			}
+			else {
+				fmt::printf("Unknown --position-format: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
+
+	if (options.count("position-stream") > 0) {
+		for (const std::string &choice : options["position-stream"].as<std::vector<std::string>>()) {
+			if (choice == "none") {
+				crossOptions.positionStream = PositionStreamOptions::NONE;
+			}
+			else if (choice == "split") {
+				crossOptions.positionStream = PositionStreamOptions::SPLIT;
+			}
+			else if (choice == "indexed") {
+				crossOptions.positionStream = PositionStreamOptions::INDEXED;
+			}
+			else {
+				fmt::printf("Unknown --position-stream: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
+
+	if (crossOptions.positionStream != PositionStreamOptions::NONE && crossOptions.meshVersion == 1) {
+		fmt::printf("Warning: Position streams need mesh version 2, ignoring --position-stream\n");
+		crossOptions.positionStream = PositionStreamOptions::NONE;
+	}
+
+	// The position stream would hold the exact positions while Draco quantizes the ones of the vertices
+	if (crossOptions.positionStream != PositionStreamOptions::NONE && crossOptions.useDraco) {
+		fmt::fprintf(stderr, "ERROR:: --position-stream can't be combined with --draco\n");
+		return 1;
+	}
+
+	if (crossOptions.subMeshFormats && crossOptions.meshVersion == 1) {
+		fmt::printf("Warning: Submesh vertex formats need mesh version 2, ignoring --submesh-formats\n");
+		crossOptions.subMeshFormats = false;
+	}
+
+	if (options.count("texcoord-format") > 0) {
+		for (const std::string &choice : options["texcoord-format"].as<std::vector<std::string>>()) {
+			if (choice == "float") {
+				crossOptions.texcoordFormat = TexcoordFormatOptions::FLOAT;
+			}
+			else if (choice == "half") {
+				crossOptions.texcoordFormat = TexcoordFormatOptions::HALF;
+			}
+			else if (choice == "unorm16") {
+				crossOptions.texcoordFormat = TexcoordFormatOptions::UNORM16;
+			}
+			else {
+				fmt::printf("Unknown --texcoord-format: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
+
+	if (options.count("normal-format") > 0) {
+		for (const std::string &choice : options["normal-format"].as<std::vector<std::string>>()) {
+			if (choice == "snorm8") {
+				crossOptions.normalFormat = NormalFormatOptions::SNORM8;
+			}
+			else if (choice == "snorm10") {
+				crossOptions.normalFormat = NormalFormatOptions::SNORM10;
+			}
+			else if (choice == "oct8") {
+				crossOptions.normalFormat = NormalFormatOptions::OCT8;
+			}
+			else if (choice == "oct16") {
+				crossOptions.normalFormat = NormalFormatOptions::OCT16;
+			}
+			else if (choice == "qtangent") {
+				crossOptions.normalFormat = NormalFormatOptions::QTANGENT;
+			}
+			else {
+				fmt::printf("Unknown --normal-format: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
+
+	if (options.count("compute-normals") > 0) {
+		for (const std::string &choice : options["compute-normals"].as<std::vector<std::string>>()) {
+			if (choice == "never") {
+				crossOptions.computeNormals = ComputeNormalsOption::NEVER;
+			}
+			else if (choice == "broken") {
+				crossOptions.computeNormals = ComputeNormalsOption::BROKEN;
+			}
+			else if (choice == "missing") {
+				crossOptions.computeNormals = ComputeNormalsOption::MISSING;
+			}
+			else if (choice == "always") {
+				crossOptions.computeNormals = ComputeNormalsOption::ALWAYS;
+			}
+			else {
+				fmt::printf("Unknown --compute-normals: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
+
+	if (options.count("compute-tangents") > 0) {
+		for (const std::string &choice : options["compute-tangents"].as<std::vector<std::string>>()) {
+			if (choice == "never") {
+				crossOptions.computeTangents = ComputeTangentsOption::NEVER;
+			}
+			else if (choice == "missing") {
+				crossOptions.computeTangents = ComputeTangentsOption::MISSING;
+			}
+			else if (choice == "always") {
+				crossOptions.computeTangents = ComputeTangentsOption::ALWAYS;
+			}
+			else {
+				fmt::printf("Unknown --compute-tangents: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
+
+	if (options.count("texture-format") > 0) {
+		for (const std::string &choice : options["texture-format"].as<std::vector<std::string>>()) {
+			if (choice == "none") {
+				crossOptions.textureFormat = TextureFormatOptions::NONE;
+			}
+			else if (choice == "rgba8") {
+				crossOptions.textureFormat = TextureFormatOptions::RGBA8;
+			}
+			else if (choice == "bc") {
+				crossOptions.textureFormat = TextureFormatOptions::BC;
+			}
+			else {
+				fmt::printf("Unknown --texture-format: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
+
+	if (options.count("scene-format") > 0) {
+		for (const std::string &choice : options["scene-format"].as<std::vector<std::string>>()) {
+			if (choice == "xml") {
+				crossOptions.sceneFormat = SceneFormatOptions::XML;
+			}
+			else if (choice == "binary") {
+				crossOptions.sceneFormat = SceneFormatOptions::BINARY;
+			}
+			else if (choice == "both") {
+				crossOptions.sceneFormat = SceneFormatOptions::BOTH;
+			}
+			else {
+				fmt::printf("Unknown --scene-format: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
+
+	if (options.count("gltf-format") > 0) {
+		for (const std::string &choice : options["gltf-format"].as<std::vector<std::string>>()) {
+			if (choice == "none") {
+				crossOptions.gltfFormat = GltfFormatOptions::NONE;
+			}
+			else if (choice == "gltf") {
+				crossOptions.gltfFormat = GltfFormatOptions::GLTF;
+			}
+			else if (choice == "glb") {
+				crossOptions.gltfFormat = GltfFormatOptions::GLB;
+			}
+			else {
+				fmt::printf("Unknown --gltf-format: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
+		}
+	}
 
-		if (outputPath.empty()) {
-			outputPath = "./";
+	if (options.count("vertex-cache-optimizer") > 0) {
+		for (const std::string &choice : options["vertex-cache-optimizer"].as<std::vector<std::string>>()) {
+			if (choice == "none") {
+				crossOptions.vertexCacheOptimizer = VertexCacheOptimizerOptions::NONE;
+			}
+			else if (choice == "pvrt") {
+				crossOptions.vertexCacheOptimizer = VertexCacheOptimizerOptions::PVRT;
+			}
+			else if (choice == "forsyth") {
+				crossOptions.vertexCacheOptimizer = VertexCacheOptimizerOptions::FORSYTH;
+			}
+			else {
+				fmt::printf("Unknown --vertex-cache-optimizer: %s\n", choice);
+				fmt::printf(options.help());
+				return 1;
+			}
 		}
 	}
 
 	if (options.count("flip-u") > 0) {
-		texturesTransforms.emplace_back([](Vec2f uv) { return Vec2f(1.0f - uv[0], uv[1]); });
+		texturesTransform = texturesTransform.Then(RawTextureTransform::FlipU());
 	}
 
 	if (options.count("flip-v") > 0) {
-		texturesTransforms.emplace_back([](Vec2f uv) { return Vec2f(uv[0], 1.0f - uv[1]); });
+		texturesTransform = texturesTransform.Then(RawTextureTransform::FlipV());
 	}
 
-	RawModel rawModel;
+	ProfileUtils::SetEnabled(profilePath.empty() == false);
 
-	if (verboseOutput) {
-		fmt::printf("Loading FBX File: %s\n", inputPath);
+	if (textureCachePath.empty() == false && LoadImageCache(textureCachePath.c_str()) == false && verboseOutput) {
+		fmt::printf("Texture cache %s not loaded, starting a new one.\n", textureCachePath);
+	}
+
+	// A batch converts files side by side, each on one thread unless --jobs says otherwise; a server runs as many
+	// jobs at once as the batch would
+	const int workerCount = server ? ThreadUtils::GetJobCount(batchJobs) : std::min(ThreadUtils::GetJobCount(batchJobs), (int)convertJobs.size());
+	if (workerCount > 1) {
+		if (options.count("jobs") == 0) {
+			crossOptions.jobs = 1;
+		}
+		// The progress of files converted at once would interleave
+		verboseOutput = false;
+	}
+	if (server) {
+		verboseOutput = false;
 	}
 
-    if (LoadFBXFile(rawModel, inputPath.c_str(), "tga;bmp;png;jpg;jpeg") == false) {
-		fmt::fprintf(stderr, "ERROR:: Failed to parse FBX: %s\n", inputPath.c_str());
-        return 1;
-    }
+	loadOptions.jobs = crossOptions.jobs;
+	loadOptions.importAnimations = options.count("no-animation") == 0;
+	loadOptions.importCameras = options.count("no-cameras") == 0;
+	loadOptions.reuseManager = convertJobs.size() > 1 || server;
+
+	// Converts a file unless the build cache has its outputs, the same for a batch and a server
+	const std::string description = DescribeConversion(arguments, inputPaths);
+	const auto runJob = [&](const ConvertJob &job, ConvertRecord &record, bool &jobUpToDate) -> bool {
+		jobUpToDate = false;
 
-	if (texturesTransforms.empty() == false) {
-		rawModel.TransformTextures(texturesTransforms);
+		// The output folder is part of the key, the entry records where the outputs go
+		uint64_t cacheKey = 0;
+		const bool cached = buildCachePath.empty() == false && BuildCache::GetKey(job.inputPath, description + "\n" + job.inputPath + "\n" + job.outputPath, cacheKey);
+		if (cached && BuildCache::Restore(buildCachePath, cacheKey, record.outputFiles)) {
+			jobUpToDate = true;
+			return true;
+		}
+		if (FileUtils::FolderExists(job.outputPath) == false && FileUtils::CreatePath((job.outputPath + "/").c_str()) == false) {
+			fmt::fprintf(stderr, "ERROR:: Failed to create output folder: %s\n", job.outputPath.c_str());
+			return false;
+		}
+		try {
+			if (ConvertFile(job.inputPath, job.outputPath, crossOptions, loadOptions, texturesTransform, writeSnapshot, record) == false) {
+				return false;
+			}
+			if (cached && BuildCache::Store(buildCachePath, cacheKey, record.textureFiles, record.outputFiles) == false) {
+				fmt::printf("Warning: Failed to store %s in the build cache\n", job.inputPath);
+			}
+			return true;
+		}
+		catch (const std::exception &exception) {
+			fmt::fprintf(stderr, "ERROR:: Failed to convert %s: %s\n", job.inputPath.c_str(), exception.what());
+			return false;
+		}
+	};
+
+	if (server) {
+		RunServer(workerCount, runJob);
 	}
 
-	rawModel.Condense();
-	rawModel.TransformGeometry(ComputeNormalsOption::NEVER);
+	// A file that fails is reported and the others are still converted
+	std::vector<char> converted(convertJobs.size(), 0);
+	std::vector<char> upToDate(convertJobs.size(), 0);
+	const auto batchStart = std::chrono::steady_clock::now();
 
-	std::vector<RawModel> rawMaterialModels;
-	rawModel.CreateMaterialModels(rawMaterialModels, false, -1, true);
+	ThreadUtils::ParallelFor((int)convertJobs.size(), workerCount, [&](int indexJob) {
+		const ConvertJob &job = convertJobs[indexJob];
+		bool jobUpToDate;
+		ConvertRecord record;
+		converted[indexJob] = runJob(job, record, jobUpToDate) ? 1 : 0;
+		upToDate[indexJob] = jobUpToDate ? 1 : 0;
 
-	char szFName[_MAX_PATH] = { 0 };
-	char szFileName[_MAX_PATH] = { 0 };
-	char szMeshBinFileName[_MAX_PATH] = { 0 };
-	char szMeshXMLFileName[_MAX_PATH] = { 0 };
-	splitfilename(inputPath.c_str(), szFName, NULL);
-	sprintf(szFileName, "%s.mesh", szFName);
-	sprintf(szMeshBinFileName, "%s/%s.mesh", outputPath.c_str(), szFName);
-	sprintf(szMeshXMLFileName, "%s/%s.xml", outputPath.c_str(), szFName);
+		if (convertJobs.size() > 1 || upToDate[indexJob]) {
+			fmt::printf("%s: %s\n", upToDate[indexJob] ? "Up to date" : converted[indexJob] ? "Converted" : "Failed", job.inputPath);
+		}
+	});
+
+	const int failedCount = (int)std::count(converted.begin(), converted.end(), 0);
+
+	if (convertJobs.size() > 1) {
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+		const int upToDateCount = (int)std::count(upToDate.begin(), upToDate.end(), 1);
+		fmt::printf("Converted %d of %d files, %d up to date, in %.2f seconds on %d workers\n", (int)convertJobs.size() - failedCount, (int)convertJobs.size(), upToDateCount, seconds, workerCount);
+
+		for (int indexJob = 0; indexJob < convertJobs.size(); indexJob++) {
+			if (converted[indexJob] == 0) {
+				fmt::printf("    failed: %s\n", convertJobs[indexJob].inputPath);
+			}
+		}
+	}
 
-	ExportMesh(szMeshBinFileName, rawModel, rawMaterialModels);
-	ExportMaterial(outputPath.c_str(), rawModel);
-	ExportMeshXML(szMeshXMLFileName, szFileName, rawModel, rawMaterialModels);
+	// Saved last, so the pixel hashes of the library textures are remembered too
+	if (textureCachePath.empty() == false && SaveImageCache(textureCachePath.c_str()) == false) {
+		fmt::printf("Warning: Failed to write texture cache: %s\n", textureCachePath);
+	}
+
+	const unsigned int peakMemory = MemoryUtils::GetPeakResidentSize() / (1024 * 1024);
+
+	if (verboseOutput || convertJobs.size() > 1) {
+		fmt::printf("Peak memory: %u MiB\n", peakMemory);
+	}
+
+	if (crossOptions.memoryBudget > 0 && peakMemory > crossOptions.memoryBudget) {
+		fmt::printf("Warning: Peak memory of %u MiB exceeds the memory budget of %u MiB\n", peakMemory, crossOptions.memoryBudget);
+	}
+
+	const std::string asset = convertJobs.size() == 1 ? convertJobs[0].inputPath : std::to_string(convertJobs.size()) + " files";
+	if (profilePath.empty() == false && ProfileUtils::WriteReport(profilePath.c_str(), asset) == false) {
+		fmt::fprintf(stderr, "ERROR:: Failed to write profile: %s\n", profilePath.c_str());
+		return 1;
+	}
 
-    return 0;
+    return failedCount > 0 ? 1 : 0;
 }
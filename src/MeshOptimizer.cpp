@@ -0,0 +1,1021 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "FBX2glTF.h"
+#include "mathfu.h"
+#include "MeshOptimizer.h"
+
+MeshOptimizerStats GetMeshOptimizerStats(const unsigned int *indices, int indexCount, int vertexCount, int cacheSize)
+{
+	MeshOptimizerStats stats;
+
+	if (indexCount < 3 || vertexCount == 0) {
+		return stats;
+	}
+
+	// FIFO cache, a vertex is cached while its insertion time is within cacheSize of the current time
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	unsigned int misses = 0;
+
+	for (int index = 0; index < indexCount; index++) {
+		const unsigned int vertex = indices[index];
+
+		if (time - timestamps[vertex] > (unsigned int)cacheSize) {
+			timestamps[vertex] = time++;
+			misses++;
+		}
+	}
+
+	stats.acmr = (float)misses / (indexCount / 3);
+	stats.atvr = (float)misses / vertexCount;
+	return stats;
+}
+
+MeshOptimizerStats GetMeshOptimizerStatsLRU(const unsigned int *indices, int indexCount, int vertexCount, int cacheSize)
+{
+	MeshOptimizerStats stats;
+
+	if (indexCount < 3 || vertexCount == 0) {
+		return stats;
+	}
+
+	// Most recently used first
+	std::vector<unsigned int> cache;
+	cache.reserve(cacheSize + 1);
+	unsigned int misses = 0;
+
+	for (int index = 0; index < indexCount; index++) {
+		const unsigned int vertex = indices[index];
+		auto it = std::find(cache.begin(), cache.end(), vertex);
+
+		if (it == cache.end()) {
+			misses++;
+			cache.insert(cache.begin(), vertex);
+			if ((int)cache.size() > cacheSize) {
+				cache.pop_back();
+			}
+		}
+		else {
+			std::rotate(cache.begin(), it, it + 1);
+		}
+	}
+
+	stats.acmr = (float)misses / (indexCount / 3);
+	stats.atvr = (float)misses / vertexCount;
+	return stats;
+}
+
+#define OVERDRAW_GRID_SIZE 256
+
+float GetMeshOverdraw(const unsigned int *indices, int indexCount, const RawVertex *vertices, int vertexCount)
+{
+	if (indexCount < 3 || vertexCount == 0) {
+		return 0.0f;
+	}
+
+	Vec3f minPosition = vertices[0].position;
+	Vec3f maxPosition = vertices[0].position;
+	for (int vertex = 1; vertex < vertexCount; vertex++) {
+		minPosition = Vec3f::Min(minPosition, vertices[vertex].position);
+		maxPosition = Vec3f::Max(maxPosition, vertices[vertex].position);
+	}
+	const Vec3f extent = maxPosition - minPosition;
+	const float scale = (OVERDRAW_GRID_SIZE - 1) / std::max(std::max(extent.x, extent.y), std::max(extent.z, FLT_MIN));
+
+	std::vector<float> depths(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE);
+	uint64_t shaded = 0;
+	uint64_t covered = 0;
+
+	for (int view = 0; view < 6; view++) {
+		// Looking down the axis from its positive end, or its negative one, depth grows away from the viewer
+		const int axis = view / 2;
+		const float sign = (view & 1) ? -1.0f : 1.0f;
+		const int axisU = (axis + 1) % 3;
+		const int axisV = (axis + 2) % 3;
+		std::fill(depths.begin(), depths.end(), FLT_MAX);
+
+		for (int index = 0; index + 2 < indexCount; index += 3) {
+			Vec3f p[3];
+			for (int corner = 0; corner < 3; corner++) {
+				const Vec3f position = (vertices[indices[index + corner]].position - minPosition) * scale;
+				p[corner] = Vec3f(position[axisU], position[axisV], sign > 0.0f ? (maxPosition[axis] - minPosition[axis]) * scale - position[axis] : position[axis]);
+			}
+
+			// Counter-clockwise triangles face the viewer
+			const float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+			if (area * sign <= 0.0f) {
+				continue;
+			}
+
+			const int minX = std::max(0, (int)ceilf(std::min(std::min(p[0].x, p[1].x), p[2].x) - 0.5f));
+			const int maxX = std::min(OVERDRAW_GRID_SIZE - 1, (int)floorf(std::max(std::max(p[0].x, p[1].x), p[2].x) - 0.5f));
+			const int minY = std::max(0, (int)ceilf(std::min(std::min(p[0].y, p[1].y), p[2].y) - 0.5f));
+			const int maxY = std::min(OVERDRAW_GRID_SIZE - 1, (int)floorf(std::max(std::max(p[0].y, p[1].y), p[2].y) - 0.5f));
+
+			for (int y = minY; y <= maxY; y++) {
+				for (int x = minX; x <= maxX; x++) {
+					// Barycentrics of the pixel center, all of the same sign as the area inside the triangle
+					const float px = x + 0.5f;
+					const float py = y + 0.5f;
+					const float w0 = ((p[1].x - px) * (p[2].y - py) - (p[2].x - px) * (p[1].y - py)) / area;
+					const float w1 = ((p[2].x - px) * (p[0].y - py) - (p[0].x - px) * (p[2].y - py)) / area;
+					const float w2 = 1.0f - w0 - w1;
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+						continue;
+					}
+
+					const float depth = w0 * p[0].z + w1 * p[1].z + w2 * p[2].z;
+					float &pixelDepth = depths[y * OVERDRAW_GRID_SIZE + x];
+					if (depth < pixelDepth) {
+						covered += pixelDepth == FLT_MAX ? 1 : 0;
+						pixelDepth = depth;
+						shaded++;
+					}
+				}
+			}
+		}
+	}
+
+	return covered > 0 ? (float)shaded / covered : 0.0f;
+}
+
+#define VERTEX_FETCH_LINE_SIZE 64
+#define VERTEX_FETCH_CACHE_SIZE (16 * 1024)
+
+float GetMeshVertexFetch(const unsigned int *indices, int indexCount, int vertexCount, int vertexSize, int cacheSize)
+{
+	if (indexCount < 3 || vertexCount == 0 || vertexSize <= 0) {
+		return 0.0f;
+	}
+
+	// Post-transform cache as in GetMeshOptimizerStats, then a FIFO cache of memory lines
+	std::vector<unsigned int> vertexTimestamps(vertexCount, 0);
+	unsigned int vertexTime = cacheSize + 1;
+
+	const unsigned int lineCount = VERTEX_FETCH_CACHE_SIZE / VERTEX_FETCH_LINE_SIZE;
+	std::vector<unsigned int> lineTimestamps(((size_t)vertexCount * vertexSize + VERTEX_FETCH_LINE_SIZE - 1) / VERTEX_FETCH_LINE_SIZE, 0);
+	unsigned int lineTime = lineCount + 1;
+
+	std::vector<bool> used(vertexCount, false);
+	size_t usedCount = 0;
+	size_t fetchedLines = 0;
+
+	for (int index = 0; index < indexCount; index++) {
+		const unsigned int vertex = indices[index];
+		if (used[vertex] == false) {
+			used[vertex] = true;
+			usedCount++;
+		}
+
+		if (vertexTime - vertexTimestamps[vertex] <= (unsigned int)cacheSize) {
+			continue;
+		}
+		vertexTimestamps[vertex] = vertexTime++;
+
+		const size_t firstLine = (size_t)vertex * vertexSize / VERTEX_FETCH_LINE_SIZE;
+		const size_t lastLine = ((size_t)vertex * vertexSize + vertexSize - 1) / VERTEX_FETCH_LINE_SIZE;
+		for (size_t line = firstLine; line <= lastLine; line++) {
+			if (lineTime - lineTimestamps[line] > lineCount) {
+				lineTimestamps[line] = lineTime++;
+				fetchedLines++;
+			}
+		}
+	}
+
+	return (float)(fetchedLines * VERTEX_FETCH_LINE_SIZE) / (usedCount * vertexSize);
+}
+
+int GetDegenerateTriangleCount(const unsigned int *indices, int indexCount, const RawVertex *vertices)
+{
+	int count = 0;
+	for (int index = 0; index + 2 < indexCount; index += 3) {
+		const unsigned int a = indices[index + 0];
+		const unsigned int b = indices[index + 1];
+		const unsigned int c = indices[index + 2];
+
+		if (a == b || b == c || c == a) {
+			count++;
+			continue;
+		}
+
+		const Vec3f normal = Vec3f::CrossProduct(vertices[b].position - vertices[a].position, vertices[c].position - vertices[a].position);
+		if (normal.LengthSquared() == 0.0f) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * Tom Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006.
+ * Greedily emits the best scoring triangle touching the simulated LRU cache, the score
+ * favours recently used vertices and vertices with few remaining triangles.
+ */
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRI_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+static float GetForsythVertexScore(int cachePosition, int valence)
+{
+	if (valence == 0) {
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			score = FORSYTH_LAST_TRI_SCORE;
+		}
+		else {
+			const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)std::min(valence, FORSYTH_MAX_VALENCE), -FORSYTH_VALENCE_BOOST_POWER);
+	return score;
+}
+
+void OptimizeVertexCacheForsyth(unsigned int *indices, int indexCount, int vertexCount)
+{
+	const int triangleCount = indexCount / 3;
+
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Vertex to triangle adjacency
+	std::vector<int> valences(vertexCount, 0);
+	std::vector<int> adjacencyOffsets(vertexCount + 1, 0);
+	std::vector<int> adjacency(indexCount);
+
+	for (int index = 0; index < indexCount; index++) {
+		valences[indices[index]]++;
+	}
+
+	for (int vertex = 0; vertex < vertexCount; vertex++) {
+		adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + valences[vertex];
+	}
+
+	{
+		std::vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+		for (int index = 0; index < indexCount; index++) {
+			adjacency[fill[indices[index]]++] = index / 3;
+		}
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	std::vector<float> triangleScores(triangleCount, 0.0f);
+	std::vector<bool> emitted(triangleCount, false);
+
+	for (int vertex = 0; vertex < vertexCount; vertex++) {
+		vertexScores[vertex] = GetForsythVertexScore(-1, valences[vertex]);
+	}
+
+	for (int triangle = 0; triangle < triangleCount; triangle++) {
+		triangleScores[triangle] =
+			vertexScores[indices[3 * triangle + 0]] +
+			vertexScores[indices[3 * triangle + 1]] +
+			vertexScores[indices[3 * triangle + 2]];
+	}
+
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+
+	// The cache holds three extra entries for vertices pushed out by the emitted triangle
+	std::vector<int> cache;
+	std::vector<int> nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	int bestTriangle = 0;
+	int nextInputTriangle = 0;
+
+	for (int count = 0; count < triangleCount; count++) {
+		if (bestTriangle < 0) {
+			// Nothing in the cache touches an open triangle, restart from the next unused one in input order
+			while (emitted[nextInputTriangle]) {
+				nextInputTriangle++;
+			}
+
+			bestTriangle = nextInputTriangle;
+		}
+
+		const unsigned int *triangleVertices = &indices[3 * bestTriangle];
+		emitted[bestTriangle] = true;
+		output.push_back(triangleVertices[0]);
+		output.push_back(triangleVertices[1]);
+		output.push_back(triangleVertices[2]);
+
+		// Remove the triangle from the adjacency of its vertices
+		for (int corner = 0; corner < 3; corner++) {
+			const int vertex = triangleVertices[corner];
+			int *begin = &adjacency[adjacencyOffsets[vertex]];
+			int *end = begin + valences[vertex];
+			*std::find(begin, end, bestTriangle) = *(end - 1);
+			valences[vertex]--;
+		}
+
+		// Move the triangle vertices to the front of the LRU cache
+		nextCache.clear();
+		nextCache.push_back(triangleVertices[0]);
+		nextCache.push_back(triangleVertices[1]);
+		nextCache.push_back(triangleVertices[2]);
+
+		for (int vertex : cache) {
+			if (vertex != (int)triangleVertices[0] && vertex != (int)triangleVertices[1] && vertex != (int)triangleVertices[2]) {
+				nextCache.push_back(vertex);
+			}
+		}
+
+		std::swap(cache, nextCache);
+
+		// Rescore the cached vertices and their open triangles, the evicted ones fall out of the cache
+		for (int position = 0; position < (int)cache.size(); position++) {
+			const int vertex = cache[position];
+			const int cachePosition = position < FORSYTH_CACHE_SIZE ? position : -1;
+			const float score = GetForsythVertexScore(cachePosition, valences[vertex]);
+			const float delta = score - vertexScores[vertex];
+
+			cachePositions[vertex] = cachePosition;
+			vertexScores[vertex] = score;
+
+			for (int offset = 0; offset < valences[vertex]; offset++) {
+				triangleScores[adjacency[adjacencyOffsets[vertex] + offset]] += delta;
+			}
+		}
+
+		if (cache.size() > FORSYTH_CACHE_SIZE) {
+			cache.resize(FORSYTH_CACHE_SIZE);
+		}
+
+		// Pick the next triangle among the ones touching the cache
+		float bestScore = -1.0f;
+		bestTriangle = -1;
+
+		for (int vertex : cache) {
+			for (int offset = 0; offset < valences[vertex]; offset++) {
+				const int triangle = adjacency[adjacencyOffsets[vertex] + offset];
+
+				if (bestScore < triangleScores[triangle]) {
+					bestScore = triangleScores[triangle];
+					bestTriangle = triangle;
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+/**
+ * Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007.
+ * The cache ordered triangles are cut into clusters where the cache restarts anyway, and where the
+ * ACMR of a cluster stays within the threshold. Clusters facing away from the mesh centroid are
+ * likely occluders and get drawn first, this doesn't depend on the view direction. The order is
+ * kept when the whole submesh ends up above the threshold.
+ */
+struct OverdrawCluster
+{
+	int firstTriangle;
+	int triangleCount;
+	float sortKey;
+};
+
+void OptimizeOverdraw(unsigned int *indices, int indexCount, const RawVertex *vertices, int vertexCount, float threshold)
+{
+	const int triangleCount = indexCount / 3;
+
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Hard boundaries, triangles where all three vertices miss the cache. The misses of each hard
+	// cluster are counted on the way, that gives its ACMR without simulating the cache again.
+	std::vector<int> hardBoundaries;
+	std::vector<unsigned int> hardMisses;
+
+	// One cache for both passes, advancing the time by more than the cache size flushes it
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = MESH_OPTIMIZER_CACHE_SIZE + 1;
+
+	for (int triangle = 0; triangle < triangleCount; triangle++) {
+		int misses = 0;
+
+		for (int corner = 0; corner < 3; corner++) {
+			const unsigned int vertex = indices[3 * triangle + corner];
+
+			if (time - timestamps[vertex] > MESH_OPTIMIZER_CACHE_SIZE) {
+				timestamps[vertex] = time++;
+				misses++;
+			}
+		}
+
+		if (triangle == 0 || misses == 3) {
+			hardBoundaries.push_back(triangle);
+			hardMisses.push_back(0);
+		}
+
+		hardMisses.back() += misses;
+	}
+
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries, split a hard cluster as soon as its prefix is within the threshold of its ACMR
+	std::vector<OverdrawCluster> clusters;
+
+	for (int indexBoundary = 0; indexBoundary + 1 < (int)hardBoundaries.size(); indexBoundary++) {
+		const int firstTriangle = hardBoundaries[indexBoundary];
+		const int lastTriangle = hardBoundaries[indexBoundary + 1];
+		const float acmr = (float)hardMisses[indexBoundary] / (lastTriangle - firstTriangle);
+
+		unsigned int misses = 0;
+		int clusterStart = firstTriangle;
+		time += MESH_OPTIMIZER_CACHE_SIZE + 1;
+
+		for (int triangle = firstTriangle; triangle < lastTriangle; triangle++) {
+			for (int corner = 0; corner < 3; corner++) {
+				const unsigned int vertex = indices[3 * triangle + corner];
+
+				if (time - timestamps[vertex] > MESH_OPTIMIZER_CACHE_SIZE) {
+					timestamps[vertex] = time++;
+					misses++;
+				}
+			}
+
+			const int clusterTriangles = triangle - clusterStart + 1;
+
+			if (triangle + 1 == lastTriangle || (float)misses / clusterTriangles <= acmr * threshold) {
+				clusters.push_back({ clusterStart, clusterTriangles, 0.0f });
+				clusterStart = triangle + 1;
+				misses = 0;
+				time += MESH_OPTIMIZER_CACHE_SIZE + 1;
+			}
+		}
+	}
+
+	// Area weighted centroid of the whole mesh
+	Vec3f meshCentroid { 0.0f };
+	float meshArea = 0.0f;
+
+	std::vector<Vec3f> clusterCentroids(clusters.size(), Vec3f { 0.0f });
+	std::vector<Vec3f> clusterNormals(clusters.size(), Vec3f { 0.0f });
+
+	for (int indexCluster = 0; indexCluster < (int)clusters.size(); indexCluster++) {
+		float clusterArea = 0.0f;
+
+		for (int triangle = clusters[indexCluster].firstTriangle; triangle < clusters[indexCluster].firstTriangle + clusters[indexCluster].triangleCount; triangle++) {
+			const Vec3f &p0 = vertices[indices[3 * triangle + 0]].position;
+			const Vec3f &p1 = vertices[indices[3 * triangle + 1]].position;
+			const Vec3f &p2 = vertices[indices[3 * triangle + 2]].position;
+			const Vec3f normal = Vec3f::CrossProduct(p1 - p0, p2 - p0);
+			const float area = normal.Length();
+			const Vec3f centroid = (p0 + p1 + p2) * (area / 3.0f);
+
+			clusterCentroids[indexCluster] += centroid;
+			clusterNormals[indexCluster] += normal;
+			clusterArea += area;
+			meshCentroid += centroid;
+			meshArea += area;
+		}
+
+		if (clusterArea > 0.0f) {
+			clusterCentroids[indexCluster] /= clusterArea;
+		}
+	}
+
+	if (meshArea > 0.0f) {
+		meshCentroid /= meshArea;
+	}
+
+	for (int indexCluster = 0; indexCluster < (int)clusters.size(); indexCluster++) {
+		const float length = clusterNormals[indexCluster].Length();
+
+		if (length > 0.0f) {
+			clusters[indexCluster].sortKey = Vec3f::DotProduct(clusterCentroids[indexCluster] - meshCentroid, clusterNormals[indexCluster] / length);
+		}
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const OverdrawCluster &a, const OverdrawCluster &b) {
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+
+	for (const OverdrawCluster &cluster : clusters) {
+		output.insert(output.end(), &indices[3 * cluster.firstTriangle], &indices[3 * (cluster.firstTriangle + cluster.triangleCount)]);
+	}
+
+	// Hard boundaries aren't bounded by the threshold, keep the cache order when the clusters are too small
+	const float acmrBefore = GetMeshOptimizerStats(indices, indexCount, vertexCount).acmr;
+	const float acmrAfter = GetMeshOptimizerStats(output.data(), indexCount, vertexCount).acmr;
+
+	if (acmrAfter > acmrBefore * threshold) {
+		return;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeVertexFetch(RawVertex *vertices, int vertexCount, unsigned int *indices, int indexCount)
+{
+	std::vector<int> remap(vertexCount, -1);
+	int nextVertex = 0;
+
+	for (int index = 0; index < indexCount; index++) {
+		if (remap[indices[index]] < 0) {
+			remap[indices[index]] = nextVertex++;
+		}
+
+		indices[index] = remap[indices[index]];
+	}
+
+	for (int vertex = 0; vertex < vertexCount; vertex++) {
+		if (remap[vertex] < 0) {
+			remap[vertex] = nextVertex++;
+		}
+	}
+
+	std::vector<RawVertex> sorted(vertexCount);
+
+	for (int vertex = 0; vertex < vertexCount; vertex++) {
+		sorted[remap[vertex]] = std::move(vertices[vertex]);
+	}
+
+	std::move(sorted.begin(), sorted.end(), vertices);
+}
+
+static void ComputeMeshletBounds(Meshlet &meshlet, const std::vector<unsigned int> &meshletVertices, const std::vector<uint8_t> &meshletTriangles, const RawVertex *vertices)
+{
+	Vec3f minPosition { FLT_MAX };
+	Vec3f maxPosition { -FLT_MAX };
+
+	for (unsigned int index = 0; index < meshlet.vertexCount; index++) {
+		const Vec3f &position = vertices[meshletVertices[meshlet.vertexOffset + index]].position;
+		minPosition = Vec3f::Min(minPosition, position);
+		maxPosition = Vec3f::Max(maxPosition, position);
+	}
+
+	const Vec3f center = (minPosition + maxPosition) * 0.5f;
+	float radius = 0.0f;
+
+	for (unsigned int index = 0; index < meshlet.vertexCount; index++) {
+		radius = std::max(radius, (vertices[meshletVertices[meshlet.vertexOffset + index]].position - center).Length());
+	}
+
+	// Normal cone from the unit triangle normals, wider than 84 degrees isn't worth testing
+	std::vector<Vec3f> normals;
+	Vec3f axis { 0.0f };
+
+	for (unsigned int triangle = 0; triangle < meshlet.triangleCount; triangle++) {
+		const uint8_t *corners = &meshletTriangles[meshlet.triangleOffset + 3 * triangle];
+		const Vec3f &p0 = vertices[meshletVertices[meshlet.vertexOffset + corners[0]]].position;
+		const Vec3f &p1 = vertices[meshletVertices[meshlet.vertexOffset + corners[1]]].position;
+		const Vec3f &p2 = vertices[meshletVertices[meshlet.vertexOffset + corners[2]]].position;
+		const Vec3f normal = Vec3f::CrossProduct(p1 - p0, p2 - p0);
+		const float length = normal.Length();
+
+		if (length > 0.0f) {
+			normals.push_back(normal / length);
+			axis += normal / length;
+		}
+	}
+
+	float minDot = 1.0f;
+	const float axisLength = axis.Length();
+
+	if (axisLength > 0.0f) {
+		axis /= axisLength;
+
+		for (const Vec3f &normal : normals) {
+			minDot = std::min(minDot, Vec3f::DotProduct(axis, normal));
+		}
+	}
+
+	meshlet.center[0] = center.x;
+	meshlet.center[1] = center.y;
+	meshlet.center[2] = center.z;
+	meshlet.radius = radius;
+	meshlet.coneAxis[0] = axis.x;
+	meshlet.coneAxis[1] = axis.y;
+	meshlet.coneAxis[2] = axis.z;
+	meshlet.coneCutoff = (axisLength > 0.0f && minDot > 0.1f) ? sqrtf(1.0f - minDot * minDot) : 1.0f;
+}
+
+void BuildMeshlets(std::vector<Meshlet> &meshlets, std::vector<unsigned int> &meshletVertices, std::vector<uint8_t> &meshletTriangles, const unsigned int *indices, int indexCount, const RawVertex *vertices, int vertexCount, int maxVertices, int maxTriangles)
+{
+	// Local index of every submesh vertex in the current meshlet, valid while its stamp matches
+	std::vector<uint8_t> localIndices(vertexCount);
+	std::vector<unsigned int> stamps(vertexCount, 0);
+	unsigned int stamp = 1;
+
+	Meshlet meshlet = {};
+	meshlet.vertexOffset = meshletVertices.size();
+	meshlet.triangleOffset = meshletTriangles.size();
+
+	auto finishMeshlet = [&]() {
+		ComputeMeshletBounds(meshlet, meshletVertices, meshletTriangles, vertices);
+		meshlets.push_back(meshlet);
+		meshletTriangles.resize((meshletTriangles.size() + 3) & ~3, 0);
+
+		meshlet = {};
+		meshlet.vertexOffset = meshletVertices.size();
+		meshlet.triangleOffset = meshletTriangles.size();
+		stamp++;
+	};
+
+	for (int index = 0; index < indexCount; index += 3) {
+		int newVertices = 0;
+
+		for (int corner = 0; corner < 3; corner++) {
+			const unsigned int vertex = indices[index + corner];
+
+			if (stamps[vertex] != stamp && (corner < 1 || vertex != indices[index]) && (corner < 2 || vertex != indices[index + 1])) {
+				newVertices++;
+			}
+		}
+
+		if (meshlet.vertexCount + newVertices > (unsigned int)maxVertices || meshlet.triangleCount + 1 > (unsigned int)maxTriangles) {
+			finishMeshlet();
+		}
+
+		for (int corner = 0; corner < 3; corner++) {
+			const unsigned int vertex = indices[index + corner];
+
+			if (stamps[vertex] != stamp) {
+				stamps[vertex] = stamp;
+				localIndices[vertex] = meshlet.vertexCount++;
+				meshletVertices.push_back(vertex);
+			}
+
+			meshletTriangles.push_back(localIndices[vertex]);
+		}
+
+		meshlet.triangleCount++;
+	}
+
+	if (meshlet.triangleCount > 0) {
+		finishMeshlet();
+	}
+}
+
+/**
+ * Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997.
+ * The quadric is the area weighted sum of the planes around a vertex, the error of a
+ * collapse is divided by the total weight to get a squared distance.
+ */
+struct Quadric
+{
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+	double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+	double a22 = 0.0, a23 = 0.0;
+	double a33 = 0.0;
+	double weight = 0.0;
+
+	void AddPlane(const Vec3f &normal, float distance, float planeWeight)
+	{
+		a00 += planeWeight * normal.x * normal.x;
+		a01 += planeWeight * normal.x * normal.y;
+		a02 += planeWeight * normal.x * normal.z;
+		a03 += planeWeight * normal.x * distance;
+		a11 += planeWeight * normal.y * normal.y;
+		a12 += planeWeight * normal.y * normal.z;
+		a13 += planeWeight * normal.y * distance;
+		a22 += planeWeight * normal.z * normal.z;
+		a23 += planeWeight * normal.z * distance;
+		a33 += planeWeight * distance * distance;
+		weight += planeWeight;
+	}
+
+	void Add(const Quadric &other)
+	{
+		a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+		a11 += other.a11; a12 += other.a12; a13 += other.a13;
+		a22 += other.a22; a23 += other.a23;
+		a33 += other.a33;
+		weight += other.weight;
+	}
+
+	double Evaluate(const Vec3f &p) const
+	{
+		const double x = p.x, y = p.y, z = p.z;
+		const double error =
+			a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x +
+			a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+			a22 * z * z + 2.0 * a23 * z +
+			a33;
+		return weight > 0.0 ? fabs(error) / weight : 0.0;
+	}
+};
+
+enum SimplifyVertexKind
+{
+	SIMPLIFY_VERTEX_MANIFOLD,   // collapses onto any neighbour
+	SIMPLIFY_VERTEX_BORDER,     // collapses along its open border only
+	SIMPLIFY_VERTEX_LOCKED,     // shares its position with other vertices, an attribute seam
+};
+
+struct SimplifyCollapse
+{
+	unsigned int source;
+	unsigned int target;
+	float error;
+};
+
+static uint64_t GetEdgeKey(unsigned int a, unsigned int b)
+{
+	return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+static bool IsCollapseFlipping(unsigned int source, unsigned int target, const std::vector<unsigned int> &indices, const std::vector<int> &adjacencyOffsets, const std::vector<int> &adjacency, const RawVertex *vertices)
+{
+	for (int offset = adjacencyOffsets[source]; offset < adjacencyOffsets[source + 1]; offset++) {
+		const unsigned int *triangle = &indices[3 * adjacency[offset]];
+
+		if (triangle[0] == target || triangle[1] == target || triangle[2] == target) {
+			continue;
+		}
+
+		Vec3f positions[3];
+		Vec3f collapsed[3];
+
+		for (int corner = 0; corner < 3; corner++) {
+			positions[corner] = vertices[triangle[corner]].position;
+			collapsed[corner] = triangle[corner] == source ? vertices[target].position : positions[corner];
+		}
+
+		const Vec3f normal = Vec3f::CrossProduct(positions[1] - positions[0], positions[2] - positions[0]);
+		const Vec3f collapsedNormal = Vec3f::CrossProduct(collapsed[1] - collapsed[0], collapsed[2] - collapsed[0]);
+
+		if (Vec3f::DotProduct(normal, collapsedNormal) <= 0.0f) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+float SimplifyMesh(std::vector<unsigned int> &indices, const RawVertex *vertices, int vertexCount, int targetIndexCount, float targetError)
+{
+	if (indices.size() <= (size_t)targetIndexCount || vertexCount == 0) {
+		return 0.0f;
+	}
+
+	// Vertices that only differ by attributes share a position, the first one stands for all of them
+	std::vector<unsigned int> positionIds(vertexCount);
+	std::vector<int> positionCounts(vertexCount, 0);
+	{
+		std::unordered_map<Vec3f, unsigned int, PositionHasher> positionMap;
+
+		for (int vertex = 0; vertex < vertexCount; vertex++) {
+			positionIds[vertex] = positionMap.emplace(vertices[vertex].position, vertex).first->second;
+			positionCounts[positionIds[vertex]]++;
+		}
+	}
+
+	Vec3f minPosition { FLT_MAX };
+	Vec3f maxPosition { -FLT_MAX };
+
+	for (unsigned int index : indices) {
+		minPosition = Vec3f::Min(minPosition, vertices[index].position);
+		maxPosition = Vec3f::Max(maxPosition, vertices[index].position);
+	}
+
+	const float extent = std::max((maxPosition - minPosition).Length(), FLT_MIN);
+	const float maxError = targetError > 0.0f ? targetError * extent : FLT_MAX;
+	const float maxErrorSquared = targetError > 0.0f ? maxError * maxError : FLT_MAX;
+
+	// Open borders are the edges, across seams, used by a single triangle
+	std::unordered_map<uint64_t, int> edgeCounts;
+
+	for (size_t index = 0; index < indices.size(); index += 3) {
+		for (int corner = 0; corner < 3; corner++) {
+			edgeCounts[GetEdgeKey(positionIds[indices[index + corner]], positionIds[indices[index + (corner + 1) % 3]])]++;
+		}
+	}
+
+	std::vector<SimplifyVertexKind> kinds(vertexCount, SIMPLIFY_VERTEX_MANIFOLD);
+	std::unordered_set<uint64_t> borderEdges;
+	std::vector<Quadric> quadrics(vertexCount);
+
+	for (int vertex = 0; vertex < vertexCount; vertex++) {
+		if (positionCounts[positionIds[vertex]] > 1) {
+			kinds[vertex] = SIMPLIFY_VERTEX_LOCKED;
+		}
+	}
+
+	for (size_t index = 0; index < indices.size(); index += 3) {
+		const Vec3f &p0 = vertices[indices[index + 0]].position;
+		const Vec3f &p1 = vertices[indices[index + 1]].position;
+		const Vec3f &p2 = vertices[indices[index + 2]].position;
+		Vec3f normal = Vec3f::CrossProduct(p1 - p0, p2 - p0);
+		const float area = normal.Length();
+
+		if (area <= 0.0f) {
+			continue;
+		}
+
+		normal /= area;
+
+		for (int corner = 0; corner < 3; corner++) {
+			quadrics[indices[index + corner]].AddPlane(normal, -Vec3f::DotProduct(normal, p0), area);
+		}
+
+		// Border edges get a plane through the edge, perpendicular to the triangle, to keep their silhouette
+		for (int corner = 0; corner < 3; corner++) {
+			const unsigned int a = indices[index + corner];
+			const unsigned int b = indices[index + (corner + 1) % 3];
+
+			if (edgeCounts[GetEdgeKey(positionIds[a], positionIds[b])] != 1) {
+				continue;
+			}
+
+			const Vec3f edge = vertices[b].position - vertices[a].position;
+			const float length = edge.Length();
+
+			if (length <= 0.0f) {
+				continue;
+			}
+
+			const Vec3f borderNormal = Vec3f::CrossProduct(edge / length, normal);
+			const float borderWeight = length * length * 10.0f;
+
+			quadrics[a].AddPlane(borderNormal, -Vec3f::DotProduct(borderNormal, vertices[a].position), borderWeight);
+			quadrics[b].AddPlane(borderNormal, -Vec3f::DotProduct(borderNormal, vertices[a].position), borderWeight);
+
+			borderEdges.insert(GetEdgeKey(a, b));
+
+			if (kinds[a] == SIMPLIFY_VERTEX_MANIFOLD) {
+				kinds[a] = SIMPLIFY_VERTEX_BORDER;
+			}
+
+			if (kinds[b] == SIMPLIFY_VERTEX_MANIFOLD) {
+				kinds[b] = SIMPLIFY_VERTEX_BORDER;
+			}
+		}
+	}
+
+	auto canCollapse = [&](unsigned int source, unsigned int target) {
+		switch (kinds[source]) {
+		case SIMPLIFY_VERTEX_MANIFOLD:
+			return true;
+		case SIMPLIFY_VERTEX_BORDER:
+			return kinds[target] != SIMPLIFY_VERTEX_MANIFOLD && borderEdges.count(GetEdgeKey(source, target)) > 0;
+		default:
+			return false;
+		}
+	};
+
+	float resultError = 0.0f;
+	std::vector<int> adjacencyOffsets(vertexCount + 1);
+	std::vector<int> adjacency;
+	std::vector<SimplifyCollapse> collapses;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+
+	// Every pass collapses the cheapest independent edges, then compacts the index buffer
+	while (indices.size() > (size_t)targetIndexCount) {
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+
+		for (unsigned int index : indices) {
+			adjacencyOffsets[index + 1]++;
+		}
+
+		for (int vertex = 0; vertex < vertexCount; vertex++) {
+			adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+		}
+
+		adjacency.resize(indices.size());
+		{
+			std::vector<int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+			for (size_t index = 0; index < indices.size(); index++) {
+				adjacency[fill[indices[index]]++] = index / 3;
+			}
+		}
+
+		collapses.clear();
+
+		for (size_t index = 0; index < indices.size(); index += 3) {
+			for (int corner = 0; corner < 3; corner++) {
+				const unsigned int a = indices[index + corner];
+				const unsigned int b = indices[index + (corner + 1) % 3];
+
+				// Interior edges are seen from both of their triangles, keep the one listing a < b
+				if (a > b) {
+					auto edgeCount = edgeCounts.find(GetEdgeKey(positionIds[a], positionIds[b]));
+
+					if (edgeCount != edgeCounts.end() && edgeCount->second > 1) {
+						continue;
+					}
+				}
+
+				Quadric quadric = quadrics[a];
+				quadric.Add(quadrics[b]);
+
+				const float errorAB = canCollapse(a, b) ? (float)quadric.Evaluate(vertices[b].position) : FLT_MAX;
+				const float errorBA = canCollapse(b, a) ? (float)quadric.Evaluate(vertices[a].position) : FLT_MAX;
+
+				if (errorAB <= errorBA && errorAB <= maxErrorSquared) {
+					collapses.push_back({ a, b, errorAB });
+				}
+				else if (errorBA < errorAB && errorBA <= maxErrorSquared) {
+					collapses.push_back({ b, a, errorBA });
+				}
+			}
+		}
+
+		std::stable_sort(collapses.begin(), collapses.end(), [](const SimplifyCollapse &a, const SimplifyCollapse &b) {
+			return a.error < b.error;
+		});
+
+		for (int vertex = 0; vertex < vertexCount; vertex++) {
+			remap[vertex] = vertex;
+		}
+
+		std::fill(touched.begin(), touched.end(), false);
+
+		// Every collapse removes about two triangles, stop once enough of them are queued
+		const size_t removeTriangles = (indices.size() - targetIndexCount) / 3;
+		size_t removedTriangles = 0;
+		int collapseCount = 0;
+
+		for (const SimplifyCollapse &collapse : collapses) {
+			if (removedTriangles >= removeTriangles) {
+				break;
+			}
+
+			if (touched[collapse.source] || touched[collapse.target]) {
+				continue;
+			}
+
+			if (IsCollapseFlipping(collapse.source, collapse.target, indices, adjacencyOffsets, adjacency, vertices)) {
+				continue;
+			}
+
+			remap[collapse.source] = collapse.target;
+			quadrics[collapse.target].Add(quadrics[collapse.source]);
+			resultError = std::max(resultError, collapse.error);
+			collapseCount++;
+
+			// Neighbours keep their triangles until the next pass so the flip test stays valid
+			for (const unsigned int vertex : { collapse.source, collapse.target }) {
+				for (int offset = adjacencyOffsets[vertex]; offset < adjacencyOffsets[vertex + 1]; offset++) {
+					const unsigned int *triangle = &indices[3 * adjacency[offset]];
+
+					if (vertex == collapse.source && (triangle[0] == collapse.target || triangle[1] == collapse.target || triangle[2] == collapse.target)) {
+						removedTriangles++;
+					}
+
+					touched[triangle[0]] = true;
+					touched[triangle[1]] = true;
+					touched[triangle[2]] = true;
+				}
+			}
+		}
+
+		if (collapseCount == 0) {
+			break;
+		}
+
+		size_t writeIndex = 0;
+
+		for (size_t index = 0; index < indices.size(); index += 3) {
+			const unsigned int a = remap[indices[index + 0]];
+			const unsigned int b = remap[indices[index + 1]];
+			const unsigned int c = remap[indices[index + 2]];
+
+			if (a != b && b != c && c != a) {
+				indices[writeIndex++] = a;
+				indices[writeIndex++] = b;
+				indices[writeIndex++] = c;
+			}
+		}
+
+		indices.resize(writeIndex);
+	}
+
+	return sqrtf(resultError) / extent;
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef __MESHOPTIMIZER_H__
+#define __MESHOPTIMIZER_H__
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include "RawModel.h"
+
+// Size of the FIFO cache used to measure ACMR/ATVR
+#define MESH_OPTIMIZER_CACHE_SIZE 16
+
+/**
+ * Triangle orderings for the post-transform vertex cache.
+ */
+enum class VertexCacheOptimizerOptions {
+	NONE,       // keep the triangle order of the source
+	PVRT,       // PVRTGeometrySort, also sorts vertices by first use
+	FORSYTH,    // Forsyth's linear-speed vertex cache optimization
+};
+
+/**
+ * Cluster of a submesh for GPU culling, written to the .mesh file as is. The vertices of a
+ * meshlet index the submesh vertices, its triangles are three bytes of local vertex indices
+ * starting 4 byte aligned. A meshlet is backfacing for every camera position where
+ * dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius,
+ * a cutoff of 1 disables the test.
+ */
+struct Meshlet
+{
+	unsigned int vertexOffset;
+	unsigned int vertexCount;
+	unsigned int triangleOffset;
+	unsigned int triangleCount;
+
+	float center[3];
+	float radius;
+
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+// Hashes exact positions, vertices that only differ by attributes share a position
+struct PositionHasher
+{
+	size_t operator()(const Vec3f &p) const
+	{
+		return std::hash<float>()(p.x) ^ (std::hash<float>()(p.y) * 31) ^ (std::hash<float>()(p.z) * 131);
+	}
+};
+
+struct MeshOptimizerStats
+{
+	float acmr { 0.0f };    // average cache miss ratio, misses per triangle
+	float atvr { 0.0f };    // average transform to vertex ratio, misses per vertex
+};
+
+MeshOptimizerStats GetMeshOptimizerStats(const unsigned int *indices, int indexCount, int vertexCount, int cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+// Same as GetMeshOptimizerStats for an LRU cache, a hit moves the vertex to the front.
+MeshOptimizerStats GetMeshOptimizerStatsLRU(const unsigned int *indices, int indexCount, int vertexCount, int cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+// Pixels shaded per pixel covered when the triangles are drawn in order with a depth test and backface culling,
+// rasterized along the six axis directions.
+float GetMeshOverdraw(const unsigned int *indices, int indexCount, const RawVertex *vertices, int vertexCount);
+
+// Bytes read from memory per byte of vertex data used, when every post-transform cache miss of a FIFO cache of
+// cacheSize fetches its vertex through 64 byte lines of a 16 KiB cache; 1 is ideal.
+float GetMeshVertexFetch(const unsigned int *indices, int indexCount, int vertexCount, int vertexSize, int cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+// Triangles that repeat a vertex or have no area.
+int GetDegenerateTriangleCount(const unsigned int *indices, int indexCount, const RawVertex *vertices);
+
+// Reorders triangles for the vertex cache, indices are relative to the first vertex.
+void OptimizeVertexCacheForsyth(unsigned int *indices, int indexCount, int vertexCount);
+
+// Reorders runs of cache friendly triangles so that outward facing clusters are drawn first.
+// The threshold bounds the ACMR increase, 1.05 allows 5% more cache misses.
+void OptimizeOverdraw(unsigned int *indices, int indexCount, const RawVertex *vertices, int vertexCount, float threshold);
+
+// Reorders vertices by first use and remaps the indices, unused vertices move to the end.
+void OptimizeVertexFetch(RawVertex *vertices, int vertexCount, unsigned int *indices, int indexCount);
+
+// Splits the triangles, in their current order, into meshlets of at most maxVertices (up to 256) and maxTriangles.
+void BuildMeshlets(std::vector<Meshlet> &meshlets, std::vector<unsigned int> &meshletVertices, std::vector<uint8_t> &meshletTriangles, const unsigned int *indices, int indexCount, const RawVertex *vertices, int vertexCount, int maxVertices, int maxTriangles);
+
+// Collapses edges by quadric error until at most targetIndexCount indices remain or the error, relative to
+// the extent of the mesh, reaches targetError (0 for no limit). Vertices are only ever moved onto existing
+// neighbours, so skin weights and other attributes are never interpolated; vertices on attribute seams are
+// locked and open borders collapse along themselves. Returns the relative error reached.
+float SimplifyMesh(std::vector<unsigned int> &indices, const RawVertex *vertices, int vertexCount, int targetIndexCount, float targetError);
+
+#endif // !__MESHOPTIMIZER_H__
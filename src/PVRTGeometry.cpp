@@ -81,6 +81,15 @@ struct SVtx {
 	SVtx	**ppMeshPos;	// Position in VtxByMesh list
 };
 
+/****************************************************************************
+@Function 		SEdgeDelta
+@Description	An edge of a block option and the number of its triangles using it
+****************************************************************************/
+struct SEdgeDelta {
+	const SEdg	*pEdg;
+	int			nRefCnt;
+};
+
 /****************************************************************************
 @Function 		SMesh
 @Description	Information about a mesh
@@ -90,6 +99,39 @@ struct SMesh {
 	int		nVtxNum;
 };
 
+/****************************************************************************
+@Function 		SBlockOptionMem
+@Description	Storage of the arrays of a block option
+****************************************************************************/
+struct SBlockOptionMem {
+	std::vector<SVtx*>			vVtx;
+	std::vector<STri*>			vTri;
+	std::vector<SEdgeDelta>		vEdgeDelta;
+};
+
+/****************************************************************************
+@Function 		PVRTGeometrySortContext
+@Description	Working memory of the sorter. The arrays keep their capacity
+				from one sort to the next, so a context reused for many
+				meshes stops allocating once it has seen the largest one.
+****************************************************************************/
+class PVRTGeometrySortContext {
+public:
+	std::vector<STri>				vTri;
+	std::vector<SEdg>				vEdg;
+	std::vector<SVtx>				vVtx;
+	std::vector<STri*>				vVtxTri;		// Triangles of every vertex, one vertex after the other
+	std::vector<SVtx*>				vVtxByMesh;
+	std::vector<std::vector<SMesh> >	vvMesh;			// Meshes of fewer vertices than a block holds, by vertex count
+	std::vector<SMesh>				vMeshLg;		// Meshes of at least as many vertices as a block holds
+
+	SBlockOptionMem					sOpt, sOptBest, sJob0, sJob1;
+
+	std::vector<PVRTGEOMETRY_IDX>	vIdxOut;
+	std::vector<char>				vVtxNew;
+	std::vector<int>				vVtxDest;
+};
+
 /****************************************************************************
 @Function 		CObject
 @Description	Information about an object (i.e. collection of mesh's to form
@@ -104,7 +146,7 @@ public:
 	int		m_nTriNumFree;
 
 	std::vector<SMesh> *m_pvMesh;
-	std::vector<SMesh> m_vMeshLg;
+	std::vector<SMesh> &m_vMeshLg;
 
 protected:
 	int		m_nVtxTot;		// Total vertices in the object
@@ -122,7 +164,8 @@ public:
 		const int				nVtxTot,
 		const int				nTriTot,
 		const int				nVtxLimit,
-		const int				nTriLimit);
+		const int				nTriLimit,
+		PVRTGeometrySortContext	* const pContext);
 
 	~CObject();
 
@@ -150,12 +193,6 @@ protected:
 @Description	A possible group of polygons to use
 ****************************************************************************/
 struct CBlockOption {
-protected:
-	struct SEdgeDelta {
-		const SEdg	*pEdg;
-		int			nRefCnt;
-	};
-
 public:
 	int			nVtxNum;			// Number of vertices in the block
 	int			nEdgNum;			// Number of edges in the block
@@ -170,11 +207,10 @@ protected:
 	int			m_nTriLimit;		// Maximum number of triangles a block can contain
 
 public:
-	~CBlockOption();
-
 	void Init(
-		const int	nVtxLimit,
-		const int	nTriLimit);
+		const int		nVtxLimit,
+		const int		nTriLimit,
+		SBlockOptionMem	* const pMem);
 	void Copy(const CBlockOption * const pSrc);
 
 	void Clear();
@@ -230,8 +266,9 @@ protected:
 
 public:
 	CBlock(
-		const int	nBufferVtxLimit,
-		const int	nBufferTriLimit);
+		const int				nBufferVtxLimit,
+		const int				nBufferTriLimit,
+		PVRTGeometrySortContext	* const pContext);
 
 	void Clear();
 
@@ -269,6 +306,7 @@ protected:
 @Input			nTriTot			Total number of triangles
 @Input			nVtxLimit		Max number of vertices a block can contain
 @Input			nTriLimit		Max number of triangles a block can contain
+@Input			pContext		Working memory the arrays are taken from
 @Description	The class's constructor.
 ****************************************************************************/
 CObject::CObject(
@@ -276,19 +314,27 @@ CObject::CObject(
 	const int				nVtxTot,
 	const int				nTriTot,
 	const int				nVtxLimit,
-	const int				nTriLimit)
+	const int				nTriLimit,
+	PVRTGeometrySortContext	* const pContext)
+	: m_vMeshLg(pContext->vMeshLg)
 {
 	int		i;
 	SVtx	*pVtx0, *pVtx1, *pVtx2;
+	STri	**ppTri;
 
 	m_nVtxLimit		= nVtxLimit;
 	m_nTriLimit		= nTriLimit;
 
-	m_pvMesh = new std::vector<SMesh>[nVtxLimit-2];
-	_ASSERT(m_pvMesh);
+	// The mesh lists keep their capacity, only their contents go
+	if((int)pContext->vvMesh.size() < nVtxLimit-2)
+		pContext->vvMesh.resize(nVtxLimit-2);
+	for(i = 0; i < nVtxLimit-2; ++i)
+		pContext->vvMesh[i].clear();
+	m_pvMesh = pContext->vvMesh.data();
+	m_vMeshLg.clear();
 
-	m_ppVtxByMesh = (SVtx**)calloc(nVtxTot, sizeof(*m_ppVtxByMesh));
-	_ASSERT(m_ppVtxByMesh);
+	pContext->vVtxByMesh.assign(nVtxTot, 0);
+	m_ppVtxByMesh = pContext->vVtxByMesh.data();
 
 	m_nVtxTot = nVtxTot;
 	m_nEdgTot = 0;
@@ -296,14 +342,17 @@ CObject::CObject(
 
 	m_nTriNumFree = m_nTriTot;
 
-	m_pTri = (STri*)calloc(nTriTot, sizeof(*m_pTri));
-	_ASSERT(m_pTri);
+	pContext->vTri.assign(nTriTot, STri());
+	m_pTri = pContext->vTri.data();
 
-	m_pEdg = (SEdg*)calloc(nTriTot*3, sizeof(*m_pEdg));	// Allocate the maximum possible number of edges, though it should be far fewer than this
-	_ASSERT(m_pEdg);
+	// Room for the maximum possible number of edges, though it should be far fewer than this; an edge is only read
+	// once BuildEdgeList wrote it, so the array isn't cleared
+	if(pContext->vEdg.size() < (size_t)nTriTot*3)
+		pContext->vEdg.resize((size_t)nTriTot*3);
+	m_pEdg = pContext->vEdg.data();
 
-	m_pVtx = (SVtx*)calloc(nVtxTot, sizeof(*m_pVtx));
-	_ASSERT(m_pVtx);
+	pContext->vVtx.assign(nVtxTot, SVtx());
+	m_pVtx = pContext->vVtx.data();
 
 	// Run through triangles...
 	for(i = 0; i < nTriTot; ++i) {
@@ -322,9 +371,14 @@ CObject::CObject(
 		m_pTri[i].psEdg[2] = BuildEdgeList(pVtx2, pVtx0);
 	}
 
-	// Run through vertices, creating enough space for pointers to each triangle using this vertex
-	for(i = 0; i < nVtxTot; ++i)
-		m_pVtx[i].psTri = (STri**)calloc(m_pVtx[i].nTriNumFree, sizeof(*m_pVtx[i].psTri));
+	// Run through vertices, giving each the space for pointers to each triangle using this vertex
+	if(pContext->vVtxTri.size() < (size_t)nTriTot*3)
+		pContext->vVtxTri.resize((size_t)nTriTot*3);
+	ppTri = pContext->vVtxTri.data();
+	for(i = 0; i < nVtxTot; ++i) {
+		m_pVtx[i].psTri = ppTri;
+		ppTri += m_pVtx[i].nTriNumFree;
+	}
 
 	// Run through triangles, marking each vertex used with a pointer to this tri
 	for(i = 0; i < nTriTot; ++i) {
@@ -357,9 +411,9 @@ CObject::~CObject()
 {
 	_ASSERT(m_nTriNumFree == 0);
 
+	// The arrays belong to the context
 	while(m_nVtxTot) {
 		--m_nVtxTot;
-		FREE(m_pVtx[m_nVtxTot].psTri);
 		_ASSERTE(m_pVtx[m_nVtxTot].nTriNumFree == 0);
 		_ASSERTE(m_pVtx[m_nVtxTot].ppMeshPos);
 	}
@@ -374,13 +428,6 @@ CObject::~CObject()
 		_ASSERTE(m_pTri[m_nTriTot].bUsed);
 	}
 #endif
-
-	FREE(m_pTri);
-	FREE(m_pEdg);
-	FREE(m_pVtx);
-
-	delete [] m_pvMesh;
-	FREE(m_ppVtxByMesh);
 }
 
 /****************************************************************************
@@ -627,33 +674,31 @@ void CObject::ResizeMesh(
 #endif
 }
 
-/****************************************************************************
-@Function 		~CBlockOption
-@Description	Default destructor
-****************************************************************************/
-CBlockOption::~CBlockOption()
-{
-	FREE(psVtx);
-	FREE(psTri);
-	FREE(psEdgeDelta);
-}
-
 /****************************************************************************
 @Function 		Init
 @Input			nVertexLimit		The maximum number of vertices a block can contain
 @Input			nTriLimit			The maximum number of triangles a block can contain
+@Input			pMem				Storage the arrays are taken from
 @Description	Initialises the class
 ****************************************************************************/
 void CBlockOption::Init(
-	const int	nVtxLimit,
-	const int	nTriLimit)
+	const int		nVtxLimit,
+	const int		nTriLimit,
+	SBlockOptionMem	* const pMem)
 {
 	m_nVtxLimit = nVtxLimit;
 	m_nTriLimit = nTriLimit;
 
-	psVtx		= (SVtx**)malloc(nVtxLimit * sizeof(*psVtx));
-	psTri		= (STri**)malloc(nTriLimit * sizeof(*psTri));
-	psEdgeDelta	= (SEdgeDelta*)malloc(3 * nTriLimit * sizeof(*psEdgeDelta));
+	if(pMem->vVtx.size() < (size_t)nVtxLimit)
+		pMem->vVtx.resize(nVtxLimit);
+	if(pMem->vTri.size() < (size_t)nTriLimit)
+		pMem->vTri.resize(nTriLimit);
+	if(pMem->vEdgeDelta.size() < (size_t)nTriLimit*3)
+		pMem->vEdgeDelta.resize((size_t)nTriLimit*3);
+
+	psVtx		= pMem->vVtx.data();
+	psTri		= pMem->vTri.data();
+	psEdgeDelta	= pMem->vEdgeDelta.data();
 }
 
 /****************************************************************************
@@ -1014,21 +1059,25 @@ void CBlockOption::Add(
 
 /****************************************************************************
 @Function 		CBlock
+@Input			nBufferVtxLimit	Max number of vertices a block can contain
+@Input			nBufferTriLimit	Max number of triangles a block can contain
+@Input			pContext		Working memory the block options are taken from
 @Description	Default constructor
 ****************************************************************************/
 CBlock::CBlock(
-	const int	nBufferVtxLimit,
-	const int	nBufferTriLimit)
+	const int				nBufferVtxLimit,
+	const int				nBufferTriLimit,
+	PVRTGeometrySortContext	* const pContext)
 {
 	m_nVtxLimit = nBufferVtxLimit;
 	m_nTriLimit = nBufferTriLimit;
 
-	m_sOpt.Init(m_nVtxLimit, m_nTriLimit);
-	m_sOptBest.Init(m_nVtxLimit, m_nTriLimit);
+	m_sOpt.Init(m_nVtxLimit, m_nTriLimit, &pContext->sOpt);
+	m_sOptBest.Init(m_nVtxLimit, m_nTriLimit, &pContext->sOptBest);
 
 	// Intialise "job" blocks
-	m_sJob0.Init(3, m_nTriLimit);
-	m_sJob1.Init(3, m_nTriLimit);
+	m_sJob0.Init(3, m_nTriLimit, &pContext->sJob0);
+	m_sJob1.Init(3, m_nTriLimit, &pContext->sJob1);
 }
 
 /****************************************************************************
@@ -1327,25 +1376,29 @@ int CBlock::Fill(
 @Input			nStride			Stride
 @Input			nVertNum		Number of vertices
 @Input			nIdxNum			Number of indices
+@Input			pContext		Working memory
 @Description	Sorts the vertices.
 ****************************************************************************/
 static void SortVertices(
-	void				* const pVtxData,
-	PVRTGEOMETRY_IDX	* const pwIdx,
-	const int			nStride,
-	const int			nVertNum,
-	const int			nIdxNum)
+	void					* const pVtxData,
+	PVRTGEOMETRY_IDX		* const pwIdx,
+	const int				nStride,
+	const int				nVertNum,
+	const int				nIdxNum,
+	PVRTGeometrySortContext	* const pContext)
 {
 	void				*pVtxNew;
 	int					*pnVtxDest;
 	int					i;
 	PVRTGEOMETRY_IDX	wNext;
 
-	pVtxNew		= malloc(nVertNum * nStride);
-	_ASSERT(pVtxNew);
+	if(pContext->vVtxNew.size() < (size_t)nVertNum * nStride)
+		pContext->vVtxNew.resize((size_t)nVertNum * nStride);
+	pVtxNew		= pContext->vVtxNew.data();
 
-	pnVtxDest	= (int*)malloc(nVertNum * sizeof(*pnVtxDest));
-	_ASSERT(pnVtxDest);
+	if(pContext->vVtxDest.size() < (size_t)nVertNum)
+		pContext->vVtxDest.resize(nVertNum);
+	pnVtxDest	= pContext->vVtxDest.data();
 
 	wNext = 0;
 
@@ -1373,9 +1426,6 @@ static void SortVertices(
 	*/
 	_ASSERT((int) wNext == nVertNum);
 	memcpy(pVtxData, pVtxNew, nVertNum * nStride);
-
-	FREE(pnVtxDest);
-	FREE(pVtxNew);
 }
 
 /****************************************************************************
@@ -1391,20 +1441,22 @@ static void SortVertices(
  @Input			nBufferVtxLimit	Number of vertices that can be stored in a buffer
  @Input			nBufferTriLimit	Number of triangles that can be stored in a buffer
  @Input			dwFlags			PVRTGEOMETRY_SORT_* flags
+ @Modified		pContext		Working memory, or 0 to allocate it for this call
  @Description	Triangle sorter
 *****************************************************************************/
 void PVRTGeometrySort(
-	void				* const pVtxData,
-	PVRTGEOMETRY_IDX	* const pwIdx,
-	const int			nStride,
-	const int			nVertNum,
-	const int			nTriNum,
-	const int			nBufferVtxLimit,
-	const int			nBufferTriLimit,
-	const unsigned int	dwFlags)
+	void					* const pVtxData,
+	PVRTGEOMETRY_IDX		* const pwIdx,
+	const int				nStride,
+	const int				nVertNum,
+	const int				nTriNum,
+	const int				nBufferVtxLimit,
+	const int				nBufferTriLimit,
+	const unsigned int		dwFlags,
+	PVRTGeometrySortContext	* const pContext)
 {
-	CObject				sOb(pwIdx, nVertNum, nTriNum, nBufferVtxLimit, nBufferTriLimit);
-	CBlock				sBlock(nBufferVtxLimit, nBufferTriLimit);
+	PVRTGeometrySortContext	sContext;
+	PVRTGeometrySortContext	* const pCtx = pContext ? pContext : &sContext;
 	PVRTGEOMETRY_IDX	*pwIdxOut;
 	int					nTriCnt, nVtxCnt;
 	int					nOutTriCnt, nOutVtxCnt, nOutBlockCnt;
@@ -1422,8 +1474,12 @@ void PVRTGeometrySort(
 		_RPT4(_CRT_WARN, "OptimiseTriListPVR() Before: Tri: %d, Vtx: %d, vtx/tri=%f Blocks=%d\n", nTriNum, sVGPMdlBefore.nVtxCnt, (float)sVGPMdlBefore.nVtxCnt / (float)nTriNum, sVGPMdlBefore.nBlockCnt);
 #endif
 
-		pwIdxOut	= (PVRTGEOMETRY_IDX*)malloc(nTriNum * 3 * sizeof(*pwIdxOut));
-		_ASSERT(pwIdxOut);
+		CObject		sOb(pwIdx, nVertNum, nTriNum, nBufferVtxLimit, nBufferTriLimit, pCtx);
+		CBlock		sBlock(nBufferVtxLimit, nBufferTriLimit, pCtx);
+
+		if(pCtx->vIdxOut.size() < (size_t)nTriNum * 3)
+			pCtx->vIdxOut.resize((size_t)nTriNum * 3);
+		pwIdxOut	= pCtx->vIdxOut.data();
 
 		// Sort geometry into blocks
 		nOutTriCnt		= 0;
@@ -1468,7 +1524,6 @@ void PVRTGeometrySort(
 
 		// Done!
 		memcpy(pwIdx, pwIdxOut, nTriNum * 3 * sizeof(*pwIdx));
-		FREE(pwIdxOut);
 
 		_RPT3(_CRT_WARN, "OptimiseTriListPVR() In: Tri: %d, Vtx: %d, vtx/tri=%f\n", nTriNum, nVertNum, (float)nVertNum / (float)nTriNum);
 		_RPT4(_CRT_WARN, "OptimiseTriListPVR() HW: Tri: %d, Vtx: %d, vtx/tri=%f Blocks=%d\n", nOutTriCnt, nOutVtxCnt, (float)nOutVtxCnt / (float)nOutTriCnt, nOutBlockCnt);
@@ -1490,10 +1545,30 @@ void PVRTGeometrySort(
 		// manner. Should cut page-breaks on the initial memory read of
 		// vertices. Affects both the order of vertices, and the values
 		// of indices, but the triangle order is unchanged.
-		SortVertices(pVtxData, pwIdx, nStride, nVertNum, nTriNum*3);
+		SortVertices(pVtxData, pwIdx, nStride, nVertNum, nTriNum*3, pCtx);
 	}
 }
 
+/*!***************************************************************************
+ @Function		PVRTGeometryCreateSortContext
+ @Return		New, empty working memory for PVRTGeometrySort
+ @Description	Creates a sort context
+*****************************************************************************/
+PVRTGeometrySortContext *PVRTGeometryCreateSortContext()
+{
+	return new PVRTGeometrySortContext;
+}
+
+/*!***************************************************************************
+ @Function		PVRTGeometryDeleteSortContext
+ @Input			pContext		Context created by PVRTGeometryCreateSortContext
+ @Description	Frees a sort context and its working memory
+*****************************************************************************/
+void PVRTGeometryDeleteSortContext(PVRTGeometrySortContext * const pContext)
+{
+	delete pContext;
+}
+
 /*****************************************************************************
  End of file (PVRTGeometry.cpp)
 *****************************************************************************/
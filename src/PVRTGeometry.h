@@ -17,10 +17,33 @@
 #define PVRTGEOMETRY_SORT_VERTEXCACHE (0x01	/* Sort triangles for optimal vertex cache usage */)
 #define PVRTGEOMETRY_SORT_IGNOREVERTS (0x02	/* Do not sort vertices for optimal memory cache usage */)
 
+/****************************************************************************
+** Structures
+****************************************************************************/
+
+/*!***************************************************************************
+ @brief      	    Working memory of the triangle sorter. A context passed to
+					every sort on one thread keeps its buffers between the
+					calls, instead of each call allocating and freeing them.
+*****************************************************************************/
+class PVRTGeometrySortContext;
+
 /****************************************************************************
 ** Functions
 ****************************************************************************/
 
+/*!***************************************************************************
+ @brief      	    Creates an empty sort context
+ @return			The context, freed with PVRTGeometryDeleteSortContext
+*****************************************************************************/
+PVRTGeometrySortContext *PVRTGeometryCreateSortContext();
+
+/*!***************************************************************************
+ @brief      	    Frees a sort context and its working memory
+ @param[in]			pContext		Context to free
+*****************************************************************************/
+void PVRTGeometryDeleteSortContext(PVRTGeometrySortContext * const pContext);
+
 /*!***************************************************************************
  @brief      	    Triangle sorter
  @param[in,out]		pVtxData		Pointer to array of vertices
@@ -31,16 +54,18 @@
  @param[in]			nBufferVtxLimit	Number of vertices that can be stored in a buffer
  @param[in]			nBufferTriLimit	Number of triangles that can be stored in a buffer
  @param[in]			dwFlags			PVRTGEOMETRY_SORT_* flags
+ @param[in,out]		pContext		Working memory, 0 allocates it for this call only
 *****************************************************************************/
 void PVRTGeometrySort(
-	void				* const pVtxData,
-	PVRTGEOMETRY_IDX	* const pwIdx,
-	const int			nStride,
-	const int			nVertNum,
-	const int			nTriNum,
-	const int			nBufferVtxLimit,
-	const int			nBufferTriLimit,
-	const unsigned int	dwFlags);
+	void					* const pVtxData,
+	PVRTGEOMETRY_IDX		* const pwIdx,
+	const int				nStride,
+	const int				nVertNum,
+	const int				nTriNum,
+	const int				nBufferVtxLimit,
+	const int				nBufferTriLimit,
+	const unsigned int		dwFlags,
+	PVRTGeometrySortContext	* const pContext = 0);
 
 
 #endif /* _PVRTGEOMETRY_H_ */
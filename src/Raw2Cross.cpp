@@ -11,6 +11,28 @@
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <array>
+#include <tuple>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RAW2CROSS_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RAW2CROSS_NEON 1
+#endif
+
+#include <json.hpp>
+
+// This can be a macro under Windows, confusing Draco
+#undef ERROR
+#include <draco/compression/encode.h>
 
 #include <stb_image.h>
 #include <stb_image_write.h>
@@ -20,11 +42,14 @@
 #include "utils/String_Utils.h"
 #include "utils/Image_Utils.h"
 #include "utils/File_Utils.h"
+#include "utils/Hash_Utils.h"
+#include "utils/Thread_Utils.h"
+#include "utils/Memory_Utils.h"
+#include "utils/Profile_Utils.h"
 #include "RawModel.h"
 #include "Raw2Cross.h"
 #include "PVRTGeometry.h"
-#include "tinyxml.h"
-#include "tinystr.h"
+#include "XmlWriter.h"
 
 void splitfilename(const char *name, char *fname, char *ext)
 {
@@ -63,30 +88,48 @@ void splitfilename(const char *name, char *fname, char *ext)
 	}
 }
 
+static unsigned int GetPositionSize(unsigned int format)
+{
+	return (format & (CROSS_VERTEX_FORMAT_POSITION_SNORM16 | CROSS_VERTEX_FORMAT_POSITION_UNORM16)) ? sizeof(uint16_t) * 4 : sizeof(float) * 3;
+}
+
 static unsigned int GetVertexSize(unsigned int format)
 {
 	unsigned int size = 0;
 
-	if (format & RAW_VERTEX_ATTRIBUTE_POSITION) {
-		size += sizeof(float) * 3;
+	const unsigned int texcoordSize = (format & (CROSS_VERTEX_FORMAT_TEXCOORD_HALF | CROSS_VERTEX_FORMAT_TEXCOORD_UNORM16)) ? sizeof(uint16_t) * 2 : sizeof(float) * 2;
+
+	if ((format & RAW_VERTEX_ATTRIBUTE_POSITION) && (format & CROSS_VERTEX_FORMAT_POSITION_STREAM) == 0) {
+		size += GetPositionSize(format);
 	}
-	if (format & RAW_VERTEX_ATTRIBUTE_NORMAL) {
+	if ((format & RAW_VERTEX_ATTRIBUTE_NORMAL) && (format & CROSS_VERTEX_FORMAT_NORMAL_OCT8)) {
 		size += sizeof(int8_t) * 4;
 	}
-	if (format & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
-		size += sizeof(int8_t) * 4;
+	else if ((format & RAW_VERTEX_ATTRIBUTE_NORMAL) && (format & CROSS_VERTEX_FORMAT_NORMAL_OCT16)) {
+		size += (format & RAW_VERTEX_ATTRIBUTE_BINORMAL) ? sizeof(int16_t) * 4 : sizeof(int16_t) * 2;
+	}
+	else if ((format & RAW_VERTEX_ATTRIBUTE_NORMAL) && (format & CROSS_VERTEX_FORMAT_QTANGENT)) {
+		size += sizeof(int16_t) * 4;
+	}
+	else {
+		if (format & RAW_VERTEX_ATTRIBUTE_NORMAL) {
+			size += sizeof(int8_t) * 4;
+		}
+		if (format & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
+			size += sizeof(int8_t) * 4;
+		}
 	}
 	if (format & RAW_VERTEX_ATTRIBUTE_COLOR) {
 		size += sizeof(uint8_t) * 4;
 	}
 	if (format & RAW_VERTEX_ATTRIBUTE_UV0) {
-		size += sizeof(float) * 2;
+		size += texcoordSize;
 	}
 	if (format & RAW_VERTEX_ATTRIBUTE_UV1) {
-		size += sizeof(float) * 2;
+		size += texcoordSize;
 	}
 	if (format & RAW_VERTEX_ATTRIBUTE_JOINT_INDICES) {
-		size += sizeof(uint8_t) * 4;
+		size += (format & CROSS_VERTEX_FORMAT_JOINT_UINT16) ? sizeof(uint16_t) * 4 : sizeof(uint8_t) * 4;
 	}
 	if (format & RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS) {
 		size += sizeof(uint8_t) * 4;
@@ -95,480 +138,4336 @@ static unsigned int GetVertexSize(unsigned int format)
 	return size;
 }
 
-static std::string GetMaterialFileName(const char *szPathName, const RawMaterial &rawMaterial)
+static int QuantizeSnorm(float value, int bits)
 {
-	char szFileName[_MAX_PATH];
-	sprintf(szFileName, "%s%s.material", szPathName, rawMaterial.name.c_str());
-	return std::string(szFileName);
+	const int scale = (1 << (bits - 1)) - 1;
+	return (int)roundf(FbxClamp<float>(value, -1.0f, 1.0f) * scale);
 }
 
-static bool ExportMeshHeader(FILE *pFile, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels)
+static int QuantizeUnorm(float value, int bits)
 {
-	typedef struct SubMeshHeader
-	{
-		char szName[260];
-
-		float minx =  FLT_MAX;
-		float miny =  FLT_MAX;
-		float minz =  FLT_MAX;
-		float maxx = -FLT_MAX;
-		float maxy = -FLT_MAX;
-		float maxz = -FLT_MAX;
-
-		unsigned int baseVertex = 0;
-		unsigned int firstIndex = 0;
-		unsigned int indexCount = 0;
-
-	} SubMeshHeader;
-
-	typedef struct MeshHeader
-	{
-		unsigned int format = 0;
-		unsigned int numSubMeshs = 0;
+	const int scale = (1 << bits) - 1;
+	return (int)roundf(FbxClamp<float>(value, 0.0f, 1.0f) * scale);
+}
 
-		unsigned int indexBufferSize = 0;
-		unsigned int indexBufferOffset = 0;
+static float DequantizeSnorm(int value, int bits)
+{
+	return std::max((float)value / ((1 << (bits - 1)) - 1), -1.0f);
+}
 
-		unsigned int vertexBufferSize = 0;
-		unsigned int vertexBufferOffset = 0;
+static float DequantizeUnorm(int value, int bits)
+{
+	return (float)value / ((1 << bits) - 1);
+}
 
-		std::vector<SubMeshHeader> subMeshHeaders;
+static uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
 
-	} MeshHeader;
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x007FFFFF;
 
+	if (exponent >= 31) {
+		// Overflow, infinity and NaN
+		return (uint16_t)(sign | 0x7C00 | ((bits & 0x7F800000) == 0x7F800000 && mantissa ? 0x0200 : 0));
+	}
 
-	unsigned int numIndex = 0;
-	unsigned int numVertex = 0;
+	if (exponent <= 0) {
+		// Subnormal or zero
+		if (exponent < -10) {
+			return (uint16_t)sign;
+		}
+		mantissa |= 0x00800000;
+		const int shift = 14 - exponent;
+		const uint32_t half = mantissa >> shift;
+		const uint32_t rest = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		return (uint16_t)(sign | (half + (rest > halfway || (rest == halfway && (half & 1)))));
+	}
 
-	MeshHeader meshHeader;
-	meshHeader.format = rawModel.GetVertexAttributes();
-	meshHeader.numSubMeshs = rawMaterialModels.size();
-	meshHeader.subMeshHeaders.resize(rawMaterialModels.size());
+	// Round to nearest even, a carry into the exponent is still correct
+	const uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	const uint32_t rest = mantissa & 0x1FFF;
+	return (uint16_t)(half + (rest > 0x1000 || (rest == 0x1000 && (half & 1))));
+}
 
-	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
-		for (int indexVertex = 0; indexVertex < rawMaterialModels[indexMesh].GetVertexCount(); indexVertex++) {
-			const RawVertex &vertex = rawMaterialModels[indexMesh].GetVertex(indexVertex);
+static float HalfToFloat(uint16_t value)
+{
+	const uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	const int exponent = (value >> 10) & 0x1F;
+	const uint32_t mantissa = value & 0x03FF;
 
-			if (meshHeader.subMeshHeaders[indexMesh].minx > vertex.position.x) meshHeader.subMeshHeaders[indexMesh].minx = vertex.position.x;
-			if (meshHeader.subMeshHeaders[indexMesh].miny > vertex.position.y) meshHeader.subMeshHeaders[indexMesh].miny = vertex.position.y;
-			if (meshHeader.subMeshHeaders[indexMesh].minz > vertex.position.z) meshHeader.subMeshHeaders[indexMesh].minz = vertex.position.z;
+	uint32_t bits;
+	if (exponent == 0) {
+		const float result = ldexpf((float)mantissa, -24);
+		return sign ? -result : result;
+	}
+	else if (exponent == 31) {
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else {
+		bits = sign | ((uint32_t)(exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
 
-			if (meshHeader.subMeshHeaders[indexMesh].maxx < vertex.position.x) meshHeader.subMeshHeaders[indexMesh].maxx = vertex.position.x;
-			if (meshHeader.subMeshHeaders[indexMesh].maxy < vertex.position.y) meshHeader.subMeshHeaders[indexMesh].maxy = vertex.position.y;
-			if (meshHeader.subMeshHeaders[indexMesh].maxz < vertex.position.z) meshHeader.subMeshHeaders[indexMesh].maxz = vertex.position.z;
-		}
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
 
-		meshHeader.subMeshHeaders[indexMesh].baseVertex = 0; // numVertex;
-		meshHeader.subMeshHeaders[indexMesh].firstIndex = numIndex;
-		meshHeader.subMeshHeaders[indexMesh].indexCount = rawMaterialModels[indexMesh].GetTriangleCount() * 3;
+static uint32_t PackSnorm1010102(const Vec3f &value, int w)
+{
+	const uint32_t x = QuantizeSnorm(value.x, 10) & 0x3FF;
+	const uint32_t y = QuantizeSnorm(value.y, 10) & 0x3FF;
+	const uint32_t z = QuantizeSnorm(value.z, 10) & 0x3FF;
+	return x | (y << 10) | (z << 20) | ((uint32_t)w << 30);
+}
 
-		meshHeader.indexBufferSize += rawMaterialModels[indexMesh].GetTriangleCount() * 3 * sizeof(unsigned int);
-		meshHeader.vertexBufferSize += rawMaterialModels[indexMesh].GetVertexCount() * GetVertexSize(meshHeader.format);
+static Vec2f EncodeOctahedron(const Vec3f &value)
+{
+	const float length = fabsf(value.x) + fabsf(value.y) + fabsf(value.z);
+	if (length < FLT_MIN) {
+		return Vec2f(0.0f, 0.0f);
+	}
 
-		strcpy(meshHeader.subMeshHeaders[indexMesh].szName, rawMaterialModels[indexMesh].GetSurface(0).name.c_str());
+	Vec2f result(value.x / length, value.y / length);
+	if (value.z < 0.0f) {
+		result = Vec2f(
+			(1.0f - fabsf(result.y)) * (result.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - fabsf(result.x)) * (result.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	return result;
+}
 
-		numIndex += rawMaterialModels[indexMesh].GetTriangleCount() * 3;
-		numVertex += rawMaterialModels[indexMesh].GetVertexCount();
+static Vec3f DecodeOctahedron(const Vec2f &value)
+{
+	Vec3f result(value.x, value.y, 1.0f - fabsf(value.x) - fabsf(value.y));
+	if (result.z < 0.0f) {
+		result = Vec3f(
+			(1.0f - fabsf(value.y)) * (value.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - fabsf(value.x)) * (value.y >= 0.0f ? 1.0f : -1.0f),
+			result.z);
 	}
-	
-	const unsigned int baseOffset = offsetof(MeshHeader, subMeshHeaders) + sizeof(SubMeshHeader) * meshHeader.subMeshHeaders.size();
-	meshHeader.indexBufferOffset = baseOffset;
-	meshHeader.vertexBufferOffset = baseOffset + meshHeader.indexBufferSize;
+	return result.Normalized();
+}
 
-	fwrite(&meshHeader.format, sizeof(meshHeader.format), 1, pFile);
-	fwrite(&meshHeader.numSubMeshs, sizeof(meshHeader.numSubMeshs), 1, pFile);
-	fwrite(&meshHeader.indexBufferSize, sizeof(meshHeader.indexBufferSize), 1, pFile);
-	fwrite(&meshHeader.indexBufferOffset, sizeof(meshHeader.indexBufferOffset), 1, pFile);
-	fwrite(&meshHeader.vertexBufferSize, sizeof(meshHeader.vertexBufferSize), 1, pFile);
-	fwrite(&meshHeader.vertexBufferOffset, sizeof(meshHeader.vertexBufferOffset), 1, pFile);
-	fwrite(meshHeader.subMeshHeaders.data(), sizeof(SubMeshHeader), meshHeader.subMeshHeaders.size(), pFile);
+// The handedness is folded into the sign of y, y itself is remapped to [0, 1]
+static Vec2f EncodeOctahedronSign(const Vec3f &value, float sign, int bits)
+{
+	const float bias = 1.0f / ((1 << (bits - 1)) - 1);
+	const Vec2f result = EncodeOctahedron(value);
+	return Vec2f(result.x, std::max(result.y * 0.5f + 0.5f, bias) * sign);
+}
 
-	return true;
+static Vec3f DecodeOctahedronSign(const Vec2f &value, float &sign)
+{
+	sign = value.y < 0.0f ? -1.0f : 1.0f;
+	return DecodeOctahedron(Vec2f(value.x, fabsf(value.y) * 2.0f - 1.0f));
 }
 
-static bool ExportMeshData(FILE *pFile, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels)
+static Vec2f QuantizeOctahedron(const Vec2f &value, int bits)
 {
-	unsigned long format = rawModel.GetVertexAttributes();
+	return Vec2f(DequantizeSnorm(QuantizeSnorm(value.x, bits), bits), DequantizeSnorm(QuantizeSnorm(value.y, bits), bits));
+}
 
-	std::vector<RawVertex> vertices;
-	std::vector<unsigned int> indices;
+// Orthonormal tangent, binormal and normal, the sign is the handedness of the original frame
+static void GetTangentFrame(const RawVertex &vertex, Vec3f &tangent, Vec3f &binormal, Vec3f &normal, float &sign)
+{
+	normal = vertex.normal.LengthSquared() > FLT_MIN ? vertex.normal.Normalized() : Vec3f(0.0f, 0.0f, 1.0f);
+	tangent = Vec3f(vertex.tangent.x, vertex.tangent.y, vertex.tangent.z);
 
-	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
-		int baseIndex = indices.size();
-		int baseVertex = vertices.size();
+	if (tangent.LengthSquared() < FLT_MIN) {
+		tangent = Vec3f::CrossProduct(vertex.binormal, normal);
+	}
 
-		for (int index = 0; index < rawMaterialModels[indexMesh].GetVertexCount(); index++) {
-			vertices.push_back(rawMaterialModels[indexMesh].GetVertex(index));
-		}
+	tangent = tangent - normal * Vec3f::DotProduct(normal, tangent);
 
-		for (int index = 0; index < rawMaterialModels[indexMesh].GetTriangleCount(); index++) {
-			const RawTriangle &triangle = rawMaterialModels[indexMesh].GetTriangle(index);
-			indices.push_back(triangle.verts[0]);
-			indices.push_back(triangle.verts[1]);
-			indices.push_back(triangle.verts[2]);
-		}
+	if (tangent.LengthSquared() < FLT_MIN) {
+		tangent = Vec3f::CrossProduct(fabsf(normal.x) < 0.9f ? Vec3f(1.0f, 0.0f, 0.0f) : Vec3f(0.0f, 1.0f, 0.0f), normal);
+	}
 
-		PVRTGeometrySort(
-			&vertices[baseVertex],
-			&indices[baseIndex],
-			sizeof(RawVertex),
-			rawMaterialModels[indexMesh].GetVertexCount(),
-			rawMaterialModels[indexMesh].GetTriangleCount(),
-			rawMaterialModels[indexMesh].GetVertexCount(),
-			rawMaterialModels[indexMesh].GetTriangleCount(),
-			PVRTGEOMETRY_SORT_VERTEXCACHE);
+	tangent.Normalize();
+	binormal = Vec3f::CrossProduct(normal, tangent);
+	sign = Vec3f::DotProduct(Vec3f::CrossProduct(vertex.binormal, vertex.normal), Vec3f(vertex.tangent.x, vertex.tangent.y, vertex.tangent.z)) < 0.0f ? -1.0f : 1.0f;
+}
 
-		for (int index = 0; index < rawMaterialModels[indexMesh].GetTriangleCount(); index++) {
-			indices[baseIndex + 3 * index + 0] += baseVertex;
-			indices[baseIndex + 3 * index + 1] += baseVertex;
-			indices[baseIndex + 3 * index + 2] += baseVertex;
-		}
+// Quaternion of the frame with w >= bias, negated for a negative handedness
+static Vec4f EncodeQTangent(const Vec3f &tangent, const Vec3f &binormal, const Vec3f &normal, float sign)
+{
+	const float m00 = tangent.x, m01 = binormal.x, m02 = normal.x;
+	const float m10 = tangent.y, m11 = binormal.y, m12 = normal.y;
+	const float m20 = tangent.z, m21 = binormal.z, m22 = normal.z;
+
+	Vec4f q;
+	const float trace = m00 + m11 + m22;
+	if (trace > 0.0f) {
+		const float s = sqrtf(trace + 1.0f) * 2.0f;
+		q = Vec4f((m21 - m12) / s, (m02 - m20) / s, (m10 - m01) / s, 0.25f * s);
 	}
+	else if (m00 > m11 && m00 > m22) {
+		const float s = sqrtf(1.0f + m00 - m11 - m22) * 2.0f;
+		q = Vec4f(0.25f * s, (m01 + m10) / s, (m02 + m20) / s, (m21 - m12) / s);
+	}
+	else if (m11 > m22) {
+		const float s = sqrtf(1.0f + m11 - m00 - m22) * 2.0f;
+		q = Vec4f((m01 + m10) / s, 0.25f * s, (m12 + m21) / s, (m02 - m20) / s);
+	}
+	else {
+		const float s = sqrtf(1.0f + m22 - m00 - m11) * 2.0f;
+		q = Vec4f((m02 + m20) / s, (m12 + m21) / s, 0.25f * s, (m10 - m01) / s);
+	}
+
+	q.Normalize();
 
-	for (int index = 0; index < indices.size(); index++) {
-		fwrite(&indices[index], sizeof(indices[index]), 1, pFile);
+	if (q.w < 0.0f) {
+		q = -q;
 	}
 
-	for (int index = 0; index < vertices.size(); index++) {
-		if (format & RAW_VERTEX_ATTRIBUTE_POSITION) {
-			// 3 Component * 4 Byte = 12 Bytes
-			float x = vertices[index].position.x;
-			float y = vertices[index].position.y;
-			float z = vertices[index].position.z;
-			fwrite(&x, sizeof(x), 1, pFile);
-			fwrite(&y, sizeof(y), 1, pFile);
-			fwrite(&z, sizeof(z), 1, pFile);
-		}
-		if (format & RAW_VERTEX_ATTRIBUTE_NORMAL) {
-			// 4 Component * 1 Byte = 4 Bytes
-			int8_t x = FbxClamp<int>((int)(vertices[index].normal.x * INT8_MAX), INT8_MIN, INT8_MAX);
-			int8_t y = FbxClamp<int>((int)(vertices[index].normal.y * INT8_MAX), INT8_MIN, INT8_MAX);
-			int8_t z = FbxClamp<int>((int)(vertices[index].normal.z * INT8_MAX), INT8_MIN, INT8_MAX);
-			int8_t w = 0;
-			fwrite(&x, sizeof(x), 1, pFile);
-			fwrite(&y, sizeof(y), 1, pFile);
-			fwrite(&z, sizeof(z), 1, pFile);
-			fwrite(&w, sizeof(w), 1, pFile);
-		}
-		if (format & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
-			// 4 Component * 1 Byte = 4 Bytes
-			int8_t x = FbxClamp<int>((int)(vertices[index].binormal.x * INT8_MAX), INT8_MIN, INT8_MAX);
-			int8_t y = FbxClamp<int>((int)(vertices[index].binormal.y * INT8_MAX), INT8_MIN, INT8_MAX);
-			int8_t z = FbxClamp<int>((int)(vertices[index].binormal.z * INT8_MAX), INT8_MIN, INT8_MAX);
-			int8_t w = Vec3f::DotProduct(Vec3f::CrossProduct(vertices[index].binormal, vertices[index].normal), Vec3f(vertices[index].tangent.x, vertices[index].tangent.y, vertices[index].tangent.z)) < 0.0f ? -INT8_MAX : INT8_MAX;
-			fwrite(&x, sizeof(x), 1, pFile);
-			fwrite(&y, sizeof(y), 1, pFile);
-			fwrite(&z, sizeof(z), 1, pFile);
-			fwrite(&w, sizeof(w), 1, pFile);
-		}
-		if (format & RAW_VERTEX_ATTRIBUTE_COLOR) {
-			// 4 Component * 1 Byte = 4 Bytes
-			uint8_t x = FbxClamp<int>((int)(vertices[index].color.x * UINT8_MAX), 0, UINT8_MAX);
-			uint8_t y = FbxClamp<int>((int)(vertices[index].color.y * UINT8_MAX), 0, UINT8_MAX);
-			uint8_t z = FbxClamp<int>((int)(vertices[index].color.z * UINT8_MAX), 0, UINT8_MAX);
-			uint8_t w = FbxClamp<int>((int)(vertices[index].color.w * UINT8_MAX), 0, UINT8_MAX);
-			fwrite(&x, sizeof(x), 1, pFile);
-			fwrite(&y, sizeof(y), 1, pFile);
-			fwrite(&z, sizeof(z), 1, pFile);
-			fwrite(&w, sizeof(w), 1, pFile);
-		}
-		if (format & RAW_VERTEX_ATTRIBUTE_UV0) {
-			// 2 Component * 4 Byte = 8 Bytes
-			float x = vertices[index].uv0.x;
-			float y = vertices[index].uv0.y;
-			fwrite(&x, sizeof(x), 1, pFile);
-			fwrite(&y, sizeof(y), 1, pFile);
-		}
-		if (format & RAW_VERTEX_ATTRIBUTE_UV1) {
-			// 2 Component * 4 Byte = 8 Bytes
-			float x = vertices[index].uv1.x;
-			float y = vertices[index].uv1.y;
-			fwrite(&x, sizeof(x), 1, pFile);
-			fwrite(&y, sizeof(y), 1, pFile);
-		}
-		if (format & RAW_VERTEX_ATTRIBUTE_JOINT_INDICES) {
-			// 4 Component * 1 Byte = 4 Bytes
-			uint8_t x = FbxClamp<int>((int)vertices[index].jointIndices.x, 0, UINT8_MAX);
-			uint8_t y = FbxClamp<int>((int)vertices[index].jointIndices.y, 0, UINT8_MAX);
-			uint8_t z = FbxClamp<int>((int)vertices[index].jointIndices.z, 0, UINT8_MAX);
-			uint8_t w = FbxClamp<int>((int)vertices[index].jointIndices.w, 0, UINT8_MAX);
-			fwrite(&x, sizeof(x), 1, pFile);
-			fwrite(&y, sizeof(y), 1, pFile);
-			fwrite(&z, sizeof(z), 1, pFile);
-			fwrite(&w, sizeof(w), 1, pFile);
-		}
-		if (format & RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS) {
-			// 4 Component * 1 Byte = 4 Bytes
-			uint8_t x = FbxClamp<int>((int)(vertices[index].jointWeights.x * UINT8_MAX), 0, UINT8_MAX);
-			uint8_t y = FbxClamp<int>((int)(vertices[index].jointWeights.y * UINT8_MAX), 0, UINT8_MAX);
-			uint8_t z = FbxClamp<int>((int)(vertices[index].jointWeights.z * UINT8_MAX), 0, UINT8_MAX);
-			uint8_t w = FbxClamp<int>((int)(vertices[index].jointWeights.w * UINT8_MAX), 0, UINT8_MAX);
-			fwrite(&x, sizeof(x), 1, pFile);
-			fwrite(&y, sizeof(y), 1, pFile);
-			fwrite(&z, sizeof(z), 1, pFile);
-			fwrite(&w, sizeof(w), 1, pFile);
-		}
+	// Keep w away from zero so that its sign survives quantization
+	const float bias = 1.0f / INT16_MAX;
+	if (q.w < bias) {
+		const float scale = sqrtf(1.0f - bias * bias);
+		q = Vec4f(q.x * scale, q.y * scale, q.z * scale, bias);
 	}
 
-	return true;
+	return sign < 0.0f ? -q : q;
 }
 
-bool ExportMesh(const char *szFileName, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels)
+static void DecodeQTangent(const Vec4f &q, Vec3f &tangent, Vec3f &normal, float &sign)
 {
-	if (FILE *pFile = fopen(szFileName, "wb")) {
-		ExportMeshHeader(pFile, rawModel, rawMaterialModels);
-		ExportMeshData(pFile, rawModel, rawMaterialModels);
-		fclose(pFile);
-	}
+	tangent = Vec3f(1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.w * q.z), 2.0f * (q.x * q.z - q.w * q.y));
+	normal = Vec3f(2.0f * (q.x * q.z + q.w * q.y), 2.0f * (q.y * q.z - q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+	sign = q.w < 0.0f ? -1.0f : 1.0f;
+}
 
-	return true;
+static std::string GetMaterialFileName(const char *szPathName, const RawMaterial &rawMaterial)
+{
+	char szFileName[_MAX_PATH];
+	sprintf(szFileName, "%s%s.material", szPathName, rawMaterial.name.c_str());
+	return std::string(szFileName);
 }
 
-static bool ExportMaterial(const char *szFileName, const RawMaterial &material, const RawModel &rawModel)
+// .mesh v1 layout:
+//   MeshHeader (6 x unsigned int), SubMeshHeader[numSubMeshs], indices, vertices
+//
+// .mesh v2 layout:
+//   MeshFileHeader, MeshSectionHeader[numSections], sections
+//   Every section starts at a multiple of MeshFileHeader::alignment so the runtime
+//   can map the file and hand the index/vertex sections straight to the GPU.
+//   The meshlet sections are only written with CrossOptions::buildMeshlets, a submesh
+//   references its meshlets through SubMeshInfoHeader::firstMeshlet/numMeshlets.
+//   The position stream is only written with CrossOptions::positionStream, it starts at
+//   SubMeshInfoHeader::basePosition for every submesh. Its optional index section mirrors
+//   the layout of the index section.
+//   The skeleton sections are only written for skinned meshes. The skeleton lists every joint
+//   bound by any submesh once, parents first; a submesh binds the SubMeshInfoHeader::numJoints
+//   palette joints from SubMeshInfoHeader::firstJoint, and the joint indices of its vertices
+//   index that palette.
+//   The morph target sections are only written when a submesh has blend channels. Each submesh
+//   has SubMeshInfoHeader::numMorphTargets targets from firstMorphTarget, one per blend channel
+//   of its surface; a target lists only the vertices it moves, as numDeltas MorphDelta records.
+//   The vertex format section is only written with CrossOptions::subMeshFormats. It holds a
+//   SubMeshVertexFormat per submesh, whose vertices then start at its byte offset into the vertex
+//   section with a stride of its own; MeshInfoHeader::vertexSize is zero and baseVertex still
+//   counts the vertices of the submeshes before it.
+//   With CrossOptions::useDraco the index and vertex sections carry MESH_SECTION_FLAG_COMPRESSED,
+//   their size is what they decode to and they take no space in the file. Every submesh is then a
+//   Draco stream in the compressed data section, at the CompressedSubMesh offset and size of its
+//   index. Its attributes are floats in the order of the vertex format: position, normal, tangent
+//   (generic, w is the handedness the binormal is rebuilt with), color, uv0, uv1, joint indices
+//   (generic uint16) and joint weights (generic), each only if the format of the submesh has it.
+//   The runtime packs the decoded vertices into that format. The streams are encoded sequentially,
+//   so every submesh keeps its vertex and triangle order and decodes to the counts of its header.
+//   The position stream is not written with Draco, its positions would not match the quantized ones.
+//   With CrossOptions::meshPageSize the index and vertex sections carry MESH_SECTION_FLAG_PAGED
+//   and take no space in the file either. The page data section follows them at the next multiple
+//   of MeshPageTable::pageSize, made of pages of that many bytes, the last one short. Every submesh, so every LOD, is a block of
+//   its indices followed by its vertices at the SubMeshPages offsets; a block that doesn't fit
+//   what is left of a page starts the next one, so small submeshes share pages and loading one
+//   submesh reads exactly its SubMeshPages::numPages pages from firstPage. The page table section
+//   is a MeshPageTable followed by a SubMeshPages per submesh.
+
+#define MESH_FILE_MAGIC   0x48534D43 // 'CMSH'
+#define MESH_FILE_VERSION 2
+
+enum MeshSectionType
 {
-	TiXmlDocument doc;
-	TiXmlElement *pMaterialNode = new TiXmlElement("Material");
-	{
-		TiXmlElement *pPassNode = new TiXmlElement("Pass");
-		{
-			pPassNode->SetAttributeString("name", "Default");
+	MESH_SECTION_INFO      = 0,
+	MESH_SECTION_SUBMESHES = 1,
+	MESH_SECTION_INDICES   = 2,
+	MESH_SECTION_VERTICES  = 3,
+	MESH_SECTION_MESHLETS  = 4,
+	MESH_SECTION_MESHLET_VERTICES  = 5,
+	MESH_SECTION_MESHLET_TRIANGLES = 6,
+	MESH_SECTION_POSITIONS         = 7,
+	MESH_SECTION_POSITION_INDICES  = 8,
+	MESH_SECTION_SKELETON          = 9,
+	MESH_SECTION_PALETTES          = 10,
+	MESH_SECTION_MORPH_TARGETS     = 11,
+	MESH_SECTION_MORPH_DELTAS      = 12,
+	MESH_SECTION_VERTEX_FORMATS    = 13,
+	MESH_SECTION_COMPRESSED_SUBMESHES = 14,
+	MESH_SECTION_COMPRESSED_DATA      = 15,
+	MESH_SECTION_PAGE_DATA            = 16,
+	MESH_SECTION_PAGE_TABLE           = 17,
+};
 
-			TiXmlElement *pPipelineNode = new TiXmlElement("Pipeline");
-			{
-				pPipelineNode->SetAttributeString("render_pass", "Default");
+enum MeshSectionFlags
+{
+	MESH_SECTION_FLAG_COMPRESSED = 0x00000001,
+	MESH_SECTION_FLAG_PAGED      = 0x00000002,
+};
 
-				TiXmlElement *pVertexNode = new TiXmlElement("Vertex");
-				{
-					pVertexNode->SetAttributeString("file_name", "Default.glsl");
+enum MorphTargetFlags
+{
+	MORPH_TARGET_FLAG_NORMALS = 0x00000001,
+};
 
-					unsigned long format = rawModel.GetVertexAttributes();
+typedef struct SubMeshHeader
+{
+	char szName[260];
 
-					if (format & RAW_VERTEX_ATTRIBUTE_POSITION) {
-						TiXmlElement *pDefineNode = new TiXmlElement("Define");
-						pDefineNode->SetAttributeString("name", "VERTEX_ATTRIBUTE_POSITION");
-						pVertexNode->LinkEndChild(pDefineNode);
-					}
-					if (format & RAW_VERTEX_ATTRIBUTE_NORMAL) {
-						TiXmlElement *pDefineNode = new TiXmlElement("Define");
-						pDefineNode->SetAttributeString("name", "VERTEX_ATTRIBUTE_NORMAL");
-						pVertexNode->LinkEndChild(pDefineNode);
-					}
-					if (format & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
-						TiXmlElement *pDefineNode = new TiXmlElement("Define");
-						pDefineNode->SetAttributeString("name", "VERTEX_ATTRIBUTE_BINORMAL");
-						pVertexNode->LinkEndChild(pDefineNode);
-					}
-					if (format & RAW_VERTEX_ATTRIBUTE_COLOR) {
-						TiXmlElement *pDefineNode = new TiXmlElement("Define");
-						pDefineNode->SetAttributeString("name", "VERTEX_ATTRIBUTE_COLOR");
-						pVertexNode->LinkEndChild(pDefineNode);
-					}
-					if (format & RAW_VERTEX_ATTRIBUTE_UV0) {
-						TiXmlElement *pDefineNode = new TiXmlElement("Define");
-						pDefineNode->SetAttributeString("name", "VERTEX_ATTRIBUTE_TEXCOORD0");
-						pVertexNode->LinkEndChild(pDefineNode);
-					}
-					if (format & RAW_VERTEX_ATTRIBUTE_UV1) {
-						TiXmlElement *pDefineNode = new TiXmlElement("Define");
-						pDefineNode->SetAttributeString("name", "VERTEX_ATTRIBUTE_TEXCOORD1");
-						pVertexNode->LinkEndChild(pDefineNode);
-					}
-					if (format & RAW_VERTEX_ATTRIBUTE_JOINT_INDICES) {
-						TiXmlElement *pDefineNode = new TiXmlElement("Define");
-						pDefineNode->SetAttributeString("name", "VERTEX_ATTRIBUTE_INDICES");
-						pVertexNode->LinkEndChild(pDefineNode);
-					}
-					if (format & RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS) {
-						TiXmlElement *pDefineNode = new TiXmlElement("Define");
-						pDefineNode->SetAttributeString("name", "VERTEX_ATTRIBUTE_WEIGHTS");
-						pVertexNode->LinkEndChild(pDefineNode);
-					}
+	float minx =  FLT_MAX;
+	float miny =  FLT_MAX;
+	float minz =  FLT_MAX;
+	float maxx = -FLT_MAX;
+	float maxy = -FLT_MAX;
+	float maxz = -FLT_MAX;
 
-					TiXmlElement *pDefineNode = new TiXmlElement("Define");
-					pDefineNode->SetAttributeString("name", "INSTANCE_ATTRIBUTE_TRANSFORM");
-					pVertexNode->LinkEndChild(pDefineNode);
-				}
-				pPipelineNode->LinkEndChild(pVertexNode);
+	unsigned int baseVertex = 0;
+	unsigned int firstIndex = 0;
+	unsigned int indexCount = 0;
 
-				TiXmlElement *pFragmentNode = new TiXmlElement("Fragment");
-				{
-					pFragmentNode->SetAttributeString("file_name", "Default.glsl");
-				}
-				pPipelineNode->LinkEndChild(pFragmentNode);
-			}
-			pPassNode->LinkEndChild(pPipelineNode);
+} SubMeshHeader;
 
-			if (material.textures[RAW_TEXTURE_USAGE_DIFFUSE] >= 0 || material.textures[RAW_TEXTURE_USAGE_ALBEDO] >= 0) {
-				int indexTexture = -1;
-				indexTexture = material.textures[RAW_TEXTURE_USAGE_DIFFUSE] >= 0 ? RAW_TEXTURE_USAGE_DIFFUSE : indexTexture;
-				indexTexture = material.textures[RAW_TEXTURE_USAGE_ALBEDO] >= 0 ? RAW_TEXTURE_USAGE_ALBEDO : indexTexture;
+typedef struct MeshHeader
+{
+	unsigned int format = 0;
+	unsigned int numSubMeshs = 0;
 
-				TiXmlElement *pTextureNode = new TiXmlElement("Texture2D");
-				{
-					char szExt[_MAX_PATH];
-					char szFName[_MAX_PATH];
-					char szFileName[_MAX_PATH];
+	unsigned int indexBufferSize = 0;
+	unsigned int indexBufferOffset = 0;
 
-					splitfilename(rawModel.GetTexture(material.textures[indexTexture]).fileName.c_str(), szFName, szExt);
-					sprintf(szFileName, "%s%s", szFName, szExt);
+	unsigned int vertexBufferSize = 0;
+	unsigned int vertexBufferOffset = 0;
 
-					pTextureNode->SetAttributeString("name", "texAlbedo");
-					pTextureNode->SetAttributeString("file_name", szFileName);
-					pTextureNode->SetAttributeString("min_filter", "GFX_NEAREST");
-					pTextureNode->SetAttributeString("mag_filter", "GFX_LINEAR");
-					pTextureNode->SetAttributeString("mipmap_mode", "GFX_NEAREST");
-					pTextureNode->SetAttributeString("address_mode", "GFX_CLAMP_TO_EDGE");
-				}
-				pPassNode->LinkEndChild(pTextureNode);
-			}
-		}
-		pMaterialNode->LinkEndChild(pPassNode);
-	}
-	doc.LinkEndChild(pMaterialNode);
-	return doc.SaveFile(szFileName);
-}
+	std::vector<SubMeshHeader> subMeshHeaders;
+
+} MeshHeader;
 
-bool ExportMaterial(const char *szPathName, const RawModel &rawModel)
+typedef struct MeshFileHeader
 {
-	for (int index = 0; index < rawModel.GetMaterialCount(); index++) {
-		std::string fileName = GetMaterialFileName(szPathName, rawModel.GetMaterial(index));
-		ExportMaterial(fileName.c_str(), rawModel.GetMaterial(index), rawModel);
-	}
-	return true;
-}
+	unsigned int magic = MESH_FILE_MAGIC;
+	unsigned int version = MESH_FILE_VERSION;
+	unsigned int alignment = 0;
+	unsigned int numSections = 0;
 
-static bool IsNameLODGroup(const char* szName)
+} MeshFileHeader;
+
+typedef struct MeshSectionHeader
 {
-	const char* szCheckName = "_LODGroup";
-	return strstr(szName, szCheckName) != nullptr;
-}
+	unsigned int type = 0;
+	unsigned int flags = 0;
+	unsigned int offset = 0;
+	unsigned int size = 0;
 
-static bool IsNodeLODGrpup(const RawNode &node, const RawModel &rawModel)
+} MeshSectionHeader;
+
+typedef struct MeshInfoHeader
 {
-	// - XXX_LODGroup
-	//  |---XXX_LOD0
-	//  |   |---Mesh
-	//  |---XXX_LOD1
-	//  |   |---Mesh
-	//  |---XXX_LOD2
-	//      |--Mesh
+	unsigned int format = 0;
+	unsigned int vertexSize = 0;
+	unsigned int numVertices = 0;
+	unsigned int numIndices = 0;
+	unsigned int numSubMeshs = 0;
+	unsigned int positionSize = 0;
+	unsigned int numPositions = 0;
 
-	if (IsNameLODGroup(node.name.c_str()) == false) {
-		return false;
-	}
+} MeshInfoHeader;
 
-	if (node.childIds.empty() == true) {
-		return false;
-	}
+typedef struct SubMeshInfoHeader
+{
+	// firstIndex counts indexSize wide elements and indices are relative to baseVertex
+	SubMeshHeader header;
+	unsigned int indexSize = sizeof(unsigned int);
+	unsigned int firstMeshlet = 0;
+	unsigned int numMeshlets = 0;
+	unsigned int basePosition = 0;
+	unsigned int firstJoint = 0;
+	unsigned int numJoints = 0;
+	unsigned int firstMorphTarget = 0;
+	unsigned int numMorphTargets = 0;
 
-	for (int indexChild = 0; indexChild < node.childIds.size(); indexChild++) {
-		const RawNode &childNode = rawModel.GetNode(rawModel.GetNodeById(node.childIds[indexChild]));
+} SubMeshInfoHeader;
 
-		if (childNode.childIds.empty() == false) {
-			return false;
-		}
+typedef struct SubMeshVertexFormat
+{
+	// vertexOffset is in bytes from the start of the vertex section
+	unsigned int format = 0;
+	unsigned int vertexSize = 0;
+	unsigned int vertexOffset = 0;
+	unsigned int reserved = 0;
 
-		if (fabs(childNode.scale.x - 1.0f) > 0.0001f ||
-			fabs(childNode.scale.y - 1.0f) > 0.0001f ||
-			fabs(childNode.scale.z - 1.0f) > 0.0001f) {
-			return false;
-		}
+} SubMeshVertexFormat;
 
-		if (fabs(childNode.translation.x - 0.0f) > 0.0001f ||
-			fabs(childNode.translation.y - 0.0f) > 0.0001f ||
-			fabs(childNode.translation.z - 0.0f) > 0.0001f) {
-			return false;
-		}
+typedef struct CompressedSubMesh
+{
+	// offset is in bytes from the start of the compressed data section, a submesh without triangles has no stream
+	unsigned int offset = 0;
+	unsigned int size = 0;
 
-		if (fabs(childNode.rotation[0] - 1.0f) > 0.0001f ||
-			fabs(childNode.rotation[1] - 0.0f) > 0.0001f ||
-			fabs(childNode.rotation[2] - 0.0f) > 0.0001f ||
-			fabs(childNode.rotation[3] - 0.0f) > 0.0001f) {
-			return false;
-		}
-	}
+} CompressedSubMesh;
 
-	return true;
-}
+typedef struct MeshPageTable
+{
+	unsigned int pageSize = 0;
+	unsigned int numPages = 0;
+	unsigned int numSubMeshs = 0;
+	unsigned int reserved = 0;
 
-static int GetLODIndex(const char* szName)
+} MeshPageTable;
+
+typedef struct SubMeshPages
 {
-	const char* szCheckNames[8] = { "_LOD0", "_LOD1", "_LOD2", "_LOD3", "_LOD4", "_LOD5", "_LOD6", "_LOD7" };
+	// The offsets are in bytes from the start of the page data section, the indices are padded to the alignment
+	unsigned int firstPage = 0;
+	unsigned int numPages = 0;
+	unsigned int indexOffset = 0;
+	unsigned int vertexOffset = 0;
 
-	for (int indexLOD = 0; indexLOD < 8; indexLOD++) {
-		if (strstr(szName, szCheckNames[indexLOD]) != nullptr) {
-			return indexLOD;
-		}
+} SubMeshPages;
+
+typedef struct SkeletonJoint
+{
+	// parent is the index of the nearest ancestor in the skeleton, or -1. The transform is relative to that joint, the
+	// nodes in between are baked into it; a joint without a parent keeps the transform relative to its node parent
+	char szName[260];
+	int parent = -1;
+	float translation[3];
+	float rotation[4];
+	float scale[3];
+
+} SkeletonJoint;
+
+typedef struct PaletteJoint
+{
+	// joint is an index into the skeleton, the matrix is column major
+	unsigned int joint = 0;
+	float inverseBindMatrix[16];
+
+} PaletteJoint;
+
+typedef struct MorphTargetHeader
+{
+	// The deltas are unorm16 relative to the bounds of the target, firstDelta counts MorphDelta records
+	float defaultWeight = 0.0f;
+	unsigned int flags = 0;
+	unsigned int firstDelta = 0;
+	unsigned int numDeltas = 0;
+
+	float positionMin[3] = { 0.0f, 0.0f, 0.0f };
+	float positionMax[3] = { 0.0f, 0.0f, 0.0f };
+	float normalMin[3] = { 0.0f, 0.0f, 0.0f };
+	float normalMax[3] = { 0.0f, 0.0f, 0.0f };
+
+} MorphTargetHeader;
+
+typedef struct MorphDelta
+{
+	// vertex is relative to SubMeshHeader::baseVertex
+	unsigned int vertex = 0;
+	uint16_t position[3] = { 0, 0, 0 };
+	uint16_t normal[3] = { 0, 0, 0 };
+
+} MorphDelta;
+
+typedef struct MeshSection
+{
+	unsigned int type;
+	unsigned int size;
+	std::function<uint8_t*(uint8_t*)> write;
+	unsigned int flags;
+
+} MeshSection;
+
+template<typename T>
+static uint8_t* WriteBuffer(uint8_t *pBuffer, const T &value)
+{
+	memcpy(pBuffer, &value, sizeof(value));
+	return pBuffer + sizeof(value);
+}
+
+template<typename T>
+static uint8_t* WriteBuffer(uint8_t *pBuffer, const std::vector<T> &values)
+{
+	if (values.empty() == false) {
+		memcpy(pBuffer, values.data(), sizeof(T) * values.size());
 	}
+	return pBuffer + sizeof(T) * values.size();
+}
 
-	return -1;
+static unsigned int AlignSize(unsigned int size, unsigned int alignment)
+{
+	return (size + alignment - 1) & ~(alignment - 1);
 }
 
-static void ExportNodeDraw(TiXmlElement *pParentNode, const RawNode &node, const RawModel &rawModel, std::unordered_map<long, long> &surfaceMeshs, std::unordered_map<long, std::string> &surfaceMaterials, int lod = -1)
+static int QuantizePosition(float value, float minValue, float maxValue, bool unorm)
 {
-	if (node.surfaceId != 0) {
-		TiXmlElement *pDrawNode = new TiXmlElement("Draw");
-		{
-			pDrawNode->SetAttributeInt1("index", surfaceMeshs[node.surfaceId]);
-			pDrawNode->SetAttributeString("name", rawModel.GetSurface(rawModel.GetSurfaceById(node.surfaceId)).name.c_str());
-			pDrawNode->SetAttributeString("material", surfaceMaterials[node.surfaceId].c_str());
+	const float extent = maxValue - minValue;
+	const float t = extent > 0.0f ? (value - minValue) / extent : 0.0f;
+	return unorm ? QuantizeUnorm(t, 16) : QuantizeSnorm(t * 2.0f - 1.0f, 16);
+}
 
-			// Default Parameters
-			if (lod >= 0) {
-				pDrawNode->SetAttributeInt1("lod", lod);
-			}
+static float DequantizePosition(int value, float minValue, float maxValue, bool unorm)
+{
+	const float t = unorm ? DequantizeUnorm(value, 16) : (DequantizeSnorm(value, 16) + 1.0f) * 0.5f;
+	return minValue + t * (maxValue - minValue);
+}
 
-			pDrawNode->SetAttributeString("mask", "4294967295");
-		}
-		pParentNode->LinkEndChild(pDrawNode);
+static float GetTexcoordError(const Vec2f &uv, bool unorm)
+{
+	float error = 0.0f;
+
+	for (int component = 0; component < 2; component++) {
+		const float value = unorm ? DequantizeUnorm(QuantizeUnorm(uv[component], 16), 16) : HalfToFloat(FloatToHalf(uv[component]));
+		error = std::max(error, fabsf(value - uv[component]));
 	}
+
+	return error;
 }
 
-static void ExportNode(TiXmlElement *pParentNode, const long id, const RawModel &rawModel, std::unordered_map<long, long> &surfaceMeshs, std::unordered_map<long, std::string> &surfaceMaterials)
+static float GetNormalError(const Vec3f &normal)
 {
-	TiXmlElement *pCurrentNode = new TiXmlElement("Node");
-	{
-		const RawNode &node = rawModel.GetNode(rawModel.GetNodeById(id));
-		pCurrentNode->SetAttributeString("translation", "%f %f %f", node.translation.x, node.translation.y, node.translation.z);
-		pCurrentNode->SetAttributeString("rotation", "%f %f %f %f", node.rotation[1], node.rotation[2], node.rotation[3], node.rotation[0]);
-		pCurrentNode->SetAttributeString("scale", "%f %f %f", node.scale.x, node.scale.y, node.scale.z);
+	float error = 0.0f;
 
-		ExportNodeDraw(pCurrentNode, node, rawModel, surfaceMeshs, surfaceMaterials);
-
-		if (IsNodeLODGrpup(node, rawModel)) {
-			for (int indexChild = 0; indexChild < node.childIds.size(); indexChild++) {
-				const RawNode &childNode = rawModel.GetNode(rawModel.GetNodeById(node.childIds[indexChild]));
-				ExportNodeDraw(pCurrentNode, childNode, rawModel, surfaceMeshs, surfaceMaterials, GetLODIndex(childNode.name.c_str()));
-			}
-		}
-		else {
-			for (int indexChild = 0; indexChild < node.childIds.size(); indexChild++) {
-				ExportNode(pCurrentNode, node.childIds[indexChild], rawModel, surfaceMeshs, surfaceMaterials);
-			}
-		}
+	for (int component = 0; component < 3; component++) {
+		error = std::max(error, fabsf(DequantizeSnorm(QuantizeSnorm(normal[component], 10), 10) - FbxClamp<float>(normal[component], -1.0f, 1.0f)));
 	}
-	pParentNode->LinkEndChild(pCurrentNode);
+
+	return error;
 }
 
-bool ExportMeshXML(const char *szFileName, const char *szMeshFileName, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels)
+static float GetTangentFrameError(const RawVertex &vertex, unsigned int attributes, NormalFormatOptions normalFormat)
 {
-	std::unordered_map<long, long> surfaceMeshs;
-	std::unordered_map<long, std::string> surfaceMaterials;
+	Vec3f tangent, binormal, normal;
+	float sign;
+	GetTangentFrame(vertex, tangent, binormal, normal, sign);
 
-	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
-		long id = rawMaterialModels[indexMesh].GetSurface(0).id;
-		surfaceMeshs[id] = indexMesh;
-		surfaceMaterials[id] = GetMaterialFileName("", rawMaterialModels[indexMesh].GetMaterial(0));
+	Vec3f decodedTangent = tangent;
+	Vec3f decodedNormal;
+	float decodedSign = sign;
+
+	if (normalFormat == NormalFormatOptions::QTANGENT) {
+		const Vec4f q = EncodeQTangent(tangent, binormal, normal, sign);
+		const Vec4f quantized(DequantizeSnorm(QuantizeSnorm(q.x, 16), 16), DequantizeSnorm(QuantizeSnorm(q.y, 16), 16), DequantizeSnorm(QuantizeSnorm(q.z, 16), 16), DequantizeSnorm(QuantizeSnorm(q.w, 16), 16));
+		DecodeQTangent(quantized.Normalized(), decodedTangent, decodedNormal, decodedSign);
 	}
+	else {
+		const int bits = normalFormat == NormalFormatOptions::OCT8 ? 8 : 16;
+		decodedNormal = DecodeOctahedron(QuantizeOctahedron(EncodeOctahedron(normal), bits));
 
-	TiXmlDocument doc;
-	TiXmlElement *pMeshNode = new TiXmlElement("Mesh");
-	pMeshNode->SetAttributeString("mesh", szMeshFileName);
-	{
-		ExportNode(pMeshNode, rawModel.GetRootNode(), rawModel, surfaceMeshs, surfaceMaterials);
+		if (attributes & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
+			decodedTangent = DecodeOctahedronSign(QuantizeOctahedron(EncodeOctahedronSign(tangent, sign, bits), bits), decodedSign);
+		}
+	}
+
+	if (decodedSign != sign) {
+		return FLT_MAX;
+	}
+
+	float error = 0.0f;
+
+	for (int component = 0; component < 3; component++) {
+		error = std::max(error, fabsf(decodedNormal[component] - normal[component]));
+		if (attributes & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
+			error = std::max(error, fabsf(decodedTangent[component] - tangent[component]));
+		}
+	}
+
+	return error;
+}
+
+static unsigned int SelectVertexFormat(unsigned int attributes, const MeshHeader &meshHeader, const std::vector<RawModel> &rawMaterialModels, const CrossOptions &options, bool verbose)
+{
+	unsigned int format = attributes;
+
+	if ((attributes & RAW_VERTEX_ATTRIBUTE_POSITION) && options.positionFormat != PositionFormatOptions::FLOAT) {
+		const bool unorm = options.positionFormat == PositionFormatOptions::UNORM16;
+		float error = 0.0f;
+
+		for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+			const SubMeshHeader &subMeshHeader = meshHeader.subMeshHeaders[indexMesh];
+			const float mins[3] = { subMeshHeader.minx, subMeshHeader.miny, subMeshHeader.minz };
+			const float maxs[3] = { subMeshHeader.maxx, subMeshHeader.maxy, subMeshHeader.maxz };
+
+			const RawVertexStreams &streams = rawMaterialModels[indexMesh].GetVertexStreams();
+
+			for (int indexVertex = 0; indexVertex < rawMaterialModels[indexMesh].GetVertexCount(); indexVertex++) {
+				const Vec3f &position = streams.GetPosition(indexVertex);
+
+				for (int component = 0; component < 3; component++) {
+					const int value = QuantizePosition(position[component], mins[component], maxs[component], unorm);
+					error = std::max(error, fabsf(DequantizePosition(value, mins[component], maxs[component], unorm) - position[component]));
+				}
+			}
+		}
+
+		if (error <= options.positionTolerance) {
+			format |= unorm ? CROSS_VERTEX_FORMAT_POSITION_UNORM16 : CROSS_VERTEX_FORMAT_POSITION_SNORM16;
+		}
+		else if (verbose) {
+			fmt::printf("Warning: Position quantization error %f exceeds tolerance %f, keeping float positions.\n", error, options.positionTolerance);
+		}
+	}
+
+	if ((attributes & (RAW_VERTEX_ATTRIBUTE_UV0 | RAW_VERTEX_ATTRIBUTE_UV1)) && options.texcoordFormat != TexcoordFormatOptions::FLOAT) {
+		const bool unorm = options.texcoordFormat == TexcoordFormatOptions::UNORM16;
+		float error = 0.0f;
+
+		for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+			const RawVertexStreams &streams = rawMaterialModels[indexMesh].GetVertexStreams();
+
+			for (int indexVertex = 0; indexVertex < rawMaterialModels[indexMesh].GetVertexCount(); indexVertex++) {
+				if (attributes & RAW_VERTEX_ATTRIBUTE_UV0) {
+					error = std::max(error, GetTexcoordError(streams.GetUv0(indexVertex), unorm));
+				}
+				if (attributes & RAW_VERTEX_ATTRIBUTE_UV1) {
+					error = std::max(error, GetTexcoordError(streams.GetUv1(indexVertex), unorm));
+				}
+			}
+		}
+
+		if (error <= options.texcoordTolerance) {
+			format |= unorm ? CROSS_VERTEX_FORMAT_TEXCOORD_UNORM16 : CROSS_VERTEX_FORMAT_TEXCOORD_HALF;
+		}
+		else if (verbose) {
+			fmt::printf("Warning: Texcoord quantization error %f exceeds tolerance %f, keeping float texcoords.\n", error, options.texcoordTolerance);
+		}
+	}
+
+	if ((attributes & (RAW_VERTEX_ATTRIBUTE_NORMAL | RAW_VERTEX_ATTRIBUTE_BINORMAL)) && options.normalFormat == NormalFormatOptions::SNORM10) {
+		float error = 0.0f;
+
+		for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+			const RawVertexStreams &streams = rawMaterialModels[indexMesh].GetVertexStreams();
+
+			for (int indexVertex = 0; indexVertex < rawMaterialModels[indexMesh].GetVertexCount(); indexVertex++) {
+				if (attributes & RAW_VERTEX_ATTRIBUTE_NORMAL) {
+					error = std::max(error, GetNormalError(streams.GetNormal(indexVertex)));
+				}
+				if (attributes & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
+					error = std::max(error, GetNormalError(streams.GetBinormal(indexVertex)));
+				}
+			}
+		}
+
+		if (error <= options.normalTolerance) {
+			format |= CROSS_VERTEX_FORMAT_NORMAL_SNORM10;
+		}
+		else if (verbose) {
+			fmt::printf("Warning: Normal quantization error %f exceeds tolerance %f, keeping snorm8 normals.\n", error, options.normalTolerance);
+		}
+	}
+
+	if ((attributes & RAW_VERTEX_ATTRIBUTE_NORMAL) && (options.normalFormat == NormalFormatOptions::OCT8 || options.normalFormat == NormalFormatOptions::OCT16 || options.normalFormat == NormalFormatOptions::QTANGENT)) {
+		NormalFormatOptions normalFormat = options.normalFormat;
+
+		if (normalFormat == NormalFormatOptions::QTANGENT && (attributes & RAW_VERTEX_ATTRIBUTE_BINORMAL) == 0) {
+			if (verbose) {
+				fmt::printf("Warning: QTangent needs binormals, using octahedral normals instead.\n");
+			}
+			normalFormat = NormalFormatOptions::OCT16;
+		}
+
+		float error = 0.0f;
+
+		for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+			for (int indexVertex = 0; indexVertex < rawMaterialModels[indexMesh].GetVertexCount(); indexVertex++) {
+				error = std::max(error, GetTangentFrameError(rawMaterialModels[indexMesh].GetVertex(indexVertex), attributes, normalFormat));
+			}
+		}
+
+		if (error <= options.normalTolerance) {
+			format |= normalFormat == NormalFormatOptions::OCT8 ? CROSS_VERTEX_FORMAT_NORMAL_OCT8 : normalFormat == NormalFormatOptions::OCT16 ? CROSS_VERTEX_FORMAT_NORMAL_OCT16 : CROSS_VERTEX_FORMAT_QTANGENT;
+		}
+		else if (verbose) {
+			fmt::printf("Warning: Tangent frame encoding error %f exceeds tolerance %f, keeping snorm8 normals.\n", error, options.normalTolerance);
+		}
+	}
+
+	if ((attributes & RAW_VERTEX_ATTRIBUTE_POSITION) && options.positionStream == PositionStreamOptions::SPLIT && options.meshVersion != 1) {
+		format |= CROSS_VERTEX_FORMAT_POSITION_STREAM;
+	}
+
+	// Joint indices are palette indices of their submesh, a byte each as long as every palette fits
+	if ((attributes & RAW_VERTEX_ATTRIBUTE_JOINT_INDICES) && options.meshVersion != 1) {
+		for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+			if (rawMaterialModels[indexMesh].GetSurfaceCount() > 0 && rawMaterialModels[indexMesh].GetSurface(0).jointIds.size() > 256) {
+				format |= CROSS_VERTEX_FORMAT_JOINT_UINT16;
+				break;
+			}
+		}
+	}
+
+	return format;
+}
+
+static void CreateSubMeshBounds(MeshHeader &meshHeader, const std::vector<RawModel> &rawMaterialModels)
+{
+	meshHeader.numSubMeshs = rawMaterialModels.size();
+	meshHeader.subMeshHeaders.resize(rawMaterialModels.size());
+
+	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+		const RawVertexStreams &streams = rawMaterialModels[indexMesh].GetVertexStreams();
+
+		for (int indexVertex = 0; indexVertex < rawMaterialModels[indexMesh].GetVertexCount(); indexVertex++) {
+			const Vec3f &position = streams.GetPosition(indexVertex);
+
+			if (meshHeader.subMeshHeaders[indexMesh].minx > position.x) meshHeader.subMeshHeaders[indexMesh].minx = position.x;
+			if (meshHeader.subMeshHeaders[indexMesh].miny > position.y) meshHeader.subMeshHeaders[indexMesh].miny = position.y;
+			if (meshHeader.subMeshHeaders[indexMesh].minz > position.z) meshHeader.subMeshHeaders[indexMesh].minz = position.z;
+
+			if (meshHeader.subMeshHeaders[indexMesh].maxx < position.x) meshHeader.subMeshHeaders[indexMesh].maxx = position.x;
+			if (meshHeader.subMeshHeaders[indexMesh].maxy < position.y) meshHeader.subMeshHeaders[indexMesh].maxy = position.y;
+			if (meshHeader.subMeshHeaders[indexMesh].maxz < position.z) meshHeader.subMeshHeaders[indexMesh].maxz = position.z;
+		}
+	}
+}
+
+static bool CreateMeshHeader(MeshHeader &meshHeader, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels, const CrossOptions &options)
+{
+	unsigned int numIndex = 0;
+	unsigned int numVertex = 0;
+
+	CreateSubMeshBounds(meshHeader, rawMaterialModels);
+
+	// Quantized formats depend on the submesh bounds
+	meshHeader.format = SelectVertexFormat(rawModel.GetVertexAttributes(), meshHeader, rawMaterialModels, options, true);
+
+	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+		meshHeader.subMeshHeaders[indexMesh].baseVertex = 0; // numVertex;
+		meshHeader.subMeshHeaders[indexMesh].firstIndex = numIndex;
+		meshHeader.subMeshHeaders[indexMesh].indexCount = rawMaterialModels[indexMesh].GetTriangleCount() * 3;
+
+		meshHeader.indexBufferSize += rawMaterialModels[indexMesh].GetTriangleCount() * 3 * sizeof(unsigned int);
+		meshHeader.vertexBufferSize += rawMaterialModels[indexMesh].GetVertexCount() * GetVertexSize(meshHeader.format);
+
+		strcpy(meshHeader.subMeshHeaders[indexMesh].szName, rawMaterialModels[indexMesh].GetSurface(0).name.c_str());
+
+		numIndex += rawMaterialModels[indexMesh].GetTriangleCount() * 3;
+		numVertex += rawMaterialModels[indexMesh].GetVertexCount();
+	}
+
+	const unsigned int baseOffset = offsetof(MeshHeader, subMeshHeaders) + sizeof(SubMeshHeader) * meshHeader.subMeshHeaders.size();
+	meshHeader.indexBufferOffset = baseOffset;
+	meshHeader.vertexBufferOffset = baseOffset + meshHeader.indexBufferSize;
+
+	return true;
+}
+
+static std::vector<unsigned int> SelectSubMeshFormats(unsigned int meshFormat, const std::vector<RawModel> &rawMaterialModels, const CrossOptions &options)
+{
+	std::vector<unsigned int> formats(rawMaterialModels.size(), meshFormat);
+	if (options.subMeshFormats == false || options.meshVersion == 1) {
+		return formats;
+	}
+
+	const unsigned int attributeMask =
+		RAW_VERTEX_ATTRIBUTE_POSITION | RAW_VERTEX_ATTRIBUTE_NORMAL | RAW_VERTEX_ATTRIBUTE_BINORMAL | RAW_VERTEX_ATTRIBUTE_COLOR |
+		RAW_VERTEX_ATTRIBUTE_UV0 | RAW_VERTEX_ATTRIBUTE_UV1 | RAW_VERTEX_ATTRIBUTE_JOINT_INDICES | RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS;
+
+	// A material model only has the attributes it kept that differ from the defaults; every submesh of a material gets
+	// their union, so the material describes the vertices of all of them
+	std::unordered_map<std::string, unsigned int> materialAttributes;
+	for (const RawModel &rawMaterialModel : rawMaterialModels) {
+		materialAttributes[rawMaterialModel.GetMaterial(0).name] |= rawMaterialModel.GetVertexAttributes() & meshFormat & attributeMask;
+	}
+
+	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+		unsigned int attributes = materialAttributes[rawMaterialModels[indexMesh].GetMaterial(0).name] | (meshFormat & RAW_VERTEX_ATTRIBUTE_POSITION);
+		unsigned int format = (meshFormat & ~attributeMask) | attributes;
+
+		if ((format & CROSS_VERTEX_FORMAT_QTANGENT) && (attributes & RAW_VERTEX_ATTRIBUTE_BINORMAL) == 0) {
+			format = (format & ~CROSS_VERTEX_FORMAT_QTANGENT) | CROSS_VERTEX_FORMAT_NORMAL_OCT16;
+		}
+
+		formats[indexMesh] = format;
+	}
+
+	return formats;
+}
+
+// The working memory of the PVRT sorter, owned by one worker of an export
+typedef std::unique_ptr<PVRTGeometrySortContext, void (*)(PVRTGeometrySortContext *)> SortContextPtr;
+
+static void OptimizeSubMesh(RawVertex *vertices, int vertexCount, unsigned int *indices, int triangleCount, PVRTGeometrySortContext *pSortContext, const CrossOptions &options)
+{
+	switch (options.vertexCacheOptimizer) {
+	case VertexCacheOptimizerOptions::PVRT:
+	{
+		ProfileUtils::ScopedTimer timer("pvrtGeometrySort");
+		PVRTGeometrySort(
+			vertices,
+			indices,
+			sizeof(RawVertex),
+			vertexCount,
+			triangleCount,
+			vertexCount,
+			triangleCount,
+			PVRTGEOMETRY_SORT_VERTEXCACHE,
+			pSortContext);
+		break;
+	}
+	case VertexCacheOptimizerOptions::FORSYTH:
+		OptimizeVertexCacheForsyth(indices, 3 * triangleCount, vertexCount);
+		break;
+	case VertexCacheOptimizerOptions::NONE:
+		break;
+	}
+
+	if (options.optimizeOverdraw) {
+		OptimizeOverdraw(indices, 3 * triangleCount, vertices, vertexCount, options.overdrawThreshold);
+	}
+
+	if (options.optimizeVertexFetch) {
+		OptimizeVertexFetch(vertices, vertexCount, indices, 3 * triangleCount);
+	}
+}
+
+// How well one submesh suits the GPU, see CrossOptions::meshMetrics
+typedef struct SubMeshMetrics
+{
+	int vertexCount = 0;
+	int triangleCount = 0;
+	unsigned int vertexSize = 0;
+	unsigned int indexSize = 0;
+
+	MeshOptimizerStats fifo;
+	MeshOptimizerStats lru;
+	float overdraw = 0.0f;
+	float vertexFetch = 0.0f;
+	int degenerateTriangles = 0;
+} SubMeshMetrics;
+
+// The optimized geometry of one submesh, its indices are relative to its first vertex
+typedef struct SubMeshData
+{
+	std::vector<RawVertex> vertices;
+	std::vector<unsigned int> indices;
+
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+
+	MeshOptimizerStats statsBefore;
+	MeshOptimizerStats statsAfter;
+
+	// The metrics that don't depend on the encoding of the submesh
+	SubMeshMetrics metrics;
+
+} SubMeshData;
+
+static void CreateSubMeshData(SubMeshData &data, const RawModel &rawMaterialModel, PVRTGeometrySortContext *pSortContext, const CrossOptions &options)
+{
+	const int vertexCount = rawMaterialModel.GetVertexCount();
+	const int triangleCount = rawMaterialModel.GetTriangleCount();
+
+	data.vertices.resize(vertexCount);
+	data.indices.resize(3 * triangleCount);
+
+	for (int index = 0; index < vertexCount; index++) {
+		data.vertices[index] = rawMaterialModel.GetVertex(index);
+	}
+
+	for (int index = 0; index < triangleCount; index++) {
+		const RawTriangle &triangle = rawMaterialModel.GetTriangle(index);
+		data.indices[3 * index + 0] = triangle.verts[0];
+		data.indices[3 * index + 1] = triangle.verts[1];
+		data.indices[3 * index + 2] = triangle.verts[2];
+	}
+
+	if (triangleCount > 0) {
+		if (options.printOptimizerStats) {
+			data.statsBefore = GetMeshOptimizerStats(data.indices.data(), 3 * triangleCount, vertexCount);
+		}
+
+		OptimizeSubMesh(data.vertices.data(), vertexCount, data.indices.data(), triangleCount, pSortContext, options);
+
+		if (options.printOptimizerStats) {
+			data.statsAfter = GetMeshOptimizerStats(data.indices.data(), 3 * triangleCount, vertexCount);
+		}
+	}
+
+	if (options.meshMetrics) {
+		data.metrics.vertexCount = vertexCount;
+		data.metrics.triangleCount = triangleCount;
+		data.metrics.fifo = GetMeshOptimizerStats(data.indices.data(), 3 * triangleCount, vertexCount, options.metricsCacheSize);
+		data.metrics.lru = GetMeshOptimizerStatsLRU(data.indices.data(), 3 * triangleCount, vertexCount, options.metricsCacheSize);
+		data.metrics.overdraw = GetMeshOverdraw(data.indices.data(), 3 * triangleCount, data.vertices.data(), vertexCount);
+		data.metrics.degenerateTriangles = GetDegenerateTriangleCount(data.indices.data(), 3 * triangleCount, data.vertices.data());
+	}
+
+	// Meshlets are built from the optimized indices, their offsets are local until merged
+	if (options.buildMeshlets) {
+		BuildMeshlets(
+			data.meshlets,
+			data.meshletVertices,
+			data.meshletTriangles,
+			data.indices.data(),
+			data.indices.size(),
+			data.vertices.data(),
+			vertexCount,
+			options.meshletMaxVertices,
+			options.meshletMaxTriangles);
+	}
+}
+
+static size_t GetSubMeshDataSize(const RawModel &rawMaterialModel)
+{
+	// Rough working set: the vertex copy and its encoding, the indices with their encoding and optimizer scratch
+	return
+		(size_t)rawMaterialModel.GetVertexCount() * 2 * sizeof(RawVertex) +
+		(size_t)rawMaterialModel.GetTriangleCount() * 3 * 4 * sizeof(unsigned int);
+}
+
+// Builds the submesh data a batch at a time on options.jobs threads and hands every submesh to write in order.
+// Without streaming all submeshes form one batch. When streaming a batch holds one submesh per job, or as many
+// as fit in what the memory budget leaves, and every material model releases its geometry once written.
+static bool ForEachSubMeshData(std::vector<RawModel> &rawMaterialModels, const CrossOptions &options, const std::function<bool(int, const SubMeshData&)> &write)
+{
+	const int numSubMeshs = rawMaterialModels.size();
+	const size_t memoryBudget = (size_t)options.memoryBudget * 1024 * 1024;
+
+	// Every worker keeps the working memory of the sorter for the submeshes it optimizes, until the export is done
+	std::vector<SortContextPtr> sortContexts;
+	for (int worker = 0; worker < ThreadUtils::GetJobCount(options.jobs); worker++) {
+		sortContexts.emplace_back(options.vertexCacheOptimizer == VertexCacheOptimizerOptions::PVRT ? PVRTGeometryCreateSortContext() : nullptr, PVRTGeometryDeleteSortContext);
+	}
+
+	for (int firstMesh = 0; firstMesh < numSubMeshs;) {
+		int lastMesh = numSubMeshs;
+
+		if (options.streaming && memoryBudget > 0) {
+			const size_t residentSize = MemoryUtils::GetResidentSize();
+			const size_t availableSize = memoryBudget > residentSize ? memoryBudget - residentSize : 0;
+			size_t batchSize = GetSubMeshDataSize(rawMaterialModels[firstMesh]);
+
+			for (lastMesh = firstMesh + 1; lastMesh < numSubMeshs; lastMesh++) {
+				const size_t size = GetSubMeshDataSize(rawMaterialModels[lastMesh]);
+
+				if (batchSize + size > availableSize) {
+					break;
+				}
+
+				batchSize += size;
+			}
+		}
+		else if (options.streaming) {
+			lastMesh = std::min(firstMesh + ThreadUtils::GetJobCount(options.jobs), numSubMeshs);
+		}
+
+		std::vector<SubMeshData> batch(lastMesh - firstMesh);
+
+		// Submeshes are independent, building them concurrently gives the same result as a serial run
+		ThreadUtils::ParallelForWorker(batch.size(), options.jobs, [&](int index, int worker) {
+			CreateSubMeshData(batch[index], rawMaterialModels[firstMesh + index], sortContexts[worker].get(), options);
+		});
+
+		for (int index = 0; index < batch.size(); index++) {
+			const int indexMesh = firstMesh + index;
+
+			if (options.printOptimizerStats) {
+				fmt::printf("Submesh %d: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", indexMesh,
+					batch[index].statsBefore.acmr, batch[index].statsAfter.acmr,
+					batch[index].statsBefore.atvr, batch[index].statsAfter.atvr);
+			}
+
+			if (write(indexMesh, batch[index]) == false) {
+				return false;
+			}
+
+			if (options.streaming) {
+				rawMaterialModels[indexMesh].ReleaseGeometry();
+				batch[index] = SubMeshData();
+			}
+		}
+
+		firstMesh = lastMesh;
 	}
-	doc.LinkEndChild(pMeshNode);
-	doc.SaveFile(szFileName);
 
 	return true;
 }
+
+static uint8_t* ExportMeshHeader(uint8_t *pBuffer, const MeshHeader &meshHeader)
+{
+	pBuffer = WriteBuffer(pBuffer, meshHeader.format);
+	pBuffer = WriteBuffer(pBuffer, meshHeader.numSubMeshs);
+	pBuffer = WriteBuffer(pBuffer, meshHeader.indexBufferSize);
+	pBuffer = WriteBuffer(pBuffer, meshHeader.indexBufferOffset);
+	pBuffer = WriteBuffer(pBuffer, meshHeader.vertexBufferSize);
+	pBuffer = WriteBuffer(pBuffer, meshHeader.vertexBufferOffset);
+	pBuffer = WriteBuffer(pBuffer, meshHeader.subMeshHeaders);
+	return pBuffer;
+}
+
+static uint8_t* ExportPosition(uint8_t *pBuffer, unsigned int format, const Vec3f &position, const SubMeshHeader &subMeshHeader)
+{
+	if (format & (CROSS_VERTEX_FORMAT_POSITION_SNORM16 | CROSS_VERTEX_FORMAT_POSITION_UNORM16)) {
+		// 4 Component * 2 Byte = 8 Bytes
+		const bool unorm = (format & CROSS_VERTEX_FORMAT_POSITION_UNORM16) != 0;
+		uint16_t x = QuantizePosition(position.x, subMeshHeader.minx, subMeshHeader.maxx, unorm);
+		uint16_t y = QuantizePosition(position.y, subMeshHeader.miny, subMeshHeader.maxy, unorm);
+		uint16_t z = QuantizePosition(position.z, subMeshHeader.minz, subMeshHeader.maxz, unorm);
+		uint16_t w = unorm ? UINT16_MAX : INT16_MAX;
+		pBuffer = WriteBuffer(pBuffer, x);
+		pBuffer = WriteBuffer(pBuffer, y);
+		pBuffer = WriteBuffer(pBuffer, z);
+		pBuffer = WriteBuffer(pBuffer, w);
+	}
+	else {
+		// 3 Component * 4 Byte = 12 Bytes
+		float x = position.x;
+		float y = position.y;
+		float z = position.z;
+		pBuffer = WriteBuffer(pBuffer, x);
+		pBuffer = WriteBuffer(pBuffer, y);
+		pBuffer = WriteBuffer(pBuffer, z);
+	}
+
+	return pBuffer;
+}
+
+// Packs one attribute of every vertex, consecutive vertices are stride bytes apart
+typedef void (*VertexAttributeKernel)(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader);
+
+typedef struct VertexAttributeLayout
+{
+	VertexAttributeKernel kernel;
+	unsigned int offset;
+
+} VertexAttributeLayout;
+
+// The kernels and offsets of a vertex format, resolved once per format instead of once per vertex
+typedef struct VertexLayout
+{
+	unsigned int format = 0;
+	unsigned int stride = 0;
+	std::vector<VertexAttributeLayout> attributes;
+
+} VertexLayout;
+
+static bool IsNegativeFrame(const RawVertex &vertex)
+{
+	return Vec3f::DotProduct(Vec3f::CrossProduct(vertex.binormal, vertex.normal), Vec3f(vertex.tangent.x, vertex.tangent.y, vertex.tangent.z)) < 0.0f;
+}
+
+// 4 Component * 1 Byte, each component is (int)(value * scale) saturated to int8 or uint8; fetch fills the 4 values of a vertex
+template<bool SIGNED, typename Fetch>
+static void PackBytes4(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, float scale, Fetch fetch)
+{
+	size_t index = 0;
+
+#if RAW2CROSS_SSE2
+	// Truncation and the saturating packs give the same bytes as FbxClamp<int> of the scalar path
+	const __m128 factor = _mm_set1_ps(scale);
+	for (; index + 4 <= count; index += 4) {
+		float values[4][4];
+		for (int i = 0; i < 4; i++) {
+			fetch(pVertices[index + i], values[i]);
+		}
+
+		const __m128i a = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(values[0]), factor));
+		const __m128i b = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(values[1]), factor));
+		const __m128i c = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(values[2]), factor));
+		const __m128i d = _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(values[3]), factor));
+		const __m128i ab = _mm_packs_epi32(a, b);
+		const __m128i cd = _mm_packs_epi32(c, d);
+
+		uint8_t packed[16];
+		_mm_storeu_si128((__m128i *)packed, SIGNED ? _mm_packs_epi16(ab, cd) : _mm_packus_epi16(ab, cd));
+		for (int i = 0; i < 4; i++) {
+			memcpy(pOutput + (index + i) * stride, packed + i * 4, 4);
+		}
+	}
+#elif RAW2CROSS_NEON
+	const float32x4_t factor = vdupq_n_f32(scale);
+	for (; index + 4 <= count; index += 4) {
+		float values[4][4];
+		for (int i = 0; i < 4; i++) {
+			fetch(pVertices[index + i], values[i]);
+		}
+
+		const int16x8_t ab = vcombine_s16(
+			vqmovn_s32(vcvtq_s32_f32(vmulq_f32(vld1q_f32(values[0]), factor))),
+			vqmovn_s32(vcvtq_s32_f32(vmulq_f32(vld1q_f32(values[1]), factor))));
+		const int16x8_t cd = vcombine_s16(
+			vqmovn_s32(vcvtq_s32_f32(vmulq_f32(vld1q_f32(values[2]), factor))),
+			vqmovn_s32(vcvtq_s32_f32(vmulq_f32(vld1q_f32(values[3]), factor))));
+
+		uint8_t packed[16];
+		if (SIGNED) {
+			vst1q_s8((int8_t *)packed, vcombine_s8(vqmovn_s16(ab), vqmovn_s16(cd)));
+		}
+		else {
+			vst1q_u8(packed, vcombine_u8(vqmovun_s16(ab), vqmovun_s16(cd)));
+		}
+		for (int i = 0; i < 4; i++) {
+			memcpy(pOutput + (index + i) * stride, packed + i * 4, 4);
+		}
+	}
+#endif
+
+	for (; index < count; index++) {
+		float values[4];
+		fetch(pVertices[index], values);
+
+		uint8_t *pBuffer = pOutput + index * stride;
+		for (int i = 0; i < 4; i++) {
+			pBuffer[i] = SIGNED ?
+				(uint8_t)(int8_t)FbxClamp<int>((int)(values[i] * scale), INT8_MIN, INT8_MAX) :
+				(uint8_t)FbxClamp<int>((int)(values[i] * scale), 0, UINT8_MAX);
+		}
+	}
+}
+
+template<bool UNORM>
+static void PackPositions16(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 4 Component * 2 Byte = 8 Bytes
+	const unsigned int format = UNORM ? CROSS_VERTEX_FORMAT_POSITION_UNORM16 : CROSS_VERTEX_FORMAT_POSITION_SNORM16;
+	for (size_t index = 0; index < count; index++) {
+		ExportPosition(pOutput + index * stride, format, pVertices[index].position, subMeshHeader);
+	}
+}
+
+static void PackPositionsFloat(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 3 Component * 4 Byte = 12 Bytes
+	for (size_t index = 0; index < count; index++) {
+		const Vec3f &position = pVertices[index].position;
+		const float values[3] = { position.x, position.y, position.z };
+		memcpy(pOutput + index * stride, values, sizeof(values));
+	}
+}
+
+template<bool OCT8, bool TANGENT>
+static void PackNormalsOctahedron(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 2 Component * 1 Byte normal, 2 Component * 1 Byte tangent = 4 Bytes, or
+	// 2 Component * 2 Byte normal, 2 Component * 2 Byte tangent = 8 Bytes
+	const int bits = OCT8 ? 8 : 16;
+	for (size_t index = 0; index < count; index++) {
+		Vec3f tangent, binormal, normal;
+		float sign;
+		GetTangentFrame(pVertices[index], tangent, binormal, normal, sign);
+
+		const Vec2f encodedNormal = EncodeOctahedron(normal);
+		const Vec2f encodedTangent = TANGENT ? EncodeOctahedronSign(tangent, sign, bits) : Vec2f(0.0f, 0.0f);
+
+		uint8_t *pBuffer = pOutput + index * stride;
+		if (OCT8) {
+			pBuffer = WriteBuffer(pBuffer, (int8_t)QuantizeSnorm(encodedNormal.x, 8));
+			pBuffer = WriteBuffer(pBuffer, (int8_t)QuantizeSnorm(encodedNormal.y, 8));
+			pBuffer = WriteBuffer(pBuffer, (int8_t)QuantizeSnorm(encodedTangent.x, 8));
+			pBuffer = WriteBuffer(pBuffer, (int8_t)QuantizeSnorm(encodedTangent.y, 8));
+		}
+		else {
+			pBuffer = WriteBuffer(pBuffer, (int16_t)QuantizeSnorm(encodedNormal.x, 16));
+			pBuffer = WriteBuffer(pBuffer, (int16_t)QuantizeSnorm(encodedNormal.y, 16));
+			if (TANGENT) {
+				pBuffer = WriteBuffer(pBuffer, (int16_t)QuantizeSnorm(encodedTangent.x, 16));
+				pBuffer = WriteBuffer(pBuffer, (int16_t)QuantizeSnorm(encodedTangent.y, 16));
+			}
+		}
+	}
+}
+
+static void PackQTangents(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 4 Component * 2 Byte = 8 Bytes
+	for (size_t index = 0; index < count; index++) {
+		Vec3f tangent, binormal, normal;
+		float sign;
+		GetTangentFrame(pVertices[index], tangent, binormal, normal, sign);
+
+		const Vec4f q = EncodeQTangent(tangent, binormal, normal, sign);
+		const int16_t values[4] = {
+			(int16_t)QuantizeSnorm(q.x, 16),
+			(int16_t)QuantizeSnorm(q.y, 16),
+			(int16_t)QuantizeSnorm(q.z, 16),
+			(int16_t)QuantizeSnorm(q.w, 16)
+		};
+		memcpy(pOutput + index * stride, values, sizeof(values));
+	}
+}
+
+static void PackNormalsSnorm10(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 10:10:10:2 = 4 Bytes
+	for (size_t index = 0; index < count; index++) {
+		WriteBuffer(pOutput + index * stride, PackSnorm1010102(pVertices[index].normal, 0));
+	}
+}
+
+static void PackBinormalsSnorm10(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 10:10:10:2 = 4 Bytes, w is the 2 bit handedness (1 or -1)
+	for (size_t index = 0; index < count; index++) {
+		WriteBuffer(pOutput + index * stride, PackSnorm1010102(pVertices[index].binormal, IsNegativeFrame(pVertices[index]) ? 0x3 : 0x1));
+	}
+}
+
+static void PackNormalsSnorm8(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 4 Component * 1 Byte = 4 Bytes, w is 0
+	PackBytes4<true>(pOutput, stride, pVertices, count, INT8_MAX, [](const RawVertex &vertex, float values[4]) {
+		values[0] = vertex.normal.x;
+		values[1] = vertex.normal.y;
+		values[2] = vertex.normal.z;
+		values[3] = 0.0f;
+	});
+}
+
+static void PackBinormalsSnorm8(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 4 Component * 1 Byte = 4 Bytes, w is the handedness (127 or -127)
+	PackBytes4<true>(pOutput, stride, pVertices, count, INT8_MAX, [](const RawVertex &vertex, float values[4]) {
+		values[0] = vertex.binormal.x;
+		values[1] = vertex.binormal.y;
+		values[2] = vertex.binormal.z;
+		values[3] = IsNegativeFrame(vertex) ? -1.0f : 1.0f;
+	});
+}
+
+static void PackColorsUnorm8(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 4 Component * 1 Byte = 4 Bytes
+	PackBytes4<false>(pOutput, stride, pVertices, count, UINT8_MAX, [](const RawVertex &vertex, float values[4]) {
+		values[0] = vertex.color.x;
+		values[1] = vertex.color.y;
+		values[2] = vertex.color.z;
+		values[3] = vertex.color.w;
+	});
+}
+
+template<Vec2f RawVertex::*UV>
+static void PackTexcoordsHalf(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 2 Component * 2 Byte = 4 Bytes
+	for (size_t index = 0; index < count; index++) {
+		const Vec2f &uv = pVertices[index].*UV;
+		const uint16_t values[2] = { FloatToHalf(uv.x), FloatToHalf(uv.y) };
+		memcpy(pOutput + index * stride, values, sizeof(values));
+	}
+}
+
+template<Vec2f RawVertex::*UV>
+static void PackTexcoordsUnorm16(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 2 Component * 2 Byte = 4 Bytes
+	for (size_t index = 0; index < count; index++) {
+		const Vec2f &uv = pVertices[index].*UV;
+		const uint16_t values[2] = { (uint16_t)QuantizeUnorm(uv.x, 16), (uint16_t)QuantizeUnorm(uv.y, 16) };
+		memcpy(pOutput + index * stride, values, sizeof(values));
+	}
+}
+
+template<Vec2f RawVertex::*UV>
+static void PackTexcoordsFloat(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 2 Component * 4 Byte = 8 Bytes
+	for (size_t index = 0; index < count; index++) {
+		const Vec2f &uv = pVertices[index].*UV;
+		const float values[2] = { uv.x, uv.y };
+		memcpy(pOutput + index * stride, values, sizeof(values));
+	}
+}
+
+static void PackJointIndicesUint16(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 4 Component * 2 Byte = 8 Bytes
+	for (size_t index = 0; index < count; index++) {
+		const Vec4i &jointIndices = pVertices[index].jointIndices;
+		uint16_t values[4];
+		for (int i = 0; i < 4; i++) {
+			values[i] = (uint16_t)FbxClamp<int>(jointIndices[i], 0, UINT16_MAX);
+		}
+		memcpy(pOutput + index * stride, values, sizeof(values));
+	}
+}
+
+static void PackJointIndicesUint8(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 4 Component * 1 Byte = 4 Bytes, the indices are exact as floats
+	PackBytes4<false>(pOutput, stride, pVertices, count, 1.0f, [](const RawVertex &vertex, float values[4]) {
+		values[0] = (float)vertex.jointIndices.x;
+		values[1] = (float)vertex.jointIndices.y;
+		values[2] = (float)vertex.jointIndices.z;
+		values[3] = (float)vertex.jointIndices.w;
+	});
+}
+
+static void PackJointWeightsUnorm8(uint8_t *pOutput, unsigned int stride, const RawVertex *pVertices, size_t count, const SubMeshHeader &subMeshHeader)
+{
+	// 4 Component * 1 Byte = 4 Bytes
+	PackBytes4<false>(pOutput, stride, pVertices, count, UINT8_MAX, [](const RawVertex &vertex, float values[4]) {
+		values[0] = vertex.jointWeights.x;
+		values[1] = vertex.jointWeights.y;
+		values[2] = vertex.jointWeights.z;
+		values[3] = vertex.jointWeights.w;
+	});
+
+	// Truncating every weight loses up to 3 in the sum, which the largest weight takes back so that
+	// normalized weights still sum to exactly UINT8_MAX
+	for (size_t index = 0; index < count; index++) {
+		const Vec4f &weights = pVertices[index].jointWeights;
+		uint8_t *pBuffer = pOutput + index * stride;
+
+		const int target = QuantizeUnorm(weights.x + weights.y + weights.z + weights.w, 8);
+		const int sum = pBuffer[0] + pBuffer[1] + pBuffer[2] + pBuffer[3];
+		if (sum > 0 && sum < target) {
+			uint8_t *pLargest = std::max_element(pBuffer, pBuffer + 4);
+			*pLargest = (uint8_t)std::min(*pLargest + target - sum, (int)UINT8_MAX);
+		}
+	}
+}
+
+static VertexLayout GetVertexLayout(unsigned int format)
+{
+	VertexLayout layout;
+	layout.format = format;
+
+	auto add = [&layout](VertexAttributeKernel kernel, unsigned int size) {
+		layout.attributes.push_back({ kernel, layout.stride });
+		layout.stride += size;
+	};
+
+	if ((format & RAW_VERTEX_ATTRIBUTE_POSITION) && (format & CROSS_VERTEX_FORMAT_POSITION_STREAM) == 0) {
+		if (format & CROSS_VERTEX_FORMAT_POSITION_UNORM16) {
+			add(PackPositions16<true>, GetPositionSize(format));
+		}
+		else if (format & CROSS_VERTEX_FORMAT_POSITION_SNORM16) {
+			add(PackPositions16<false>, GetPositionSize(format));
+		}
+		else {
+			add(PackPositionsFloat, GetPositionSize(format));
+		}
+	}
+	if ((format & RAW_VERTEX_ATTRIBUTE_NORMAL) && (format & CROSS_VERTEX_FORMAT_NORMAL_OCT8)) {
+		add((format & RAW_VERTEX_ATTRIBUTE_BINORMAL) ? PackNormalsOctahedron<true, true> : PackNormalsOctahedron<true, false>, sizeof(int8_t) * 4);
+	}
+	else if ((format & RAW_VERTEX_ATTRIBUTE_NORMAL) && (format & CROSS_VERTEX_FORMAT_NORMAL_OCT16)) {
+		if (format & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
+			add(PackNormalsOctahedron<false, true>, sizeof(int16_t) * 4);
+		}
+		else {
+			add(PackNormalsOctahedron<false, false>, sizeof(int16_t) * 2);
+		}
+	}
+	else if ((format & RAW_VERTEX_ATTRIBUTE_NORMAL) && (format & CROSS_VERTEX_FORMAT_QTANGENT)) {
+		add(PackQTangents, sizeof(int16_t) * 4);
+	}
+	else {
+		// Binormal is only separate from the normal outside of the tangent frame encodings
+		if (format & RAW_VERTEX_ATTRIBUTE_NORMAL) {
+			add((format & CROSS_VERTEX_FORMAT_NORMAL_SNORM10) ? PackNormalsSnorm10 : PackNormalsSnorm8, sizeof(int8_t) * 4);
+		}
+		if (format & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
+			add((format & CROSS_VERTEX_FORMAT_NORMAL_SNORM10) ? PackBinormalsSnorm10 : PackBinormalsSnorm8, sizeof(int8_t) * 4);
+		}
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_COLOR) {
+		add(PackColorsUnorm8, sizeof(uint8_t) * 4);
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_UV0) {
+		if (format & CROSS_VERTEX_FORMAT_TEXCOORD_HALF) {
+			add(PackTexcoordsHalf<&RawVertex::uv0>, sizeof(uint16_t) * 2);
+		}
+		else if (format & CROSS_VERTEX_FORMAT_TEXCOORD_UNORM16) {
+			add(PackTexcoordsUnorm16<&RawVertex::uv0>, sizeof(uint16_t) * 2);
+		}
+		else {
+			add(PackTexcoordsFloat<&RawVertex::uv0>, sizeof(float) * 2);
+		}
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_UV1) {
+		if (format & CROSS_VERTEX_FORMAT_TEXCOORD_HALF) {
+			add(PackTexcoordsHalf<&RawVertex::uv1>, sizeof(uint16_t) * 2);
+		}
+		else if (format & CROSS_VERTEX_FORMAT_TEXCOORD_UNORM16) {
+			add(PackTexcoordsUnorm16<&RawVertex::uv1>, sizeof(uint16_t) * 2);
+		}
+		else {
+			add(PackTexcoordsFloat<&RawVertex::uv1>, sizeof(float) * 2);
+		}
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_JOINT_INDICES) {
+		if (format & CROSS_VERTEX_FORMAT_JOINT_UINT16) {
+			add(PackJointIndicesUint16, sizeof(uint16_t) * 4);
+		}
+		else {
+			add(PackJointIndicesUint8, sizeof(uint8_t) * 4);
+		}
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS) {
+		add(PackJointWeightsUnorm8, sizeof(uint8_t) * 4);
+	}
+
+	assert(layout.stride == GetVertexSize(format));
+	return layout;
+}
+
+// Writes data at an absolute offset of the .mesh, every byte of the file is written exactly once
+typedef std::function<bool(unsigned int offset, const std::vector<uint8_t> &data)> MeshFileWriter;
+
+static std::vector<uint8_t> ExportVertexData(const VertexLayout &layout, const std::vector<RawVertex> &vertices, const SubMeshHeader &subMeshHeader)
+{
+	std::vector<uint8_t> data(vertices.size() * layout.stride);
+
+	// One attribute at a time over all vertices keeps each kernel free of format branches
+	if (vertices.empty() == false) {
+		for (const VertexAttributeLayout &attribute : layout.attributes) {
+			attribute.kernel(data.data() + attribute.offset, layout.stride, vertices.data(), vertices.size(), subMeshHeader);
+		}
+	}
+
+	return data;
+}
+
+static SubMeshMetrics GetSubMeshMetrics(const SubMeshData &data, unsigned int vertexSize, unsigned int indexSize, const CrossOptions &options)
+{
+	SubMeshMetrics metrics = data.metrics;
+	metrics.vertexSize = vertexSize;
+	metrics.indexSize = indexSize;
+	metrics.vertexFetch = GetMeshVertexFetch(data.indices.data(), data.indices.size(), data.vertices.size(), vertexSize, options.metricsCacheSize);
+	return metrics;
+}
+
+// With CrossOptions::meshMetrics every submesh gets its metrics
+static bool ExportMeshV1(const MeshFileWriter &writer, const RawModel &rawModel, std::vector<RawModel> &rawMaterialModels, const CrossOptions &options, std::vector<SubMeshMetrics> &metrics)
+{
+	MeshHeader meshHeader;
+	CreateMeshHeader(meshHeader, rawModel, rawMaterialModels, options);
+
+	std::vector<uint8_t> headerData(meshHeader.indexBufferOffset);
+	uint8_t *pBuffer = ExportMeshHeader(headerData.data(), meshHeader);
+	assert(pBuffer == headerData.data() + headerData.size());
+
+	if (writer(0, headerData) == false) {
+		return false;
+	}
+
+	// Indices are rebased onto the vertex buffer shared by all submeshes
+	unsigned int baseVertex = 0;
+	const VertexLayout vertexLayout = GetVertexLayout(meshHeader.format);
+
+	return ForEachSubMeshData(rawMaterialModels, options, [&](int indexMesh, const SubMeshData &data) {
+		const SubMeshHeader &subMeshHeader = meshHeader.subMeshHeaders[indexMesh];
+		const unsigned int indexOffset = meshHeader.indexBufferOffset + subMeshHeader.firstIndex * sizeof(unsigned int);
+		const unsigned int vertexOffset = meshHeader.vertexBufferOffset + baseVertex * vertexLayout.stride;
+
+		std::vector<uint8_t> indexData(data.indices.size() * sizeof(unsigned int));
+		uint8_t *pBuffer = indexData.data();
+
+		for (unsigned int index : data.indices) {
+			pBuffer = WriteBuffer(pBuffer, index + baseVertex);
+		}
+
+		baseVertex += data.vertices.size();
+
+		if (options.meshMetrics) {
+			metrics[indexMesh] = GetSubMeshMetrics(data, vertexLayout.stride, sizeof(unsigned int), options);
+		}
+
+		return
+			writer(indexOffset, indexData) &&
+			writer(vertexOffset, ExportVertexData(vertexLayout, data.vertices, subMeshHeader));
+	});
+}
+
+// A vertex only gets a delta for the targets that move it
+static bool IsMorphDeltaZero(const RawBlendVertex &blend)
+{
+	for (int i = 0; i < 3; i++) {
+		if (fabsf(blend.position[i]) > 1e-6f || fabsf(blend.normal[i]) > 1e-6f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Sparse, quantized morph targets of one submesh, the delta offsets are local until merged
+static void CreateMorphTargets(std::vector<MorphTargetHeader> &targets, std::vector<MorphDelta> &deltas, const RawSurface &surface, const std::vector<RawVertex> &vertices)
+{
+	for (int channel = 0; channel < surface.blendChannels.size(); channel++) {
+		MorphTargetHeader target;
+		target.defaultWeight = surface.blendChannels[channel].defaultDeform;
+		target.flags = surface.blendChannels[channel].hasNormals ? MORPH_TARGET_FLAG_NORMALS : 0;
+		target.firstDelta = deltas.size();
+
+		std::vector<unsigned int> moved;
+		for (unsigned int index = 0; index < vertices.size(); index++) {
+			if (channel < vertices[index].blends.size() && IsMorphDeltaZero(vertices[index].blends[channel]) == false) {
+				moved.push_back(index);
+			}
+		}
+
+		for (int i = 0; i < 3; i++) {
+			target.positionMin[i] = target.normalMin[i] =  FLT_MAX;
+			target.positionMax[i] = target.normalMax[i] = -FLT_MAX;
+		}
+		for (unsigned int index : moved) {
+			const RawBlendVertex &blend = vertices[index].blends[channel];
+			for (int i = 0; i < 3; i++) {
+				target.positionMin[i] = std::min(target.positionMin[i], blend.position[i]);
+				target.positionMax[i] = std::max(target.positionMax[i], blend.position[i]);
+				target.normalMin[i] = std::min(target.normalMin[i], blend.normal[i]);
+				target.normalMax[i] = std::max(target.normalMax[i], blend.normal[i]);
+			}
+		}
+		if (moved.empty()) {
+			for (int i = 0; i < 3; i++) {
+				target.positionMin[i] = target.positionMax[i] = target.normalMin[i] = target.normalMax[i] = 0.0f;
+			}
+		}
+
+		for (unsigned int index : moved) {
+			const RawBlendVertex &blend = vertices[index].blends[channel];
+			MorphDelta delta;
+			delta.vertex = index;
+			for (int i = 0; i < 3; i++) {
+				delta.position[i] = (uint16_t)QuantizePosition(blend.position[i], target.positionMin[i], target.positionMax[i], true);
+				if (target.flags & MORPH_TARGET_FLAG_NORMALS) {
+					delta.normal[i] = (uint16_t)QuantizePosition(blend.normal[i], target.normalMin[i], target.normalMax[i], true);
+				}
+			}
+			deltas.push_back(delta);
+		}
+
+		target.numDeltas = moved.size();
+		targets.push_back(target);
+	}
+}
+
+typedef struct NodeTransform
+{
+	Vec3f translation { 0.0f };
+	Quatf rotation { 1.0f, 0.0f, 0.0f, 0.0f };
+	Vec3f scale { 1.0f };
+
+} NodeTransform;
+
+// The transform of child followed by parent, which stays exact while the scale of parent is uniform or child isn't
+// rotated
+static NodeTransform ComposeTransform(const NodeTransform &parent, const NodeTransform &child)
+{
+	NodeTransform transform;
+	const Vec3f scaledTranslation(parent.scale.x * child.translation.x, parent.scale.y * child.translation.y, parent.scale.z * child.translation.z);
+	transform.translation = parent.translation + parent.rotation * scaledTranslation;
+	transform.rotation = parent.rotation * child.rotation;
+	transform.scale = Vec3f(parent.scale.x * child.scale.x, parent.scale.y * child.scale.y, parent.scale.z * child.scale.z);
+	return transform;
+}
+
+static NodeTransform GetNodeTransform(const RawNode &node)
+{
+	NodeTransform transform;
+	transform.translation = node.translation;
+	transform.rotation = node.rotation;
+	transform.scale = node.scale;
+	return transform;
+}
+
+// The transform of the nodes between a joint and the nearest joint above it, false when no joint is above it
+static bool GetJointParentOffset(const RawModel &rawModel, int nodeIndex, NodeTransform &offset)
+{
+	offset = NodeTransform();
+	int parentIndex = rawModel.GetNodeById(rawModel.GetNode(nodeIndex).parentId);
+	while (parentIndex >= 0 && rawModel.GetNode(parentIndex).isJoint == false) {
+		offset = ComposeTransform(GetNodeTransform(rawModel.GetNode(parentIndex)), offset);
+		parentIndex = rawModel.GetNodeById(rawModel.GetNode(parentIndex).parentId);
+	}
+	return parentIndex >= 0;
+}
+
+// The joints of every submesh, with the union of them in a skeleton ordered parents first
+static bool CreateSkeleton(std::vector<SkeletonJoint> &skeleton, std::vector<PaletteJoint> &palettes, std::vector<SubMeshInfoHeader> &subMeshInfoHeaders, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels)
+{
+	std::unordered_map<long, int> jointIndices;
+	std::vector<long> jointIds;
+
+	for (const RawModel &rawMaterialModel : rawMaterialModels) {
+		if (rawMaterialModel.GetSurfaceCount() > 0) {
+			for (long jointId : rawMaterialModel.GetSurface(0).jointIds) {
+				if (jointIndices.emplace(jointId, -1).second) {
+					jointIds.push_back(jointId);
+				}
+			}
+		}
+	}
+
+	// Depth first from the root keeps every parent ahead of its children. offset is the transform of the nodes between
+	// the parent joint and the node.
+	std::function<void(long, int, const NodeTransform &)> addJoints = [&](long id, int parent, const NodeTransform &offset) {
+		const int nodeIndex = rawModel.GetNodeById(id);
+		if (nodeIndex < 0) {
+			return;
+		}
+		const RawNode &node = rawModel.GetNode(nodeIndex);
+		const NodeTransform transform = parent >= 0 ? ComposeTransform(offset, GetNodeTransform(node)) : GetNodeTransform(node);
+		auto it = jointIndices.find(id);
+
+		if (it != jointIndices.end()) {
+			SkeletonJoint joint;
+			strncpy(joint.szName, node.name.c_str(), sizeof(joint.szName) - 1);
+			joint.szName[sizeof(joint.szName) - 1] = 0;
+			joint.parent = parent;
+			for (int i = 0; i < 3; i++) {
+				joint.translation[i] = transform.translation[i];
+				joint.scale[i] = transform.scale[i];
+			}
+			joint.rotation[0] = transform.rotation[1];
+			joint.rotation[1] = transform.rotation[2];
+			joint.rotation[2] = transform.rotation[3];
+			joint.rotation[3] = transform.rotation[0];
+
+			parent = it->second = (int)skeleton.size();
+			skeleton.push_back(joint);
+		}
+
+		for (long childId : node.childIds) {
+			addJoints(childId, parent, (it != jointIndices.end() || parent < 0) ? NodeTransform() : transform);
+		}
+	};
+	addJoints(rawModel.GetRootNode(), -1, NodeTransform());
+
+	for (long jointId : jointIds) {
+		if (jointIndices[jointId] < 0) {
+			const int nodeIndex = rawModel.GetNodeById(jointId);
+			fmt::fprintf(stderr, "ERROR:: Joint %s isn't below the root node\n", nodeIndex >= 0 ? rawModel.GetNode(nodeIndex).name.c_str() : std::to_string(jointId).c_str());
+			return false;
+		}
+	}
+
+	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+		SubMeshInfoHeader &infoHeader = subMeshInfoHeaders[indexMesh];
+		infoHeader.firstJoint = palettes.size();
+
+		if (rawMaterialModels[indexMesh].GetSurfaceCount() == 0) {
+			continue;
+		}
+
+		const RawSurface &surface = rawMaterialModels[indexMesh].GetSurface(0);
+		for (int indexJoint = 0; indexJoint < surface.jointIds.size(); indexJoint++) {
+			PaletteJoint paletteJoint;
+			paletteJoint.joint = jointIndices[surface.jointIds[indexJoint]];
+			for (int i = 0; i < 16; i++) {
+				paletteJoint.inverseBindMatrix[i] = surface.inverseBindMatrices[indexJoint][i];
+			}
+			palettes.push_back(paletteJoint);
+		}
+
+		infoHeader.numJoints = surface.jointIds.size();
+	}
+	return true;
+}
+
+template<typename T>
+static int AddDracoAttribute(draco::Mesh &mesh, draco::GeometryAttribute::Type type, draco::DataType dataType, int numComponents, const std::vector<RawVertex> &vertices, const std::function<T(const RawVertex&)> &getValue)
+{
+	draco::PointAttribute attribute;
+	attribute.Init(type, nullptr, numComponents, dataType, false, numComponents * draco::DataTypeLength(dataType), 0);
+
+	const int attributeId = mesh.AddAttribute(attribute, true, vertices.size());
+	draco::PointAttribute *pAttribute = mesh.attribute(attributeId);
+
+	for (int index = 0; index < vertices.size(); index++) {
+		const T value = getValue(vertices[index]);
+		pAttribute->SetAttributeValue(pAttribute->mapped_index(draco::PointIndex(index)), &value);
+	}
+	return pAttribute->unique_id();
+}
+
+// Joint indices as the 4 x uint16 of the Draco attribute, whatever the width of Vec4i
+typedef std::array<uint16_t, 4> DracoJoints;
+
+static DracoJoints GetDracoJoints(const RawVertex &vertex)
+{
+	return DracoJoints {{ (uint16_t)vertex.jointIndices[0], (uint16_t)vertex.jointIndices[1], (uint16_t)vertex.jointIndices[2], (uint16_t)vertex.jointIndices[3] }};
+}
+
+// The vertices of the submesh with the attributes of its format as floats, quantized by Draco
+static bool EncodeDracoSubMesh(std::vector<uint8_t> &stream, unsigned int format, const SubMeshData &data, const char *szName, const CrossOptions &options)
+{
+	const int triangleCount = data.indices.size() / 3;
+	if (triangleCount == 0) {
+		stream.clear();
+		return true;
+	}
+
+	draco::Mesh mesh;
+	mesh.set_num_points(data.vertices.size());
+	mesh.SetNumFaces(triangleCount);
+	for (int triangle = 0; triangle < triangleCount; triangle++) {
+		draco::Mesh::Face face;
+		face[0] = data.indices[3 * triangle + 0];
+		face[1] = data.indices[3 * triangle + 1];
+		face[2] = data.indices[3 * triangle + 2];
+		mesh.SetFace(draco::FaceIndex(triangle), face);
+	}
+
+	if (format & RAW_VERTEX_ATTRIBUTE_POSITION) {
+		AddDracoAttribute<Vec3f>(mesh, draco::GeometryAttribute::POSITION, draco::DT_FLOAT32, 3, data.vertices, [](const RawVertex &vertex) { return vertex.position; });
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_NORMAL) {
+		AddDracoAttribute<Vec3f>(mesh, draco::GeometryAttribute::NORMAL, draco::DT_FLOAT32, 3, data.vertices, [](const RawVertex &vertex) { return vertex.normal; });
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_BINORMAL) {
+		AddDracoAttribute<Vec4f>(mesh, draco::GeometryAttribute::GENERIC, draco::DT_FLOAT32, 4, data.vertices, [](const RawVertex &vertex) {
+			Vec3f tangent, binormal, normal;
+			float sign;
+			GetTangentFrame(vertex, tangent, binormal, normal, sign);
+			return Vec4f(tangent.x, tangent.y, tangent.z, sign);
+		});
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_COLOR) {
+		AddDracoAttribute<Vec4f>(mesh, draco::GeometryAttribute::COLOR, draco::DT_FLOAT32, 4, data.vertices, [](const RawVertex &vertex) { return vertex.color; });
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_UV0) {
+		AddDracoAttribute<Vec2f>(mesh, draco::GeometryAttribute::TEX_COORD, draco::DT_FLOAT32, 2, data.vertices, [](const RawVertex &vertex) { return vertex.uv0; });
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_UV1) {
+		AddDracoAttribute<Vec2f>(mesh, draco::GeometryAttribute::TEX_COORD, draco::DT_FLOAT32, 2, data.vertices, [](const RawVertex &vertex) { return vertex.uv1; });
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_JOINT_INDICES) {
+		for (const RawVertex &vertex : data.vertices) {
+			for (int i = 0; i < 4; i++) {
+				if ((int)vertex.jointIndices[i] < 0 || (int)vertex.jointIndices[i] > UINT16_MAX) {
+					fmt::fprintf(stderr, "ERROR:: Joint index %d of submesh %s doesn't fit in 16 bits\n", (int)vertex.jointIndices[i], szName);
+					return false;
+				}
+			}
+		}
+		AddDracoAttribute<DracoJoints>(mesh, draco::GeometryAttribute::GENERIC, draco::DT_UINT16, 4, data.vertices, GetDracoJoints);
+	}
+	if (format & RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS) {
+		AddDracoAttribute<Vec4f>(mesh, draco::GeometryAttribute::GENERIC, draco::DT_FLOAT32, 4, data.vertices, [](const RawVertex &vertex) { return vertex.jointWeights; });
+	}
+
+	draco::Encoder encoder;
+	encoder.SetSpeedOptions(options.dracoSpeed, options.dracoSpeed);
+	encoder.SetAttributeQuantization(draco::GeometryAttribute::POSITION, options.dracoPositionBits);
+	encoder.SetAttributeQuantization(draco::GeometryAttribute::NORMAL, options.dracoNormalBits);
+	encoder.SetAttributeQuantization(draco::GeometryAttribute::TEX_COORD, options.dracoTexcoordBits);
+	encoder.SetAttributeQuantization(draco::GeometryAttribute::COLOR, options.dracoColorBits);
+	encoder.SetAttributeQuantization(draco::GeometryAttribute::GENERIC, options.dracoGenericBits);
+
+	// Edgebreaker may reorder, split or drop vertices, the sequential encoding keeps them as they are so the decoded
+	// counts match baseVertex and the vertex section
+	encoder.SetEncodingMethod(draco::MESH_SEQUENTIAL_ENCODING);
+
+	draco::EncoderBuffer buffer;
+	const draco::Status status = encoder.EncodeMeshToBuffer(mesh, &buffer);
+	if (status.code() != draco::Status::OK) {
+		fmt::fprintf(stderr, "ERROR:: Failed to compress submesh %s: %s\n", szName, status.error_msg());
+		return false;
+	}
+
+	stream.assign(buffer.data(), buffer.data() + buffer.size());
+	return true;
+}
+
+static bool ExportMeshV2(const MeshFileWriter &writer, const RawModel &rawModel, std::vector<RawModel> &rawMaterialModels, const CrossOptions &options, std::vector<SubMeshMetrics> &metrics)
+{
+	MeshHeader meshHeader;
+	CreateMeshHeader(meshHeader, rawModel, rawMaterialModels, options);
+
+	// Each submesh gets its own index width, its range starts 4 byte aligned in the index section
+	std::vector<SubMeshInfoHeader> subMeshInfoHeaders(meshHeader.numSubMeshs);
+	unsigned int indexBufferSize = 0;
+	unsigned int baseVertex = 0;
+	unsigned int numIndex = 0;
+
+	// With submesh formats every submesh has a stride of its own and the vertex section is their sum
+	std::vector<SubMeshVertexFormat> vertexFormats(meshHeader.numSubMeshs);
+	std::vector<VertexLayout> vertexLayouts(meshHeader.numSubMeshs);
+	const std::vector<unsigned int> subMeshFormats = SelectSubMeshFormats(meshHeader.format, rawMaterialModels, options);
+	meshHeader.vertexBufferSize = 0;
+
+	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+		const unsigned int numVertex = rawMaterialModels[indexMesh].GetVertexCount();
+		const bool useLongIndices =
+			(options.useLongIndices == UseLongIndicesOptions::ALWAYS) ||
+			(options.useLongIndices == UseLongIndicesOptions::AUTO && numVertex > 65535);
+
+		SubMeshInfoHeader &infoHeader = subMeshInfoHeaders[indexMesh];
+		infoHeader.header = meshHeader.subMeshHeaders[indexMesh];
+		infoHeader.indexSize = useLongIndices ? sizeof(uint32_t) : sizeof(uint16_t);
+		infoHeader.header.baseVertex = baseVertex;
+		infoHeader.header.firstIndex = indexBufferSize / infoHeader.indexSize;
+
+		SubMeshVertexFormat &vertexFormat = vertexFormats[indexMesh];
+		vertexFormat.format = subMeshFormats[indexMesh];
+		vertexLayouts[indexMesh] = GetVertexLayout(vertexFormat.format);
+		vertexFormat.vertexSize = vertexLayouts[indexMesh].stride;
+		vertexFormat.vertexOffset = meshHeader.vertexBufferSize;
+
+		indexBufferSize = AlignSize(indexBufferSize + infoHeader.header.indexCount * infoHeader.indexSize, sizeof(uint32_t));
+		meshHeader.vertexBufferSize += numVertex * vertexFormat.vertexSize;
+		baseVertex += numVertex;
+		numIndex += infoHeader.header.indexCount;
+	}
+
+	// The sections up to the vertices have sizes known up front, so every submesh is written into them as soon as it
+	// is built; the sections after them are gathered while the submeshes go by and written at the end
+	const bool hasPositions =
+		(options.positionStream == PositionStreamOptions::SPLIT && baseVertex > 0) ||
+		(options.positionStream == PositionStreamOptions::INDEXED && numIndex > 0);
+	const bool hasPositionIndices =
+		(options.positionStream == PositionStreamOptions::INDEXED && numIndex > 0);
+
+	std::vector<SkeletonJoint> skeleton;
+	std::vector<PaletteJoint> palettes;
+	if (CreateSkeleton(skeleton, palettes, subMeshInfoHeaders, rawModel, rawMaterialModels) == false) {
+		return false;
+	}
+	const bool hasSkeleton = skeleton.empty() == false;
+
+	bool hasMorphTargets = false;
+	for (const RawModel &rawMaterialModel : rawMaterialModels) {
+		hasMorphTargets |= rawMaterialModel.GetSurfaceCount() > 0 && rawMaterialModel.GetSurface(0).blendChannels.empty() == false;
+	}
+
+	// Compressed indices and vertices are only written once every submesh is encoded, they take no space where their
+	// sections start
+	const bool paged = options.meshPageSize > 0 && options.useDraco == false;
+	const unsigned int sectionFlags = options.useDraco ? MESH_SECTION_FLAG_COMPRESSED : (paged ? MESH_SECTION_FLAG_PAGED : 0);
+	const unsigned int storedIndexBufferSize = sectionFlags ? 0 : indexBufferSize;
+	const unsigned int storedVertexBufferSize = sectionFlags ? 0 : meshHeader.vertexBufferSize;
+
+	const unsigned int numSections = 4 + (options.buildMeshlets ? 3 : 0) + (hasPositions ? 1 : 0) + (hasPositionIndices ? 1 : 0) + (hasSkeleton ? 2 : 0) + (hasMorphTargets ? 2 : 0) + (options.subMeshFormats ? 1 : 0) + (options.useDraco ? 2 : 0) + (paged ? 2 : 0);
+	const unsigned int alignment = std::max(options.meshAlignment, 16u);
+
+	// The blocks of the submeshes are laid out up front, their sizes are known before any submesh is built
+	MeshPageTable pageTable;
+	std::vector<SubMeshPages> subMeshPages(paged ? meshHeader.numSubMeshs : 0);
+	std::vector<unsigned int> blockEnds(subMeshPages.size());
+	unsigned int pageDataSize = 0;
+
+	if (paged) {
+		pageTable.pageSize = std::max(options.meshPageSize, alignment);
+		pageTable.numSubMeshs = meshHeader.numSubMeshs;
+
+		for (int indexMesh = 0; indexMesh < subMeshPages.size(); indexMesh++) {
+			const SubMeshInfoHeader &infoHeader = subMeshInfoHeaders[indexMesh];
+			const unsigned int indexDataSize = AlignSize(infoHeader.header.indexCount * infoHeader.indexSize, alignment);
+			const unsigned int blockSize = indexDataSize + rawMaterialModels[indexMesh].GetVertexCount() * vertexFormats[indexMesh].vertexSize;
+
+			unsigned int blockOffset = AlignSize(pageDataSize, alignment);
+			const unsigned int pageEnd = (blockOffset / pageTable.pageSize + 1) * pageTable.pageSize;
+			if (blockOffset % pageTable.pageSize != 0 && blockOffset + blockSize > pageEnd) {
+				blockOffset = pageEnd;
+			}
+
+			SubMeshPages &pages = subMeshPages[indexMesh];
+			pages.firstPage = blockOffset / pageTable.pageSize;
+			pages.numPages = blockSize > 0 ? (blockOffset + blockSize - 1) / pageTable.pageSize - pages.firstPage + 1 : 0;
+			pages.indexOffset = blockOffset;
+			pages.vertexOffset = blockOffset + indexDataSize;
+
+			// The padding before the next block is written with this one
+			if (indexMesh > 0) {
+				blockEnds[indexMesh - 1] = blockOffset;
+			}
+			pageDataSize = blockOffset + blockSize;
+		}
+
+		if (blockEnds.empty() == false) {
+			blockEnds.back() = pageDataSize;
+		}
+		pageTable.numPages = (pageDataSize + pageTable.pageSize - 1) / pageTable.pageSize;
+	}
+	const unsigned int infoOffset = AlignSize(sizeof(MeshFileHeader) + sizeof(MeshSectionHeader) * numSections, alignment);
+	const unsigned int subMeshOffset = AlignSize(infoOffset + sizeof(MeshInfoHeader), alignment);
+	const unsigned int indexOffset = AlignSize(subMeshOffset + sizeof(SubMeshInfoHeader) * meshHeader.numSubMeshs, alignment);
+	const unsigned int vertexOffset = AlignSize(indexOffset + storedIndexBufferSize, alignment);
+	const unsigned int pageDataOffset = paged ? AlignSize(vertexOffset, pageTable.pageSize) : vertexOffset;
+
+	auto exportIndexData = [](const SubMeshInfoHeader &infoHeader, const std::vector<unsigned int> &indices) {
+		// Padded to the 4 byte aligned start of the next submesh
+		std::vector<uint8_t> data(AlignSize(indices.size() * infoHeader.indexSize, sizeof(uint32_t)), 0);
+		uint8_t *pBuffer = data.data();
+
+		for (unsigned int index : indices) {
+			if (infoHeader.indexSize == sizeof(uint16_t)) {
+				pBuffer = WriteBuffer(pBuffer, (uint16_t)index);
+			}
+			else {
+				pBuffer = WriteBuffer(pBuffer, (uint32_t)index);
+			}
+		}
+
+		return data;
+	};
+
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+
+	std::vector<MorphTargetHeader> morphTargets;
+	std::vector<MorphDelta> morphDeltas;
+
+	// Depth only passes read the positions of their own stream, deduplicated per submesh for an indexed stream
+	const unsigned int positionSize = hasPositions ? GetPositionSize(meshHeader.format) : 0;
+	unsigned int numPositions = 0;
+	std::vector<uint8_t> positionData;
+	std::vector<uint8_t> positionIndexData(hasPositionIndices ? indexBufferSize : 0, 0);
+
+	std::vector<CompressedSubMesh> compressedSubMeshes(options.useDraco ? meshHeader.numSubMeshs : 0);
+	std::vector<uint8_t> compressedData;
+
+	const bool success = ForEachSubMeshData(rawMaterialModels, options, [&](int indexMesh, const SubMeshData &data) {
+		const SubMeshHeader &subMeshHeader = meshHeader.subMeshHeaders[indexMesh];
+		SubMeshInfoHeader &infoHeader = subMeshInfoHeaders[indexMesh];
+		const unsigned int indexDataOffset = infoHeader.header.firstIndex * infoHeader.indexSize;
+
+		if (options.buildMeshlets) {
+			infoHeader.firstMeshlet = meshlets.size();
+			infoHeader.numMeshlets = data.meshlets.size();
+
+			for (Meshlet meshlet : data.meshlets) {
+				meshlet.vertexOffset += meshletVertices.size();
+				meshlet.triangleOffset += meshletTriangles.size();
+				meshlets.push_back(meshlet);
+			}
+
+			meshletVertices.insert(meshletVertices.end(), data.meshletVertices.begin(), data.meshletVertices.end());
+			meshletTriangles.insert(meshletTriangles.end(), data.meshletTriangles.begin(), data.meshletTriangles.end());
+		}
+
+		// Morph deltas index the vertices in their optimized order
+		if (hasMorphTargets && rawMaterialModels[indexMesh].GetSurfaceCount() > 0) {
+			std::vector<MorphTargetHeader> targets;
+			std::vector<MorphDelta> deltas;
+			CreateMorphTargets(targets, deltas, rawMaterialModels[indexMesh].GetSurface(0), data.vertices);
+
+			infoHeader.firstMorphTarget = morphTargets.size();
+			infoHeader.numMorphTargets = targets.size();
+
+			for (MorphTargetHeader target : targets) {
+				target.firstDelta += morphDeltas.size();
+				morphTargets.push_back(target);
+			}
+
+			morphDeltas.insert(morphDeltas.end(), deltas.begin(), deltas.end());
+		}
+
+		if (options.positionStream == PositionStreamOptions::SPLIT) {
+			infoHeader.basePosition = numPositions;
+
+			for (const RawVertex &vertex : data.vertices) {
+				positionData.resize(positionData.size() + positionSize);
+				ExportPosition(positionData.data() + positionData.size() - positionSize, meshHeader.format, vertex.position, subMeshHeader);
+			}
+
+			numPositions += data.vertices.size();
+		}
+		else if (options.positionStream == PositionStreamOptions::INDEXED) {
+			std::vector<unsigned int> positionIndices(data.indices.size());
+			std::unordered_map<Vec3f, unsigned int, PositionHasher> positionMap;
+
+			infoHeader.basePosition = numPositions;
+
+			// Positions come in the order of first use, like the vertices
+			for (int index = 0; index < data.indices.size(); index++) {
+				const Vec3f &position = data.vertices[data.indices[index]].position;
+				auto it = positionMap.emplace(position, positionMap.size());
+
+				if (it.second) {
+					positionData.resize(positionData.size() + positionSize);
+					ExportPosition(positionData.data() + positionData.size() - positionSize, meshHeader.format, position, subMeshHeader);
+				}
+
+				positionIndices[index] = it.first->second;
+			}
+
+			const std::vector<uint8_t> indexData = exportIndexData(infoHeader, positionIndices);
+			std::copy(indexData.begin(), indexData.end(), positionIndexData.begin() + indexDataOffset);
+			numPositions += positionMap.size();
+		}
+
+		if (options.meshMetrics) {
+			metrics[indexMesh] = GetSubMeshMetrics(data, vertexFormats[indexMesh].vertexSize, infoHeader.indexSize, options);
+		}
+
+		if (paged) {
+			const SubMeshPages &pages = subMeshPages[indexMesh];
+			const std::vector<uint8_t> indexData = exportIndexData(infoHeader, data.indices);
+			const std::vector<uint8_t> vertexData = ExportVertexData(vertexLayouts[indexMesh], data.vertices, subMeshHeader);
+
+			std::vector<uint8_t> block(blockEnds[indexMesh] - pages.indexOffset, 0);
+			std::copy(indexData.begin(), indexData.end(), block.begin());
+			std::copy(vertexData.begin(), vertexData.end(), block.begin() + (pages.vertexOffset - pages.indexOffset));
+			return writer(pageDataOffset + pages.indexOffset, block);
+		}
+
+		if (options.useDraco) {
+			std::vector<uint8_t> stream;
+			if (EncodeDracoSubMesh(stream, vertexFormats[indexMesh].format, data, subMeshHeader.szName, options) == false) {
+				return false;
+			}
+
+			compressedSubMeshes[indexMesh].offset = compressedData.size();
+			compressedSubMeshes[indexMesh].size = stream.size();
+			compressedData.insert(compressedData.end(), stream.begin(), stream.end());
+			return true;
+		}
+
+		return
+			writer(indexOffset + indexDataOffset, exportIndexData(infoHeader, data.indices)) &&
+			writer(vertexOffset + vertexFormats[indexMesh].vertexOffset, ExportVertexData(vertexLayouts[indexMesh], data.vertices, subMeshHeader));
+	});
+
+	if (success == false) {
+		return false;
+	}
+
+	MeshInfoHeader infoHeader;
+	infoHeader.format = meshHeader.format;
+	infoHeader.vertexSize = options.subMeshFormats ? 0 : GetVertexSize(meshHeader.format);
+	infoHeader.numVertices = baseVertex;
+	infoHeader.numIndices = numIndex;
+	infoHeader.numSubMeshs = meshHeader.numSubMeshs;
+	infoHeader.positionSize = positionSize;
+	infoHeader.numPositions = numPositions;
+
+	std::vector<MeshSection> sections;
+	sections.push_back({ MESH_SECTION_INFO, sizeof(infoHeader), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, infoHeader); } });
+	sections.push_back({ MESH_SECTION_SUBMESHES, (unsigned int)sizeof(SubMeshInfoHeader) * meshHeader.numSubMeshs, [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, subMeshInfoHeaders); } });
+	sections.push_back({ MESH_SECTION_INDICES, indexBufferSize, nullptr, sectionFlags });
+	sections.push_back({ MESH_SECTION_VERTICES, meshHeader.vertexBufferSize, nullptr, sectionFlags });
+
+	// The page data follows the vertices at the next page boundary, so its offset is known while the submeshes are
+	// written and every page starts page aligned in the file
+	if (paged) {
+		sections.push_back({ MESH_SECTION_PAGE_DATA, pageDataSize, nullptr });
+	}
+
+	if (options.buildMeshlets) {
+		sections.push_back({ MESH_SECTION_MESHLETS, (unsigned int)sizeof(Meshlet) * (unsigned int)meshlets.size(), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, meshlets); } });
+		sections.push_back({ MESH_SECTION_MESHLET_VERTICES, (unsigned int)sizeof(unsigned int) * (unsigned int)meshletVertices.size(), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, meshletVertices); } });
+		sections.push_back({ MESH_SECTION_MESHLET_TRIANGLES, (unsigned int)meshletTriangles.size(), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, meshletTriangles); } });
+	}
+
+	if (hasPositions) {
+		sections.push_back({ MESH_SECTION_POSITIONS, (unsigned int)positionData.size(), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, positionData); } });
+	}
+
+	if (hasPositionIndices) {
+		sections.push_back({ MESH_SECTION_POSITION_INDICES, indexBufferSize, [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, positionIndexData); } });
+	}
+
+	if (hasSkeleton) {
+		sections.push_back({ MESH_SECTION_SKELETON, (unsigned int)sizeof(SkeletonJoint) * (unsigned int)skeleton.size(), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, skeleton); } });
+		sections.push_back({ MESH_SECTION_PALETTES, (unsigned int)sizeof(PaletteJoint) * (unsigned int)palettes.size(), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, palettes); } });
+	}
+
+	if (hasMorphTargets) {
+		sections.push_back({ MESH_SECTION_MORPH_TARGETS, (unsigned int)sizeof(MorphTargetHeader) * (unsigned int)morphTargets.size(), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, morphTargets); } });
+		sections.push_back({ MESH_SECTION_MORPH_DELTAS, (unsigned int)sizeof(MorphDelta) * (unsigned int)morphDeltas.size(), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, morphDeltas); } });
+	}
+
+	if (options.subMeshFormats) {
+		sections.push_back({ MESH_SECTION_VERTEX_FORMATS, (unsigned int)sizeof(SubMeshVertexFormat) * meshHeader.numSubMeshs, [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, vertexFormats); } });
+	}
+
+	if (options.useDraco) {
+		sections.push_back({ MESH_SECTION_COMPRESSED_SUBMESHES, (unsigned int)sizeof(CompressedSubMesh) * meshHeader.numSubMeshs, [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, compressedSubMeshes); } });
+		sections.push_back({ MESH_SECTION_COMPRESSED_DATA, (unsigned int)compressedData.size(), [&](uint8_t *pBuffer) { return WriteBuffer(pBuffer, compressedData); } });
+	}
+
+	if (paged) {
+		sections.push_back({ MESH_SECTION_PAGE_TABLE, (unsigned int)(sizeof(MeshPageTable) + sizeof(SubMeshPages) * subMeshPages.size()), [&](uint8_t *pBuffer) { return WriteBuffer(WriteBuffer(pBuffer, pageTable), subMeshPages); } });
+	}
+
+	assert(sections.size() == numSections);
+
+	MeshFileHeader fileHeader;
+	fileHeader.alignment = alignment;
+	fileHeader.numSections = sections.size();
+
+	std::vector<MeshSectionHeader> sectionHeaders(sections.size());
+	unsigned int offset = infoOffset;
+
+	for (int indexSection = 0; indexSection < sections.size(); indexSection++) {
+		if (sections[indexSection].type == MESH_SECTION_PAGE_DATA) {
+			offset = AlignSize(offset, pageTable.pageSize);
+		}
+		sectionHeaders[indexSection].type = sections[indexSection].type;
+		sectionHeaders[indexSection].flags = sections[indexSection].flags;
+		sectionHeaders[indexSection].offset = offset;
+		sectionHeaders[indexSection].size = sections[indexSection].size;
+
+		if ((sections[indexSection].flags & (MESH_SECTION_FLAG_COMPRESSED | MESH_SECTION_FLAG_PAGED)) == 0) {
+			offset = AlignSize(offset + sections[indexSection].size, alignment);
+		}
+	}
+
+	assert(sectionHeaders[2].offset == indexOffset && sectionHeaders[3].offset == vertexOffset);
+	assert(paged == false || sectionHeaders[4].offset == pageDataOffset);
+
+	// Padding between sections stays zero, the padding after the indices and the vertices is written with the next section
+	auto exportSection = [&](int indexSection, unsigned int beginOffset, unsigned int endOffset) {
+		std::vector<uint8_t> data(endOffset - beginOffset, 0);
+		uint8_t *pSection = data.data() + sectionHeaders[indexSection].offset - beginOffset;
+		uint8_t *pBuffer = sections[indexSection].write(pSection);
+		assert(pBuffer == pSection + sectionHeaders[indexSection].size);
+		return writer(beginOffset, data);
+	};
+
+	unsigned int beginOffset = paged ? pageDataOffset + pageDataSize : vertexOffset + storedVertexBufferSize;
+
+	for (int indexSection = paged ? 5 : 4; indexSection < sections.size(); indexSection++) {
+		const unsigned int endOffset = indexSection + 1 < sections.size() ? sectionHeaders[indexSection + 1].offset : offset;
+
+		if (exportSection(indexSection, beginOffset, endOffset) == false) {
+			return false;
+		}
+
+		beginOffset = endOffset;
+	}
+
+	if (beginOffset < offset && writer(beginOffset, std::vector<uint8_t>(offset - beginOffset, 0)) == false) {
+		return false;
+	}
+
+	std::vector<uint8_t> headerData(infoOffset, 0);
+	uint8_t *pBuffer = headerData.data();
+	pBuffer = WriteBuffer(pBuffer, fileHeader);
+	pBuffer = WriteBuffer(pBuffer, sectionHeaders);
+
+	return
+		writer(0, headerData) &&
+		exportSection(0, infoOffset, subMeshOffset) &&
+		exportSection(1, subMeshOffset, indexOffset) &&
+		(indexOffset + storedIndexBufferSize == vertexOffset || writer(indexOffset + storedIndexBufferSize, std::vector<uint8_t>(vertexOffset - indexOffset - storedIndexBufferSize, 0))) &&
+		(pageDataOffset == vertexOffset || writer(vertexOffset, std::vector<uint8_t>(pageDataOffset - vertexOffset, 0)));
+}
+
+static bool SeekFile(FILE *pFile, unsigned int offset)
+{
+#if defined( _WIN32 )
+	return _fseeki64(pFile, offset, SEEK_SET) == 0;
+#else
+	return fseeko(pFile, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static bool WriteMeshFile(const char *szFileName, const std::function<bool(FILE*)> &write, const CrossOptions &options)
+{
+	const std::string fileName = options.atomicWrite ? std::string(szFileName) + ".tmp" + std::to_string(std::random_device()()) : std::string(szFileName);
+
+	FILE *pFile = fopen(fileName.c_str(), "wb");
+	if (pFile == nullptr) {
+		fmt::fprintf(stderr, "ERROR:: Failed to open %s for writing\n", fileName.c_str());
+		return false;
+	}
+
+	const bool success = write(pFile);
+	if (fclose(pFile) != 0 || success == false) {
+		fmt::fprintf(stderr, "ERROR:: Failed to write %s\n", fileName.c_str());
+		remove(fileName.c_str());
+		return false;
+	}
+
+	if (options.atomicWrite && FileUtils::RenameFile(fileName, szFileName) == false) {
+		fmt::fprintf(stderr, "ERROR:: Failed to rename %s to %s\n", fileName.c_str(), szFileName);
+		remove(fileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+unsigned int GetMeshFormat(const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels, const CrossOptions &options)
+{
+	MeshHeader meshHeader;
+	CreateSubMeshBounds(meshHeader, rawMaterialModels);
+	return SelectVertexFormat(rawModel.GetVertexAttributes(), meshHeader, rawMaterialModels, options, false);
+}
+
+std::vector<unsigned int> GetMaterialFormats(unsigned int meshFormat, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels, const CrossOptions &options)
+{
+	const std::vector<unsigned int> subMeshFormats = SelectSubMeshFormats(meshFormat, rawMaterialModels, options);
+
+	// The material models carry copies of the materials, which are told apart by name
+	std::unordered_map<std::string, unsigned int> materialNameFormats;
+	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+		materialNameFormats.emplace(rawMaterialModels[indexMesh].GetMaterial(0).name, subMeshFormats[indexMesh]);
+	}
+
+	std::vector<unsigned int> formats(rawModel.GetMaterialCount(), meshFormat);
+	for (int index = 0; index < rawModel.GetMaterialCount(); index++) {
+		auto it = materialNameFormats.find(rawModel.GetMaterial(index).name);
+		if (it != materialNameFormats.end()) {
+			formats[index] = it->second;
+		}
+	}
+	return formats;
+}
+
+std::string GetMeshMetricsFileName(const char *szMeshFileName)
+{
+	std::string fileName = szMeshFileName;
+	if (fileName.size() > 5 && fileName.compare(fileName.size() - 5, 5, ".mesh") == 0) {
+		fileName.resize(fileName.size() - 5);
+	}
+	return fileName + ".metrics.json";
+}
+
+static bool ExportMeshMetrics(const char *szFileName, const std::vector<RawModel> &rawMaterialModels, const std::vector<SubMeshMetrics> &metrics, const CrossOptions &options)
+{
+	nlohmann::json subMeshes = nlohmann::json::array();
+	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+		const RawModel &rawMaterialModel = rawMaterialModels[indexMesh];
+		const SubMeshMetrics &subMeshMetrics = metrics[indexMesh];
+		subMeshes.push_back({
+			{ "name", rawMaterialModel.GetSurfaceCount() > 0 ? rawMaterialModel.GetSurface(0).name : std::string() },
+			{ "material", rawMaterialModel.GetMaterialCount() > 0 ? rawMaterialModel.GetMaterial(0).name : std::string() },
+			{ "vertices", subMeshMetrics.vertexCount },
+			{ "triangles", subMeshMetrics.triangleCount },
+			{ "bytesPerVertex", subMeshMetrics.vertexSize },
+			{ "indexSize", subMeshMetrics.indexSize },
+			{ "acmrFifo", subMeshMetrics.fifo.acmr },
+			{ "atvrFifo", subMeshMetrics.fifo.atvr },
+			{ "acmrLru", subMeshMetrics.lru.acmr },
+			{ "atvrLru", subMeshMetrics.lru.atvr },
+			{ "overdraw", subMeshMetrics.overdraw },
+			{ "vertexFetch", subMeshMetrics.vertexFetch },
+			{ "degenerateTriangles", subMeshMetrics.degenerateTriangles }
+		});
+	}
+
+	const nlohmann::json report = {
+		{ "cacheSize", options.metricsCacheSize },
+		{ "subMeshes", subMeshes }
+	};
+
+	std::ofstream stream(szFileName, std::ios::trunc);
+	stream << report.dump(1) << std::endl;
+	if (!stream.good()) {
+		fmt::fprintf(stderr, "ERROR:: Failed to write %s\n", szFileName);
+		return false;
+	}
+	return true;
+}
+
+bool ExportMesh(const char *szFileName, const RawModel &rawModel, std::vector<RawModel> &rawMaterialModels, const CrossOptions &options)
+{
+	std::vector<SubMeshMetrics> metrics(rawMaterialModels.size());
+
+	auto exportMesh = [&](const MeshFileWriter &writer) {
+		if (options.meshVersion == 1) {
+			return ExportMeshV1(writer, rawModel, rawMaterialModels, options, metrics);
+		}
+		else {
+			return ExportMeshV2(writer, rawModel, rawMaterialModels, options, metrics);
+		}
+	};
+
+	bool success;
+	if (options.streaming) {
+		// Every submesh goes to the file as soon as it is encoded
+		success = WriteMeshFile(szFileName, [&](FILE *pFile) {
+			return exportMesh([&](unsigned int offset, const std::vector<uint8_t> &data) {
+				return SeekFile(pFile, offset) && fwrite(data.data(), 1, data.size(), pFile) == data.size();
+			});
+		}, options);
+	}
+	else {
+		// The whole file is staged in memory and written with a single call
+		std::vector<uint8_t> buffer;
+
+		const bool exported = exportMesh([&](unsigned int offset, const std::vector<uint8_t> &data) {
+			if (buffer.size() < offset + data.size()) {
+				buffer.resize(offset + data.size());
+			}
+			std::copy(data.begin(), data.end(), buffer.begin() + offset);
+			return true;
+		});
+		if (exported == false) {
+			return false;
+		}
+
+		success = WriteMeshFile(szFileName, [&](FILE *pFile) {
+			return fwrite(buffer.data(), 1, buffer.size(), pFile) == buffer.size();
+		}, options);
+	}
+
+	if (success && options.meshMetrics) {
+		ProfileUtils::ScopedTimer timer("exportMeshMetrics");
+		success = ExportMeshMetrics(GetMeshMetricsFileName(szFileName).c_str(), rawMaterialModels, metrics, options);
+	}
+	return success;
+}
+
+// .anim layout, one file per RawAnimation:
+//   AnimFileHeader, AnimTrackHeader[numTracks], track data
+//   The headers come first so the runtime can read them for every clip and only load
+//   the track data, AnimFileHeader::dataOffset/dataSize, of the clips it plays.
+//   Every track is one channel of a node, keys are sampled at AnimFileHeader::frameRate.
+//   Tracks of joints are relative to the parent joint, as SkeletonJoint is.
+//   Translations and scales are unorm16 relative to AnimTrackHeader::minValue/maxValue,
+//   rotations are smallest three quaternions in 3 x uint16 and morph weights are unorm16.
+//   A track with ANIM_TRACK_FLAG_CONSTANT stores a single key for the whole clip. A track
+//   with ANIM_TRACK_FLAG_SPARSE starts with the uint16 frame index of each of its keys.
+
+#define ANIM_FILE_MAGIC   0x4D4E4143 // 'CANM'
+#define ANIM_FILE_VERSION 1
+
+enum AnimTrackType
+{
+	ANIM_TRACK_TRANSLATION = 0, // 3 x unorm16
+	ANIM_TRACK_ROTATION    = 1, // 3 x uint16, smallest three
+	ANIM_TRACK_SCALE       = 2, // 3 x unorm16
+	ANIM_TRACK_WEIGHTS     = 3, // numComponents x unorm16
+};
+
+enum AnimTrackFlags
+{
+	ANIM_TRACK_FLAG_CONSTANT = 0x00000001,
+	ANIM_TRACK_FLAG_SPARSE   = 0x00000002,
+};
+
+typedef struct AnimFileHeader
+{
+	unsigned int magic = ANIM_FILE_MAGIC;
+	unsigned int version = ANIM_FILE_VERSION;
+	char szName[260];
+
+	float duration = 0.0f;
+	float frameRate = 0.0f;
+	unsigned int numFrames = 0;
+	unsigned int numTracks = 0;
+
+	unsigned int dataOffset = 0;
+	unsigned int dataSize = 0;
+
+} AnimFileHeader;
+
+typedef struct AnimTrackHeader
+{
+	// offset is relative to AnimFileHeader::dataOffset
+	char szNodeName[260];
+	unsigned int type = 0;
+	unsigned int flags = 0;
+	unsigned int numComponents = 0;
+	unsigned int numKeys = 0;
+	unsigned int offset = 0;
+	unsigned int size = 0;
+
+	float minValue[3] = { 0.0f, 0.0f, 0.0f };
+	float maxValue[3] = { 0.0f, 0.0f, 0.0f };
+
+} AnimTrackHeader;
+
+static void EncodeSmallestThree(uint16_t *pKey, const Quatf &rotation)
+{
+	const int bits = 15;
+	const float range = 1.0f / sqrtf(2.0f);
+
+	float q[4] = { rotation.vector().x, rotation.vector().y, rotation.vector().z, rotation.scalar() };
+	const float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+	int largest = 0;
+	for (int i = 0; i < 4; i++) {
+		q[i] = length > 0.0f ? q[i] / length : (i == 3 ? 1.0f : 0.0f);
+		if (fabsf(q[i]) > fabsf(q[largest])) {
+			largest = i;
+		}
+	}
+
+	// q and -q are the same rotation, the dropped component is always positive
+	const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+	for (int i = 0, component = 0; i < 4; i++) {
+		if (i != largest) {
+			const float value = std::max(-1.0f, std::min(1.0f, sign * q[i] / range));
+			pKey[component++] = (uint16_t)QuantizeUnorm(value * 0.5f + 0.5f, bits);
+		}
+	}
+
+	// The index of the dropped component lives in the high bits of the first two values
+	pKey[0] |= (uint16_t)((largest & 1) << bits);
+	pKey[1] |= (uint16_t)((largest >> 1) << bits);
+}
+
+static void GetTrackRange(AnimTrackHeader &trackHeader, const std::vector<Vec3f> &values)
+{
+	for (int i = 0; i < 3; i++) {
+		trackHeader.minValue[i] =  FLT_MAX;
+		trackHeader.maxValue[i] = -FLT_MAX;
+	}
+
+	for (const Vec3f &value : values) {
+		for (int i = 0; i < 3; i++) {
+			trackHeader.minValue[i] = std::min(trackHeader.minValue[i], value[i]);
+			trackHeader.maxValue[i] = std::max(trackHeader.maxValue[i], value[i]);
+		}
+	}
+}
+
+static std::vector<uint16_t> CreateTrackKeys(AnimTrackHeader &trackHeader, const std::vector<Vec3f> &values)
+{
+	std::vector<uint16_t> keys(values.size() * 3);
+
+	GetTrackRange(trackHeader, values);
+
+	for (size_t index = 0; index < values.size(); index++) {
+		for (int i = 0; i < 3; i++) {
+			const float extent = trackHeader.maxValue[i] - trackHeader.minValue[i];
+			keys[index * 3 + i] = extent > 0.0f ? (uint16_t)QuantizeUnorm((values[index][i] - trackHeader.minValue[i]) / extent, 16) : 0;
+		}
+	}
+
+	return keys;
+}
+
+static std::vector<uint16_t> CreateTrackKeys(AnimTrackHeader &trackHeader, const std::vector<Quatf> &values)
+{
+	std::vector<uint16_t> keys(values.size() * 3);
+
+	for (size_t index = 0; index < values.size(); index++) {
+		EncodeSmallestThree(&keys[index * 3], values[index]);
+	}
+
+	return keys;
+}
+
+static std::vector<uint16_t> CreateTrackKeys(AnimTrackHeader &trackHeader, const std::vector<float> &values)
+{
+	std::vector<uint16_t> keys(values.size());
+
+	for (size_t index = 0; index < values.size(); index++) {
+		keys[index] = (uint16_t)QuantizeUnorm(std::max(0.0f, std::min(1.0f, values[index])), 16);
+	}
+
+	return keys;
+}
+
+// Tracks whose quantized keys never change are stored as a single key
+static bool ElideConstantTrack(AnimTrackHeader &trackHeader, std::vector<uint16_t> &keys)
+{
+	const size_t keySize = trackHeader.numComponents;
+
+	for (size_t index = keySize; index < keys.size(); index++) {
+		if (keys[index] != keys[index % keySize]) {
+			return false;
+		}
+	}
+
+	keys.resize(keySize);
+	trackHeader.numKeys = 1;
+	trackHeader.flags |= ANIM_TRACK_FLAG_CONSTANT;
+	return true;
+}
+
+template<typename T>
+static void CreateTrack(std::vector<AnimTrackHeader> &trackHeaders, std::vector<std::vector<uint16_t>> &tracks, const AnimFileHeader &fileHeader, const RawNode &node, unsigned int type, unsigned int numComponents, const std::vector<T> &values, const std::vector<float> &times)
+{
+	if (values.empty()) {
+		return;
+	}
+
+	AnimTrackHeader trackHeader;
+	strncpy(trackHeader.szNodeName, node.name.c_str(), sizeof(trackHeader.szNodeName) - 1);
+	trackHeader.szNodeName[sizeof(trackHeader.szNodeName) - 1] = 0;
+	trackHeader.type = type;
+	trackHeader.numComponents = numComponents;
+
+	std::vector<uint16_t> keys = CreateTrackKeys(trackHeader, values);
+	trackHeader.numKeys = (unsigned int)(keys.size() / numComponents);
+
+	// Reduced tracks lead with the frames of their keys
+	if (ElideConstantTrack(trackHeader, keys) == false && times.empty() == false) {
+		std::vector<uint16_t> frames(times.size());
+		for (size_t index = 0; index < times.size(); index++) {
+			frames[index] = (uint16_t)std::min(roundf(times[index] * fileHeader.frameRate), (float)(fileHeader.numFrames - 1));
+		}
+		keys.insert(keys.begin(), frames.begin(), frames.end());
+		trackHeader.flags |= ANIM_TRACK_FLAG_SPARSE;
+	}
+
+	trackHeaders.push_back(trackHeader);
+	tracks.emplace_back(std::move(keys));
+}
+
+bool ExportAnimation(const char *szFileName, const RawModel &rawModel, const RawAnimation &animation, const CrossOptions &options)
+{
+	AnimFileHeader fileHeader;
+	strncpy(fileHeader.szName, animation.name.c_str(), sizeof(fileHeader.szName) - 1);
+	fileHeader.szName[sizeof(fileHeader.szName) - 1] = 0;
+	fileHeader.numFrames = (unsigned int)animation.times.size();
+	fileHeader.duration = animation.times.empty() ? 0.0f : animation.times.back();
+	fileHeader.frameRate = fileHeader.duration > 0.0f ? (fileHeader.numFrames - 1) / fileHeader.duration : 0.0f;
+
+	if (fileHeader.numFrames > 65536) {
+		fmt::fprintf(stderr, "ERROR:: Animation %s has more than 65536 frames\n", animation.name.c_str());
+		return false;
+	}
+
+	std::vector<AnimTrackHeader> trackHeaders;
+	std::vector<std::vector<uint16_t>> tracks;
+
+	for (const RawChannel &channel : animation.channels) {
+		const RawNode &node = rawModel.GetNode(channel.nodeIndex);
+
+		// The skeleton bakes the nodes between a joint and its parent joint into the joint, its keys get the same.
+		// Each of translation, rotation and scale only depends on the same path of the joint.
+		NodeTransform offset;
+		if (node.isJoint && GetJointParentOffset(rawModel, channel.nodeIndex, offset)) {
+			std::vector<Quatf> rotations(channel.rotations);
+			std::vector<Vec3f> translations(channel.translations);
+			std::vector<Vec3f> scales(channel.scales);
+			for (Quatf &rotation : rotations) {
+				rotation = offset.rotation * rotation;
+			}
+			for (Vec3f &translation : translations) {
+				NodeTransform transform;
+				transform.translation = translation;
+				translation = ComposeTransform(offset, transform).translation;
+			}
+			for (Vec3f &scale : scales) {
+				scale = Vec3f(offset.scale.x * scale.x, offset.scale.y * scale.y, offset.scale.z * scale.z);
+			}
+			CreateTrack(trackHeaders, tracks, fileHeader, node, ANIM_TRACK_ROTATION,    3, rotations, channel.rotationTimes);
+			CreateTrack(trackHeaders, tracks, fileHeader, node, ANIM_TRACK_TRANSLATION, 3, translations, channel.translationTimes);
+			CreateTrack(trackHeaders, tracks, fileHeader, node, ANIM_TRACK_SCALE,       3, scales, channel.scaleTimes);
+		} else {
+			CreateTrack(trackHeaders, tracks, fileHeader, node, ANIM_TRACK_ROTATION,    3, channel.rotations, channel.rotationTimes);
+			CreateTrack(trackHeaders, tracks, fileHeader, node, ANIM_TRACK_TRANSLATION, 3, channel.translations, channel.translationTimes);
+			CreateTrack(trackHeaders, tracks, fileHeader, node, ANIM_TRACK_SCALE,       3, channel.scales, channel.scaleTimes);
+		}
+		if (channel.weights.empty() == false) {
+			const size_t numKeys = channel.weightTimes.empty() ? fileHeader.numFrames : channel.weightTimes.size();
+			CreateTrack(trackHeaders, tracks, fileHeader, node, ANIM_TRACK_WEIGHTS, (unsigned int)(channel.weights.size() / numKeys), channel.weights, channel.weightTimes);
+		}
+	}
+
+	// Every track starts 4 byte aligned
+	fileHeader.numTracks = (unsigned int)trackHeaders.size();
+	fileHeader.dataOffset = AlignSize(sizeof(fileHeader) + sizeof(AnimTrackHeader) * fileHeader.numTracks, 16);
+
+	for (size_t index = 0; index < trackHeaders.size(); index++) {
+		trackHeaders[index].offset = fileHeader.dataSize;
+		trackHeaders[index].size = (unsigned int)(tracks[index].size() * sizeof(uint16_t));
+		fileHeader.dataSize += AlignSize(trackHeaders[index].size, 4);
+	}
+
+	std::vector<uint8_t> buffer(fileHeader.dataOffset + fileHeader.dataSize, 0);
+	{
+		uint8_t *pBuffer = buffer.data();
+		pBuffer = WriteBuffer(pBuffer, fileHeader);
+		pBuffer = WriteBuffer(pBuffer, trackHeaders);
+
+		for (size_t index = 0; index < tracks.size(); index++) {
+			WriteBuffer(buffer.data() + fileHeader.dataOffset + trackHeaders[index].offset, tracks[index]);
+		}
+	}
+
+	return WriteMeshFile(szFileName, [&](FILE *pFile) {
+		return fwrite(buffer.data(), 1, buffer.size(), pFile) == buffer.size();
+	}, options);
+}
+
+std::string GetAnimationFileName(const char *szPathName, const char *szFName, const RawAnimation &animation)
+{
+	// Take names often carry characters that are not valid in file names
+	std::string name = animation.name;
+	for (char &c : name) {
+		if (strchr("\\/:*?\"<>| ", c) != nullptr) {
+			c = '_';
+		}
+	}
+
+	char szFileName[_MAX_PATH];
+	sprintf(szFileName, "%s%s_%s.anim", szPathName, szFName, name.c_str());
+	return std::string(szFileName);
+}
+
+static int GetAlbedoTexture(const RawMaterial &material)
+{
+	if (material.textures[RAW_TEXTURE_USAGE_ALBEDO] >= 0) {
+		return material.textures[RAW_TEXTURE_USAGE_ALBEDO];
+	}
+	return material.textures[RAW_TEXTURE_USAGE_DIFFUSE];
+}
+
+// Texels of edge extension around every texture in an atlas, keeps the first mips free of bleeding
+#define ATLAS_PADDING 4
+
+struct AtlasRect
+{
+	int texture;
+	int page;
+	int x, y;
+	int width, height;
+};
+
+static int NextPowerOfTwo(int value)
+{
+	int power = 1;
+	while (power < value) {
+		power *= 2;
+	}
+	return power;
+}
+
+// Shelf packs the rects, tallest first, into pages of atlasSize texels; returns the number of pages used
+static int PackAtlasRects(std::vector<AtlasRect> &rects, int firstPage, int atlasSize, std::vector<int> &pageHeights)
+{
+	std::stable_sort(rects.begin(), rects.end(), [](const AtlasRect &a, const AtlasRect &b) {
+		return a.height != b.height ? a.height > b.height : a.width > b.width;
+	});
+
+	int page = firstPage - 1;
+	int shelfX = atlasSize, shelfY = 0, shelfHeight = 0;
+
+	for (AtlasRect &rect : rects) {
+		const int width = rect.width + 2 * ATLAS_PADDING;
+		const int height = rect.height + 2 * ATLAS_PADDING;
+
+		if (shelfX + width > atlasSize) {
+			shelfX = 0;
+			shelfY += shelfHeight;
+			shelfHeight = height;
+		}
+		if (page < firstPage || shelfY + height > atlasSize) {
+			page++;
+			pageHeights.push_back(0);
+			shelfX = 0;
+			shelfY = 0;
+			shelfHeight = height;
+		}
+
+		rect.page = page;
+		rect.x = shelfX + ATLAS_PADDING;
+		rect.y = shelfY + ATLAS_PADDING;
+		shelfX += width;
+		pageHeights[page] = std::max(pageHeights[page], shelfY + height);
+	}
+
+	return page + 1 - firstPage;
+}
+
+int CreateTextureAtlases(RawModel &rawModel, const char *szPathName, const char *szFName, bool flipV, const CrossOptions &options)
+{
+	if (options.atlasMaxTextureSize <= 0 || (rawModel.GetVertexAttributes() & RAW_VERTEX_ATTRIBUTE_UV0) == 0) {
+		return 0;
+	}
+
+	const int atlasLimit = options.atlasSize - 2 * ATLAS_PADDING;
+
+	// Materials whose only texture is a small albedo texture, and whose triangles never wrap it
+	std::vector<char> candidates(rawModel.GetMaterialCount(), 0);
+	for (int index = 0; index < rawModel.GetMaterialCount(); index++) {
+		const RawMaterial &material = rawModel.GetMaterial(index);
+		const int indexTexture = GetAlbedoTexture(material);
+		if (indexTexture < 0) {
+			continue;
+		}
+		const RawTexture &texture = rawModel.GetTexture(indexTexture);
+		if (texture.fileLocation.empty() || std::max(texture.width, texture.height) > std::min(options.atlasMaxTextureSize, atlasLimit)) {
+			continue;
+		}
+		int textureCount = 0;
+		for (int usage = 0; usage < RAW_TEXTURE_USAGE_MAX; usage++) {
+			textureCount += material.textures[usage] >= 0 ? 1 : 0;
+		}
+		candidates[index] = textureCount == 1;
+	}
+
+	const float epsilon = 1.0f / 4096.0f;
+	for (int index = 0; index < rawModel.GetTriangleCount(); index++) {
+		const RawTriangle &triangle = rawModel.GetTriangle(index);
+		if (triangle.materialIndex < 0 || candidates[triangle.materialIndex] == 0) {
+			continue;
+		}
+		for (int vertexIndex : triangle.verts) {
+			const Vec2f &uv = rawModel.GetVertexStreams().GetUv0(vertexIndex);
+			if (uv[0] < -epsilon || uv[0] > 1.0f + epsilon || uv[1] < -epsilon || uv[1] > 1.0f + epsilon) {
+				candidates[triangle.materialIndex] = 0;
+				break;
+			}
+		}
+	}
+
+	std::vector<int> textures;
+	std::vector<int> textureRects(rawModel.GetTextureCount(), -1);
+	for (int index = 0; index < rawModel.GetMaterialCount(); index++) {
+		const int indexTexture = GetAlbedoTexture(rawModel.GetMaterial(index));
+		if (candidates[index] && textureRects[indexTexture] < 0) {
+			textureRects[indexTexture] = (int)textures.size();
+			textures.push_back(indexTexture);
+		}
+	}
+	if (textures.size() < 2) {
+		return 0;
+	}
+
+	std::vector<std::shared_ptr<const ImagePixels>> images(textures.size());
+	ThreadUtils::ParallelFor((int)textures.size(), ThreadUtils::GetJobCount(options.jobs), [&](int index) {
+		images[index] = GetImagePixels(rawModel.GetTexture(textures[index]).fileLocation.c_str());
+	});
+
+	// Opaque and transparent textures get pages of their own, so opaque triangles stay opaque
+	std::vector<AtlasRect> opaqueRects, transparentRects;
+	for (size_t index = 0; index < textures.size(); index++) {
+		if (!images[index]) {
+			continue;
+		}
+		const AtlasRect rect = { (int)index, -1, 0, 0, images[index]->width, images[index]->height };
+		if (rawModel.GetTexture(textures[index]).occlusion == RAW_TEXTURE_OCCLUSION_TRANSPARENT) {
+			transparentRects.push_back(rect);
+		}
+		else {
+			opaqueRects.push_back(rect);
+		}
+	}
+
+	std::vector<int> pageHeights;
+	const int opaquePages = PackAtlasRects(opaqueRects, 0, options.atlasSize, pageHeights);
+	PackAtlasRects(transparentRects, opaquePages, options.atlasSize, pageHeights);
+
+	std::vector<AtlasRect> rects(textures.size(), AtlasRect { -1, -1, 0, 0, 0, 0 });
+	for (const AtlasRect &rect : opaqueRects) {
+		rects[rect.texture] = rect;
+	}
+	for (const AtlasRect &rect : transparentRects) {
+		rects[rect.texture] = rect;
+	}
+
+	// Every page is written as a png, its height trimmed to the power of two its shelves need
+	std::vector<int> pageTextures(pageHeights.size(), -1);
+	for (size_t page = 0; page < pageHeights.size(); page++) {
+		pageHeights[page] = NextPowerOfTwo(pageHeights[page]);
+
+		const int width = options.atlasSize;
+		const int height = pageHeights[page];
+		std::vector<uint8_t> pixels((size_t)width * height * 4, 0);
+
+		for (const AtlasRect &rect : rects) {
+			if (rect.page != (int)page) {
+				continue;
+			}
+			const TextureMipLevel source = ExpandToRGBA(*images[rect.texture]);
+			for (int y = -ATLAS_PADDING; y < rect.height + ATLAS_PADDING; y++) {
+				const int sy = std::min(std::max(y, 0), rect.height - 1);
+				for (int x = -ATLAS_PADDING; x < rect.width + ATLAS_PADDING; x++) {
+					const int sx = std::min(std::max(x, 0), rect.width - 1);
+					memcpy(&pixels[((size_t)(rect.y + y) * width + rect.x + x) * 4], &source.pixels[((size_t)sy * rect.width + sx) * 4], 4);
+				}
+			}
+		}
+
+		char szFileName[_MAX_PATH];
+		sprintf(szFileName, "%s_atlas%d.png", szFName, (int)page);
+		const std::string fileLocation = std::string(szPathName) + szFileName;
+		if (stbi_write_png(fileLocation.c_str(), width, height, 4, pixels.data(), width * 4) == 0) {
+			fmt::printf("Warning: Failed to write texture atlas %s\n", fileLocation);
+			continue;
+		}
+
+		RawTexture texture;
+		texture.name = szFileName;
+		texture.width = width;
+		texture.height = height;
+		texture.mipLevels = (int)ceilf(log2f((float)std::max(width, height)));
+		texture.usage = RAW_TEXTURE_USAGE_ALBEDO;
+		texture.occlusion = (int)page < opaquePages ? RAW_TEXTURE_OCCLUSION_OPAQUE : RAW_TEXTURE_OCCLUSION_TRANSPARENT;
+		texture.fileName = szFileName;
+		texture.fileLocation = fileLocation;
+		pageTextures[page] = rawModel.AddTexture(texture);
+	}
+
+	// Materials that now only differ by name share the name of the first of them, Condense() merges them
+	std::vector<int> materialRemap(rawModel.GetMaterialCount(), -1);
+	std::vector<RawTextureTransform> uvTransforms(rawModel.GetMaterialCount());
+	std::vector<int> atlasMaterials;
+	int atlasedCount = 0;
+
+	for (int index = 0; index < (int)materialRemap.size(); index++) {
+		const RawMaterial material = rawModel.GetMaterial(index);
+		const int indexTexture = GetAlbedoTexture(material);
+		if (candidates[index] == 0 || rects[textureRects[indexTexture]].page < 0 || pageTextures[rects[textureRects[indexTexture]].page] < 0) {
+			continue;
+		}
+		const AtlasRect &rect = rects[textureRects[indexTexture]];
+		const int pageTexture = pageTextures[rect.page];
+
+		int textures[RAW_TEXTURE_USAGE_MAX];
+		for (int usage = 0; usage < RAW_TEXTURE_USAGE_MAX; usage++) {
+			textures[usage] = material.textures[usage] == indexTexture ? pageTexture : material.textures[usage];
+		}
+
+		std::string name = material.name;
+		for (int atlasMaterial : atlasMaterials) {
+			const RawMaterial &other = rawModel.GetMaterial(atlasMaterial);
+			if (other.type == material.type && *other.info == *material.info &&
+				std::equal(std::begin(other.textures), std::end(other.textures), std::begin(textures))) {
+				name = other.name;
+				break;
+			}
+		}
+
+		const int atlasMaterial = rawModel.AddMaterial(name.c_str(), material.type, textures, material.info);
+		if (std::find(atlasMaterials.begin(), atlasMaterials.end(), atlasMaterial) == atlasMaterials.end()) {
+			atlasMaterials.push_back(atlasMaterial);
+		}
+		materialRemap[index] = atlasMaterial;
+
+		const float width = (float)options.atlasSize;
+		const float height = (float)pageHeights[rect.page];
+		RawTextureTransform &transform = uvTransforms[index];
+		transform.m[0][0] = rect.width / width;
+		transform.m[0][2] = rect.x / width;
+		transform.m[1][1] = rect.height / height;
+		transform.m[1][2] = flipV ? rect.y / height : (height - rect.y - rect.height) / height;
+		atlasedCount++;
+	}
+
+	rawModel.RemapMaterials(materialRemap, uvTransforms);
+	rawModel.Condense();
+	return atlasedCount;
+}
+
+// Writers racing on the same name, as batch jobs sharing an output folder do, each write a private temporary file and
+// atomically rename it into place, so the file is always complete.
+static bool WriteFileAtomic(const std::string &fileName, const std::function<bool(const std::string &)> &write)
+{
+	const std::string tempFileName = fileName + ".tmp" + std::to_string(std::random_device()());
+	if (write(tempFileName) == false) {
+		remove(tempFileName.c_str());
+		return false;
+	}
+	if (FileUtils::RenameFile(tempFileName, fileName) == false) {
+		remove(tempFileName.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Files in the library are named by their content, so a file that already exists holds the same content.
+static bool WriteLibraryFile(const std::string &fileName, const std::function<bool(const std::string &)> &write)
+{
+	if (FileUtils::FileExists(fileName)) {
+		return true;
+	}
+	if (FileUtils::CreatePath(fileName.c_str()) == false) {
+		return false;
+	}
+	return WriteFileAtomic(fileName, write) || FileUtils::FileExists(fileName);
+}
+
+bool ExportTextures(const char *szPathName, const RawModel &rawModel, const CrossOptions &options, std::vector<std::string> &textureFileNames)
+{
+	textureFileNames.assign(rawModel.GetTextureCount(), std::string());
+
+	const bool library = options.libraryPath.empty() == false;
+	if (options.textureFormat == TextureFormatOptions::NONE && library == false) {
+		return true;
+	}
+
+	// Only the albedo textures are referenced by the materials, textures sharing a source file are written once.
+	// Without a library every source file gets an output file named after it, a suffix keeps the names of different
+	// source files with the same name apart.
+	std::vector<int> textures;
+	std::vector<int> textureSources(rawModel.GetTextureCount(), -1);
+	std::unordered_map<std::string, int> sourceTextures;
+	std::vector<std::string> textureNames;
+	std::unordered_set<std::string> usedNames;
+	for (int index = 0; index < rawModel.GetMaterialCount(); index++) {
+		const int indexTexture = GetAlbedoTexture(rawModel.GetMaterial(index));
+		if (indexTexture < 0 || rawModel.GetTexture(indexTexture).fileLocation.empty()) {
+			continue;
+		}
+		auto it = sourceTextures.emplace(rawModel.GetTexture(indexTexture).fileLocation, (int)textures.size());
+		if (it.second) {
+			textures.push_back(indexTexture);
+
+			char szFName[_MAX_PATH];
+			splitfilename(rawModel.GetTexture(indexTexture).fileName.c_str(), szFName, NULL);
+			std::string name = szFName;
+			for (int suffix = 1; usedNames.insert(StringUtils::ToLower(name)).second == false; suffix++) {
+				name = std::string(szFName) + "_" + std::to_string(suffix);
+			}
+			textureNames.push_back(name);
+		}
+		textureSources[indexTexture] = it.first->second;
+	}
+
+	std::vector<std::string> outputFileNames(textures.size());
+	ThreadUtils::ParallelFor((int)textures.size(), ThreadUtils::GetJobCount(options.jobs), [&](int index) {
+		ProfileUtils::ScopedTimer timer("exportTexture");
+
+		const RawTexture &texture = rawModel.GetTexture(textures[index]);
+		const bool transparent = texture.occlusion == RAW_TEXTURE_OCCLUSION_TRANSPARENT;
+
+		char szExt[_MAX_PATH];
+		splitfilename(texture.fileName.c_str(), NULL, szExt);
+
+		auto writeTexture = [&](const std::string &fileName) {
+			if (options.textureFormat == TextureFormatOptions::NONE) {
+				return FileUtils::CopyFile(texture.fileLocation, fileName);
+			}
+			const std::shared_ptr<const ImagePixels> image = GetImagePixels(texture.fileLocation.c_str());
+			return image && WriteTextureKTX(fileName.c_str(), CreateMipChain(*image, true), options.textureFormat, true, transparent);
+		};
+
+		if (library == false) {
+			const std::string fileName = textureNames[index] + ".ktx";
+			if (WriteFileAtomic(std::string(szPathName) + fileName, writeTexture)) {
+				outputFileNames[index] = fileName;
+			}
+			return;
+		}
+
+		// The same pixels converted the same way share one library file, whatever the source file was called. The way
+		// covers the format and whether the block compression keeps alpha.
+		uint64_t hash;
+		if (GetImageHash(texture.fileLocation.c_str(), hash) == false) {
+			return;
+		}
+		const uint64_t conversion = ((uint64_t)options.textureFormat << 1) | (transparent ? 1 : 0);
+		const std::string extension = options.textureFormat == TextureFormatOptions::NONE ? StringUtils::ToLower(szExt) : ".ktx";
+		const std::string fileName = options.libraryPath + "/textures/" + HashUtils::ToHexString(HashUtils::HashBytes(&hash, sizeof(hash), conversion)) + extension;
+		if (WriteLibraryFile(fileName, writeTexture)) {
+			outputFileNames[index] = fileName;
+		}
+	});
+
+	// Materials keep referencing the source file of every texture that failed
+	bool success = true;
+	for (size_t index = 0; index < textures.size(); index++) {
+		if (outputFileNames[index].empty()) {
+			fmt::printf("Warning: Failed to export texture %s\n", rawModel.GetTexture(textures[index]).fileLocation);
+			success = false;
+		}
+	}
+	for (int index = 0; index < rawModel.GetTextureCount(); index++) {
+		if (textureSources[index] >= 0) {
+			textureFileNames[index] = outputFileNames[textureSources[index]];
+		}
+	}
+	return success;
+}
+
+static void WriteMaterialXML(XmlWriter &writer, const RawMaterial &material, const RawModel &rawModel, unsigned int format, const std::vector<std::string> &textureFileNames)
+{
+	// Attributes of the vertex format the shader is told about, see CrossVertexFormat for the encodings
+	static const struct { unsigned int format; const char *szName; } formatDefines[] = {
+		{ RAW_VERTEX_ATTRIBUTE_POSITION,        "VERTEX_ATTRIBUTE_POSITION" },
+		{ RAW_VERTEX_ATTRIBUTE_NORMAL,          "VERTEX_ATTRIBUTE_NORMAL" },
+		{ RAW_VERTEX_ATTRIBUTE_BINORMAL,        "VERTEX_ATTRIBUTE_BINORMAL" },
+		{ RAW_VERTEX_ATTRIBUTE_COLOR,           "VERTEX_ATTRIBUTE_COLOR" },
+		{ RAW_VERTEX_ATTRIBUTE_UV0,             "VERTEX_ATTRIBUTE_TEXCOORD0" },
+		{ RAW_VERTEX_ATTRIBUTE_UV1,             "VERTEX_ATTRIBUTE_TEXCOORD1" },
+		{ RAW_VERTEX_ATTRIBUTE_JOINT_INDICES,   "VERTEX_ATTRIBUTE_INDICES" },
+		{ RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS,   "VERTEX_ATTRIBUTE_WEIGHTS" },
+		{ CROSS_VERTEX_FORMAT_POSITION_SNORM16, "VERTEX_FORMAT_POSITION_SNORM16" },
+		{ CROSS_VERTEX_FORMAT_POSITION_UNORM16, "VERTEX_FORMAT_POSITION_UNORM16" },
+		{ CROSS_VERTEX_FORMAT_TEXCOORD_HALF,    "VERTEX_FORMAT_TEXCOORD_HALF" },
+		{ CROSS_VERTEX_FORMAT_TEXCOORD_UNORM16, "VERTEX_FORMAT_TEXCOORD_UNORM16" },
+		{ CROSS_VERTEX_FORMAT_NORMAL_SNORM10,   "VERTEX_FORMAT_NORMAL_SNORM10" },
+		{ CROSS_VERTEX_FORMAT_NORMAL_OCT8,      "VERTEX_FORMAT_NORMAL_OCT8" },
+		{ CROSS_VERTEX_FORMAT_NORMAL_OCT16,     "VERTEX_FORMAT_NORMAL_OCT16" },
+		{ CROSS_VERTEX_FORMAT_QTANGENT,         "VERTEX_FORMAT_QTANGENT" },
+		{ CROSS_VERTEX_FORMAT_POSITION_STREAM,  "VERTEX_FORMAT_POSITION_STREAM" },
+	};
+
+	writer.BeginElement("Material");
+	{
+		writer.BeginElement("Pass");
+		{
+			writer.Attribute("name", "Default");
+
+			writer.BeginElement("Pipeline");
+			{
+				writer.Attribute("render_pass", "Default");
+
+				writer.BeginElement("Vertex");
+				{
+					writer.Attribute("file_name", "Default.glsl");
+
+					for (const auto &formatDefine : formatDefines) {
+						if (format & formatDefine.format) {
+							writer.BeginElement("Define");
+							writer.Attribute("name", formatDefine.szName);
+							writer.EndElement();
+						}
+					}
+
+					writer.BeginElement("Define");
+					writer.Attribute("name", "INSTANCE_ATTRIBUTE_TRANSFORM");
+					writer.EndElement();
+				}
+				writer.EndElement();
+
+				writer.BeginElement("Fragment");
+				{
+					writer.Attribute("file_name", "Default.glsl");
+				}
+				writer.EndElement();
+			}
+			writer.EndElement();
+
+			const int indexTexture = GetAlbedoTexture(material);
+			if (indexTexture >= 0) {
+				writer.BeginElement("Texture2D");
+				{
+					char szExt[_MAX_PATH];
+					char szFName[_MAX_PATH];
+					char szFileName[_MAX_PATH];
+
+					splitfilename(rawModel.GetTexture(indexTexture).fileName.c_str(), szFName, szExt);
+					sprintf(szFileName, "%s%s", szFName, szExt);
+
+					// Converted textures carry their mip chain, so they are sampled trilinearly
+					const bool exported = textureFileNames.empty() == false && textureFileNames[indexTexture].empty() == false;
+					const bool converted = exported && StringUtils::ToLower(textureFileNames[indexTexture]).rfind(".ktx") == textureFileNames[indexTexture].size() - 4;
+
+					writer.Attribute("name", "texAlbedo");
+					writer.Attribute("file_name", exported ? textureFileNames[indexTexture].c_str() : szFileName);
+					writer.Attribute("min_filter", converted ? "GFX_LINEAR" : "GFX_NEAREST");
+					writer.Attribute("mag_filter", "GFX_LINEAR");
+					writer.Attribute("mipmap_mode", converted ? "GFX_LINEAR" : "GFX_NEAREST");
+					writer.Attribute("address_mode", "GFX_CLAMP_TO_EDGE");
+				}
+				writer.EndElement();
+			}
+		}
+		writer.EndElement();
+	}
+	writer.EndElement();
+}
+
+bool ExportMaterial(const char *szPathName, const RawModel &rawModel, const std::vector<unsigned int> &materialFormats, const std::vector<std::string> &textureFileNames, const CrossOptions &options, std::vector<std::string> &materialFileNames)
+{
+	materialFileNames.assign(rawModel.GetMaterialCount(), std::string());
+
+	bool success = true;
+	for (int index = 0; index < rawModel.GetMaterialCount(); index++) {
+		std::string text;
+		{
+			XmlWriter writer(&text);
+			WriteMaterialXML(writer, rawModel.GetMaterial(index), rawModel, materialFormats[index], textureFileNames);
+		}
+
+		// The material name is not part of the document, so with a library equal materials of any model share one file
+		const std::string fileName = options.libraryPath.empty() ?
+			GetMaterialFileName(szPathName, rawModel.GetMaterial(index)) :
+			options.libraryPath + "/materials/" + HashUtils::ToHexString(HashUtils::HashString(text)) + ".material";
+
+		auto writeMaterial = [&](const std::string &materialFileName) {
+			FILE *pFile = fopen(materialFileName.c_str(), "wb");
+			if (pFile == nullptr) {
+				return false;
+			}
+			const bool complete = fwrite(text.data(), 1, text.size(), pFile) == text.size();
+			return fclose(pFile) == 0 && complete;
+		};
+
+		if (options.libraryPath.empty()) {
+			materialFileNames[index] = GetMaterialFileName("", rawModel.GetMaterial(index));
+			success = WriteFileAtomic(fileName, writeMaterial) && success;
+			continue;
+		}
+
+		if (WriteLibraryFile(fileName, writeMaterial) == false) {
+			fmt::printf("Warning: Failed to write material %s\n", fileName);
+			success = false;
+		}
+		materialFileNames[index] = fileName;
+	}
+	return success;
+}
+
+static bool IsNameLODGroup(const char* szName)
+{
+	const char* szCheckName = "_LODGroup";
+	return strstr(szName, szCheckName) != nullptr;
+}
+
+static bool IsNodeLODGrpup(const RawNode &node, const RawModel &rawModel)
+{
+	// - XXX_LODGroup
+	//  |---XXX_LOD0
+	//  |   |---Mesh
+	//  |---XXX_LOD1
+	//  |   |---Mesh
+	//  |---XXX_LOD2
+	//      |--Mesh
+
+	if (IsNameLODGroup(node.name.c_str()) == false) {
+		return false;
+	}
+
+	if (node.childIds.empty() == true) {
+		return false;
+	}
+
+	for (int indexChild = 0; indexChild < node.childIds.size(); indexChild++) {
+		const RawNode &childNode = rawModel.GetNode(rawModel.GetNodeById(node.childIds[indexChild]));
+
+		if (childNode.childIds.empty() == false) {
+			return false;
+		}
+
+		if (fabs(childNode.scale.x - 1.0f) > 0.0001f ||
+			fabs(childNode.scale.y - 1.0f) > 0.0001f ||
+			fabs(childNode.scale.z - 1.0f) > 0.0001f) {
+			return false;
+		}
+
+		if (fabs(childNode.translation.x - 0.0f) > 0.0001f ||
+			fabs(childNode.translation.y - 0.0f) > 0.0001f ||
+			fabs(childNode.translation.z - 0.0f) > 0.0001f) {
+			return false;
+		}
+
+		if (fabs(childNode.rotation[0] - 1.0f) > 0.0001f ||
+			fabs(childNode.rotation[1] - 0.0f) > 0.0001f ||
+			fabs(childNode.rotation[2] - 0.0f) > 0.0001f ||
+			fabs(childNode.rotation[3] - 0.0f) > 0.0001f) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static int GetLODIndex(const char* szName)
+{
+	const char* szCheckNames[8] = { "_LOD0", "_LOD1", "_LOD2", "_LOD3", "_LOD4", "_LOD5", "_LOD6", "_LOD7" };
+
+	for (int indexLOD = 0; indexLOD < 8; indexLOD++) {
+		if (strstr(szName, szCheckNames[indexLOD]) != nullptr) {
+			return indexLOD;
+		}
+	}
+
+	return -1;
+}
+
+// Transform from the space of the node to the space of its parent
+static Mat4f GetNodeLocalTransform(const RawNode &node)
+{
+	return Mat4f::FromTranslationVector(node.translation) * node.rotation.ToMatrix4() * Mat4f::FromScaleVector(node.scale);
+}
+
+int CreateStaticBatches(RawModel &rawModel, const CrossOptions &options)
+{
+	const int numNodes = rawModel.GetNodeCount();
+	const int rootIndex = rawModel.GetNodeById(rawModel.GetRootNode());
+	if (rootIndex < 0) {
+		return 0;
+	}
+
+	// Parents before children, so transforms and animation can be passed down in one pass
+	std::vector<int> order;
+	std::vector<int> parents(numNodes, -1);
+	order.push_back(rootIndex);
+	for (size_t index = 0; index < order.size(); index++) {
+		const RawNode &node = rawModel.GetNode(order[index]);
+		for (const long childId : node.childIds) {
+			const int childIndex = rawModel.GetNodeById(childId);
+			if (childIndex >= 0) {
+				parents[childIndex] = order[index];
+				order.push_back(childIndex);
+			}
+		}
+	}
+
+	// Animated nodes and joints move everything below them, and like cameras keep their place in the hierarchy
+	std::vector<bool> pinned(numNodes, false);
+	for (int indexAnimation = 0; indexAnimation < rawModel.GetAnimationCount(); indexAnimation++) {
+		for (const RawChannel &channel : rawModel.GetAnimation(indexAnimation).channels) {
+			pinned[channel.nodeIndex] = true;
+		}
+	}
+
+	std::vector<bool> dynamic(numNodes, false);
+	std::vector<Mat4f> transforms(numNodes, Mat4f::Identity());
+	for (const int nodeIndex : order) {
+		const RawNode &node = rawModel.GetNode(nodeIndex);
+		const int parentIndex = parents[nodeIndex];
+		pinned[nodeIndex] = pinned[nodeIndex] || node.isJoint;
+		dynamic[nodeIndex] = pinned[nodeIndex] || (parentIndex >= 0 && dynamic[parentIndex]);
+		if (parentIndex >= 0) {
+			transforms[nodeIndex] = transforms[parentIndex] * GetNodeLocalTransform(node);
+		}
+	}
+
+	for (int indexCamera = 0; indexCamera < rawModel.GetCameraCount(); indexCamera++) {
+		const int nodeIndex = rawModel.GetNodeById(rawModel.GetCamera(indexCamera).nodeId);
+		if (nodeIndex >= 0) {
+			pinned[nodeIndex] = true;
+		}
+	}
+
+	// Upper bound of the vertices of every surface, a vertex shared by two surfaces counts for both
+	std::vector<int> surfaceVertexCounts(rawModel.GetSurfaceCount(), 0);
+	{
+		std::vector<int> lastSurfaces(rawModel.GetVertexCount(), -1);
+		for (int indexTriangle = 0; indexTriangle < rawModel.GetTriangleCount(); indexTriangle++) {
+			const RawTriangle &triangle = rawModel.GetTriangle(indexTriangle);
+			for (int j = 0; j < 3; j++) {
+				if (triangle.surfaceIndex >= 0 && lastSurfaces[triangle.verts[j]] != triangle.surfaceIndex) {
+					lastSurfaces[triangle.verts[j]] = triangle.surfaceIndex;
+					surfaceVertexCounts[triangle.surfaceIndex]++;
+				}
+			}
+		}
+	}
+
+	// Static nodes are grouped by the cell of the batch grid their surface center falls in
+	std::map<std::tuple<int, int, int>, std::vector<int>> cells;
+	std::vector<int> surfaceNodeCounts(rawModel.GetSurfaceCount(), 0);
+
+	for (const int nodeIndex : order) {
+		const RawNode &node = rawModel.GetNode(nodeIndex);
+		const int surfaceIndex = node.surfaceId != 0 ? rawModel.GetSurfaceById(node.surfaceId) : -1;
+		if (surfaceIndex < 0) {
+			continue;
+		}
+		surfaceNodeCounts[surfaceIndex]++;
+
+		const RawSurface &surface = rawModel.GetSurface(surfaceIndex);
+		const int parentIndex = parents[nodeIndex];
+		if (dynamic[nodeIndex] || surface.jointIds.empty() == false || surface.blendChannels.empty() == false ||
+			surfaceVertexCounts[surfaceIndex] == 0 || surfaceVertexCounts[surfaceIndex] > options.batchMaxVertices ||
+			IsNodeLODGrpup(node, rawModel) || (parentIndex >= 0 && IsNodeLODGrpup(rawModel.GetNode(parentIndex), rawModel))) {
+			continue;
+		}
+
+		int cell[3] = { 0, 0, 0 };
+		if (options.batchMaxExtent > 0.0f && surface.bounds.initialized) {
+			const Vec3f center = (surface.bounds.min + surface.bounds.max) * 0.5f;
+			const Mat4f &m = transforms[nodeIndex];
+			for (int axis = 0; axis < 3; axis++) {
+				const float value = m(axis, 0) * center[0] + m(axis, 1) * center[1] + m(axis, 2) * center[2] + m(axis, 3);
+				cell[axis] = (int)floorf(value / options.batchMaxExtent);
+			}
+		}
+		cells[std::make_tuple(cell[0], cell[1], cell[2])].push_back(nodeIndex);
+	}
+
+	// Every node id and surface id is unique, so the batches count up from the largest
+	long nextId = 0;
+	for (int indexNode = 0; indexNode < numNodes; indexNode++) {
+		nextId = std::max(nextId, rawModel.GetNode(indexNode).id);
+	}
+	for (int indexSurface = 0; indexSurface < rawModel.GetSurfaceCount(); indexSurface++) {
+		nextId = std::max(nextId, rawModel.GetSurface(indexSurface).id);
+	}
+
+	std::vector<RawSurfaceInstance> instances;
+	std::vector<int> batchedNodes;
+	int numBatches = 0;
+
+	auto createBatch = [&](const std::vector<int> &nodeIndices) {
+		// A batch of one saves no draw
+		if (nodeIndices.size() < 2) {
+			return;
+		}
+
+		const std::string name = "StaticBatch" + std::to_string(numBatches++);
+
+		RawSurface surface;
+		surface.id = ++nextId;
+		surface.name = name;
+		surface.skeletonRootId = ++nextId;
+		surface.bounds.Clear();
+		surface.discrete = false;
+		const int surfaceIndex = rawModel.AddSurface(surface);
+
+		RawNode batchNode;
+		batchNode.isJoint = false;
+		batchNode.id = surface.skeletonRootId;
+		batchNode.name = name;
+		batchNode.parentId = rawModel.GetRootNode();
+		batchNode.translation = Vec3f(0.0f, 0.0f, 0.0f);
+		batchNode.rotation = Quatf(1.0f, 0.0f, 0.0f, 0.0f);
+		batchNode.scale = Vec3f(1.0f, 1.0f, 1.0f);
+		batchNode.surfaceId = surface.id;
+		rawModel.AddNode(batchNode);
+		rawModel.GetNode(rawModel.GetNodeById(rawModel.GetRootNode())).childIds.push_back(batchNode.id);
+
+		for (const int nodeIndex : nodeIndices) {
+			instances.push_back(RawSurfaceInstance { rawModel.GetSurfaceById(rawModel.GetNode(nodeIndex).surfaceId), surfaceIndex, transforms[nodeIndex] });
+			batchedNodes.push_back(nodeIndex);
+		}
+	};
+
+	for (const auto &cell : cells) {
+		std::vector<int> batch;
+		int batchVertexCount = 0;
+
+		for (const int nodeIndex : cell.second) {
+			const int vertexCount = surfaceVertexCounts[rawModel.GetSurfaceById(rawModel.GetNode(nodeIndex).surfaceId)];
+			if (batchVertexCount + vertexCount > options.batchMaxVertices) {
+				createBatch(batch);
+				batch.clear();
+				batchVertexCount = 0;
+			}
+			batch.push_back(nodeIndex);
+			batchVertexCount += vertexCount;
+		}
+		createBatch(batch);
+	}
+
+	if (batchedNodes.empty()) {
+		return 0;
+	}
+
+	// The surfaces only batched nodes draw lose their own triangles
+	std::vector<bool> removeSurfaces(rawModel.GetSurfaceCount(), false);
+	std::vector<int> batchedSurfaceCounts(rawModel.GetSurfaceCount(), 0);
+	for (const RawSurfaceInstance &instance : instances) {
+		batchedSurfaceCounts[instance.surfaceIndex]++;
+	}
+	for (int indexSurface = 0; indexSurface < (int)surfaceNodeCounts.size(); indexSurface++) {
+		removeSurfaces[indexSurface] = batchedSurfaceCounts[indexSurface] > 0 && batchedSurfaceCounts[indexSurface] == surfaceNodeCounts[indexSurface];
+	}
+
+	rawModel.BakeSurfaces(instances, removeSurfaces);
+
+	// Collapse the hierarchy: a node left without a surface and without children is dropped, which may in turn leave
+	// its parent empty. Only nodes emptied by batching go, empty nodes of the source scene stay.
+	std::vector<bool> removeNodes(rawModel.GetNodeCount(), false);
+	std::vector<bool> emptied(rawModel.GetNodeCount(), false);
+	for (const int nodeIndex : batchedNodes) {
+		rawModel.GetNode(nodeIndex).surfaceId = 0;
+		emptied[nodeIndex] = true;
+	}
+	for (auto it = order.rbegin(); it != order.rend(); ++it) {
+		const RawNode &node = rawModel.GetNode(*it);
+		if (*it == rootIndex || pinned[*it] || node.surfaceId != 0 || emptied[*it] == false) {
+			continue;
+		}
+		bool childrenRemoved = true;
+		for (const long childId : node.childIds) {
+			const int childIndex = rawModel.GetNodeById(childId);
+			childrenRemoved = childrenRemoved && childIndex >= 0 && removeNodes[childIndex];
+		}
+		if (childrenRemoved) {
+			removeNodes[*it] = true;
+			if (parents[*it] >= 0) {
+				emptied[parents[*it]] = true;
+			}
+		}
+	}
+	rawModel.RemoveNodes(removeNodes);
+
+	return (int)batchedNodes.size();
+}
+
+// Tight enough that a transform taken for the identity and dropped moves nothing by more than float precision; the
+// scalar of a quaternion alone is not, 1 - |w| <= 0.0001 still allows rotations of about 1.6 degrees
+#define IDENTITY_TOLERANCE 0.000001f
+
+static bool IsRotationIdentity(const Quatf &rotation)
+{
+	return rotation.vector().LengthSquared() <= IDENTITY_TOLERANCE * IDENTITY_TOLERANCE;
+}
+
+static bool IsNodeTransformIdentity(const RawNode &node)
+{
+	return
+		fabs(node.translation.x) <= IDENTITY_TOLERANCE && fabs(node.translation.y) <= IDENTITY_TOLERANCE && fabs(node.translation.z) <= IDENTITY_TOLERANCE &&
+		fabs(node.scale.x - 1.0f) <= IDENTITY_TOLERANCE && fabs(node.scale.y - 1.0f) <= IDENTITY_TOLERANCE && fabs(node.scale.z - 1.0f) <= IDENTITY_TOLERANCE &&
+		IsRotationIdentity(node.rotation);
+}
+
+int FlattenHierarchy(RawModel &rawModel, const CrossOptions &options)
+{
+	const int numNodes = rawModel.GetNodeCount();
+	const int rootIndex = rawModel.GetNodeById(rawModel.GetRootNode());
+	if (rootIndex < 0) {
+		return 0;
+	}
+
+	// Parents before children, so a node folded into its children is already in its final place
+	std::vector<int> order;
+	std::vector<int> parents(numNodes, -1);
+	order.push_back(rootIndex);
+	for (size_t index = 0; index < order.size(); index++) {
+		for (const long childId : rawModel.GetNode(order[index]).childIds) {
+			const int childIndex = rawModel.GetNodeById(childId);
+			if (childIndex >= 0) {
+				parents[childIndex] = order[index];
+				order.push_back(childIndex);
+			}
+		}
+	}
+
+	// Animated nodes and joints have transforms of their own the runtime updates, cameras, skeleton roots, LOD nodes
+	// and the nodes of the keep-list are looked up by the runtime; all of them stay
+	std::vector<bool> pinned(numNodes, false);
+	std::vector<bool> kept(numNodes, false);
+	for (int indexAnimation = 0; indexAnimation < rawModel.GetAnimationCount(); indexAnimation++) {
+		for (const RawChannel &channel : rawModel.GetAnimation(indexAnimation).channels) {
+			pinned[channel.nodeIndex] = true;
+		}
+	}
+	for (int indexCamera = 0; indexCamera < rawModel.GetCameraCount(); indexCamera++) {
+		const int nodeIndex = rawModel.GetNodeById(rawModel.GetCamera(indexCamera).nodeId);
+		if (nodeIndex >= 0) {
+			kept[nodeIndex] = true;
+		}
+	}
+	for (int indexSurface = 0; indexSurface < rawModel.GetSurfaceCount(); indexSurface++) {
+		const int nodeIndex = rawModel.GetNodeById(rawModel.GetSurface(indexSurface).skeletonRootId);
+		if (nodeIndex >= 0) {
+			kept[nodeIndex] = true;
+		}
+	}
+	for (int indexNode = 0; indexNode < numNodes; indexNode++) {
+		const RawNode &node = rawModel.GetNode(indexNode);
+		pinned[indexNode] = pinned[indexNode] || node.isJoint;
+		kept[indexNode] = kept[indexNode] || pinned[indexNode] || indexNode == rootIndex || node.surfaceId != 0 ||
+			node.childIds.empty() || GetLODIndex(node.name.c_str()) >= 0 || IsNodeLODGrpup(node, rawModel) ||
+			std::find(options.flattenKeepNodes.begin(), options.flattenKeepNodes.end(), node.name) != options.flattenKeepNodes.end();
+	}
+
+	std::vector<bool> removeNodes(numNodes, false);
+	int removedCount = 0;
+
+	for (const int nodeIndex : order) {
+		if (kept[nodeIndex]) {
+			continue;
+		}
+
+		// The transform of the node moves into its children, which only stays a translation, rotation and scale while
+		// the scale is uniform or the child isn't rotated. Pinned children keep the transforms they have, so only
+		// an identity node moves above them.
+		const RawNode &node = rawModel.GetNode(nodeIndex);
+		const bool identity = IsNodeTransformIdentity(node);
+		const bool uniformScale = fabs(node.scale.x - node.scale.y) <= 0.0001f * fabs(node.scale.x) && fabs(node.scale.x - node.scale.z) <= 0.0001f * fabs(node.scale.x);
+		bool foldable = true;
+		for (const long childId : node.childIds) {
+			const int childIndex = rawModel.GetNodeById(childId);
+			foldable = foldable && childIndex >= 0 && (identity || (pinned[childIndex] == false && (uniformScale || IsRotationIdentity(rawModel.GetNode(childIndex).rotation))));
+		}
+		if (foldable == false) {
+			continue;
+		}
+
+		const RawNode parent = node;
+		RawNode &grandParent = rawModel.GetNode(parents[nodeIndex]);
+		for (const long childId : parent.childIds) {
+			const int childIndex = rawModel.GetNodeById(childId);
+			RawNode &child = rawModel.GetNode(childIndex);
+			if (pinned[childIndex] == false) {
+				const NodeTransform transform = ComposeTransform(GetNodeTransform(parent), GetNodeTransform(child));
+				child.translation = transform.translation;
+				child.rotation = transform.rotation;
+				child.scale = transform.scale;
+			}
+			child.parentId = grandParent.id;
+			parents[childIndex] = parents[nodeIndex];
+		}
+
+		// The children take the place of the node among the children of its parent
+		auto it = std::find(grandParent.childIds.begin(), grandParent.childIds.end(), parent.id);
+		it = grandParent.childIds.erase(it);
+		grandParent.childIds.insert(it, parent.childIds.begin(), parent.childIds.end());
+
+		rawModel.GetNode(nodeIndex).childIds.clear();
+		removeNodes[nodeIndex] = true;
+		removedCount++;
+	}
+
+	if (removedCount > 0) {
+		rawModel.RemoveNodes(removeNodes);
+	}
+	return removedCount;
+}
+
+// .scene layout:
+//   SceneFileHeader, SceneNode[numNodes], SceneDraw[numDraws], SceneAnimation[numAnimations],
+//   SceneInstanceGroup[numInstanceGroups], SceneInstance[numInstances], strings
+//   The same scene as the mesh XML, flattened so the runtime reads it in one go without parsing
+//   text. Nodes are in depth first order, parents before their children; a node draws the
+//   SceneNode::numDraws draws from firstDraw. Names are byte offsets into the string table, which
+//   holds every distinct string once, zero terminated; offset 0 is the empty string. Every
+//   section starts at the offset the header gives for it, relative to the start of the file.
+//   The instance sections are only filled with CrossOptions::instancing. The static draws, those
+//   of nodes nothing moves and not skinned or morphed, of the same submesh and material then
+//   become one instance group, drawn once per SceneInstance from firstInstance, and no longer
+//   appear among the draws of their nodes.
+//   The BVH covers the static draws and every instance, with their submesh bounds in the space
+//   of the root node; draws of animated nodes and joints, and skinned or morphed draws, are left
+//   to the runtime. Its nodes are in depth first order, an inner node is followed by its left
+//   child and SceneBVHNode::first is its right child. A leaf holds the count primitives from
+//   first, each with its bounds.
+
+#define SCENE_FILE_MAGIC   0x4E435343 // 'CSCN'
+#define SCENE_FILE_VERSION 3
+
+typedef struct SceneFileHeader
+{
+	unsigned int magic = SCENE_FILE_MAGIC;
+	unsigned int version = SCENE_FILE_VERSION;
+	unsigned int mesh = 0;
+
+	unsigned int numNodes = 0;
+	unsigned int nodesOffset = 0;
+	unsigned int numDraws = 0;
+	unsigned int drawsOffset = 0;
+	unsigned int numAnimations = 0;
+	unsigned int animationsOffset = 0;
+	unsigned int numInstanceGroups = 0;
+	unsigned int instanceGroupsOffset = 0;
+	unsigned int numInstances = 0;
+	unsigned int instancesOffset = 0;
+	unsigned int numBVHNodes = 0;
+	unsigned int bvhNodesOffset = 0;
+	unsigned int numBVHPrimitives = 0;
+	unsigned int bvhPrimitivesOffset = 0;
+	unsigned int stringsSize = 0;
+	unsigned int stringsOffset = 0;
+
+} SceneFileHeader;
+
+typedef struct SceneNode
+{
+	// parent is the index of the parent node, or -1; rotation is x, y, z, w
+	int parent = -1;
+	unsigned int name = 0;
+	unsigned int firstDraw = 0;
+	unsigned int numDraws = 0;
+	float translation[3];
+	float rotation[4];
+	float scale[3];
+
+} SceneNode;
+
+typedef struct SceneDraw
+{
+	// subMesh indexes the submeshes of the .mesh, lod is -1 for draws outside LOD groups
+	unsigned int subMesh = 0;
+	unsigned int name = 0;
+	unsigned int material = 0;
+	int lod = -1;
+	unsigned int mask = 0xFFFFFFFF;
+
+} SceneDraw;
+
+typedef struct SceneAnimation
+{
+	unsigned int name = 0;
+	unsigned int anim = 0;
+
+} SceneAnimation;
+
+typedef struct SceneInstanceGroup
+{
+	// The fields of SceneDraw, firstInstance counts SceneInstance records
+	unsigned int subMesh = 0;
+	unsigned int name = 0;
+	unsigned int material = 0;
+	int lod = -1;
+	unsigned int mask = 0xFFFFFFFF;
+	unsigned int firstInstance = 0;
+	unsigned int numInstances = 0;
+
+} SceneInstanceGroup;
+
+typedef struct SceneInstance
+{
+	// Row major 3x4 transform relative to the root node
+	float transform[12];
+
+} SceneInstance;
+
+enum SceneBVHPrimitiveType
+{
+	SCENE_BVH_PRIMITIVE_DRAW     = 0, // index is a SceneDraw
+	SCENE_BVH_PRIMITIVE_INSTANCE = 1, // index is a SceneInstance
+};
+
+typedef struct SceneBVHNode
+{
+	// count is zero for inner nodes
+	float min[3];
+	float max[3];
+	unsigned int first = 0;
+	unsigned int count = 0;
+
+} SceneBVHNode;
+
+typedef struct SceneBVHPrimitive
+{
+	float min[3];
+	float max[3];
+	unsigned int type = SCENE_BVH_PRIMITIVE_DRAW;
+	unsigned int index = 0;
+
+} SceneBVHPrimitive;
+
+// The scene both the mesh XML and the .scene are written from
+typedef struct SceneGraph
+{
+	SceneFileHeader header;
+	std::vector<SceneNode> nodes;
+	std::vector<SceneDraw> draws;
+	std::vector<SceneAnimation> animations;
+	std::vector<SceneInstanceGroup> instanceGroups;
+	std::vector<SceneInstance> instances;
+	std::vector<SceneBVHNode> bvhNodes;
+	std::vector<SceneBVHPrimitive> bvhPrimitives;
+	std::vector<char> strings;
+	std::unordered_map<std::string, unsigned int> stringOffsets;
+
+	// Per node, only while the scene is built: the transform relative to the root, whether anything moves it and
+	// whether its draws move, which skinned and morphed draws do wherever their node is
+	std::vector<Mat4f> nodeTransforms;
+	std::vector<bool> nodeMoving;
+	std::vector<bool> nodeDynamic;
+
+	unsigned int AddString(const std::string &string)
+	{
+		auto it = stringOffsets.find(string);
+		if (it != stringOffsets.end()) {
+			return it->second;
+		}
+		const unsigned int offset = (unsigned int)strings.size();
+		strings.insert(strings.end(), string.c_str(), string.c_str() + string.size() + 1);
+		stringOffsets.emplace(string, offset);
+		return offset;
+	}
+
+	const char *GetString(unsigned int offset) const
+	{
+		return strings.data() + offset;
+	}
+
+} SceneGraph;
+
+static void AddNodeDraws(SceneGraph &scene, const RawNode &node, const RawModel &rawModel, std::unordered_map<long, std::vector<long>> &surfaceMeshs, std::unordered_map<long, std::vector<long>> &surfaceLODMeshs, const std::vector<std::string> &meshMaterials, const std::vector<int> &materialModelLODs, int lod = -1)
+{
+	if (node.surfaceId != 0) {
+		const unsigned int name = scene.AddString(rawModel.GetSurface(rawModel.GetSurfaceById(node.surfaceId)).name);
+		const std::vector<long> &lodMeshs = surfaceLODMeshs[node.surfaceId];
+
+		auto addDraw = [&](long indexMesh, int drawLOD) {
+			SceneDraw draw;
+			draw.subMesh = (unsigned int)indexMesh;
+			draw.name = name;
+			draw.material = scene.AddString(meshMaterials[indexMesh]);
+			draw.lod = drawLOD;
+			scene.draws.push_back(draw);
+			scene.nodes.back().numDraws++;
+		};
+
+		// Every node of a shared surface draws the same submeshes, one per material of the surface
+		for (long indexMesh : surfaceMeshs[node.surfaceId]) {
+			addDraw(indexMesh, (lod < 0 && lodMeshs.empty() == false) ? 0 : lod);
+		}
+
+		// Generated LODs only stand in for authored ones
+		if (lod < 0) {
+			for (long indexMesh : lodMeshs) {
+				addDraw(indexMesh, materialModelLODs[indexMesh]);
+			}
+		}
+	}
+}
+
+// Skinned and morphed surfaces move their vertices at runtime
+static bool IsSurfaceDeformed(const long surfaceId, const RawModel &rawModel)
+{
+	const int surfaceIndex = surfaceId != 0 ? rawModel.GetSurfaceById(surfaceId) : -1;
+	return surfaceIndex >= 0 && (rawModel.GetSurface(surfaceIndex).jointIds.empty() == false || rawModel.GetSurface(surfaceIndex).blendChannels.empty() == false);
+}
+
+static void AddNodes(SceneGraph &scene, const long rootId, const RawModel &rawModel, std::unordered_map<long, std::vector<long>> &surfaceMeshs, std::unordered_map<long, std::vector<long>> &surfaceLODMeshs, const std::vector<std::string> &meshMaterials, const std::vector<int> &materialModelLODs, const std::vector<bool> &animatedNodes)
+{
+	// Depth first with an explicit stack, so deep hierarchies don't exhaust the call stack
+	struct NodeFrame
+	{
+		const RawNode *node;
+		int index;
+		size_t nextChild;
+	};
+	std::vector<NodeFrame> stack;
+
+	auto addNode = [&](const long id, int parent) {
+		const int nodeIndex = rawModel.GetNodeById(id);
+		const RawNode &node = rawModel.GetNode(nodeIndex);
+
+		SceneNode sceneNode;
+		sceneNode.parent = parent;
+		sceneNode.name = scene.AddString(node.name);
+		sceneNode.firstDraw = (unsigned int)scene.draws.size();
+		sceneNode.translation[0] = node.translation.x;
+		sceneNode.translation[1] = node.translation.y;
+		sceneNode.translation[2] = node.translation.z;
+		sceneNode.rotation[0] = node.rotation[1];
+		sceneNode.rotation[1] = node.rotation[2];
+		sceneNode.rotation[2] = node.rotation[3];
+		sceneNode.rotation[3] = node.rotation[0];
+		sceneNode.scale[0] = node.scale.x;
+		sceneNode.scale[1] = node.scale.y;
+		sceneNode.scale[2] = node.scale.z;
+		scene.nodes.push_back(sceneNode);
+		scene.nodeTransforms.push_back(parent >= 0 ? scene.nodeTransforms[parent] * GetNodeLocalTransform(node) : Mat4f::Identity());
+		scene.nodeMoving.push_back(animatedNodes[nodeIndex] || node.isJoint || (parent >= 0 && scene.nodeMoving[parent]));
+
+		// A LOD group draws the surfaces of its children too
+		bool deformed = IsSurfaceDeformed(node.surfaceId, rawModel);
+		if (IsNodeLODGrpup(node, rawModel)) {
+			for (const long childId : node.childIds) {
+				deformed = deformed || IsSurfaceDeformed(rawModel.GetNode(rawModel.GetNodeById(childId)).surfaceId, rawModel);
+			}
+		}
+		scene.nodeDynamic.push_back(scene.nodeMoving.back() || deformed);
+
+		const int index = (int)scene.nodes.size() - 1;
+		AddNodeDraws(scene, node, rawModel, surfaceMeshs, surfaceLODMeshs, meshMaterials, materialModelLODs);
+
+		// The children of a LOD group are drawn by the group itself
+		if (IsNodeLODGrpup(node, rawModel)) {
+			for (int indexChild = 0; indexChild < node.childIds.size(); indexChild++) {
+				const RawNode &childNode = rawModel.GetNode(rawModel.GetNodeById(node.childIds[indexChild]));
+				AddNodeDraws(scene, childNode, rawModel, surfaceMeshs, surfaceLODMeshs, meshMaterials, materialModelLODs, GetLODIndex(childNode.name.c_str()));
+			}
+			stack.push_back(NodeFrame { &node, index, node.childIds.size() });
+		}
+		else {
+			stack.push_back(NodeFrame { &node, index, 0 });
+		}
+	};
+
+	addNode(rootId, -1);
+	while (stack.empty() == false) {
+		NodeFrame &frame = stack.back();
+		if (frame.nextChild < frame.node->childIds.size()) {
+			const long childId = frame.node->childIds[frame.nextChild++];
+			addNode(childId, frame.index);
+		}
+		else {
+			stack.pop_back();
+		}
+	}
+}
+
+static bool IsSurfaceAuthoredLOD(long surfaceId, const RawModel &rawModel)
+{
+	for (int indexNode = 0; indexNode < rawModel.GetNodeCount(); indexNode++) {
+		const RawNode &node = rawModel.GetNode(indexNode);
+
+		if (node.surfaceId != surfaceId) {
+			continue;
+		}
+
+		const int indexParent = rawModel.GetNodeById(node.parentId);
+
+		if (indexParent >= 0 && IsNodeLODGrpup(rawModel.GetNode(indexParent), rawModel)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void CreateLODModel(RawModel &lodModel, const RawModel &rawMaterialModel, const std::vector<unsigned int> &indices, int lod)
+{
+	RawSurface surface = rawMaterialModel.GetSurface(0);
+	surface.name += "_LOD" + std::to_string(lod);
+
+	lodModel.AddVertexAttribute((RawVertexAttribute)rawMaterialModel.GetVertexAttributes());
+
+	for (int indexNode = 0; indexNode < rawMaterialModel.GetNodeCount(); indexNode++) {
+		lodModel.AddNode(rawMaterialModel.GetNode(indexNode));
+	}
+
+	const int materialIndex = lodModel.AddMaterial(rawMaterialModel.GetMaterial(0));
+	const int surfaceIndex = lodModel.AddSurface(surface);
+
+	for (int index = 0; index < indices.size(); index += 3) {
+		lodModel.AddTriangle(
+			lodModel.AddVertex(rawMaterialModel.GetVertex(indices[index + 0])),
+			lodModel.AddVertex(rawMaterialModel.GetVertex(indices[index + 1])),
+			lodModel.AddVertex(rawMaterialModel.GetVertex(indices[index + 2])),
+			materialIndex, surfaceIndex);
+	}
+}
+
+// The same split CreateMaterialModels orders the triangles by, for a whole material model
+static bool IsSubMeshTransparent(const RawModel &rawMaterialModel, const RawModel &rawModel)
+{
+	const int textureIndex = rawMaterialModel.GetMaterial(0).textures[RAW_TEXTURE_USAGE_DIFFUSE];
+	if (textureIndex >= 0) {
+		return rawModel.GetTexture(textureIndex).occlusion == RAW_TEXTURE_OCCLUSION_TRANSPARENT;
+	}
+
+	const RawVertexStreams &vertices = rawMaterialModel.GetVertexStreams();
+	for (int index = 0; index < rawMaterialModel.GetVertexCount(); index++) {
+		if (vertices.GetColor(index).w < 1.0f) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void SortSubMeshes(const RawModel &rawModel, std::vector<RawModel> &rawMaterialModels, const CrossOptions &options)
+{
+	// Every material is drawn with Default.glsl, the pipelines only differ by the Define set of the vertex format
+	const std::vector<unsigned int> formats = SelectSubMeshFormats(GetMeshFormat(rawModel, rawMaterialModels, options), rawMaterialModels, options);
+
+	// Opaque first, grouped by pipeline, then albedo texture binding, then material; transparent submeshes keep the
+	// order they blend in. The submesh index makes every key unique, so the sort is stable.
+	typedef std::tuple<bool, unsigned int, int, std::string, int> SubMeshKey;
+	std::vector<SubMeshKey> keys(rawMaterialModels.size());
+	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+		const RawMaterial &material = rawMaterialModels[indexMesh].GetMaterial(0);
+		keys[indexMesh] = IsSubMeshTransparent(rawMaterialModels[indexMesh], rawModel) ?
+			SubMeshKey(true, 0, -1, std::string(), indexMesh) :
+			SubMeshKey(false, formats[indexMesh], GetAlbedoTexture(material), material.name, indexMesh);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<RawModel> sortedModels;
+	sortedModels.reserve(rawMaterialModels.size());
+	for (const SubMeshKey &key : keys) {
+		sortedModels.push_back(std::move(rawMaterialModels[std::get<4>(key)]));
+	}
+	rawMaterialModels.swap(sortedModels);
+}
+
+void CreateLODModels(std::vector<RawModel> &rawMaterialModels, std::vector<int> &materialModelLODs, const RawModel &rawModel, const CrossOptions &options)
+{
+	const int numMeshs = rawMaterialModels.size();
+	materialModelLODs.assign(numMeshs, 0);
+
+	if (options.lodCount <= 0) {
+		return;
+	}
+
+	// Each LOD is simplified from the previous one and stops the chain when it no longer pays off
+	std::vector<std::vector<RawModel>> lodModels(numMeshs);
+
+	ThreadUtils::ParallelFor(numMeshs, options.jobs, [&](int indexMesh) {
+		const RawModel &rawMaterialModel = rawMaterialModels[indexMesh];
+
+		if (rawMaterialModel.GetTriangleCount() == 0 || IsSurfaceAuthoredLOD(rawMaterialModel.GetSurface(0).id, rawModel)) {
+			return;
+		}
+
+		std::vector<RawVertex> vertices(rawMaterialModel.GetVertexCount());
+		std::vector<unsigned int> indices;
+
+		for (int index = 0; index < rawMaterialModel.GetVertexCount(); index++) {
+			vertices[index] = rawMaterialModel.GetVertex(index);
+		}
+
+		for (int index = 0; index < rawMaterialModel.GetTriangleCount(); index++) {
+			const RawTriangle &triangle = rawMaterialModel.GetTriangle(index);
+			indices.push_back(triangle.verts[0]);
+			indices.push_back(triangle.verts[1]);
+			indices.push_back(triangle.verts[2]);
+		}
+
+		float targetTriangles = rawMaterialModel.GetTriangleCount();
+
+		for (int lod = 1; lod <= std::min(options.lodCount, 7); lod++) {
+			const size_t previousIndexCount = indices.size();
+			targetTriangles *= options.lodRatio;
+
+			SimplifyMesh(indices, vertices.data(), vertices.size(), 3 * (int)targetTriangles, options.lodError);
+
+			if (indices.empty() || indices.size() > previousIndexCount * 0.95f) {
+				break;
+			}
+
+			lodModels[indexMesh].emplace_back();
+			CreateLODModel(lodModels[indexMesh].back(), rawMaterialModel, indices, lod);
+		}
+	});
+
+	for (int indexMesh = 0; indexMesh < numMeshs; indexMesh++) {
+		for (int indexLOD = 0; indexLOD < lodModels[indexMesh].size(); indexLOD++) {
+			rawMaterialModels.push_back(std::move(lodModels[indexMesh][indexLOD]));
+			materialModelLODs.push_back(indexLOD + 1);
+		}
+	}
+}
+
+// Row major 3x4, the last row of an affine transform is implied
+static void GetAffineTransform(const Mat4f &m, float transform[12])
+{
+	for (int row = 0; row < 3; row++) {
+		for (int column = 0; column < 4; column++) {
+			transform[row * 4 + column] = m(row, column);
+		}
+	}
+}
+
+// Moves the static draws of every submesh and material drawn at least minInstances times into an instance group
+static void CreateInstanceGroups(SceneGraph &scene, int minInstances)
+{
+	typedef std::tuple<unsigned int, unsigned int, int, unsigned int> InstanceKey;
+	std::map<InstanceKey, int> groupIndices;
+	std::vector<std::vector<std::pair<unsigned int, int>>> groupDraws;
+
+	for (int indexNode = 0; indexNode < scene.nodes.size(); indexNode++) {
+		const SceneNode &node = scene.nodes[indexNode];
+		if (scene.nodeDynamic[indexNode]) {
+			continue;
+		}
+		for (unsigned int indexDraw = node.firstDraw; indexDraw < node.firstDraw + node.numDraws; indexDraw++) {
+			const SceneDraw &draw = scene.draws[indexDraw];
+			auto it = groupIndices.emplace(InstanceKey(draw.subMesh, draw.material, draw.lod, draw.mask), (int)groupDraws.size());
+			if (it.second) {
+				groupDraws.emplace_back();
+			}
+			groupDraws[it.first->second].emplace_back(indexDraw, indexNode);
+		}
+	}
+
+	std::vector<bool> instanced(scene.draws.size(), false);
+	for (const auto &draws : groupDraws) {
+		if (draws.size() < (size_t)std::max(minInstances, 2)) {
+			continue;
+		}
+
+		const SceneDraw &draw = scene.draws[draws.front().first];
+		SceneInstanceGroup group;
+		group.subMesh = draw.subMesh;
+		group.name = draw.name;
+		group.material = draw.material;
+		group.lod = draw.lod;
+		group.mask = draw.mask;
+		group.firstInstance = (unsigned int)scene.instances.size();
+		group.numInstances = (unsigned int)draws.size();
+		scene.instanceGroups.push_back(group);
+
+		for (const auto &indexDraw : draws) {
+			SceneInstance instance;
+			GetAffineTransform(scene.nodeTransforms[indexDraw.second], instance.transform);
+			scene.instances.push_back(instance);
+			instanced[indexDraw.first] = true;
+		}
+	}
+
+	if (scene.instanceGroups.empty()) {
+		return;
+	}
+
+	std::vector<SceneDraw> draws;
+	for (SceneNode &node : scene.nodes) {
+		const unsigned int firstDraw = (unsigned int)draws.size();
+		for (unsigned int indexDraw = node.firstDraw; indexDraw < node.firstDraw + node.numDraws; indexDraw++) {
+			if (instanced[indexDraw] == false) {
+				draws.push_back(scene.draws[indexDraw]);
+			}
+		}
+		node.firstDraw = firstDraw;
+		node.numDraws = (unsigned int)draws.size() - firstDraw;
+	}
+	scene.draws.swap(draws);
+}
+
+#define SCENE_BVH_BINS          16
+#define SCENE_BVH_LEAF_SIZE     4  // ranges this small are always leaves
+#define SCENE_BVH_MAX_LEAF_SIZE 16 // ranges larger than this are always split
+
+static float GetSurfaceArea(const float min[3], const float max[3])
+{
+	const float x = max[0] - min[0];
+	const float y = max[1] - min[1];
+	const float z = max[2] - min[2];
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+static void GrowBounds(float min[3], float max[3], const float otherMin[3], const float otherMax[3])
+{
+	for (int axis = 0; axis < 3; axis++) {
+		min[axis] = std::min(min[axis], otherMin[axis]);
+		max[axis] = std::max(max[axis], otherMax[axis]);
+	}
+}
+
+/**
+ * Binned SAH BVH over the static draws and instances. Skinned and morphed draws are dynamic, their bind pose bounds
+ * don't hold once they deform. Every range of primitives is split at the cheapest of SCENE_BVH_BINS - 1 planes per
+ * axis, unless no split beats a leaf and the range fits in one.
+ */
+static void CreateSceneBVH(SceneGraph &scene, const std::vector<RawModel> &rawMaterialModels)
+{
+	std::vector<SceneBVHPrimitive> &primitives = scene.bvhPrimitives;
+
+	auto addPrimitive = [&](unsigned int type, unsigned int index, unsigned int subMesh, const float transform[12]) {
+		const Bounds<float, 3> &bounds = rawMaterialModels[subMesh].GetSurface(0).bounds;
+		if (bounds.initialized == false) {
+			return;
+		}
+
+		// The box around the transformed box, from its transformed center and extent
+		SceneBVHPrimitive primitive;
+		primitive.type = type;
+		primitive.index = index;
+		for (int row = 0; row < 3; row++) {
+			float center = transform[row * 4 + 3];
+			float extent = 0.0f;
+			for (int column = 0; column < 3; column++) {
+				center += transform[row * 4 + column] * (bounds.min[column] + bounds.max[column]) * 0.5f;
+				extent += fabsf(transform[row * 4 + column]) * (bounds.max[column] - bounds.min[column]) * 0.5f;
+			}
+			primitive.min[row] = center - extent;
+			primitive.max[row] = center + extent;
+		}
+		primitives.push_back(primitive);
+	};
+
+	for (int indexNode = 0; indexNode < scene.nodes.size(); indexNode++) {
+		const SceneNode &node = scene.nodes[indexNode];
+		if (scene.nodeDynamic[indexNode]) {
+			continue;
+		}
+		float transform[12];
+		GetAffineTransform(scene.nodeTransforms[indexNode], transform);
+		for (unsigned int indexDraw = node.firstDraw; indexDraw < node.firstDraw + node.numDraws; indexDraw++) {
+			addPrimitive(SCENE_BVH_PRIMITIVE_DRAW, indexDraw, scene.draws[indexDraw].subMesh, transform);
+		}
+	}
+	for (const SceneInstanceGroup &group : scene.instanceGroups) {
+		for (unsigned int indexInstance = group.firstInstance; indexInstance < group.firstInstance + group.numInstances; indexInstance++) {
+			addPrimitive(SCENE_BVH_PRIMITIVE_INSTANCE, indexInstance, group.subMesh, scene.instances[indexInstance].transform);
+		}
+	}
+
+	if (primitives.empty()) {
+		return;
+	}
+
+	// Ranges still to build, the right child of an inner node is built after its whole left subtree
+	struct BuildTask
+	{
+		unsigned int first;
+		unsigned int count;
+		int rightOf;
+	};
+	std::vector<BuildTask> tasks;
+	tasks.push_back(BuildTask { 0, (unsigned int)primitives.size(), -1 });
+
+	while (tasks.empty() == false) {
+		const BuildTask task = tasks.back();
+		tasks.pop_back();
+
+		const unsigned int indexNode = (unsigned int)scene.bvhNodes.size();
+		if (task.rightOf >= 0) {
+			scene.bvhNodes[task.rightOf].first = indexNode;
+		}
+		scene.bvhNodes.emplace_back();
+
+		SceneBVHNode node;
+		float centroidMin[3] = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+		float centroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (int axis = 0; axis < 3; axis++) {
+			node.min[axis] =  FLT_MAX;
+			node.max[axis] = -FLT_MAX;
+		}
+		for (unsigned int index = task.first; index < task.first + task.count; index++) {
+			const SceneBVHPrimitive &primitive = primitives[index];
+			GrowBounds(node.min, node.max, primitive.min, primitive.max);
+			for (int axis = 0; axis < 3; axis++) {
+				const float centroid = (primitive.min[axis] + primitive.max[axis]) * 0.5f;
+				centroidMin[axis] = std::min(centroidMin[axis], centroid);
+				centroidMax[axis] = std::max(centroidMax[axis], centroid);
+			}
+		}
+
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float bestCost = FLT_MAX;
+
+		if (task.count > SCENE_BVH_LEAF_SIZE) {
+			for (int axis = 0; axis < 3; axis++) {
+				const float extent = centroidMax[axis] - centroidMin[axis];
+				if (extent <= 0.0f) {
+					continue;
+				}
+
+				unsigned int binCounts[SCENE_BVH_BINS] = { 0 };
+				float binMins[SCENE_BVH_BINS][3];
+				float binMaxs[SCENE_BVH_BINS][3];
+				for (int bin = 0; bin < SCENE_BVH_BINS; bin++) {
+					for (int i = 0; i < 3; i++) {
+						binMins[bin][i] =  FLT_MAX;
+						binMaxs[bin][i] = -FLT_MAX;
+					}
+				}
+				for (unsigned int index = task.first; index < task.first + task.count; index++) {
+					const SceneBVHPrimitive &primitive = primitives[index];
+					const float centroid = (primitive.min[axis] + primitive.max[axis]) * 0.5f;
+					const int bin = std::min((int)((centroid - centroidMin[axis]) / extent * SCENE_BVH_BINS), SCENE_BVH_BINS - 1);
+					binCounts[bin]++;
+					GrowBounds(binMins[bin], binMaxs[bin], primitive.min, primitive.max);
+				}
+
+				// Sweep from the right, then evaluate every plane sweeping from the left
+				float rightAreas[SCENE_BVH_BINS];
+				unsigned int rightCounts[SCENE_BVH_BINS];
+				float sweepMin[3] = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+				float sweepMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+				unsigned int sweepCount = 0;
+				for (int bin = SCENE_BVH_BINS - 1; bin > 0; bin--) {
+					GrowBounds(sweepMin, sweepMax, binMins[bin], binMaxs[bin]);
+					sweepCount += binCounts[bin];
+					rightAreas[bin] = sweepCount > 0 ? GetSurfaceArea(sweepMin, sweepMax) : 0.0f;
+					rightCounts[bin] = sweepCount;
+				}
+
+				float leftMin[3] = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+				float leftMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+				unsigned int leftCount = 0;
+				for (int split = 1; split < SCENE_BVH_BINS; split++) {
+					GrowBounds(leftMin, leftMax, binMins[split - 1], binMaxs[split - 1]);
+					leftCount += binCounts[split - 1];
+					if (leftCount == 0 || rightCounts[split] == 0) {
+						continue;
+					}
+					const float cost = GetSurfaceArea(leftMin, leftMax) * leftCount + rightAreas[split] * rightCounts[split];
+					if (cost < bestCost) {
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = split;
+					}
+				}
+			}
+		}
+
+		// Intersecting a primitive costs as much as descending a level, large ranges are split regardless
+		const float leafCost = GetSurfaceArea(node.min, node.max) * task.count;
+		if (task.count <= SCENE_BVH_LEAF_SIZE || (task.count <= SCENE_BVH_MAX_LEAF_SIZE && (bestAxis < 0 || bestCost >= leafCost))) {
+			node.first = task.first;
+			node.count = task.count;
+			scene.bvhNodes[indexNode] = node;
+			continue;
+		}
+
+		// Without a plane the centroids are all in one place, halving the range still bounds the leaves
+		unsigned int middle = task.first + task.count / 2;
+		if (bestAxis >= 0) {
+			const float extent = centroidMax[bestAxis] - centroidMin[bestAxis];
+			const auto it = std::partition(primitives.begin() + task.first, primitives.begin() + task.first + task.count, [&](const SceneBVHPrimitive &primitive) {
+				const float centroid = (primitive.min[bestAxis] + primitive.max[bestAxis]) * 0.5f;
+				return std::min((int)((centroid - centroidMin[bestAxis]) / extent * SCENE_BVH_BINS), SCENE_BVH_BINS - 1) < bestSplit;
+			});
+			middle = (unsigned int)(it - primitives.begin());
+		}
+
+		scene.bvhNodes[indexNode] = node;
+		tasks.push_back(BuildTask { middle, task.first + task.count - middle, (int)indexNode });
+		tasks.push_back(BuildTask { task.first, middle - task.first, -1 });
+	}
+}
+
+std::shared_ptr<SceneGraph> CreateSceneGraph(const char *szMeshFileName, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels, const std::vector<int> &materialModelLODs, const std::vector<std::string> &materialFileNames, const std::vector<std::string> &animationFileNames, const CrossOptions &options)
+{
+	std::shared_ptr<SceneGraph> pScene = std::make_shared<SceneGraph>();
+	SceneGraph &scene = *pScene;
+
+	std::unordered_map<long, std::vector<long>> surfaceMeshs;
+	std::unordered_map<long, std::vector<long>> surfaceLODMeshs;
+	std::vector<std::string> meshMaterials(rawMaterialModels.size());
+
+	// The material models carry copies of the materials, which are told apart by name
+	std::unordered_map<std::string, std::string> materialNameFiles;
+	for (int index = 0; index < rawModel.GetMaterialCount() && index < (int)materialFileNames.size(); index++) {
+		materialNameFiles.emplace(rawModel.GetMaterial(index).name, materialFileNames[index]);
+	}
+
+	for (int indexMesh = 0; indexMesh < rawMaterialModels.size(); indexMesh++) {
+		long id = rawMaterialModels[indexMesh].GetSurface(0).id;
+		auto it = materialNameFiles.find(rawMaterialModels[indexMesh].GetMaterial(0).name);
+		meshMaterials[indexMesh] = it != materialNameFiles.end() ? it->second : GetMaterialFileName("", rawMaterialModels[indexMesh].GetMaterial(0));
+
+		// Generated LODs follow the submeshes and come in order
+		if (materialModelLODs[indexMesh] > 0) {
+			surfaceLODMeshs[id].push_back(indexMesh);
+		}
+		else {
+			surfaceMeshs[id].push_back(indexMesh);
+		}
+	}
+
+	scene.AddString("");
+	scene.header.mesh = scene.AddString(szMeshFileName);
+
+	std::vector<bool> animatedNodes(rawModel.GetNodeCount(), false);
+	for (int indexAnimation = 0; indexAnimation < rawModel.GetAnimationCount(); indexAnimation++) {
+		for (const RawChannel &channel : rawModel.GetAnimation(indexAnimation).channels) {
+			animatedNodes[channel.nodeIndex] = true;
+		}
+	}
+
+	AddNodes(scene, rawModel.GetRootNode(), rawModel, surfaceMeshs, surfaceLODMeshs, meshMaterials, materialModelLODs, animatedNodes);
+
+	if (options.instancing) {
+		CreateInstanceGroups(scene, options.instanceMinCount);
+	}
+
+	for (int indexAnimation = 0; indexAnimation < animationFileNames.size(); indexAnimation++) {
+		SceneAnimation animation;
+		animation.name = scene.AddString(rawModel.GetAnimation(indexAnimation).name);
+		animation.anim = scene.AddString(animationFileNames[indexAnimation]);
+		scene.animations.push_back(animation);
+	}
+
+	// Only the .scene has a BVH
+	if (options.sceneFormat != SceneFormatOptions::XML) {
+		CreateSceneBVH(scene, rawMaterialModels);
+	}
+	return pScene;
+}
+
+bool ExportMeshXML(const char *szFileName, const SceneGraph &scene, const CrossOptions &options)
+{
+	// The instance transforms stay binary, in a file next to the XML
+	const std::string instancesName = StringUtils::GetFileBaseString(szFileName) + ".instances";
+	if (scene.instances.empty() == false) {
+		const std::string instancesFileName = StringUtils::GetFolderString(szFileName) + instancesName;
+		const bool written = WriteMeshFile(instancesFileName.c_str(), [&](FILE *pFile) {
+			return fwrite(scene.instances.data(), sizeof(SceneInstance), scene.instances.size(), pFile) == scene.instances.size();
+		}, options);
+		if (written == false) {
+			return false;
+		}
+	}
+
+	FILE *pFile = fopen(szFileName, "wb");
+	if (pFile == nullptr) {
+		return false;
+	}
+
+	XmlWriter writer(pFile);
+	writer.BeginElement("Mesh");
+	writer.Attribute("mesh", scene.GetString(scene.header.mesh));
+	{
+		// A node's element stays open until the next node that is not one of its descendants
+		std::vector<int> openNodes;
+
+		for (int indexNode = 0; indexNode < scene.nodes.size(); indexNode++) {
+			const SceneNode &node = scene.nodes[indexNode];
+
+			while (openNodes.empty() == false && openNodes.back() != node.parent) {
+				writer.EndElement();
+				openNodes.pop_back();
+			}
+
+			writer.BeginElement("Node");
+			writer.AttributeFormat("translation", "%f %f %f", node.translation[0], node.translation[1], node.translation[2]);
+			writer.AttributeFormat("rotation", "%f %f %f %f", node.rotation[0], node.rotation[1], node.rotation[2], node.rotation[3]);
+			writer.AttributeFormat("scale", "%f %f %f", node.scale[0], node.scale[1], node.scale[2]);
+			openNodes.push_back(indexNode);
+
+			for (unsigned int indexDraw = node.firstDraw; indexDraw < node.firstDraw + node.numDraws; indexDraw++) {
+				const SceneDraw &draw = scene.draws[indexDraw];
+
+				writer.BeginElement("Draw");
+				{
+					writer.Attribute("index", (int)draw.subMesh);
+					writer.Attribute("name", scene.GetString(draw.name));
+					writer.Attribute("material", scene.GetString(draw.material));
+
+					// Default Parameters
+					if (draw.lod >= 0) {
+						writer.Attribute("lod", draw.lod);
+					}
+
+					writer.AttributeFormat("mask", "%u", draw.mask);
+				}
+				writer.EndElement();
+			}
+		}
+
+		while (openNodes.empty() == false) {
+			writer.EndElement();
+			openNodes.pop_back();
+		}
+
+		for (const SceneInstanceGroup &group : scene.instanceGroups) {
+			writer.BeginElement("Instances");
+			{
+				writer.Attribute("index", (int)group.subMesh);
+				writer.Attribute("name", scene.GetString(group.name));
+				writer.Attribute("material", scene.GetString(group.material));
+
+				if (group.lod >= 0) {
+					writer.Attribute("lod", group.lod);
+				}
+
+				writer.AttributeFormat("mask", "%u", group.mask);
+				writer.Attribute("transforms", instancesName);
+				writer.Attribute("first", (int)group.firstInstance);
+				writer.Attribute("count", (int)group.numInstances);
+			}
+			writer.EndElement();
+		}
+
+		for (const SceneAnimation &animation : scene.animations) {
+			writer.BeginElement("Animation");
+			writer.Attribute("name", scene.GetString(animation.name));
+			writer.Attribute("anim", scene.GetString(animation.anim));
+			writer.EndElement();
+		}
+	}
+	writer.EndElement();
+
+	const bool success = writer.Finish();
+	return fclose(pFile) == 0 && success;
+}
+
+bool ExportScene(const char *szFileName, const SceneGraph &scene, const CrossOptions &options)
+{
+	SceneFileHeader header = scene.header;
+	header.numNodes = (unsigned int)scene.nodes.size();
+	header.nodesOffset = sizeof(header);
+	header.numDraws = (unsigned int)scene.draws.size();
+	header.drawsOffset = header.nodesOffset + sizeof(SceneNode) * header.numNodes;
+	header.numAnimations = (unsigned int)scene.animations.size();
+	header.animationsOffset = header.drawsOffset + sizeof(SceneDraw) * header.numDraws;
+	header.numInstanceGroups = (unsigned int)scene.instanceGroups.size();
+	header.instanceGroupsOffset = header.animationsOffset + sizeof(SceneAnimation) * header.numAnimations;
+	header.numInstances = (unsigned int)scene.instances.size();
+	header.instancesOffset = header.instanceGroupsOffset + sizeof(SceneInstanceGroup) * header.numInstanceGroups;
+	header.numBVHNodes = (unsigned int)scene.bvhNodes.size();
+	header.bvhNodesOffset = header.instancesOffset + sizeof(SceneInstance) * header.numInstances;
+	header.numBVHPrimitives = (unsigned int)scene.bvhPrimitives.size();
+	header.bvhPrimitivesOffset = header.bvhNodesOffset + sizeof(SceneBVHNode) * header.numBVHNodes;
+	header.stringsSize = (unsigned int)scene.strings.size();
+	header.stringsOffset = header.bvhPrimitivesOffset + sizeof(SceneBVHPrimitive) * header.numBVHPrimitives;
+
+	std::vector<uint8_t> buffer(header.stringsOffset + header.stringsSize, 0);
+	{
+		uint8_t *pBuffer = buffer.data();
+		pBuffer = WriteBuffer(pBuffer, header);
+		pBuffer = WriteBuffer(pBuffer, scene.nodes);
+		pBuffer = WriteBuffer(pBuffer, scene.draws);
+		pBuffer = WriteBuffer(pBuffer, scene.animations);
+		pBuffer = WriteBuffer(pBuffer, scene.instanceGroups);
+		pBuffer = WriteBuffer(pBuffer, scene.instances);
+		pBuffer = WriteBuffer(pBuffer, scene.bvhNodes);
+		pBuffer = WriteBuffer(pBuffer, scene.bvhPrimitives);
+		pBuffer = WriteBuffer(pBuffer, scene.strings);
+	}
+
+	return WriteMeshFile(szFileName, [&](FILE *pFile) {
+		return fwrite(buffer.data(), 1, buffer.size(), pFile) == buffer.size();
+	}, options);
+}
@@ -12,12 +12,259 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include "RawModel.h"
+#include "MeshOptimizer.h"
+#include "TextureProcessor.h"
+
+/**
+ * Encoding bits stored above the RawVertexAttribute bits of the .mesh format field.
+ * Quantized positions are relative to the bounds of their submesh. The octahedral and
+ * QTangent encodings store the whole tangent frame in the normal attribute, the binormal
+ * attribute then takes no space of its own. With a split position stream the positions
+ * are left out of the interleaved vertices.
+ */
+enum CrossVertexFormat
+{
+	CROSS_VERTEX_FORMAT_POSITION_SNORM16 = 0x00000100, // 4 x snorm16, xyz in [min, max], w = 1
+	CROSS_VERTEX_FORMAT_POSITION_UNORM16 = 0x00000200, // 4 x unorm16, xyz in [min, max], w = 1
+	CROSS_VERTEX_FORMAT_TEXCOORD_HALF    = 0x00000400, // 2 x half, both texcoords
+	CROSS_VERTEX_FORMAT_TEXCOORD_UNORM16 = 0x00000800, // 2 x unorm16, both texcoords
+	CROSS_VERTEX_FORMAT_NORMAL_SNORM10   = 0x00001000, // 10:10:10:2 snorm, normal and binormal
+	CROSS_VERTEX_FORMAT_NORMAL_OCT8      = 0x00002000, // 2 x snorm8 octahedral normal, 2 x snorm8 octahedral tangent
+	CROSS_VERTEX_FORMAT_NORMAL_OCT16     = 0x00004000, // 2 x snorm16 octahedral normal, 2 x snorm16 octahedral tangent
+	CROSS_VERTEX_FORMAT_QTANGENT         = 0x00008000, // 4 x snorm16 tangent frame quaternion
+	CROSS_VERTEX_FORMAT_POSITION_STREAM  = 0x00010000, // positions only in the position stream
+	CROSS_VERTEX_FORMAT_JOINT_UINT16     = 0x00020000, // 4 x uint16 joint indices, for palettes of more than 256 joints
+};
+
+enum class PositionFormatOptions {
+	FLOAT,      // 3 x float
+	SNORM16,    // 4 x snorm16 relative to the submesh bounds
+	UNORM16,    // 4 x unorm16 relative to the submesh bounds
+};
+
+enum class TexcoordFormatOptions {
+	FLOAT,      // 2 x float
+	HALF,       // 2 x half float
+	UNORM16,    // 2 x unorm16, only for texcoords in [0, 1]
+};
+
+enum class NormalFormatOptions {
+	SNORM8,     // 4 x snorm8
+	SNORM10,    // 10:10:10:2 snorm
+	OCT8,       // octahedral normal and tangent, 2 x snorm8 each
+	OCT16,      // octahedral normal and tangent, 2 x snorm16 each
+	QTANGENT,   // tangent frame quaternion, 4 x snorm16
+};
+
+enum class PositionStreamOptions {
+	NONE,       // positions only in the interleaved vertices
+	SPLIT,      // positions moved to their own stream, sharing the index buffer
+	INDEXED,    // deduplicated copy of the positions with its own index buffer
+};
+
+enum class SceneFormatOptions {
+	XML,        // the mesh XML only
+	BINARY,     // the binary .scene only
+	BOTH,       // the mesh XML and the binary .scene
+};
+
+enum class GltfFormatOptions {
+	NONE,       // no glTF model
+	GLTF,       // <name>_gltf/<name>.gltf with its buffer and textures in that folder
+	GLB,        // a self-contained <name>.glb
+};
+
+/**
+ * User-supplied options that dictate the nature of the Cross mesh being generated.
+ */
+struct CrossOptions
+{
+	/** Version of the .mesh container to write, 1 is the legacy packed layout. */
+	int meshVersion { 2 };
+	/** Alignment in bytes of every section of a version 2 .mesh, at least 16. */
+	unsigned int meshAlignment { 16 };
+	/** Size in bytes of the pages the indices and vertices of every submesh are grouped into, zero for no pages; version 2 only. */
+	unsigned int meshPageSize { 0 };
+	/** When to use 32-bit indices, decided per submesh; version 1 always uses 32-bit indices. */
+	UseLongIndicesOptions useLongIndices = UseLongIndicesOptions::AUTO;
+	/** Encoding of vertex positions. */
+	PositionFormatOptions positionFormat = PositionFormatOptions::FLOAT;
+	/** Encoding of vertex texture coordinates. */
+	TexcoordFormatOptions texcoordFormat = TexcoordFormatOptions::FLOAT;
+	/** Whether depth only passes get a position stream of their own, version 2 only. */
+	PositionStreamOptions positionStream = PositionStreamOptions::NONE;
+	/** Whether every submesh keeps only the vertex attributes its material reads, in a format of its own; version 2 only. */
+	bool subMeshFormats { false };
+	/** Whether to store the indices and vertices of every submesh as a Draco stream, version 2 only. */
+	bool useDraco { false };
+	/** Draco encoding speed from 0 to 10, slower compresses better. */
+	int dracoSpeed { 5 };
+	/** Quantization bits of Draco positions. */
+	int dracoPositionBits { 14 };
+	/** Quantization bits of Draco normals. */
+	int dracoNormalBits { 10 };
+	/** Quantization bits of Draco texture coordinates. */
+	int dracoTexcoordBits { 12 };
+	/** Quantization bits of Draco colors. */
+	int dracoColorBits { 8 };
+	/** Quantization bits of Draco tangents and joint weights. */
+	int dracoGenericBits { 8 };
+	/** Encoding of vertex normals and binormals. */
+	NormalFormatOptions normalFormat = NormalFormatOptions::SNORM8;
+	/** When to compute vertex normals from geometry. */
+	ComputeNormalsOption computeNormals = ComputeNormalsOption::NEVER;
+	/** When to compute tangents and binormals from the normals and the first texture coordinates. */
+	ComputeTangentsOption computeTangents = ComputeTangentsOption::NEVER;
+	/** Largest position error, in scene units, before falling back to float positions. */
+	float positionTolerance { 0.001f };
+	/** Largest texture coordinate error before falling back to float texture coordinates. */
+	float texcoordTolerance { 1.0f / 4096.0f };
+	/** Largest normal component error before falling back to snorm8 normals. */
+	float normalTolerance { 0.03f };
+	/** Distance in scene units within which vertices are welded before the submeshes are built, zero welds none. */
+	float weldPositionTolerance { 0.0f };
+	/** Largest angle in degrees between the normals, binormals and tangents of welded vertices. */
+	float weldNormalAngle { 2.0f };
+	/** Largest texture coordinate distance between welded vertices. */
+	float weldTexcoordTolerance { 1.0f / 4096.0f };
+	/** Whether to drop triangles that repeat a vertex, have no area or repeat another triangle before the submeshes are built. */
+	bool removeDegenerateTriangles { false };
+	/** Area in square scene units up to which triangles count as degenerate. */
+	float degenerateMinArea { 0.0f };
+	/** Smallest angle in degrees below which triangles count as degenerate, zero for none. */
+	float degenerateMinAngle { 0.0f };
+	/** Largest world space position error, in scene units, that dropping animation keys may cause, zero keeps every key. */
+	float animationTolerance { 0.0001f };
+	/** Largest morph weight error that dropping animation keys may cause. */
+	float animationWeightTolerance { 0.001f };
+	/** Largest number of joints a skinned submesh binds, larger ones are split; zero never splits. */
+	int maxPaletteJoints { 0 };
+	/** Largest width and height of an albedo texture to pack into an atlas, zero disables atlasing. */
+	int atlasMaxTextureSize { 0 };
+	/** Width and largest height of an atlas page in texels. */
+	int atlasSize { 2048 };
+	/**
+	 * Folder shared by every converted model for textures and materials named by a hash of their content, referenced
+	 * with this path as given; empty writes materials next to the model.
+	 */
+	std::string libraryPath;
+	/** GPU format albedo textures are converted to with their mip chain, NONE references the source files. */
+	TextureFormatOptions textureFormat = TextureFormatOptions::NONE;
+	/** Which scene files describe the nodes, draws and animations of the mesh. */
+	SceneFormatOptions sceneFormat = SceneFormatOptions::XML;
+	/** Whether to bake static nodes into batches under the root node, one submesh per material and batch. */
+	bool staticBatching { false };
+	/** Size of the grid cells that bound the extent of a static batch in scene units, zero for one cell. */
+	float batchMaxExtent { 0.0f };
+	/** Largest number of vertices in a static batch, larger surfaces are not batched. */
+	int batchMaxVertices { 65535 };
+	/** Whether to fold the empty nodes of the hierarchy into their children before the scene is written. */
+	bool flattenHierarchy { false };
+	/** Names of the nodes flattening keeps, for nodes the runtime looks up by name. */
+	std::vector<std::string> flattenKeepNodes;
+	/** Whether to order submeshes by the pipeline state and textures they are drawn with, opaque ones first. */
+	bool sortSubMeshes { false };
+	/** Whether static draws of the same submesh and material become instance groups with a transform per instance. */
+	bool instancing { false };
+	/** Fewest draws of a submesh and material that form an instance group, at least 2. */
+	int instanceMinCount { 2 };
+	/** Number of worker threads for per-submesh and per-texture work, zero means one per hardware thread. */
+	int jobs { 0 };
+	/** Whether to write the .mesh to a temporary file and atomically rename it into place. */
+	bool atomicWrite { false };
+	/** Whether to write the .mesh a batch of submeshes at a time, releasing their geometry once written. */
+	bool streaming { false };
+	/** Peak memory in MiB that streaming batches are sized to stay under, zero makes one submesh per job a batch. */
+	unsigned int memoryBudget { 0 };
+	/** Triangle ordering for the post-transform vertex cache. */
+	VertexCacheOptimizerOptions vertexCacheOptimizer = VertexCacheOptimizerOptions::PVRT;
+	/** Whether to reorder triangle clusters to reduce overdraw after the vertex cache pass. */
+	bool optimizeOverdraw { false };
+	/** Largest ACMR increase the overdraw pass may cause, 1.05 allows 5% more cache misses. */
+	float overdrawThreshold { 1.05f };
+	/** Whether to reorder vertices by first use after the triangle passes. */
+	bool optimizeVertexFetch { false };
+	/** Whether to print ACMR/ATVR per submesh before and after the optimizers. */
+	bool printOptimizerStats { false };
+	/**
+	 * Whether to write the cache, overdraw, vertex fetch and size metrics of every exported submesh to a
+	 * .metrics.json file next to the .mesh.
+	 */
+	bool meshMetrics { false };
+	/** Size of the FIFO and LRU post-transform caches the metrics simulate. */
+	int metricsCacheSize { MESH_OPTIMIZER_CACHE_SIZE };
+	/** Whether to split every submesh into meshlets with culling bounds, version 2 only. */
+	bool buildMeshlets { false };
+	/** Largest number of vertices in a meshlet, at most 256. */
+	int meshletMaxVertices { 64 };
+	/** Largest number of triangles in a meshlet. */
+	int meshletMaxTriangles { 124 };
+	/** Number of LODs to generate for submeshes without authored ones, at most 7. */
+	int lodCount { 0 };
+	/** Triangle ratio between consecutive LODs. */
+	float lodRatio { 0.5f };
+	/** Largest simplification error relative to the submesh extent, zero for no limit. */
+	float lodError { 0.01f };
+	/** Which glTF model is written next to the Cross files from the same imported and processed model. */
+	GltfFormatOptions gltfFormat = GltfFormatOptions::NONE;
+	/** Materials and compression of the glTF model, the import and processing options are the ones above. */
+	GltfOptions gltfOptions;
+	/** Whether the glTF model is written on its own thread while the Cross files are. */
+	bool parallelExports { false };
+};
 
 void splitfilename(const char *name, char *fname, char *ext);
 
-bool ExportMesh(const char *szFileName, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels);
-bool ExportMaterial(const char *szPathName, const RawModel &rawModel);
-bool ExportMeshXML(const char *szFileName, const char *szMeshFileName, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels);
+unsigned int GetMeshFormat(const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels, const CrossOptions &options);
+// The vertex format every material of rawModel is drawn with, the mesh format unless CrossOptions::subMeshFormats
+std::vector<unsigned int> GetMaterialFormats(unsigned int meshFormat, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels, const CrossOptions &options);
+
+// Orders the material models so that drawing them in file order switches pipelines and texture bindings as rarely as
+// possible: opaque ones first, grouped by vertex format, albedo texture and material. Call before CreateLODModels.
+void SortSubMeshes(const RawModel &rawModel, std::vector<RawModel> &rawMaterialModels, const CrossOptions &options);
+void CreateLODModels(std::vector<RawModel> &rawMaterialModels, std::vector<int> &materialModelLODs, const RawModel &rawModel, const CrossOptions &options);
+
+// With CrossOptions::streaming every material model releases its geometry once it is written
+bool ExportMesh(const char *szFileName, const RawModel &rawModel, std::vector<RawModel> &rawMaterialModels, const CrossOptions &options);
+// Where ExportMesh writes the metrics of CrossOptions::meshMetrics for the given .mesh file
+std::string GetMeshMetricsFileName(const char *szMeshFileName);
+/**
+ * Packs the albedo textures of at most atlasMaxTextureSize texels into png atlases next to the output and points
+ * the materials using them at the atlas, remapping their uv0. Materials that then only differ by name are merged.
+ * Returns the number of materials moved to an atlas.
+ */
+int CreateTextureAtlases(RawModel &rawModel, const char *szPathName, const char *szFName, bool flipV, const CrossOptions &options);
+/**
+ * Bakes the surfaces of static nodes, not animated, skinned, morphed or in a LOD group, into one surface per batch,
+ * with the vertices transformed into the space of the root node. Batches are bounded by the batch grid and vertex
+ * count and drawn by a node under the root. Nodes left empty are removed. Returns the number of nodes batched, call
+ * Condense() afterwards.
+ */
+int CreateStaticBatches(RawModel &rawModel, const CrossOptions &options);
+/**
+ * Folds the nodes without a surface into their children, whose transforms take on the transform of the node, so that
+ * chains of empty groups no longer cost the runtime a transform update each. Animated nodes, joints, cameras, skeleton
+ * roots, LOD nodes, leaves and the nodes of CrossOptions::flattenKeepNodes stay, as do nodes whose transform can't
+ * move into a child: a non-identity transform above an animated child or joint, or a non-uniform scale above a
+ * rotated child. Returns the number of nodes removed.
+ */
+int FlattenHierarchy(RawModel &rawModel, const CrossOptions &options);
+// Converts the textures the materials reference to .ktx files, or with a library copies them into it; textureFileNames
+// holds the name the materials reference every exported texture by
+bool ExportTextures(const char *szPathName, const RawModel &rawModel, const CrossOptions &options, std::vector<std::string> &textureFileNames);
+// materialFileNames holds the name the mesh XML references every material by
+bool ExportMaterial(const char *szPathName, const RawModel &rawModel, const std::vector<unsigned int> &materialFormats, const std::vector<std::string> &textureFileNames, const CrossOptions &options, std::vector<std::string> &materialFileNames);
+// The scene the mesh XML and the .scene are written from, built once for both of them
+struct SceneGraph;
+std::shared_ptr<SceneGraph> CreateSceneGraph(const char *szMeshFileName, const RawModel &rawModel, const std::vector<RawModel> &rawMaterialModels, const std::vector<int> &materialModelLODs, const std::vector<std::string> &materialFileNames, const std::vector<std::string> &animationFileNames, const CrossOptions &options);
+// With CrossOptions::instancing the instance transforms are written to a .instances file next to the XML
+bool ExportMeshXML(const char *szFileName, const SceneGraph &scene, const CrossOptions &options);
+// The scene of the mesh XML as flat binary arrays, read by the runtime without parsing text
+bool ExportScene(const char *szFileName, const SceneGraph &scene, const CrossOptions &options);
+
+std::string GetAnimationFileName(const char *szPathName, const char *szFName, const RawAnimation &animation);
+bool ExportAnimation(const char *szFileName, const RawModel &rawModel, const RawAnimation &animation, const CrossOptions &options);
 
 #endif // !__RAW2CROSS_H__
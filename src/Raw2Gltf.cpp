@@ -11,6 +11,7 @@
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <set>
 
 #include <stb_image.h>
 #include <stb_image_write.h>
@@ -68,8 +69,8 @@ struct Holder
 struct GLTFData
 {
     explicit GLTFData(bool _isGlb)
-        : binary(new std::vector<uint8_t>),
-          isGlb(_isGlb)
+        : isGlb(_isGlb),
+          binary(new std::vector<uint8_t>)
     {
     }
 
@@ -292,7 +293,8 @@ ModelData *Raw2Gltf(
         materialModels,
         options.useLongIndices == UseLongIndicesOptions::NEVER,
         options.keepAttribs,
-        true);
+        true,
+        options.jobs);
 
     if (verboseOutput) {
         fmt::printf("%7d vertices\n", raw.GetVertexCount());
@@ -309,6 +311,7 @@ ModelData *Raw2Gltf(
     std::map<std::string, std::shared_ptr<MaterialData>> materialsByName;
     std::map<std::string, std::shared_ptr<TextureData>>  textureByIndicesKey;
     std::map<long, std::shared_ptr<MeshData>>            meshBySurfaceId;
+    std::set<std::string>                                imageFiles;
 
     // for now, we only have one buffer; data->binary points to the same vector as that BufferData does.
     BufferData &buffer = *gltf->buffers.hold(
@@ -368,18 +371,29 @@ ModelData *Raw2Gltf(
                         channel.scales.size(), channel.weights.size());
                 }
 
+                // reduced paths sample their own key times, the others share the time accessor of the animation
+                auto timeAccessor = [&](const std::vector<float> &times) -> const AccessorData & {
+                    if (times.empty()) {
+                        return *accessor;
+                    }
+                    auto keyAccessor = gltf->AddAccessorAndView(buffer, GLT_FLOAT, times);
+                    keyAccessor->min = { times.front() };
+                    keyAccessor->max = { times.back() };
+                    return *keyAccessor;
+                };
+
                 NodeData &nDat = require(nodesById, node.id);
                 if (!channel.translations.empty()) {
-                    aDat.AddNodeChannel(nDat, *gltf->AddAccessorAndView(buffer, GLT_VEC3F, channel.translations), "translation");
+                    aDat.AddNodeChannel(nDat, timeAccessor(channel.translationTimes), *gltf->AddAccessorAndView(buffer, GLT_VEC3F, channel.translations), "translation");
                 }
                 if (!channel.rotations.empty()) {
-                    aDat.AddNodeChannel(nDat, *gltf->AddAccessorAndView(buffer, GLT_QUATF, channel.rotations), "rotation");
+                    aDat.AddNodeChannel(nDat, timeAccessor(channel.rotationTimes), *gltf->AddAccessorAndView(buffer, GLT_QUATF, channel.rotations), "rotation");
                 }
                 if (!channel.scales.empty()) {
-                    aDat.AddNodeChannel(nDat, *gltf->AddAccessorAndView(buffer, GLT_VEC3F, channel.scales), "scale");
+                    aDat.AddNodeChannel(nDat, timeAccessor(channel.scaleTimes), *gltf->AddAccessorAndView(buffer, GLT_VEC3F, channel.scales), "scale");
                 }
                 if (!channel.weights.empty()) {
-                    aDat.AddNodeChannel(nDat, *gltf->AddAccessorAndView(buffer, {CT_FLOAT, 1, "SCALAR"}, channel.weights), "weights");
+                    aDat.AddNodeChannel(nDat, timeAccessor(channel.weightTimes), *gltf->AddAccessorAndView(buffer, {CT_FLOAT, 1, "SCALAR"}, channel.weights), "weights");
                 }
             }
         }
@@ -442,7 +456,8 @@ ModelData *Raw2Gltf(
                 int width {};
                 int height {};
                 int channels {};
-                uint8_t *pixels {};
+                const uint8_t *pixels {};
+                std::shared_ptr<const ImagePixels> image;
             };
 
             int width = -1, height = -1;
@@ -455,7 +470,13 @@ ModelData *Raw2Gltf(
                     const std::string &fileLoc = rawTex.fileLocation;
                     const std::string &name    = StringUtils::GetFileBaseString(StringUtils::GetFileNameString(fileLoc));
                     if (!fileLoc.empty()) {
-                        info.pixels = stbi_load(fileLoc.c_str(), &info.width, &info.height, &info.channels, 0);
+                        info.image = GetImagePixels(fileLoc.c_str());
+                        if (info.image) {
+                            info.width    = info.image->width;
+                            info.height   = info.image->height;
+                            info.channels = info.image->channels;
+                            info.pixels   = info.image->pixels.data();
+                        }
                         if (!info.pixels) {
                             fmt::printf("Warning: merge texture [%d](%s) could not be loaded.\n",
                                 rawTexIx,
@@ -555,6 +576,7 @@ ModelData *Raw2Gltf(
                     return nullptr;
                 }
                 fclose(fp);
+                imageFiles.insert(imagePath);
                 if (verboseOutput) {
                     fmt::printf("Wrote %lu bytes to texture '%s'.\n", imgBuffer.size(), imagePath);
                 }
@@ -592,6 +614,7 @@ ModelData *Raw2Gltf(
                 image = new ImageData(relativeFilename, relativeFilename);
                 std::string outputPath = outputFolder + relativeFilename;
                 if (FileUtils::CopyFile(rawTexture.fileLocation, outputPath)) {
+                    imageFiles.insert(outputPath);
                     if (verboseOutput) {
                         fmt::printf("Copied texture '%s' to output folder: %s\n", textureName, outputPath);
                     }
@@ -870,7 +893,7 @@ ModelData *Raw2Gltf(
                         GLT_VEC3F, draco::GeometryAttribute::NORMAL, draco::DT_FLOAT32);
                     gltf->AddAttributeToPrimitive<Vec3f>(buffer, surfaceModel, *primitive, ATTR_NORMAL);
                 }
-                if ((surfaceModel.GetVertexAttributes() & RAW_VERTEX_ATTRIBUTE_TANGENT) != 0) {
+                if ((surfaceModel.GetVertexAttributes() & RAW_VERTEX_ATTRIBUTE_BINORMAL) != 0) {
                     const AttributeDefinition<Vec4f> ATTR_TANGENT("TANGENT", &RawVertex::tangent, GLT_VEC4F);
                     gltf->AddAttributeToPrimitive<Vec4f>(buffer, surfaceModel, *primitive, ATTR_TANGENT);
                 }
@@ -910,7 +933,7 @@ ModelData *Raw2Gltf(
                     std::vector<Vec3f> positions, normals;
                     std::vector<Vec4f> tangents;
                     for (int jj = 0; jj < surfaceModel.GetVertexCount(); jj ++) {
-                        auto blendVertex = surfaceModel.GetVertex(jj).blends[channelIx];
+                        auto blendVertex = surfaceModel.GetVertexStreams().GetBlend(jj, channelIx);
                         shapeBounds.AddPoint(blendVertex.position);
                         positions.push_back(blendVertex.position);
                         if (options.useBlendShapeTangents && channel.hasNormals) {
@@ -1144,5 +1167,54 @@ ModelData *Raw2Gltf(
         gltfOutStream.seekp(0, std::ios::end);
     }
 
-    return new ModelData(gltf->binary);
+    return new ModelData(gltf->binary, std::vector<std::string>(imageFiles.begin(), imageFiles.end()));
+}
+
+bool ExportGltf(
+    const std::string &modelPath,
+    const std::string &outputFolder,
+    const RawModel &raw,
+    const GltfOptions &options,
+    std::vector<std::string> &outputFiles)
+{
+    std::ofstream outStream(modelPath, std::ios::trunc | std::ios::out | std::ios::binary);
+    if (outStream.fail()) {
+        fmt::fprintf(stderr, "ERROR:: Couldn't open file for writing: %s\n", modelPath.c_str());
+        return false;
+    }
+    const std::unique_ptr<ModelData> data(Raw2Gltf(outStream, outputFolder, raw, options));
+    const unsigned long modelSize = (unsigned long) outStream.tellp();
+    outStream.close();
+    if (outStream.fail()) {
+        fmt::fprintf(stderr, "ERROR:: Failed to write file: %s\n", modelPath.c_str());
+        return false;
+    }
+    outputFiles.push_back(modelPath);
+    if (verboseOutput) {
+        fmt::printf("Wrote %lu bytes of %s to %s.\n", modelSize, options.outputBinary ? "binary glTF" : "glTF", modelPath);
+    }
+
+    // Everything is inside the .glb file
+    if (options.outputBinary) {
+        return true;
+    }
+
+    if (options.embedResources == false) {
+        const std::string binaryPath = outputFolder + extBufferFilename;
+        std::ofstream binaryStream(binaryPath, std::ios::trunc | std::ios::out | std::ios::binary);
+        binaryStream.write((const char *) data->binary->data(), data->binary->size());
+        binaryStream.close();
+        if (binaryStream.fail()) {
+            fmt::fprintf(stderr, "ERROR:: Failed to write %lu bytes to file '%s'.\n", (unsigned long) data->binary->size(), binaryPath.c_str());
+            return false;
+        }
+        outputFiles.push_back(binaryPath);
+        if (verboseOutput) {
+            fmt::printf("Wrote %lu bytes of binary data to %s.\n", (unsigned long) data->binary->size(), binaryPath);
+        }
+    }
+
+    // Textures are copied next to the model and the merged ones written there
+    outputFiles.insert(outputFiles.end(), data->imageFiles.begin(), data->imageFiles.end());
+    return true;
 }
@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 // This can be a macro under Windows, confusing Draco
 #undef ERROR
@@ -179,12 +180,15 @@ struct TextureData;
 
 struct ModelData
 {
-    explicit ModelData(std::shared_ptr<const std::vector<uint8_t> > const &_binary)
-        : binary(_binary)
+    explicit ModelData(std::shared_ptr<const std::vector<uint8_t> > const &_binary, std::vector<std::string> const &_imageFiles)
+        : binary(_binary),
+          imageFiles(_imageFiles)
     {
     }
 
     std::shared_ptr<const std::vector<uint8_t> > const binary;
+    // The textures copied or merged into the output folder, each once
+    std::vector<std::string> const imageFiles;
 };
 
 ModelData *Raw2Gltf(
@@ -194,4 +198,17 @@ ModelData *Raw2Gltf(
     const GltfOptions &options
 );
 
+/**
+ * Writes the model to modelPath as glTF, or as a .glb file with options.outputBinary. A .gltf file that doesn't embed
+ * its resources shares outputFolder, which ends with a separator, with its buffer and textures. The files written are
+ * appended to outputFiles.
+ */
+bool ExportGltf(
+    const std::string &modelPath,
+    const std::string &outputFolder,
+    const RawModel &raw,
+    const GltfOptions &options,
+    std::vector<std::string> &outputFiles
+);
+
 #endif // !__RAW2GLTF_H__
@@ -12,7 +12,8 @@
 #include <unordered_map>
 #include <cmath>
 #include <map>
-#include <set>
+#include <atomic>
+#include <array>
 
 #if defined( __unix__ )
 #include <algorithm>
@@ -21,6 +22,7 @@
 #include "FBX2glTF.h"
 #include "utils/String_Utils.h"
 #include "utils/Image_Utils.h"
+#include "utils/Thread_Utils.h"
 #include "RawModel.h"
 
 extern bool verboseOutput;
@@ -56,6 +58,258 @@ size_t RawVertex::Difference(const RawVertex &other) const
     return attributes;
 }
 
+const RawVertex      RawVertexStreams::defaultVertex;
+const RawBlendVertex RawVertexStreams::defaultBlend;
+
+template<typename _value_type_>
+static void AddStreamValue(std::vector<_value_type_> &stream, const size_t count, const _value_type_ &value, const _value_type_ &defaultValue)
+{
+    // Streams stay unallocated until the first value that differs from the default.
+    if (stream.empty()) {
+        if (value == defaultValue) {
+            return;
+        }
+        stream.assign(count, defaultValue);
+    }
+    stream.push_back(value);
+}
+
+template<typename _value_type_>
+static void CompactStream(std::vector<_value_type_> &stream, const std::vector<int> &targets, const int count)
+{
+    if (stream.empty()) {
+        return;
+    }
+    std::vector<_value_type_> compacted((size_t) count);
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (targets[i] >= 0) {
+            compacted[targets[i]] = std::move(stream[i]);
+        }
+    }
+    stream.swap(compacted);
+}
+
+void RawVertexStreams::AddBlends(const RawVertex &vertex)
+{
+    if (blendSpans.empty()) {
+        if (vertex.blends.empty()) {
+            return;
+        }
+        blendSpans.assign(count, RawBlendSpan { 0, 0, 0 });
+    }
+    RawBlendSpan span { (int) blendArena.size(), 0, (int) vertex.blends.size() };
+    for (int channel = 0; channel < span.channelCount; channel++) {
+        if (!(vertex.blends[channel] == defaultBlend)) {
+            blendArena.push_back(RawBlendDelta { channel, vertex.blends[channel] });
+            span.count++;
+        }
+    }
+    blendSpans.push_back(span);
+}
+
+void RawVertexStreams::AddBlends(const RawVertexStreams &other, const int index)
+{
+    if (blendSpans.empty()) {
+        if (other.GetBlendChannelCount(index) == 0) {
+            return;
+        }
+        blendSpans.assign(count, RawBlendSpan { 0, 0, 0 });
+    }
+    const RawBlendSpan &otherSpan = other.blendSpans[index];
+    blendSpans.push_back(RawBlendSpan { (int) blendArena.size(), otherSpan.count, otherSpan.channelCount });
+    blendArena.insert(blendArena.end(),
+        other.blendArena.begin() + otherSpan.offset, other.blendArena.begin() + otherSpan.offset + otherSpan.count);
+}
+
+bool RawVertexStreams::BlendsEqual(const int index, const RawVertex &vertex) const
+{
+    if (GetBlendChannelCount(index) != (int) vertex.blends.size()) {
+        return false;
+    }
+    if (vertex.blends.empty()) {
+        return true;
+    }
+    const RawBlendSpan &span = blendSpans[index];
+    int next = 0;
+    for (int channel = 0; channel < span.channelCount; channel++) {
+        if (next < span.count && blendArena[span.offset + next].channel == channel) {
+            if (!(blendArena[span.offset + next++].delta == vertex.blends[channel])) {
+                return false;
+            }
+        } else if (!(vertex.blends[channel] == defaultBlend)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RawVertexStreams::BlendsEqual(const int index, const RawVertexStreams &other, const int otherIndex) const
+{
+    // Both sides only store the non-zero deltas in channel order, so the spans compare directly.
+    if (GetBlendChannelCount(index) != other.GetBlendChannelCount(otherIndex)) {
+        return false;
+    }
+    if (blendSpans.empty() || other.blendSpans.empty()) {
+        return true;
+    }
+    const RawBlendSpan &span      = blendSpans[index];
+    const RawBlendSpan &otherSpan = other.blendSpans[otherIndex];
+    return span.count == otherSpan.count &&
+           std::equal(blendArena.begin() + span.offset, blendArena.begin() + span.offset + span.count,
+               other.blendArena.begin() + otherSpan.offset);
+}
+
+RawBlendVertex RawVertexStreams::GetBlend(const int index, const int channel) const
+{
+    if (blendSpans.empty()) {
+        return defaultBlend;
+    }
+    const RawBlendSpan &span = blendSpans[index];
+    const auto begin = blendArena.begin() + span.offset;
+    const auto end   = begin + span.count;
+    const auto it    = std::lower_bound(begin, end, channel, [](const RawBlendDelta &delta, const int channel) {
+        return delta.channel < channel;
+    });
+    return (it != end && it->channel == channel) ? it->delta : defaultBlend;
+}
+
+void RawVertexStreams::Add(const RawVertex &vertex)
+{
+    AddStreamValue(position, count, vertex.position, defaultVertex.position);
+    AddStreamValue(normal, count, vertex.normal, defaultVertex.normal);
+    AddStreamValue(binormal, count, vertex.binormal, defaultVertex.binormal);
+    AddStreamValue(tangent, count, vertex.tangent, defaultVertex.tangent);
+    AddStreamValue(color, count, vertex.color, defaultVertex.color);
+    AddStreamValue(uv0, count, vertex.uv0, defaultVertex.uv0);
+    AddStreamValue(uv1, count, vertex.uv1, defaultVertex.uv1);
+    AddStreamValue(jointIndices, count, vertex.jointIndices, defaultVertex.jointIndices);
+    AddStreamValue(jointWeights, count, vertex.jointWeights, defaultVertex.jointWeights);
+    AddStreamValue(blendSurfaceIx, count, vertex.blendSurfaceIx, defaultVertex.blendSurfaceIx);
+    AddBlends(vertex);
+    AddStreamValue(polarityUv0, count, (uint8_t) vertex.polarityUv0, (uint8_t) defaultVertex.polarityUv0);
+    count++;
+}
+
+void RawVertexStreams::Add(const RawVertexStreams &other, const int index)
+{
+    AddStreamValue(position, count, other.GetPosition(index), defaultVertex.position);
+    AddStreamValue(normal, count, other.GetNormal(index), defaultVertex.normal);
+    AddStreamValue(binormal, count, other.GetBinormal(index), defaultVertex.binormal);
+    AddStreamValue(tangent, count, other.GetTangent(index), defaultVertex.tangent);
+    AddStreamValue(color, count, other.GetColor(index), defaultVertex.color);
+    AddStreamValue(uv0, count, other.GetUv0(index), defaultVertex.uv0);
+    AddStreamValue(uv1, count, other.GetUv1(index), defaultVertex.uv1);
+    AddStreamValue(jointIndices, count, other.GetJointIndices(index), defaultVertex.jointIndices);
+    AddStreamValue(jointWeights, count, other.GetJointWeights(index), defaultVertex.jointWeights);
+    AddStreamValue(blendSurfaceIx, count, other.GetBlendSurfaceIx(index), defaultVertex.blendSurfaceIx);
+    AddBlends(other, index);
+    AddStreamValue(polarityUv0, count, (uint8_t) other.GetPolarityUv0(index), (uint8_t) defaultVertex.polarityUv0);
+    count++;
+}
+
+void RawVertexStreams::Clear()
+{
+    *this = RawVertexStreams();
+}
+
+void RawVertexStreams::Compact(const std::vector<int> &targets, const int count)
+{
+    CompactStream(position, targets, count);
+    CompactStream(normal, targets, count);
+    CompactStream(binormal, targets, count);
+    CompactStream(tangent, targets, count);
+    CompactStream(color, targets, count);
+    CompactStream(uv0, targets, count);
+    CompactStream(uv1, targets, count);
+    CompactStream(jointIndices, targets, count);
+    CompactStream(jointWeights, targets, count);
+    CompactStream(blendSurfaceIx, targets, count);
+    if (!blendSpans.empty()) {
+        // Copy the kept spans into a fresh arena in their new order, dropping the deltas of removed vertices.
+        CompactStream(blendSpans, targets, count);
+        std::vector<RawBlendDelta> compacted;
+        for (auto &span : blendSpans) {
+            const int offset = (int) compacted.size();
+            compacted.insert(compacted.end(), blendArena.begin() + span.offset, blendArena.begin() + span.offset + span.count);
+            span.offset = offset;
+        }
+        blendArena.swap(compacted);
+    }
+    CompactStream(polarityUv0, targets, count);
+    this->count = (size_t) count;
+}
+
+RawVertex RawVertexStreams::GetVertex(const int index) const
+{
+    RawVertex vertex;
+    vertex.position       = GetPosition(index);
+    vertex.normal         = GetNormal(index);
+    vertex.binormal       = GetBinormal(index);
+    vertex.tangent        = GetTangent(index);
+    vertex.color          = GetColor(index);
+    vertex.uv0            = GetUv0(index);
+    vertex.uv1            = GetUv1(index);
+    vertex.jointIndices   = GetJointIndices(index);
+    vertex.jointWeights   = GetJointWeights(index);
+    vertex.blendSurfaceIx = GetBlendSurfaceIx(index);
+    vertex.blends.resize((size_t) GetBlendChannelCount(index));
+    if (!vertex.blends.empty()) {
+        const RawBlendSpan &span = blendSpans[index];
+        for (int i = 0; i < span.count; i++) {
+            vertex.blends[blendArena[span.offset + i].channel] = blendArena[span.offset + i].delta;
+        }
+    }
+    vertex.polarityUv0    = GetPolarityUv0(index);
+    return vertex;
+}
+
+bool RawVertexStreams::Equals(const int index, const RawVertex &vertex) const
+{
+    return (GetPosition(index) == vertex.position) &&
+           (GetNormal(index) == vertex.normal) &&
+           (GetTangent(index) == vertex.tangent) &&
+           (GetBinormal(index) == vertex.binormal) &&
+           (GetColor(index) == vertex.color) &&
+           (GetUv0(index) == vertex.uv0) &&
+           (GetUv1(index) == vertex.uv1) &&
+           (GetJointIndices(index) == vertex.jointIndices) &&
+           (GetJointWeights(index) == vertex.jointWeights) &&
+           (GetPolarityUv0(index) == vertex.polarityUv0) &&
+           (GetBlendSurfaceIx(index) == vertex.blendSurfaceIx) &&
+           BlendsEqual(index, vertex);
+}
+
+bool RawVertexStreams::Equals(const int index, const RawVertexStreams &other, const int otherIndex) const
+{
+    return (GetPosition(index) == other.GetPosition(otherIndex)) &&
+           (GetNormal(index) == other.GetNormal(otherIndex)) &&
+           (GetTangent(index) == other.GetTangent(otherIndex)) &&
+           (GetBinormal(index) == other.GetBinormal(otherIndex)) &&
+           (GetColor(index) == other.GetColor(otherIndex)) &&
+           (GetUv0(index) == other.GetUv0(otherIndex)) &&
+           (GetUv1(index) == other.GetUv1(otherIndex)) &&
+           (GetJointIndices(index) == other.GetJointIndices(otherIndex)) &&
+           (GetJointWeights(index) == other.GetJointWeights(otherIndex)) &&
+           (GetPolarityUv0(index) == other.GetPolarityUv0(otherIndex)) &&
+           (GetBlendSurfaceIx(index) == other.GetBlendSurfaceIx(otherIndex)) &&
+           BlendsEqual(index, other, otherIndex);
+}
+
+size_t RawVertexStreams::Difference(const int index, const RawVertex &other) const
+{
+    size_t attributes = 0;
+    if (GetPosition(index) != other.position) { attributes |= RAW_VERTEX_ATTRIBUTE_POSITION; }
+    if (GetNormal(index) != other.normal) { attributes |= RAW_VERTEX_ATTRIBUTE_NORMAL; }
+    if (GetBinormal(index) != other.binormal) { attributes |= RAW_VERTEX_ATTRIBUTE_BINORMAL; }
+    if (GetColor(index) != other.color) { attributes |= RAW_VERTEX_ATTRIBUTE_COLOR; }
+    if (GetUv0(index) != other.uv0) { attributes |= RAW_VERTEX_ATTRIBUTE_UV0; }
+    if (GetUv1(index) != other.uv1) { attributes |= RAW_VERTEX_ATTRIBUTE_UV1; }
+    // Always need both or neither.
+    if (GetJointIndices(index) != other.jointIndices) { attributes |= RAW_VERTEX_ATTRIBUTE_JOINT_INDICES | RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS; }
+    if (GetJointWeights(index) != other.jointWeights) { attributes |= RAW_VERTEX_ATTRIBUTE_JOINT_INDICES | RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS; }
+    return attributes;
+}
+
 RawModel::RawModel()
     : vertexAttributes(0)
 {
@@ -66,15 +320,98 @@ void RawModel::AddVertexAttribute(const RawVertexAttribute attrib)
     vertexAttributes |= attrib;
 }
 
+int RawVertexMap::Find(const RawVertex &vertex, const size_t hash, const RawVertexStreams &vertices) const
+{
+    if (slots.empty()) {
+        return -1;
+    }
+    const size_t mask = slots.size() - 1;
+    for (size_t slot = hash & mask; slots[slot] >= 0; slot = (slot + 1) & mask) {
+        const int index = slots[slot];
+        if (hashes[index] == hash && vertices.Equals(index, vertex)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int RawVertexMap::Find(const RawVertexStreams &other, const int otherIndex, const size_t hash, const RawVertexStreams &vertices) const
+{
+    if (slots.empty()) {
+        return -1;
+    }
+    const size_t mask = slots.size() - 1;
+    for (size_t slot = hash & mask; slots[slot] >= 0; slot = (slot + 1) & mask) {
+        const int index = slots[slot];
+        if (hashes[index] == hash && vertices.Equals(index, other, otherIndex)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+void RawVertexMap::Insert(const int index, const size_t hash)
+{
+    assert(index == (int) hashes.size());
+    hashes.push_back(hash);
+    // Keep the load factor at or below one half so probe sequences stay short.
+    if (hashes.size() * 2 > slots.size()) {
+        Grow();
+        return;
+    }
+    const size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    while (slots[slot] >= 0) {
+        slot = (slot + 1) & mask;
+    }
+    slots[slot] = index;
+}
+
+void RawVertexMap::Clear()
+{
+    slots.clear();
+    hashes.clear();
+}
+
+void RawVertexMap::Grow()
+{
+    // Rehash from the stored hashes, the vertices themselves are never touched.
+    size_t capacity = std::max(slots.size() * 2, (size_t) 64);
+    while (hashes.size() * 2 > capacity) {
+        capacity *= 2;
+    }
+    slots.assign(capacity, -1);
+    const size_t mask = capacity - 1;
+    for (size_t index = 0; index < hashes.size(); index++) {
+        size_t slot = hashes[index] & mask;
+        while (slots[slot] >= 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = (int) index;
+    }
+}
+
 int RawModel::AddVertex(const RawVertex &vertex)
 {
-    auto it = vertexHash.find(vertex);
-    if (it != vertexHash.end()) {
-        return it->second;
+    if (vertexMap.GetCount() != vertices.GetCount()) {
+        RehashVertices();
+    }
+    const size_t hash = VertexHasher()(vertex);
+    const int    index = vertexMap.Find(vertex, hash, vertices);
+    if (index >= 0) {
+        return index;
+    }
+    vertexMap.Insert((int) vertices.GetCount(), hash);
+    vertices.Add(vertex);
+    return (int) vertices.GetCount() - 1;
+}
+
+void RawModel::RehashVertices()
+{
+    vertexMap.Clear();
+    for (size_t i = 0; i < vertices.GetCount(); i++) {
+        vertexMap.Insert((int) i, VertexHasher()(vertices.GetVertex((int) i)));
     }
-    vertexHash.emplace(vertex, (int) vertices.size());
-    vertices.push_back(vertex);
-    return (int) vertices.size() - 1;
 }
 
 int RawModel::AddTriangle(const int v0, const int v1, const int v2, const int materialIndex, const int surfaceIndex)
@@ -111,6 +448,17 @@ int RawModel::AddTexture(const std::string &name, const std::string &fileName, c
     return (int) textures.size() - 1;
 }
 
+int RawModel::AddTexture(const RawTexture &texture)
+{
+    for (size_t i = 0; i < textures.size(); i++) {
+        if (StringUtils::CompareNoCase(textures[i].name, texture.name) == 0 && textures[i].usage == texture.usage) {
+            return (int) i;
+        }
+    }
+    textures.emplace_back(texture);
+    return (int) textures.size() - 1;
+}
+
 int RawModel::AddMaterial(const RawMaterial &material)
 {
     return AddMaterial(material.name.c_str(), material.type, material.textures, material.info);
@@ -163,6 +511,7 @@ int RawModel::AddSurface(const RawSurface &surface)
         }
     }
 
+    surfaceIndices.emplace(surface.id, (int) surfaces.size());
     surfaces.emplace_back(surface);
     return (int) (surfaces.size() - 1);
 }
@@ -171,10 +520,9 @@ int RawModel::AddSurface(const char *name, const long surfaceId)
 {
     assert(name[0] != '\0');
 
-    for (size_t i = 0; i < surfaces.size(); i++) {
-        if (surfaces[i].id == surfaceId) {
-            return (int) i;
-        }
+    const int surfaceIndex = GetSurfaceById(surfaceId);
+    if (surfaceIndex >= 0) {
+        return surfaceIndex;
     }
     RawSurface  surface;
     surface.id = surfaceId;
@@ -182,6 +530,7 @@ int RawModel::AddSurface(const char *name, const long surfaceId)
     surface.bounds.Clear();
     surface.discrete  = false;
 
+    surfaceIndices.emplace(surfaceId, (int) surfaces.size());
     surfaces.emplace_back(surface);
     return (int) (surfaces.size() - 1);
 }
@@ -194,10 +543,9 @@ int RawModel::AddAnimation(const RawAnimation &animation)
 
 int RawModel::AddNode(const RawNode &node)
 {
-    for (size_t i = 0; i < nodes.size(); i++) {
-        if (nodes[i].id == node.id) {
-            return (int)i;
-        }
+    auto it = nodeIndices.emplace(node.id, (int) nodes.size());
+    if (it.second == false) {
+        return it.first->second;
     }
 
     nodes.emplace_back(node);
@@ -240,10 +588,9 @@ int RawModel::AddNode(const long id, const char *name, const long parentId)
 {
     assert(name[0] != '\0');
 
-    for (size_t i = 0; i < nodes.size(); i++) {
-        if (nodes[i].id == id ) {
-            return (int) i;
-        }
+    const int nodeIndex = GetNodeById(id);
+    if (nodeIndex >= 0) {
+        return nodeIndex;
     }
 
     RawNode joint;
@@ -256,75 +603,249 @@ int RawModel::AddNode(const long id, const char *name, const long parentId)
     joint.rotation    = Quatf(0, 0, 0, 1);
     joint.scale       = Vec3f(1, 1, 1);
 
+    nodeIndices.emplace(id, (int) nodes.size());
     nodes.emplace_back(joint);
     return (int) nodes.size() - 1;
 }
 
+// Moves every element to its target index in place by following the permutation cycles, elements
+// with a target of -1 are dropped. The targets of the kept elements must be unique and below count.
+template<typename _value_type_>
+static void CompactInPlace(std::vector<_value_type_> &values, std::vector<int> &targets, const int count)
+{
+    int next = count;
+    for (auto &target : targets) {
+        if (target < 0) {
+            target = next++;
+        }
+    }
+    for (int i = 0; i < (int) values.size(); i++) {
+        while (targets[i] != i) {
+            const int target = targets[i];
+            std::swap(values[i], values[target]);
+            std::swap(targets[i], targets[target]);
+        }
+    }
+    values.resize(count);
+}
+
 void RawModel::Condense()
 {
+    // Everything is renumbered in order of first use, like re-adding it would, and merged the same way
+    // AddSurface, AddMaterial, AddTexture and AddVertex would merge it.
+    std::vector<int> remap;
+    std::vector<int> targets;
+
     // Only keep surfaces that are referenced by one or more triangles.
     {
-        std::vector<RawSurface> oldSurfaces = surfaces;
-
-        surfaces.clear();
+        std::unordered_map<long, int> surfaceIds;
+        remap.assign(surfaces.size(), -1);
+        targets.assign(surfaces.size(), -1);
 
         for (auto &triangle : triangles) {
-            const RawSurface &surface = oldSurfaces[triangle.surfaceIndex];
-            const int surfaceIndex = AddSurface(surface.name.c_str(), surface.id);
-            surfaces[surfaceIndex] = surface;
+            int &surfaceIndex = remap[triangle.surfaceIndex];
+            if (surfaceIndex < 0) {
+                auto it = surfaceIds.emplace(surfaces[triangle.surfaceIndex].id, (int) surfaceIds.size());
+                if (it.second) {
+                    targets[triangle.surfaceIndex] = it.first->second;
+                }
+                surfaceIndex = it.first->second;
+            }
             triangle.surfaceIndex = surfaceIndex;
         }
+
+        CompactInPlace(surfaces, targets, (int) surfaceIds.size());
+
+        surfaceIndices.clear();
+        for (size_t i = 0; i < surfaces.size(); i++) {
+            surfaceIndices.emplace(surfaces[i].id, (int) i);
+        }
     }
 
     // Only keep materials that are referenced by one or more triangles.
     {
-        std::vector<RawMaterial> oldMaterials = materials;
-
-        materials.clear();
+        int materialCount = 0;
+        remap.assign(materials.size(), -1);
+        targets.assign(materials.size(), -1);
+        std::vector<int> sources;
 
         for (auto &triangle : triangles) {
-            const RawMaterial &material = oldMaterials[triangle.materialIndex];
-            const int materialIndex = AddMaterial(material);
-            materials[materialIndex] = material;
+            int &materialIndex = remap[triangle.materialIndex];
+            if (materialIndex < 0) {
+                const RawMaterial &material = materials[triangle.materialIndex];
+                for (int i = 0; i < materialCount && materialIndex < 0; i++) {
+                    const RawMaterial &other = materials[sources[i]];
+                    if (other.name == material.name && other.type == material.type && *other.info == *material.info &&
+                        std::equal(std::begin(other.textures), std::end(other.textures), std::begin(material.textures))) {
+                        materialIndex = i;
+                    }
+                }
+                if (materialIndex < 0) {
+                    materialIndex = materialCount++;
+                    targets[triangle.materialIndex] = materialIndex;
+                    sources.push_back(triangle.materialIndex);
+                }
+            }
             triangle.materialIndex = materialIndex;
         }
+
+        CompactInPlace(materials, targets, materialCount);
     }
 
     // Only keep textures that are referenced by one or more materials.
     {
-        std::vector<RawTexture> oldTextures = textures;
-
-        textures.clear();
+        int textureCount = 0;
+        remap.assign(textures.size(), -1);
+        targets.assign(textures.size(), -1);
+        std::vector<int> sources;
 
         for (auto &material : materials) {
             for (int j = 0; j < RAW_TEXTURE_USAGE_MAX; j++) {
-                if (material.textures[j] >= 0) {
-                    const RawTexture &texture = oldTextures[material.textures[j]];
-                    const int textureIndex = AddTexture(texture.name, texture.fileName, texture.fileLocation, texture.usage);
-                    textures[textureIndex] = texture;
-                    material.textures[j] = textureIndex;
+                if (material.textures[j] < 0) {
+                    continue;
+                }
+                int &textureIndex = remap[material.textures[j]];
+                if (textureIndex < 0) {
+                    const RawTexture &texture = textures[material.textures[j]];
+                    for (int i = 0; i < textureCount && textureIndex < 0; i++) {
+                        const RawTexture &other = textures[sources[i]];
+                        if (StringUtils::CompareNoCase(other.name, texture.name) == 0 && other.usage == texture.usage) {
+                            textureIndex = i;
+                        }
+                    }
+                    if (textureIndex < 0) {
+                        textureIndex = textureCount++;
+                        targets[material.textures[j]] = textureIndex;
+                        sources.push_back(material.textures[j]);
+                    }
                 }
+                material.textures[j] = textureIndex;
             }
         }
+
+        CompactInPlace(textures, targets, textureCount);
     }
 
     // Only keep vertices that are referenced by one or more triangles.
     {
-        std::vector<RawVertex> oldVertices = vertices;
+        // Vertices that all went through AddVertex are unique and hashed, only vertices changed since
+        // have to be hashed again and merged with their first equal vertex.
+        std::vector<int> canonical(vertices.GetCount());
+        if (vertexMap.GetCount() == vertices.GetCount()) {
+            for (int i = 0; i < (int) vertices.GetCount(); i++) {
+                canonical[i] = i;
+            }
+        } else {
+            RehashVertices();
+            for (int i = 0; i < (int) vertices.GetCount(); i++) {
+                const int match = vertexMap.Find(vertices, i, vertexMap.GetHash(i), vertices);
+                canonical[i] = (match >= 0 && match < i) ? canonical[match] : i;
+            }
+        }
 
-        vertexHash.clear();
-        vertices.clear();
+        std::vector<size_t> hashes;
+        int vertexCount = 0;
+        remap.assign(vertices.GetCount(), -1);
+        targets.assign(vertices.GetCount(), -1);
 
         for (auto &triangle : triangles) {
             for (int j = 0; j < 3; j++) {
-                triangle.verts[j] = AddVertex(oldVertices[triangle.verts[j]]);
+                const int vertexIndex = canonical[triangle.verts[j]];
+                if (remap[vertexIndex] < 0) {
+                    remap[vertexIndex] = vertexCount++;
+                    targets[vertexIndex] = remap[vertexIndex];
+                    hashes.push_back(vertexMap.GetHash(vertexIndex));
+                }
+                triangle.verts[j] = remap[vertexIndex];
             }
         }
+
+        vertices.Compact(targets, vertexCount);
+
+        vertexMap.Clear();
+        for (int i = 0; i < vertexCount; i++) {
+            vertexMap.Insert(i, hashes[i]);
+        }
+    }
+}
+
+void RawModel::Append(const RawModel &other)
+{
+    vertexAttributes |= other.vertexAttributes;
+
+    std::vector<int> textureRemap(other.textures.size());
+    for (size_t i = 0; i < other.textures.size(); i++) {
+        textureRemap[i] = AddTexture(other.textures[i]);
+    }
+
+    std::vector<int> materialRemap(other.materials.size());
+    for (size_t i = 0; i < other.materials.size(); i++) {
+        RawMaterial material = other.materials[i];
+        for (int &texture : material.textures) {
+            texture = (texture >= 0) ? textureRemap[texture] : -1;
+        }
+        materialRemap[i] = AddMaterial(material);
+    }
+
+    // Surfaces are matched by id only, like AddSurface(name, surfaceId) does.
+    std::vector<int> surfaceRemap(other.surfaces.size());
+    for (size_t i = 0; i < other.surfaces.size(); i++) {
+        int surfaceIndex = GetSurfaceById(other.surfaces[i].id);
+        if (surfaceIndex < 0) {
+            surfaceIndex = (int) surfaces.size();
+            surfaceIndices.emplace(other.surfaces[i].id, surfaceIndex);
+            surfaces.emplace_back(other.surfaces[i]);
+        }
+        surfaceRemap[i] = surfaceIndex;
+    }
+
+    if (vertexMap.GetCount() != vertices.GetCount()) {
+        RehashVertices();
+    }
+    const bool reuseHashes = other.vertexMap.GetCount() == other.vertices.GetCount();
+
+    std::vector<int> vertexRemap(other.vertices.GetCount());
+    for (int i = 0; i < (int) other.vertices.GetCount(); i++) {
+        // Blend shape vertices refer to their surface, which may have moved.
+        const int blendSurfaceIx = other.vertices.GetBlendSurfaceIx(i);
+        if (blendSurfaceIx >= 0 && surfaceRemap[blendSurfaceIx] != blendSurfaceIx) {
+            RawVertex vertex = other.vertices.GetVertex(i);
+            vertex.blendSurfaceIx = surfaceRemap[blendSurfaceIx];
+            vertexRemap[i] = AddVertex(vertex);
+            continue;
+        }
+        const size_t hash = reuseHashes ? other.vertexMap.GetHash(i) : VertexHasher()(other.vertices.GetVertex(i));
+        int index = vertexMap.Find(other.vertices, i, hash, vertices);
+        if (index < 0) {
+            index = (int) vertices.GetCount();
+            vertexMap.Insert(index, hash);
+            vertices.Add(other.vertices, i);
+        }
+        vertexRemap[i] = index;
+    }
+
+    triangles.reserve(triangles.size() + other.triangles.size());
+    for (const RawTriangle &triangle : other.triangles) {
+        AddTriangle(
+            vertexRemap[triangle.verts[0]], vertexRemap[triangle.verts[1]], vertexRemap[triangle.verts[2]],
+            materialRemap[triangle.materialIndex], surfaceRemap[triangle.surfaceIndex]);
     }
 }
 
-void RawModel::TransformGeometry(ComputeNormalsOption normals)
+void RawModel::ReleaseGeometry()
 {
+    vertices.Clear();
+    vertexMap = RawVertexMap();
+    std::vector<RawTriangle>().swap(triangles);
+}
+
+void RawModel::TransformGeometry(ComputeNormalsOption normals, ComputeTangentsOption tangents, const int jobs)
+{
+    // Tangents are built around the normals, a mesh without them gets them computed first.
+    if (tangents != ComputeTangentsOption::NEVER && normals == ComputeNormalsOption::NEVER) {
+        normals = ComputeNormalsOption::MISSING;
+    }
+
     switch(normals) {
         case ComputeNormalsOption::NEVER:
             break;
@@ -335,7 +856,7 @@ void RawModel::TransformGeometry(ComputeNormalsOption normals)
             // otherwise fall through
         case ComputeNormalsOption::BROKEN:
         case ComputeNormalsOption::ALWAYS:
-            size_t computedNormalsCount = this->CalculateNormals(normals == ComputeNormalsOption::BROKEN);
+            size_t computedNormalsCount = this->CalculateNormals(normals == ComputeNormalsOption::BROKEN, jobs);
             vertexAttributes |= RAW_VERTEX_ATTRIBUTE_NORMAL;
 
             if (verboseOutput) {
@@ -347,230 +868,731 @@ void RawModel::TransformGeometry(ComputeNormalsOption normals)
             }
             break;
     }
+
+    switch(tangents) {
+        case ComputeTangentsOption::NEVER:
+            break;
+        case ComputeTangentsOption::MISSING:
+            if ((vertexAttributes & RAW_VERTEX_ATTRIBUTE_BINORMAL) != 0) {
+                break;
+            }
+            // otherwise fall through
+        case ComputeTangentsOption::ALWAYS:
+            if ((vertexAttributes & RAW_VERTEX_ATTRIBUTE_UV0) == 0) {
+                fmt::printf("Warning: Tangents need texture coordinates, not computing tangents.\n");
+                break;
+            }
+            size_t computedTangentsCount = this->CalculateTangents(jobs);
+            vertexAttributes |= RAW_VERTEX_ATTRIBUTE_BINORMAL;
+
+            if (verboseOutput) {
+                fmt::printf("Computed %lu tangents.\n", computedTangentsCount);
+            }
+            break;
+    }
 }
 
-void RawModel::TransformTextures(const std::vector<std::function<Vec2f(Vec2f)>> &transforms)
+RawTextureTransform RawTextureTransform::FlipU()
 {
-    for (auto &vertice : vertices) {
-        if ((vertexAttributes & RAW_VERTEX_ATTRIBUTE_UV0) != 0) {
-            for (const auto &fun : transforms) {
-                vertice.uv0 = fun(vertice.uv0);
-            }
+    RawTextureTransform transform;
+    transform.m[0][0] = -1.0f;
+    transform.m[0][2] = 1.0f;
+    return transform;
+}
+
+RawTextureTransform RawTextureTransform::FlipV()
+{
+    RawTextureTransform transform;
+    transform.m[1][1] = -1.0f;
+    transform.m[1][2] = 1.0f;
+    return transform;
+}
+
+RawTextureTransform RawTextureTransform::Then(const RawTextureTransform &next) const
+{
+    RawTextureTransform result;
+    for (int row = 0; row < 2; row++) {
+        for (int col = 0; col < 3; col++) {
+            result.m[row][col] = next.m[row][0] * m[0][col] + next.m[row][1] * m[1][col];
         }
-        if ((vertexAttributes & RAW_VERTEX_ATTRIBUTE_UV1) != 0) {
-            for (const auto &fun : transforms) {
-                vertice.uv1 = fun(vertice.uv1);
+        result.m[row][2] += next.m[row][2];
+    }
+    return result;
+}
+
+bool RawTextureTransform::IsIdentity() const
+{
+    const RawTextureTransform identity;
+    for (int row = 0; row < 2; row++) {
+        for (int col = 0; col < 3; col++) {
+            if (m[row][col] != identity.m[row][col]) {
+                return false;
             }
         }
     }
+    return true;
 }
 
-struct TriangleModelSortPos
+// Branch free over plain floats so the compiler can vectorize it.
+static void TransformTextureStream(std::vector<Vec2f> &stream, const RawTextureTransform &transform)
 {
-    static bool Compare(const RawTriangle &a, const RawTriangle &b)
-    {
-        if (a.materialIndex != b.materialIndex) {
-            return a.materialIndex < b.materialIndex;
-        }
-        if (a.surfaceIndex != b.surfaceIndex) {
-            return a.surfaceIndex < b.surfaceIndex;
-        }
-        return a.verts[0] < b.verts[0];
+    const float m00 = transform.m[0][0], m01 = transform.m[0][1], m02 = transform.m[0][2];
+    const float m10 = transform.m[1][0], m11 = transform.m[1][1], m12 = transform.m[1][2];
+    Vec2f *uvs = stream.data();
+    const size_t count = stream.size();
+    for (size_t i = 0; i < count; i++) {
+        const float u = uvs[i][0];
+        const float v = uvs[i][1];
+        uvs[i][0] = m00 * u + m01 * v + m02;
+        uvs[i][1] = m10 * u + m11 * v + m12;
     }
-};
+}
 
-struct TriangleModelSortNeg
+void RawModel::TransformTextures(const RawTextureTransform &transform)
 {
-    static bool Compare(const RawTriangle &a, const RawTriangle &b)
-    {
-        if (a.materialIndex != b.materialIndex) {
-            return a.materialIndex < b.materialIndex;
+    if (transform.IsIdentity()) {
+        return;
+    }
+    if ((vertexAttributes & RAW_VERTEX_ATTRIBUTE_UV0) != 0) {
+        TransformTextureStream(vertices.GetUv0Stream(), transform);
+    }
+    if ((vertexAttributes & RAW_VERTEX_ATTRIBUTE_UV1) != 0) {
+        TransformTextureStream(vertices.GetUv1Stream(), transform);
+    }
+    // The vertices changed in place, they get hashed again when needed.
+    vertexMap.Clear();
+}
+
+void RawModel::RemapMaterials(const std::vector<int> &materialRemap, const std::vector<RawTextureTransform> &uvTransforms)
+{
+    for (auto &triangle : triangles) {
+        if (triangle.materialIndex < 0 || materialRemap[triangle.materialIndex] < 0) {
+            continue;
         }
-        if (a.surfaceIndex != b.surfaceIndex) {
-            return a.surfaceIndex < b.surfaceIndex;
+        const RawTextureTransform &transform = uvTransforms[triangle.materialIndex];
+        for (int &vertexIndex : triangle.verts) {
+            RawVertex vertex = vertices.GetVertex(vertexIndex);
+            vertex.uv0 = transform.Apply(vertex.uv0);
+            vertexIndex = AddVertex(vertex);
         }
-        return a.verts[0] > b.verts[0];
+        triangle.materialIndex = materialRemap[triangle.materialIndex];
     }
-};
+}
 
-void RawModel::CreateMaterialModels(
-    std::vector<RawModel> &materialModels, bool shortIndices, const int keepAttribs, const bool forceDiscrete) const
+// Scales the vector to unit length, zero vectors stay zero.
+static Vec3f NormalizeSafe(const Vec3f &vector)
 {
-    // Sort all triangles based on material first, then surface, then first vertex index.
-    std::vector<RawTriangle> sortedTriangles;
+    const float length = vector.Length();
+    return length > 0.0f ? vector / length : vector;
+}
 
-    bool invertedTransparencySort = true;
-    if (invertedTransparencySort) {
-        // Split the triangles into opaque and transparent triangles.
-        std::vector<RawTriangle> opaqueTriangles;
-        std::vector<RawTriangle> transparentTriangles;
-        for (const auto &triangle : triangles) {
-            const int materialIndex = triangle.materialIndex;
-            if (materialIndex < 0) {
-                opaqueTriangles.push_back(triangle);
-                continue;
-            }
-            const int textureIndex = materials[materialIndex].textures[RAW_TEXTURE_USAGE_DIFFUSE];
-            if (textureIndex < 0) {
-                if (vertices[triangle.verts[0]].color.w < 1.0f ||
-                    vertices[triangle.verts[1]].color.w < 1.0f ||
-                    vertices[triangle.verts[2]].color.w < 1.0f) {
-                    transparentTriangles.push_back(triangle);
-                    continue;
+void RawModel::BakeSurfaces(const std::vector<RawSurfaceInstance> &instances, const std::vector<bool> &removeSurfaces)
+{
+    std::vector<std::vector<int>> surfaceTriangles(surfaces.size());
+    for (int i = 0; i < (int) triangles.size(); i++) {
+        if (triangles[i].surfaceIndex >= 0) {
+            surfaceTriangles[triangles[i].surfaceIndex].push_back(i);
+        }
+    }
+
+    std::vector<int> vertexRemap(vertices.GetCount(), -1);
+    std::vector<int> remappedVertices;
+
+    for (const RawSurfaceInstance &instance : instances) {
+        const Mat4f &m = instance.transform;
+        // Normals go through the inverse transpose, so they stay perpendicular under non-uniform scale
+        const Mat4f normalMatrix = m.Inverse().Transpose();
+        const float determinant =
+            m(0, 0) * (m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1)) -
+            m(0, 1) * (m(1, 0) * m(2, 2) - m(1, 2) * m(2, 0)) +
+            m(0, 2) * (m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0));
+        const bool mirrored = determinant < 0.0f;
+
+        auto transformVector = [](const Mat4f &matrix, const Vec3f &v) {
+            return Vec3f(
+                matrix(0, 0) * v[0] + matrix(0, 1) * v[1] + matrix(0, 2) * v[2],
+                matrix(1, 0) * v[0] + matrix(1, 1) * v[1] + matrix(1, 2) * v[2],
+                matrix(2, 0) * v[0] + matrix(2, 1) * v[1] + matrix(2, 2) * v[2]);
+        };
+
+        RawSurface &target = surfaces[instance.targetSurfaceIndex];
+        for (const int vertexIndex : remappedVertices) {
+            vertexRemap[vertexIndex] = -1;
+        }
+        remappedVertices.clear();
+
+        for (const int triangleIndex : surfaceTriangles[instance.surfaceIndex]) {
+            const RawTriangle triangle = triangles[triangleIndex];
+            int verts[3];
+            for (int j = 0; j < 3; j++) {
+                const int sourceIndex = triangle.verts[j];
+                if (vertexRemap[sourceIndex] < 0) {
+                    RawVertex vertex = vertices.GetVertex(sourceIndex);
+                    vertex.position = transformVector(m, vertex.position) + Vec3f(m(0, 3), m(1, 3), m(2, 3));
+                    vertex.normal   = NormalizeSafe(transformVector(normalMatrix, vertex.normal));
+                    vertex.binormal = NormalizeSafe(transformVector(m, vertex.binormal));
+                    const Vec3f tangent = NormalizeSafe(transformVector(m, Vec3f(vertex.tangent[0], vertex.tangent[1], vertex.tangent[2])));
+                    vertex.tangent  = Vec4f(tangent[0], tangent[1], tangent[2], mirrored ? -vertex.tangent[3] : vertex.tangent[3]);
+                    target.bounds.AddPoint(vertex.position);
+
+                    vertexRemap[sourceIndex] = AddVertex(vertex);
+                    remappedVertices.push_back(sourceIndex);
                 }
-                opaqueTriangles.push_back(triangle);
-                continue;
+                verts[j] = vertexRemap[sourceIndex];
             }
-            if (textures[textureIndex].occlusion == RAW_TEXTURE_OCCLUSION_TRANSPARENT) {
-                transparentTriangles.push_back(triangle);
-            } else {
-                opaqueTriangles.push_back(triangle);
+            if (mirrored) {
+                std::swap(verts[1], verts[2]);
             }
+            AddTriangle(verts[0], verts[1], verts[2], triangle.materialIndex, instance.targetSurfaceIndex);
         }
+    }
 
-        // Sort the opaque triangles.
-        std::sort(opaqueTriangles.begin(), opaqueTriangles.end(), TriangleModelSortPos::Compare);
+    triangles.erase(
+        std::remove_if(triangles.begin(), triangles.end(), [&](const RawTriangle &triangle) {
+            return triangle.surfaceIndex >= 0 && triangle.surfaceIndex < (int) removeSurfaces.size() && removeSurfaces[triangle.surfaceIndex];
+        }),
+        triangles.end());
+}
 
-        // Sort the transparent triangles in the reverse direction.
-        std::sort(transparentTriangles.begin(), transparentTriangles.end(), TriangleModelSortNeg::Compare);
+void RawModel::RemoveNodes(const std::vector<bool> &removeNodes)
+{
+    std::vector<int> remap(nodes.size(), -1);
+    std::vector<int> targets(nodes.size(), -1);
+    int nodeCount = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (!removeNodes[i]) {
+            remap[i] = targets[i] = nodeCount++;
+        }
+    }
 
-        // Add the triangles to the sorted list.
-        for (const auto &opaqueTriangle : opaqueTriangles) {
-            sortedTriangles.push_back(opaqueTriangle);
+    for (auto &node : nodes) {
+        node.childIds.erase(
+            std::remove_if(node.childIds.begin(), node.childIds.end(), [&](const long childId) {
+                const int childIndex = GetNodeById(childId);
+                return childIndex >= 0 && removeNodes[childIndex];
+            }),
+            node.childIds.end());
+    }
+    for (auto &animation : animations) {
+        for (auto &channel : animation.channels) {
+            channel.nodeIndex = remap[channel.nodeIndex];
         }
-        for (const auto &transparentTriangle : transparentTriangles) {
-            sortedTriangles.push_back(transparentTriangle);
+    }
+
+    CompactInPlace(nodes, targets, nodeCount);
+
+    nodeIndices.clear();
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodeIndices.emplace(nodes[i].id, (int) i);
+    }
+}
+
+static size_t HashWeldCell(const int64_t x, const int64_t y, const int64_t z)
+{
+    // Cells that collide only cost extra comparisons, candidates are always checked against the tolerances
+    return (size_t) ((uint64_t) x * 73856093u ^ (uint64_t) y * 19349663u ^ (uint64_t) z * 83492791u);
+}
+
+size_t RawModel::WeldVertices(const float positionTolerance, const float normalAngle, const float uvTolerance)
+{
+    if (positionTolerance <= 0.0f || vertices.GetCount() == 0) {
+        return 0;
+    }
+
+    const float positionTolerance2 = positionTolerance * positionTolerance;
+    const float uvTolerance2 = uvTolerance * uvTolerance;
+    const float normalCos = std::cos(std::min(std::max(normalAngle, 0.0f), 180.0f) * ((float) M_PI / 180.0f));
+
+    // Normals, binormals and tangents are within the angle when both are zero or neither is and they are close enough,
+    // every other attribute has to be equal.
+    const auto directionsClose = [&](const Vec3f &a, const Vec3f &b) {
+        const float lengths = std::sqrt(a.LengthSquared() * b.LengthSquared());
+        return (lengths < FLT_MIN) ? a == b : Vec3f::DotProduct(a, b) >= normalCos * lengths;
+    };
+    const auto canWeld = [&](const int i, const int j) {
+        const Vec4f &tangent = vertices.GetTangent(i);
+        const Vec4f &otherTangent = vertices.GetTangent(j);
+        return (vertices.GetPosition(i) - vertices.GetPosition(j)).LengthSquared() <= positionTolerance2 &&
+               (vertices.GetUv0(i) - vertices.GetUv0(j)).LengthSquared() <= uvTolerance2 &&
+               (vertices.GetUv1(i) - vertices.GetUv1(j)).LengthSquared() <= uvTolerance2 &&
+               directionsClose(vertices.GetNormal(i), vertices.GetNormal(j)) &&
+               directionsClose(vertices.GetBinormal(i), vertices.GetBinormal(j)) &&
+               directionsClose(Vec3f(tangent[0], tangent[1], tangent[2]), Vec3f(otherTangent[0], otherTangent[1], otherTangent[2])) &&
+               tangent[3] == otherTangent[3] &&
+               vertices.GetColor(i) == vertices.GetColor(j) &&
+               vertices.GetJointIndices(i) == vertices.GetJointIndices(j) &&
+               vertices.GetJointWeights(i) == vertices.GetJointWeights(j) &&
+               vertices.GetPolarityUv0(i) == vertices.GetPolarityUv0(j) &&
+               vertices.GetBlendSurfaceIx(i) == vertices.GetBlendSurfaceIx(j) &&
+               vertices.BlendsEqual(i, vertices, j);
+    };
+
+    // The vertices kept so far are chained per grid cell as wide as the position tolerance, a vertex within it of
+    // another is in the same or one of the 26 neighbouring cells. Every vertex is welded to the first kept vertex it
+    // is close enough to, kept vertices don't move.
+    const int vertexCount = (int) vertices.GetCount();
+    std::unordered_map<size_t, int> cellHeads;
+    std::vector<int> cellNext(vertexCount, -1);
+    std::vector<int> remap(vertexCount);
+    size_t weldedCount = 0;
+
+    for (int i = 0; i < vertexCount; i++) {
+        const Vec3f &position = vertices.GetPosition(i);
+        const int64_t x = (int64_t) std::floor((double) position[0] / positionTolerance);
+        const int64_t y = (int64_t) std::floor((double) position[1] / positionTolerance);
+        const int64_t z = (int64_t) std::floor((double) position[2] / positionTolerance);
+
+        int match = -1;
+        for (int dz = -1; dz <= 1 && match < 0; dz++) {
+            for (int dy = -1; dy <= 1 && match < 0; dy++) {
+                for (int dx = -1; dx <= 1 && match < 0; dx++) {
+                    const auto it = cellHeads.find(HashWeldCell(x + dx, y + dy, z + dz));
+                    if (it == cellHeads.end()) {
+                        continue;
+                    }
+                    for (int j = it->second; j >= 0 && match < 0; j = cellNext[j]) {
+                        if (canWeld(i, j)) {
+                            match = j;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (match >= 0) {
+            remap[i] = match;
+            weldedCount++;
+        } else {
+            remap[i] = i;
+            int &head = cellHeads.emplace(HashWeldCell(x, y, z), -1).first->second;
+            cellNext[i] = head;
+            head = i;
         }
-    } else {
-        sortedTriangles = triangles;
-        std::sort(sortedTriangles.begin(), sortedTriangles.end(), TriangleModelSortPos::Compare);
     }
 
-    // Overestimate the number of models that will be created to avoid massive reallocation.
-    int discreteCount = 0;
-    for (const auto &surface : surfaces) {
-        discreteCount += (surface.discrete != false);
+    for (auto &triangle : triangles) {
+        for (int j = 0; j < 3; j++) {
+            triangle.verts[j] = remap[triangle.verts[j]];
+        }
     }
+    return weldedCount;
+}
 
-    materialModels.clear();
-    materialModels.reserve(materials.size() + discreteCount);
+size_t RawModel::RemoveDegenerateTriangles(const float minArea, const float minAngle, std::vector<int> &surfaceDropCounts)
+{
+    const float minAngleCos = std::cos(std::min(std::max(minAngle, 0.0f), 60.0f) * ((float) M_PI / 180.0f));
+
+    // Skinned or morphed corners at the same place may move apart, only triangles whose corners move together are
+    // dropped for their shape.
+    const auto isFlat = [&](const int verts[3]) {
+        for (int j = 1; j < 3; j++) {
+            if (vertices.GetJointIndices(verts[j]) != vertices.GetJointIndices(verts[0]) ||
+                vertices.GetJointWeights(verts[j]) != vertices.GetJointWeights(verts[0])) {
+                return false;
+            }
+        }
+        for (int j = 0; j < 3; j++) {
+            if (vertices.GetBlendChannelCount(verts[j]) > 0) {
+                return false;
+            }
+        }
 
-    const RawVertex defaultVertex;
+        const Vec3f &p0 = vertices.GetPosition(verts[0]);
+        const Vec3f &p1 = vertices.GetPosition(verts[1]);
+        const Vec3f &p2 = vertices.GetPosition(verts[2]);
+        if (p0 == p1 || p1 == p2 || p2 == p0 || Vec3f::CrossProduct(p1 - p0, p2 - p0).Length() * 0.5f <= minArea) {
+            return true;
+        }
+        if (minAngle > 0.0f) {
+            const Vec3f *positions[3] = { &p0, &p1, &p2 };
+            for (int j = 0; j < 3; j++) {
+                const Vec3f e0 = *positions[(j + 1) % 3] - *positions[j];
+                const Vec3f e1 = *positions[(j + 2) % 3] - *positions[j];
+                if (Vec3f::DotProduct(e0, e1) > minAngleCos * std::sqrt(e0.LengthSquared() * e1.LengthSquared())) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
 
-    // Create a separate model for each material.
-    RawModel *model;
-    for (size_t i = 0; i < sortedTriangles.size(); i++) {
+    std::vector<bool> dropped(triangles.size(), false);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        const int *verts = triangles[i].verts;
+        dropped[i] = verts[0] == verts[1] || verts[1] == verts[2] || verts[2] == verts[0] || isFlat(verts);
+    }
 
-        if (sortedTriangles[i].materialIndex < 0 || sortedTriangles[i].surfaceIndex < 0) {
+    // Repeats of a triangle with the same winding, material and surface, rotated to start at their lowest vertex;
+    // the first one is kept. Reversed windings are kept as the back faces of double-sided geometry.
+    std::vector<std::array<int, 5>> keys(triangles.size());
+    std::vector<int> order;
+    for (size_t i = 0; i < triangles.size(); i++) {
+        if (dropped[i]) {
             continue;
         }
+        const RawTriangle &triangle = triangles[i];
+        const int first = (triangle.verts[0] < triangle.verts[1]) ?
+            ((triangle.verts[0] < triangle.verts[2]) ? 0 : 2) : ((triangle.verts[1] < triangle.verts[2]) ? 1 : 2);
+        keys[i] = {{ triangle.verts[first], triangle.verts[(first + 1) % 3], triangle.verts[(first + 2) % 3], triangle.materialIndex, triangle.surfaceIndex }};
+        order.push_back((int) i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const int a, const int b) { return keys[a] < keys[b]; });
+    for (size_t i = 1; i < order.size(); i++) {
+        if (keys[order[i]] == keys[order[i - 1]]) {
+            dropped[order[i]] = true;
+        }
+    }
 
-        if (i == 0 ||
-            (shortIndices && model->GetVertexCount() >= 0xFFFE) ||
-            sortedTriangles[i].materialIndex != sortedTriangles[i - 1].materialIndex ||
-            (sortedTriangles[i].surfaceIndex != sortedTriangles[i - 1].surfaceIndex &&
-                (forceDiscrete || surfaces[sortedTriangles[i].surfaceIndex].discrete ||
-                    surfaces[sortedTriangles[i - 1].surfaceIndex].discrete))) {
-            materialModels.resize(materialModels.size() + 1);
-            model = &materialModels[materialModels.size() - 1];
+    surfaceDropCounts.assign(surfaces.size(), 0);
+    size_t droppedCount = 0;
+    for (size_t i = 0; i < triangles.size(); i++) {
+        if (dropped[i]) {
+            surfaceDropCounts[triangles[i].surfaceIndex]++;
+            droppedCount++;
         }
+    }
 
-        // FIXME: will have to unlink from the nodes, transform both surfaces into a
-        // common space, and reparent to a new node with appropriate transform.
+    size_t triangleCount = 0;
+    for (size_t i = 0; i < triangles.size(); i++) {
+        if (!dropped[i]) {
+            triangles[triangleCount++] = triangles[i];
+        }
+    }
+    triangles.resize(triangleCount);
+    return droppedCount;
+}
 
-        const int prevSurfaceCount = model->GetSurfaceCount();
-        const int materialIndex    = model->AddMaterial(materials[sortedTriangles[i].materialIndex]);
-        const int surfaceIndex     = model->AddSurface(surfaces[sortedTriangles[i].surfaceIndex]);
-        RawSurface &rawSurface = model->GetSurface(surfaceIndex);
+void RawModel::TransformTextures(const std::vector<std::function<Vec2f(Vec2f)>> &transforms)
+{
+    if ((vertexAttributes & RAW_VERTEX_ATTRIBUTE_UV0) != 0) {
+        for (auto &uv : vertices.GetUv0Stream()) {
+            for (const auto &fun : transforms) {
+                uv = fun(uv);
+            }
+        }
+    }
+    if ((vertexAttributes & RAW_VERTEX_ATTRIBUTE_UV1) != 0) {
+        for (auto &uv : vertices.GetUv1Stream()) {
+            for (const auto &fun : transforms) {
+                uv = fun(uv);
+            }
+        }
+    }
+    // The vertices changed in place, they get hashed again when needed.
+    vertexMap.Clear();
+}
+
+// Stable counting sort of triangle indices on key(triangleIndex), the keys must be in [0, keyCount).
+template<typename _key_func_>
+static void BucketSortTriangles(std::vector<int> &order, std::vector<int> &scratch, const int keyCount, const _key_func_ &key)
+{
+    std::vector<int> offsets((size_t) keyCount + 1, 0);
+    for (const int triangleIndex : order) {
+        offsets[key(triangleIndex) + 1]++;
+    }
+    for (int i = 0; i < keyCount; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    scratch.resize(order.size());
+    for (const int triangleIndex : order) {
+        scratch[offsets[key(triangleIndex)]++] = triangleIndex;
+    }
+    order.swap(scratch);
+}
+
+void RawModel::CreateMaterialModels(
+    std::vector<RawModel> &materialModels, bool shortIndices, const int keepAttribs, const bool forceDiscrete, const int jobs,
+    const int maxPaletteJoints) const
+{
+    // Split the triangles into opaque and transparent triangles.
+    std::vector<uint8_t> transparent(triangles.size(), 0);
 
-        if (model->GetSurfaceCount() > prevSurfaceCount) {
-            const std::vector<long> &jointIds = surfaces[sortedTriangles[i].surfaceIndex].jointIds;
-            for (const auto &jointId : jointIds) {
-                const int nodeIndex = GetNodeById(jointId);
-                assert(nodeIndex != -1);
-                model->AddNode(GetNode(nodeIndex));
+    bool invertedTransparencySort = true;
+    if (invertedTransparencySort) {
+        for (size_t i = 0; i < triangles.size(); i++) {
+            const RawTriangle &triangle = triangles[i];
+            const int materialIndex = triangle.materialIndex;
+            if (materialIndex < 0) {
+                continue;
+            }
+            const int textureIndex = materials[materialIndex].textures[RAW_TEXTURE_USAGE_DIFFUSE];
+            if (textureIndex < 0) {
+                transparent[i] = vertices.GetColor(triangle.verts[0]).w < 1.0f ||
+                                 vertices.GetColor(triangle.verts[1]).w < 1.0f ||
+                                 vertices.GetColor(triangle.verts[2]).w < 1.0f;
+                continue;
             }
-            rawSurface.bounds.Clear();
+            transparent[i] = textures[textureIndex].occlusion == RAW_TEXTURE_OCCLUSION_TRANSPARENT;
         }
+    }
 
-        int verts[3];
-        for (int j = 0; j < 3; j++) {
-            RawVertex vertex = vertices[sortedTriangles[i].verts[j]];
+    // Order the triangles on material first, then surface, then first vertex index, with the transparent
+    // triangles after the opaque ones and sorted in the reverse vertex direction. Every key is a small
+    // integer, so this is one stable bucket pass per key, least significant key first.
+    std::vector<int> order;
+    order.reserve(triangles.size());
+    for (int i = 0; i < (int) triangles.size(); i++) {
+        if (triangles[i].materialIndex >= 0 && triangles[i].surfaceIndex >= 0) {
+            order.push_back(i);
+        }
+    }
+
+    const int vertexCount = (int) vertices.GetCount();
+    std::vector<int> scratch;
+    BucketSortTriangles(order, scratch, vertexCount, [&](const int triangleIndex) {
+        const int vertexIndex = triangles[triangleIndex].verts[0];
+        return transparent[triangleIndex] ? vertexCount - 1 - vertexIndex : vertexIndex;
+    });
+    BucketSortTriangles(order, scratch, (int) surfaces.size(), [&](const int triangleIndex) {
+        return triangles[triangleIndex].surfaceIndex;
+    });
+    BucketSortTriangles(order, scratch, (int) materials.size(), [&](const int triangleIndex) {
+        return triangles[triangleIndex].materialIndex;
+    });
+    BucketSortTriangles(order, scratch, 2, [&](const int triangleIndex) {
+        return (int) transparent[triangleIndex];
+    });
+
+    // A model always ends where the material changes, or where the surface changes and either surface is
+    // discrete. Those runs of triangles are independent of each other and are built in parallel; within a
+    // run a model only ends early when it runs out of short indices.
+    std::vector<int> runStarts;
+    for (size_t i = 0; i < order.size(); i++) {
+        const RawTriangle &triangle = triangles[order[i]];
+        if (i == 0) {
+            runStarts.push_back(0);
+            continue;
+        }
+        const RawTriangle &previous = triangles[order[i - 1]];
+        if (triangle.materialIndex != previous.materialIndex ||
+            (triangle.surfaceIndex != previous.surfaceIndex &&
+                (forceDiscrete || surfaces[triangle.surfaceIndex].discrete || surfaces[previous.surfaceIndex].discrete))) {
+            runStarts.push_back((int) i);
+        }
+    }
+    runStarts.push_back((int) order.size());
+    const int runCount = (int) runStarts.size() - 1;
+
+    // While the vertex map is current its hashes can be reused for the vertices of the models, unless
+    // attributes get stripped, which changes the vertices.
+    const bool reuseHashes = keepAttribs == -1 && vertexMap.GetCount() == vertices.GetCount();
+
+    const RawVertex defaultVertex;
 
-            if (keepAttribs != -1) {
-                int keep = keepAttribs;
-                if ((keepAttribs & RAW_VERTEX_ATTRIBUTE_POSITION) != 0) {
-                    keep |= RAW_VERTEX_ATTRIBUTE_JOINT_INDICES | RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS;
+    std::vector<std::vector<RawModel>> runModels((size_t) runCount);
+    const int workerCount = std::max(std::min(ThreadUtils::GetJobCount(jobs), runCount), 1);
+    std::atomic<int> nextRun(0);
+
+    ThreadUtils::ParallelFor(workerCount, workerCount, [&](int) {
+        // The index of each source vertex in the model being built, or -1.
+        std::vector<int> vertexRemap(vertices.GetCount(), -1);
+        std::vector<int> remappedVertices;
+        // The palette index of each joint of a source surface, or -1, per surface of the model being built.
+        std::vector<std::vector<int>> jointRemaps;
+        std::vector<int> newJoints;
+
+        for (int run = nextRun++; run < runCount; run = nextRun++) {
+            std::vector<RawModel> &models = runModels[run];
+            RawModel *model = nullptr;
+            int materialIndex = -1;
+            int keep = -1;
+
+            for (int i = runStarts[run]; i < runStarts[run + 1]; i++) {
+                const RawTriangle &triangle = triangles[order[i]];
+                const RawSurface &sourceSurface = surfaces[triangle.surfaceIndex];
+
+                // The joints the triangle adds to the palette of its surface in the model being built
+                bool paletteFull = false;
+                if (maxPaletteJoints > 0 && model != nullptr && !sourceSurface.jointIds.empty()) {
+                    const int modelSurfaceIndex = model->GetSurfaceById(sourceSurface.id);
+                    if (modelSurfaceIndex >= 0) {
+                        const std::vector<int> &jointRemap = jointRemaps[modelSurfaceIndex];
+                        newJoints.clear();
+                        for (int j = 0; j < 3; j++) {
+                            const int sourceIndex = triangle.verts[j];
+                            if (vertexRemap[sourceIndex] >= 0) {
+                                continue;
+                            }
+                            const Vec4i &jointIndices = vertices.GetJointIndices(sourceIndex);
+                            const Vec4f &jointWeights = vertices.GetJointWeights(sourceIndex);
+                            for (int k = 0; k < 4; k++) {
+                                if (jointWeights[k] > 0.0f && jointRemap[jointIndices[k]] < 0 &&
+                                    std::find(newJoints.begin(), newJoints.end(), jointIndices[k]) == newJoints.end()) {
+                                    newJoints.push_back(jointIndices[k]);
+                                }
+                            }
+                        }
+                        const size_t paletteSize = model->GetSurface(modelSurfaceIndex).jointIds.size();
+                        paletteFull = paletteSize > 0 && paletteSize + newJoints.size() > (size_t) maxPaletteJoints;
+                    }
                 }
-                if ((keepAttribs & RAW_VERTEX_ATTRIBUTE_AUTO) != 0) {
-                    keep |= RAW_VERTEX_ATTRIBUTE_POSITION;
 
-                    const RawMaterial &mat = model->GetMaterial(materialIndex);
-                    if (mat.textures[RAW_TEXTURE_USAGE_DIFFUSE] != -1) {
-                        keep |= RAW_VERTEX_ATTRIBUTE_UV0;
+                if (model == nullptr || (shortIndices && model->GetVertexCount() >= 0xFFFE) || paletteFull) {
+                    for (const int vertexIndex : remappedVertices) {
+                        vertexRemap[vertexIndex] = -1;
                     }
-                    if (mat.textures[RAW_TEXTURE_USAGE_NORMAL] != -1) {
-                        keep |= RAW_VERTEX_ATTRIBUTE_NORMAL |
-                                RAW_VERTEX_ATTRIBUTE_BINORMAL |
-                                RAW_VERTEX_ATTRIBUTE_UV0;
+                    remappedVertices.clear();
+                    jointRemaps.clear();
+
+                    models.resize(models.size() + 1);
+                    model = &models.back();
+                    materialIndex = model->AddMaterial(materials[triangle.materialIndex]);
+
+                    keep = keepAttribs;
+                    if (keepAttribs != -1) {
+                        if ((keepAttribs & RAW_VERTEX_ATTRIBUTE_POSITION) != 0) {
+                            keep |= RAW_VERTEX_ATTRIBUTE_JOINT_INDICES | RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS;
+                        }
+                        if ((keepAttribs & RAW_VERTEX_ATTRIBUTE_AUTO) != 0) {
+                            keep |= RAW_VERTEX_ATTRIBUTE_POSITION;
+
+                            const RawMaterial &mat = model->GetMaterial(materialIndex);
+                            if (mat.textures[RAW_TEXTURE_USAGE_DIFFUSE] != -1) {
+                                keep |= RAW_VERTEX_ATTRIBUTE_UV0;
+                            }
+                            if (mat.textures[RAW_TEXTURE_USAGE_NORMAL] != -1) {
+                                keep |= RAW_VERTEX_ATTRIBUTE_NORMAL |
+                                        RAW_VERTEX_ATTRIBUTE_BINORMAL |
+                                        RAW_VERTEX_ATTRIBUTE_UV0;
+                            }
+                            if (mat.textures[RAW_TEXTURE_USAGE_SPECULAR] != -1) {
+                                keep |= RAW_VERTEX_ATTRIBUTE_NORMAL |
+                                        RAW_VERTEX_ATTRIBUTE_UV0;
+                            }
+                            if (mat.textures[RAW_TEXTURE_USAGE_EMISSIVE] != -1) {
+                                keep |= RAW_VERTEX_ATTRIBUTE_UV1;
+                            }
+                        }
                     }
-                    if (mat.textures[RAW_TEXTURE_USAGE_SPECULAR] != -1) {
-                        keep |= RAW_VERTEX_ATTRIBUTE_NORMAL |
-                                RAW_VERTEX_ATTRIBUTE_UV0;
+                }
+
+                // FIXME: will have to unlink from the nodes, transform both surfaces into a
+                // common space, and reparent to a new node with appropriate transform.
+
+                const int prevSurfaceCount = model->GetSurfaceCount();
+                const int surfaceIndex     = model->AddSurface(sourceSurface);
+                RawSurface &rawSurface = model->GetSurface(surfaceIndex);
+
+                if (model->GetSurfaceCount() > prevSurfaceCount) {
+                    const std::vector<long> &jointIds = sourceSurface.jointIds;
+                    for (const auto &jointId : jointIds) {
+                        const int nodeIndex = GetNodeById(jointId);
+                        assert(nodeIndex != -1);
+                        model->AddNode(GetNode(nodeIndex));
                     }
-                    if (mat.textures[RAW_TEXTURE_USAGE_EMISSIVE] != -1) {
-                        keep |= RAW_VERTEX_ATTRIBUTE_UV1;
+                    rawSurface.bounds.Clear();
+
+                    // The palette of the surface fills up with the joints its vertices bind
+                    jointRemaps.resize(model->GetSurfaceCount());
+                    if (maxPaletteJoints > 0 && !jointIds.empty()) {
+                        jointRemaps[surfaceIndex].assign(jointIds.size(), -1);
+                        rawSurface.jointIds.clear();
+                        rawSurface.jointGeometryMins.clear();
+                        rawSurface.jointGeometryMaxs.clear();
+                        rawSurface.inverseBindMatrices.clear();
                     }
                 }
-                if ((keep & RAW_VERTEX_ATTRIBUTE_POSITION) == 0) { vertex.position = defaultVertex.position; }
-                if ((keep & RAW_VERTEX_ATTRIBUTE_NORMAL) == 0) { vertex.normal = defaultVertex.normal; }
-                if ((keep & RAW_VERTEX_ATTRIBUTE_BINORMAL) == 0) { vertex.binormal = defaultVertex.binormal; }
-                if ((keep & RAW_VERTEX_ATTRIBUTE_COLOR) == 0) { vertex.color = defaultVertex.color; }
-                if ((keep & RAW_VERTEX_ATTRIBUTE_UV0) == 0) { vertex.uv0 = defaultVertex.uv0; }
-                if ((keep & RAW_VERTEX_ATTRIBUTE_UV1) == 0) { vertex.uv1 = defaultVertex.uv1; }
-                if ((keep & RAW_VERTEX_ATTRIBUTE_JOINT_INDICES) == 0) { vertex.jointIndices = defaultVertex.jointIndices; }
-                if ((keep & RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS) == 0) { vertex.jointWeights = defaultVertex.jointWeights; }
-            }
+                std::vector<int> &jointRemap = jointRemaps[surfaceIndex];
+
+                int verts[3];
+                for (int j = 0; j < 3; j++) {
+                    const int sourceIndex = triangle.verts[j];
+
+                    // Every source vertex is added to a model once, later corners go through the remap.
+                    if (vertexRemap[sourceIndex] < 0) {
+                        int index;
+                        if (reuseHashes && jointRemap.empty()) {
+                            const size_t hash = vertexMap.GetHash(sourceIndex);
+                            index = model->vertexMap.Find(vertices, sourceIndex, hash, model->vertices);
+                            if (index < 0) {
+                                index = (int) model->vertices.GetCount();
+                                model->vertexMap.Insert(index, hash);
+                                model->vertices.Add(vertices, sourceIndex);
+                            }
+                        } else {
+                            RawVertex vertex = vertices.GetVertex(sourceIndex);
+                            if (keep != -1) {
+                                if ((keep & RAW_VERTEX_ATTRIBUTE_POSITION) == 0) { vertex.position = defaultVertex.position; }
+                                if ((keep & RAW_VERTEX_ATTRIBUTE_NORMAL) == 0) { vertex.normal = defaultVertex.normal; }
+                                if ((keep & RAW_VERTEX_ATTRIBUTE_BINORMAL) == 0) { vertex.binormal = defaultVertex.binormal; }
+                                if ((keep & RAW_VERTEX_ATTRIBUTE_COLOR) == 0) { vertex.color = defaultVertex.color; }
+                                if ((keep & RAW_VERTEX_ATTRIBUTE_UV0) == 0) { vertex.uv0 = defaultVertex.uv0; }
+                                if ((keep & RAW_VERTEX_ATTRIBUTE_UV1) == 0) { vertex.uv1 = defaultVertex.uv1; }
+                                if ((keep & RAW_VERTEX_ATTRIBUTE_JOINT_INDICES) == 0) { vertex.jointIndices = defaultVertex.jointIndices; }
+                                if ((keep & RAW_VERTEX_ATTRIBUTE_JOINT_WEIGHTS) == 0) { vertex.jointWeights = defaultVertex.jointWeights; }
+                            }
+                            if (!jointRemap.empty()) {
+                                for (int k = 0; k < 4; k++) {
+                                    if (vertex.jointWeights[k] <= 0.0f) {
+                                        vertex.jointIndices[k] = 0;
+                                        continue;
+                                    }
+                                    const int joint = vertex.jointIndices[k];
+                                    if (jointRemap[joint] < 0) {
+                                        jointRemap[joint] = (int) rawSurface.jointIds.size();
+                                        rawSurface.jointIds.push_back(sourceSurface.jointIds[joint]);
+                                        rawSurface.inverseBindMatrices.push_back(sourceSurface.inverseBindMatrices[joint]);
+                                        if (joint < (int) sourceSurface.jointGeometryMins.size()) {
+                                            rawSurface.jointGeometryMins.push_back(sourceSurface.jointGeometryMins[joint]);
+                                            rawSurface.jointGeometryMaxs.push_back(sourceSurface.jointGeometryMaxs[joint]);
+                                        }
+                                    }
+                                    vertex.jointIndices[k] = jointRemap[joint];
+                                }
+                            }
+                            index = model->AddVertex(vertex);
+                        }
+                        model->vertexAttributes |= model->vertices.Difference(index, defaultVertex);
+
+                        vertexRemap[sourceIndex] = index;
+                        remappedVertices.push_back(sourceIndex);
+                    }
+                    verts[j] = vertexRemap[sourceIndex];
 
-            verts[j] = model->AddVertex(vertex);
-            model->vertexAttributes |= vertex.Difference(defaultVertex);
+                    rawSurface.bounds.AddPoint(model->vertices.GetPosition(verts[j]));
+                }
 
-            rawSurface.bounds.AddPoint(vertex.position);
+                model->AddTriangle(verts[0], verts[1], verts[2], materialIndex, surfaceIndex);
+            }
         }
+    });
 
-        model->AddTriangle(verts[0], verts[1], verts[2], materialIndex, surfaceIndex);
+    // Overestimate the number of models that will be created to avoid massive reallocation.
+    int discreteCount = 0;
+    for (const auto &surface : surfaces) {
+        discreteCount += (surface.discrete != false);
+    }
+
+    materialModels.clear();
+    materialModels.reserve(std::max(materials.size() + discreteCount, (size_t) runCount));
+    for (auto &models : runModels) {
+        for (auto &model : models) {
+            materialModels.push_back(std::move(model));
+        }
     }
 }
 
 int RawModel::GetNodeById(const long nodeId) const
 {
-    for (size_t i = 0; i < nodes.size(); i++) {
-        if (nodes[i].id == nodeId) {
-            return (int) i;
-        }
-    }
-    return -1;
+    auto it = nodeIndices.find(nodeId);
+    return it != nodeIndices.end() ? it->second : -1;
 }
 
 int RawModel::GetSurfaceById(const long surfaceId) const
 {
-    for (size_t i = 0; i < surfaces.size(); i++) {
-        if (surfaces[i].id == surfaceId) {
-            return (int)i;
-        }
-    }
-    return -1;
+    auto it = surfaceIndices.find(surfaceId);
+    return it != surfaceIndices.end() ? it->second : -1;
 }
 
-Vec3f RawModel::getFaceNormal(int verts[3]) const
+Vec3f RawModel::getFaceNormal(const int verts[3]) const
 {
-    const float l0 = (vertices[verts[1]].position - vertices[verts[0]].position ).LengthSquared();
-    const float l1 = (vertices[verts[2]].position - vertices[verts[1]].position ).LengthSquared();
-    const float l2 = (vertices[verts[0]].position - vertices[verts[2]].position ).LengthSquared();
+    const float l0 = (vertices.GetPosition(verts[1]) - vertices.GetPosition(verts[0]) ).LengthSquared();
+    const float l1 = (vertices.GetPosition(verts[2]) - vertices.GetPosition(verts[1]) ).LengthSquared();
+    const float l2 = (vertices.GetPosition(verts[0]) - vertices.GetPosition(verts[2]) ).LengthSquared();
     const int index = ( l0 > l1 ) ? ( l0 > l2 ? 2 : 1 ) : ( l1 > l2 ? 0 : 1 );
 
-    const Vec3f e0 = vertices[verts[(index + 1) % 3]].position - vertices[verts[index]].position;
-    const Vec3f e1 = vertices[verts[(index + 2) % 3]].position - vertices[verts[index]].position;
+    const Vec3f e0 = vertices.GetPosition(verts[(index + 1) % 3]) - vertices.GetPosition(verts[index]);
+    const Vec3f e1 = vertices.GetPosition(verts[(index + 2) % 3]) - vertices.GetPosition(verts[index]);
     if (e0.LengthSquared() < FLT_MIN || e1.LengthSquared() < FLT_MIN) {
         return Vec3f { 0.0f };
     }
@@ -585,51 +1607,394 @@ Vec3f RawModel::getFaceNormal(int verts[3]) const
     return result.Normalized() * angle * area;
 }
 
-size_t RawModel::CalculateNormals(bool onlyBroken)
+// Triangles and vertices are processed in chunks of this many, each chunk only writes its own slots.
+static const int GEOMETRY_CHUNK_SIZE = 4096;
+
+static int GetChunkCount(const int count)
+{
+    return (count + GEOMETRY_CHUNK_SIZE - 1) / GEOMETRY_CHUNK_SIZE;
+}
+
+void RawModel::getVertexCorners(std::vector<int> &offsets, std::vector<int> &corners) const
 {
+    offsets.assign(vertices.GetCount() + 1, 0);
+    for (const auto &triangle : triangles) {
+        for (int vertIx : triangle.verts) {
+            offsets[vertIx + 1]++;
+        }
+    }
+    for (size_t vertIx = 0; vertIx < vertices.GetCount(); vertIx++) {
+        offsets[vertIx + 1] += offsets[vertIx];
+    }
+
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+    corners.resize(3 * triangles.size());
+    for (int triIx = 0; triIx < (int) triangles.size(); triIx++) {
+        for (int j = 0; j < 3; j++) {
+            corners[next[triangles[triIx].verts[j]]++] = 3 * triIx + j;
+        }
+    }
+}
+
+size_t RawModel::CalculateNormals(bool onlyBroken, const int jobs)
+{
+    std::vector<Vec3f> &normals = vertices.GetNormalStream();
+    const int vertexCount = (int) vertices.GetCount();
+    const int triangleCount = (int) triangles.size();
+
     Vec3f averagePos = Vec3f { 0.0f };
-    std::set<int> brokenVerts;
-    for (int vertIx = 0; vertIx < vertices.size(); vertIx ++) {
-        RawVertex &vertex = vertices[vertIx];
-        averagePos += (vertex.position / (float)vertices.size());
-        if (onlyBroken && (vertex.normal.LengthSquared() >= FLT_MIN)) {
+    std::vector<uint8_t> brokenVerts(vertexCount, 0);
+    size_t brokenCount = 0;
+    for (int vertIx = 0; vertIx < vertexCount; vertIx ++) {
+        averagePos += (vertices.GetPosition(vertIx) / (float)vertexCount);
+        if (onlyBroken && (normals[vertIx].LengthSquared() >= FLT_MIN)) {
             continue;
         }
-        vertex.normal = Vec3f { 0.0f };
-        if (onlyBroken) {
-            brokenVerts.emplace(vertIx);
+        brokenVerts[vertIx] = 1;
+        brokenCount++;
+    }
+    if (brokenCount == 0) {
+        return 0;
+    }
+
+    // Face normals first, only for the triangles that touch a vertex getting a new normal.
+    std::vector<Vec3f> faceNormals(triangleCount);
+    ThreadUtils::ParallelFor(GetChunkCount(triangleCount), jobs, [&](int chunk) {
+        const int end = std::min((chunk + 1) * GEOMETRY_CHUNK_SIZE, triangleCount);
+        for (int triIx = chunk * GEOMETRY_CHUNK_SIZE; triIx < end; triIx++) {
+            const int *verts = triangles[triIx].verts;
+            const bool relevant = brokenVerts[verts[0]] || brokenVerts[verts[1]] || brokenVerts[verts[2]];
+            faceNormals[triIx] = relevant ? this->getFaceNormal(verts) : Vec3f { 0.0f };
+        }
+    });
+
+    // Every vertex then sums the face normals of its triangles in triangle order, as a serial pass would.
+    std::vector<int> cornerOffsets;
+    std::vector<int> corners;
+    getVertexCorners(cornerOffsets, corners);
+
+    ThreadUtils::ParallelFor(GetChunkCount(vertexCount), jobs, [&](int chunk) {
+        const int end = std::min((chunk + 1) * GEOMETRY_CHUNK_SIZE, vertexCount);
+        for (int vertIx = chunk * GEOMETRY_CHUNK_SIZE; vertIx < end; vertIx++) {
+            if (brokenVerts[vertIx] == 0) {
+                continue;
+            }
+            Vec3f normal = Vec3f { 0.0f };
+            for (int i = cornerOffsets[vertIx]; i < cornerOffsets[vertIx + 1]; i++) {
+                normal += faceNormals[corners[i] / 3];
+            }
+            if (normal.LengthSquared() < FLT_MIN) {
+                normal = vertices.GetPosition(vertIx) - averagePos;
+                if (normal.LengthSquared() < FLT_MIN) {
+                    normals[vertIx] = Vec3f { 0.0f, 1.0f, 0.0f };
+                    continue;
+                }
+            }
+            normals[vertIx] = normal.Normalized();
         }
+    });
+    // The vertices changed in place, they get hashed again when needed.
+    vertexMap.Clear();
+    return brokenCount;
+}
+
+static Vec3f ProjectOntoPlane(const Vec3f &v, const Vec3f &normal)
+{
+    const Vec3f projected = v - normal * Vec3f::DotProduct(normal, v);
+    return projected.LengthSquared() < FLT_MIN ? Vec3f { 0.0f } : projected.Normalized();
+}
+
+size_t RawModel::CalculateTangents(const int jobs)
+{
+    const int vertexCount = (int) vertices.GetCount();
+    const int triangleCount = (int) triangles.size();
+
+    // The tangent and bitangent every triangle contributes to each of its corners.
+    std::vector<Vec3f> cornerTangents(3 * triangleCount);
+    std::vector<Vec3f> cornerBitangents(3 * triangleCount);
+    ThreadUtils::ParallelFor(GetChunkCount(triangleCount), jobs, [&](int chunk) {
+        const int end = std::min((chunk + 1) * GEOMETRY_CHUNK_SIZE, triangleCount);
+        for (int triIx = chunk * GEOMETRY_CHUNK_SIZE; triIx < end; triIx++) {
+            const int *verts = triangles[triIx].verts;
+            const Vec3f e1 = vertices.GetPosition(verts[1]) - vertices.GetPosition(verts[0]);
+            const Vec3f e2 = vertices.GetPosition(verts[2]) - vertices.GetPosition(verts[0]);
+            const Vec2f t1 = vertices.GetUv0(verts[1]) - vertices.GetUv0(verts[0]);
+            const Vec2f t2 = vertices.GetUv0(verts[2]) - vertices.GetUv0(verts[0]);
+            const float area = t1.x * t2.y - t2.x * t1.y;
+
+            // Like MikkTSpace only the orientation of the texture mapping matters, not its scale.
+            const float sign = area < 0.0f ? -1.0f : 1.0f;
+            const Vec3f tangent = (e1 * t2.y - e2 * t1.y) * sign;
+            const Vec3f bitangent = (e2 * t1.x - e1 * t2.x) * sign;
+
+            for (int j = 0; j < 3; j++) {
+                const int corner = 3 * triIx + j;
+                const Vec3f edge0 = vertices.GetPosition(verts[(j + 1) % 3]) - vertices.GetPosition(verts[j]);
+                const Vec3f edge1 = vertices.GetPosition(verts[(j + 2) % 3]) - vertices.GetPosition(verts[j]);
+                if (fabsf(area) < FLT_MIN || edge0.LengthSquared() < FLT_MIN || edge1.LengthSquared() < FLT_MIN) {
+                    cornerTangents[corner] = Vec3f { 0.0f };
+                    cornerBitangents[corner] = Vec3f { 0.0f };
+                    continue;
+                }
+                const float angle = acosf(std::max(-1.0f, std::min(1.0f, Vec3f::DotProduct(edge0.Normalized(), edge1.Normalized()))));
+                const Vec3f &normal = vertices.GetNormal(verts[j]);
+                cornerTangents[corner] = ProjectOntoPlane(tangent, normal) * angle;
+                cornerBitangents[corner] = ProjectOntoPlane(bitangent, normal) * angle;
+            }
+        }
+    });
+
+    std::vector<int> cornerOffsets;
+    std::vector<int> corners;
+    getVertexCorners(cornerOffsets, corners);
+
+    std::vector<Vec3f> &binormals = vertices.GetBinormalStream();
+    std::vector<Vec4f> &tangents = vertices.GetTangentStream();
+    ThreadUtils::ParallelFor(GetChunkCount(vertexCount), jobs, [&](int chunk) {
+        const int end = std::min((chunk + 1) * GEOMETRY_CHUNK_SIZE, vertexCount);
+        for (int vertIx = chunk * GEOMETRY_CHUNK_SIZE; vertIx < end; vertIx++) {
+            const Vec3f &normal = vertices.GetNormal(vertIx);
+            Vec3f tangent = Vec3f { 0.0f };
+            Vec3f bitangent = Vec3f { 0.0f };
+            for (int i = cornerOffsets[vertIx]; i < cornerOffsets[vertIx + 1]; i++) {
+                tangent += cornerTangents[corners[i]];
+                bitangent += cornerBitangents[corners[i]];
+            }
+
+            tangent = ProjectOntoPlane(tangent, normal);
+            if (tangent.LengthSquared() < FLT_MIN) {
+                // Degenerate texture mapping, any tangent in the plane of the normal will do.
+                tangent = ProjectOntoPlane(fabsf(normal.x) < 0.9f ? Vec3f(1.0f, 0.0f, 0.0f) : Vec3f(0.0f, 1.0f, 0.0f), normal);
+            }
+
+            const Vec3f binormal = Vec3f::CrossProduct(normal, tangent);
+            const float sign = Vec3f::DotProduct(binormal, bitangent) < 0.0f ? -1.0f : 1.0f;
+            binormals[vertIx] = binormal * sign;
+            tangents[vertIx] = Vec4f(tangent, sign);
+        }
+    });
+    // The vertices changed in place, they get hashed again when needed.
+    vertexMap.Clear();
+    return vertices.GetCount();
+}
+
+// Positions this far from a node stand in for the geometry bound to the leaves of the hierarchy.
+static const float KEYFRAME_SHELL_DISTANCE = 0.01f;
+// The most samples one segment replaces, this keeps the reduction linear in the number of samples.
+static const int KEYFRAME_MAX_SPAN = 64;
+
+static float GetMaxScale(const Vec3f &scale)
+{
+    return std::max(fabsf(scale.x), std::max(fabsf(scale.y), fabsf(scale.z)));
+}
+
+static float DotProduct(const Quatf &a, const Quatf &b)
+{
+    return a.scalar() * b.scalar() + Vec3f::DotProduct(a.vector(), b.vector());
+}
+
+// Shortest path slerp, as the runtimes interpolate rotation keys.
+static Quatf SlerpShortest(const Quatf &a, Quatf b, const float t)
+{
+    float cosAngle = DotProduct(a, b);
+    if (cosAngle < 0.0f) {
+        b = Quatf(-b.scalar(), -b.vector());
+        cosAngle = -cosAngle;
+    }
+    float wa = 1.0f - t;
+    float wb = t;
+    if (cosAngle < 0.9995f) {
+        const float angle = acosf(cosAngle);
+        const float sinAngle = sinf(angle);
+        wa = sinf((1.0f - t) * angle) / sinAngle;
+        wb = sinf(t * angle) / sinAngle;
     }
+    Quatf q(a.scalar() * wa + b.scalar() * wb, a.vector() * wa + b.vector() * wb);
+    q.Normalize();
+    return q;
+}
 
-	for (auto &triangle : triangles) {
-        bool relevant = false;
-        for (int vertIx : triangle.verts) {
-            relevant |= (brokenVerts.count(vertIx) > 0);
-		}
-        if (!relevant) {
+static float GetRotationAngle(const Quatf &a, const Quatf &b)
+{
+    const float cosHalfAngle = std::min(fabsf(DotProduct(a, b)), 1.0f);
+    return 2.0f * acosf(cosHalfAngle);
+}
+
+// Greedily extends every segment, up to KEYFRAME_MAX_SPAN samples, as long as interpolating its end keys reproduces
+// the samples in between. isWithinTolerance(first, last, index, t) tests the sample at index against the
+// interpolation at t.
+template<typename _within_func_>
+static std::vector<int> ReduceKeys(const std::vector<float> &times, const _within_func_ &isWithinTolerance)
+{
+    const int count = (int) times.size();
+    std::vector<int> keys;
+    if (count == 0) {
+        return keys;
+    }
+
+    keys.push_back(0);
+    int first = 0;
+    for (int last = 2; last < count; last++) {
+        if (last - first > KEYFRAME_MAX_SPAN) {
+            first = last - 1;
+            keys.push_back(first);
             continue;
         }
-        Vec3f faceNormal = this->getFaceNormal(triangle.verts);
-        for (int vertIx : triangle.verts) {
-            if (!onlyBroken || brokenVerts.count(vertIx) > 0) {
-                vertices[vertIx].normal += faceNormal;
+        const float duration = times[last] - times[first];
+        for (int index = first + 1; index < last; index++) {
+            const float t = duration > 0.0f ? (times[index] - times[first]) / duration : 0.0f;
+            if (!isWithinTolerance(first, last, index, t)) {
+                first = last - 1;
+                keys.push_back(first);
+                break;
             }
-		}
-	}
+        }
+    }
+    if (count > 1) {
+        keys.push_back(count - 1);
+    }
+    return keys;
+}
 
-    for (int vertIx = 0; vertIx < vertices.size(); vertIx ++) {
-        if (onlyBroken && brokenVerts.count(vertIx) == 0) {
-            continue;
+// Keeps the values of the given keys, stride values per key, and their times.
+template<typename _value_type_>
+static size_t KeepKeys(std::vector<_value_type_> &values, std::vector<float> &keyTimes, const std::vector<float> &times, const std::vector<int> &keys, const size_t stride)
+{
+    const size_t droppedCount = times.size() - keys.size();
+    std::vector<_value_type_> keptValues;
+    keptValues.reserve(keys.size() * stride);
+    keyTimes.clear();
+    for (const int key : keys) {
+        keptValues.insert(keptValues.end(), values.begin() + key * stride, values.begin() + (key + 1) * stride);
+        keyTimes.push_back(times[key]);
+    }
+    values = std::move(keptValues);
+    return droppedCount;
+}
+
+size_t RawModel::ReduceKeyframes(const float positionTolerance, const float weightTolerance, const int jobs)
+{
+    // The largest scale and translation every node takes, at rest or in any animation.
+    std::vector<float> maxScales(nodes.size());
+    std::vector<float> maxTranslations(nodes.size());
+    for (int nodeIndex = 0; nodeIndex < (int) nodes.size(); nodeIndex++) {
+        maxScales[nodeIndex] = GetMaxScale(nodes[nodeIndex].scale);
+        maxTranslations[nodeIndex] = nodes[nodeIndex].translation.Length();
+    }
+    for (const RawAnimation &animation : animations) {
+        for (const RawChannel &channel : animation.channels) {
+            for (const Vec3f &scale : channel.scales) {
+                maxScales[channel.nodeIndex] = std::max(maxScales[channel.nodeIndex], GetMaxScale(scale));
+            }
+            for (const Vec3f &translation : channel.translations) {
+                maxTranslations[channel.nodeIndex] = std::max(maxTranslations[channel.nodeIndex], translation.Length());
+            }
         }
-        RawVertex &vertex = vertices[vertIx];
-        if (vertex.normal.LengthSquared() < FLT_MIN) {
-            vertex.normal = vertex.position - averagePos;
-            if (vertex.normal.LengthSquared() < FLT_MIN) {
-                vertex.normal = Vec3f { 0.0f, 1.0f, 0.0f };
-                continue;
+    }
+
+    // How far the positions that a node moves, its own and those of its descendants, are from the node's origin, and
+    // the number of nodes on the longest path down from it. The reach is measured in the parent space of the node,
+    // with the largest scales and translations the triangle inequality keeps it an upper bound for any pose.
+    std::vector<float> reaches(nodes.size(), -1.0f);
+    std::vector<int> heights(nodes.size(), 0);
+    std::function<float(int)> getReach = [&](int nodeIndex) -> float {
+        if (reaches[nodeIndex] >= 0.0f) {
+            return reaches[nodeIndex];
+        }
+        const RawNode &node = nodes[nodeIndex];
+        float reach = KEYFRAME_SHELL_DISTANCE;
+        int height = 1;
+        for (const long childId : node.childIds) {
+            const int childIndex = GetNodeById(childId);
+            if (childIndex >= 0) {
+                reach = std::max(reach, maxTranslations[childIndex] + getReach(childIndex));
+                height = std::max(height, heights[childIndex] + 1);
             }
         }
-        vertex.normal.Normalize();
-	}
-    return onlyBroken ? brokenVerts.size() : vertices.size();
+        reaches[nodeIndex] = reach * maxScales[nodeIndex];
+        heights[nodeIndex] = height;
+        return reaches[nodeIndex];
+    };
+
+    // How much the ancestors of a node scale an error in its parent space, and the number of nodes down to it.
+    std::vector<float> ancestorScales(nodes.size(), -1.0f);
+    std::vector<int> depths(nodes.size(), 0);
+    std::function<float(int)> getAncestorScale = [&](int nodeIndex) -> float {
+        if (ancestorScales[nodeIndex] >= 0.0f) {
+            return ancestorScales[nodeIndex];
+        }
+        const int parentIndex = GetNodeById(nodes[nodeIndex].parentId);
+        ancestorScales[nodeIndex] = 1.0f;
+        depths[nodeIndex] = 1;
+        if (parentIndex >= 0) {
+            ancestorScales[nodeIndex] = getAncestorScale(parentIndex) * maxScales[parentIndex];
+            depths[nodeIndex] = depths[parentIndex] + 1;
+        }
+        return ancestorScales[nodeIndex];
+    };
+    for (int nodeIndex = 0; nodeIndex < (int) nodes.size(); nodeIndex++) {
+        getReach(nodeIndex);
+        getAncestorScale(nodeIndex);
+    }
+
+    std::atomic<size_t> droppedCount(0);
+    for (RawAnimation &animation : animations) {
+        const std::vector<float> &times = animation.times;
+        ThreadUtils::ParallelFor((int) animation.channels.size(), jobs, [&](int channelIx) {
+            RawChannel &channel = animation.channels[channelIx];
+            const int nodeIndex = channel.nodeIndex;
+            // The rotation turns the scaled descendants, the scale stretches the unscaled ones
+            const float reach = std::max(reaches[nodeIndex], FLT_MIN);
+            const float localReach = std::max(reach / std::max(maxScales[nodeIndex], FLT_MIN), FLT_MIN);
+            // The errors of the nodes on a path from the root add up, and so do those of the three paths of a node.
+            // Every node gets an even share of the longest path through it, in the world space of its parent.
+            const int pathLength = depths[nodeIndex] + heights[nodeIndex] - 1;
+            const float tolerance = positionTolerance / (3.0f * pathLength * std::max(ancestorScales[nodeIndex], FLT_MIN));
+            size_t dropped = 0;
+
+            if (channel.translations.size() == times.size() && channel.translationTimes.empty()) {
+                const std::vector<Vec3f> &values = channel.translations;
+                const std::vector<int> keys = ReduceKeys(times, [&](int first, int last, int index, float t) {
+                    const Vec3f value = values[first] * (1.0f - t) + values[last] * t;
+                    return (value - values[index]).Length() <= tolerance;
+                });
+                dropped += KeepKeys(channel.translations, channel.translationTimes, times, keys, 1);
+            }
+            if (channel.rotations.size() == times.size() && channel.rotationTimes.empty()) {
+                // A rotation error of some angle moves the descendants by up to that angle times their distance
+                const std::vector<Quatf> &values = channel.rotations;
+                const float angleTolerance = tolerance / reach;
+                const std::vector<int> keys = ReduceKeys(times, [&](int first, int last, int index, float t) {
+                    return GetRotationAngle(SlerpShortest(values[first], values[last], t), values[index]) <= angleTolerance;
+                });
+                dropped += KeepKeys(channel.rotations, channel.rotationTimes, times, keys, 1);
+            }
+            if (channel.scales.size() == times.size() && channel.scaleTimes.empty()) {
+                const std::vector<Vec3f> &values = channel.scales;
+                const float scaleTolerance = tolerance / localReach;
+                const std::vector<int> keys = ReduceKeys(times, [&](int first, int last, int index, float t) {
+                    const Vec3f value = values[first] * (1.0f - t) + values[last] * t - values[index];
+                    return GetMaxScale(value) <= scaleTolerance;
+                });
+                dropped += KeepKeys(channel.scales, channel.scaleTimes, times, keys, 1);
+            }
+            if (!channel.weights.empty() && channel.weightTimes.empty() && !times.empty() && channel.weights.size() % times.size() == 0) {
+                const std::vector<float> &values = channel.weights;
+                const size_t stride = values.size() / times.size();
+                const std::vector<int> keys = ReduceKeys(times, [&](int first, int last, int index, float t) {
+                    for (size_t i = 0; i < stride; i++) {
+                        const float value = values[first * stride + i] * (1.0f - t) + values[last * stride + i] * t;
+                        if (fabsf(value - values[index * stride + i]) > weightTolerance) {
+                            return false;
+                        }
+                    }
+                    return true;
+                });
+                dropped += KeepKeys(channel.weights, channel.weightTimes, times, keys, stride);
+            }
+
+            droppedCount += dropped;
+        });
+    }
+    return droppedCount;
 }
@@ -24,6 +24,15 @@ enum class ComputeNormalsOption {
     ALWAYS      // compute a new normal for every vertex, obliterating whatever may have been there before
 };
 
+/**
+ * When to (re-)compute tangents and binormals from the normals and the first texture coordinates.
+ */
+enum class ComputeTangentsOption {
+    NEVER,      // keep whatever tangents were read from the source
+    MISSING,    // if a mesh lacks tangents, compute them all
+    ALWAYS      // compute a new tangent frame for every vertex
+};
+
 enum class UseLongIndicesOptions {
     NEVER,      // only ever use 16-bit indices
     AUTO,       // use shorts or longs depending on vertex count
@@ -60,6 +69,12 @@ struct GltfOptions
     ComputeNormalsOption computeNormals = ComputeNormalsOption::BROKEN;
     /** When to use 32-bit indices. */
     UseLongIndicesOptions useLongIndices = UseLongIndicesOptions::AUTO;
+    /** Largest world space position error, in scene units, that dropping animation keys may cause, zero keeps every key. */
+    float animationTolerance { 0.0f };
+    /** Largest morph weight error that dropping animation keys may cause. */
+    float animationWeightTolerance { 0.001f };
+    /** Number of threads the material models are built on, zero or less uses one per hardware thread. */
+    int jobs { 1 };
 };
 
 enum RawVertexAttribute
@@ -127,15 +142,176 @@ class VertexHasher
 public:
     size_t operator()(const RawVertex &v) const
     {
+        // Hashes every field compared by RawVertex::operator==, so seam and hard edge vertices don't collide.
         size_t seed = 5381;
         const auto hasher = std::hash<float>{};
-        seed ^= hasher(v.position[0]) + 0x9e3779b9 + (seed<<6) + (seed>>2);
-        seed ^= hasher(v.position[1]) + 0x9e3779b9 + (seed<<6) + (seed>>2);
-        seed ^= hasher(v.position[2]) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+        const auto combine = [&seed](size_t hash) { seed ^= hash + 0x9e3779b9 + (seed<<6) + (seed>>2); };
+        for (int i = 0; i < 3; i++) { combine(hasher(v.position[i])); }
+        for (int i = 0; i < 3; i++) { combine(hasher(v.normal[i])); }
+        for (int i = 0; i < 3; i++) { combine(hasher(v.binormal[i])); }
+        for (int i = 0; i < 4; i++) { combine(hasher(v.tangent[i])); }
+        for (int i = 0; i < 4; i++) { combine(hasher(v.color[i])); }
+        for (int i = 0; i < 2; i++) { combine(hasher(v.uv0[i])); }
+        for (int i = 0; i < 2; i++) { combine(hasher(v.uv1[i])); }
+        for (int i = 0; i < 4; i++) { combine(std::hash<int>{}(v.jointIndices[i])); }
+        for (int i = 0; i < 4; i++) { combine(hasher(v.jointWeights[i])); }
+        combine(std::hash<int>{}(v.blendSurfaceIx));
+        combine(std::hash<bool>{}(v.polarityUv0));
+        for (const auto &blend : v.blends) {
+            for (int i = 0; i < 3; i++) { combine(hasher(blend.position[i])); }
+            for (int i = 0; i < 3; i++) { combine(hasher(blend.normal[i])); }
+            for (int i = 0; i < 4; i++) { combine(hasher(blend.tangent[i])); }
+        }
         return seed;
     }
 };
 
+// A non-zero blend shape delta of one vertex for one blend channel.
+struct RawBlendDelta
+{
+    int            channel;
+    RawBlendVertex delta;
+
+    bool operator==(const RawBlendDelta &other) const {
+        return channel == other.channel && delta == other.delta;
+    }
+};
+
+// The blend shape deltas of one vertex: count sparse deltas at offset in the blend arena, for a vertex
+// that has channelCount blend channels in total.
+struct RawBlendSpan
+{
+    int offset;
+    int count;
+    int channelCount;
+};
+
+/**
+ * Structure of arrays vertex storage, every vertex member lives in a stream of its own. A stream is only
+ * allocated once a vertex with a value other than the RawVertex default is added, until then it reads as
+ * the default value. Passes that touch a single attribute can work on its stream directly.
+ */
+class RawVertexStreams
+{
+public:
+    size_t GetCount() const { return count; }
+
+    void Add(const RawVertex &vertex);
+    // Appends vertex index of other, stream by stream.
+    void Add(const RawVertexStreams &other, const int index);
+    void Clear();
+    // Moves vertex i to targets[i] and drops it when that is negative, the kept targets are [0, count).
+    void Compact(const std::vector<int> &targets, const int count);
+
+    RawVertex GetVertex(const int index) const;
+    bool Equals(const int index, const RawVertex &vertex) const;
+    bool Equals(const int index, const RawVertexStreams &other, const int otherIndex) const;
+    // Same as GetVertex(index).Difference(other).
+    size_t Difference(const int index, const RawVertex &other) const;
+
+    const Vec3f &GetPosition(const int index) const { return Get(position, index, defaultVertex.position); }
+    const Vec3f &GetNormal(const int index) const { return Get(normal, index, defaultVertex.normal); }
+    const Vec3f &GetBinormal(const int index) const { return Get(binormal, index, defaultVertex.binormal); }
+    const Vec4f &GetTangent(const int index) const { return Get(tangent, index, defaultVertex.tangent); }
+    const Vec4f &GetColor(const int index) const { return Get(color, index, defaultVertex.color); }
+    const Vec2f &GetUv0(const int index) const { return Get(uv0, index, defaultVertex.uv0); }
+    const Vec2f &GetUv1(const int index) const { return Get(uv1, index, defaultVertex.uv1); }
+    const Vec4i &GetJointIndices(const int index) const { return Get(jointIndices, index, defaultVertex.jointIndices); }
+    const Vec4f &GetJointWeights(const int index) const { return Get(jointWeights, index, defaultVertex.jointWeights); }
+    int GetBlendSurfaceIx(const int index) const { return Get(blendSurfaceIx, index, defaultVertex.blendSurfaceIx); }
+    // Blend shape deltas are kept sparse in one arena, channels without a delta read as zero.
+    int GetBlendChannelCount(const int index) const { return blendSpans.empty() ? 0 : blendSpans[index].channelCount; }
+    RawBlendVertex GetBlend(const int index, const int channel) const;
+    bool GetPolarityUv0(const int index) const { return !polarityUv0.empty() && polarityUv0[index] != 0; }
+
+    // The stream of an attribute member of RawVertex, empty while it is not allocated.
+    const std::vector<Vec2f> &GetStream(const Vec2f RawVertex::* ptr) const { return (ptr == &RawVertex::uv0) ? uv0 : uv1; }
+    const std::vector<Vec3f> &GetStream(const Vec3f RawVertex::* ptr) const
+    {
+        return (ptr == &RawVertex::position) ? position : (ptr == &RawVertex::normal) ? normal : binormal;
+    }
+    const std::vector<Vec4f> &GetStream(const Vec4f RawVertex::* ptr) const
+    {
+        return (ptr == &RawVertex::tangent) ? tangent : (ptr == &RawVertex::color) ? color : jointWeights;
+    }
+    const std::vector<Vec4i> &GetStream(const Vec4i RawVertex::*) const { return jointIndices; }
+
+    // Streams for passes that change an attribute of every vertex, they are allocated on first access.
+    std::vector<Vec3f> &GetPositionStream() { return Allocate(position, defaultVertex.position); }
+    std::vector<Vec3f> &GetNormalStream() { return Allocate(normal, defaultVertex.normal); }
+    std::vector<Vec3f> &GetBinormalStream() { return Allocate(binormal, defaultVertex.binormal); }
+    std::vector<Vec4f> &GetTangentStream() { return Allocate(tangent, defaultVertex.tangent); }
+    std::vector<Vec2f> &GetUv0Stream() { return Allocate(uv0, defaultVertex.uv0); }
+    std::vector<Vec2f> &GetUv1Stream() { return Allocate(uv1, defaultVertex.uv1); }
+
+    static const RawVertex      defaultVertex;
+    static const RawBlendVertex defaultBlend;
+
+private:
+    // Snapshots copy the streams as they are.
+    friend class RawModel;
+
+    void AddBlends(const RawVertex &vertex);
+    void AddBlends(const RawVertexStreams &other, const int index);
+    bool BlendsEqual(const int index, const RawVertex &vertex) const;
+    bool BlendsEqual(const int index, const RawVertexStreams &other, const int otherIndex) const;
+
+    template<typename _value_type_>
+    static const _value_type_ &Get(const std::vector<_value_type_> &stream, const int index, const _value_type_ &defaultValue)
+    {
+        return stream.empty() ? defaultValue : stream[index];
+    }
+
+    template<typename _value_type_>
+    std::vector<_value_type_> &Allocate(std::vector<_value_type_> &stream, const _value_type_ &defaultValue)
+    {
+        if (stream.empty()) {
+            stream.assign(count, defaultValue);
+        }
+        return stream;
+    }
+
+    size_t                                   count { 0 };
+    std::vector<Vec3f>                       position;
+    std::vector<Vec3f>                       normal;
+    std::vector<Vec3f>                       binormal;
+    std::vector<Vec4f>                       tangent;
+    std::vector<Vec4f>                       color;
+    std::vector<Vec2f>                       uv0;
+    std::vector<Vec2f>                       uv1;
+    std::vector<Vec4i>                       jointIndices;
+    std::vector<Vec4f>                       jointWeights;
+    std::vector<int>                         blendSurfaceIx;
+    std::vector<RawBlendSpan>                blendSpans;
+    std::vector<RawBlendDelta>               blendArena;
+    std::vector<uint8_t>                     polarityUv0;
+};
+
+/**
+ * Open addressing map from vertices to their index in a vertex array. Only indices and the hash of every
+ * vertex are stored, keys are compared against the vertex array itself.
+ */
+class RawVertexMap
+{
+public:
+    // Returns the index of a vertex equal to the given one, or -1; hash is VertexHasher()(vertex).
+    int Find(const RawVertex &vertex, const size_t hash, const RawVertexStreams &vertices) const;
+    int Find(const RawVertexStreams &other, const int otherIndex, const size_t hash, const RawVertexStreams &vertices) const;
+    // Records vertices[index], which must be the next index, with its hash.
+    void Insert(const int index, const size_t hash);
+    void Clear();
+
+    // Number of hashed vertices, falls behind the vertex array once the vertices are changed in place.
+    size_t GetCount() const { return hashes.size(); }
+    size_t GetHash(const int index) const { return hashes[index]; }
+
+private:
+    void Grow();
+
+    std::vector<int>    slots;  // vertex index per slot, -1 when empty
+    std::vector<size_t> hashes; // hash per vertex index
+};
+
 struct RawTriangle
 {
     int verts[3];
@@ -143,6 +319,26 @@ struct RawTriangle
     int surfaceIndex;
 };
 
+/**
+ * Affine transform of texture coordinates, (u, v) becomes (m[0][0] u + m[0][1] v + m[0][2], m[1][0] u + m[1][1] v + m[1][2]).
+ * Flips and other fixed transforms are composed into one of these once, instead of being applied one by one to every vertex.
+ */
+struct RawTextureTransform
+{
+    float m[2][3] { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+
+    static RawTextureTransform FlipU();
+    static RawTextureTransform FlipV();
+
+    // The transform that applies this one and then next.
+    RawTextureTransform Then(const RawTextureTransform &next) const;
+    bool IsIdentity() const;
+    Vec2f Apply(const Vec2f &uv) const
+    {
+        return Vec2f(m[0][0] * uv[0] + m[0][1] * uv[1] + m[0][2], m[1][0] * uv[0] + m[1][1] * uv[1] + m[1][2]);
+    }
+};
+
 enum RawShadingModel
 {
     RAW_SHADING_MODEL_UNKNOWN = -1,
@@ -342,6 +538,12 @@ struct RawChannel
     std::vector<Quatf> rotations;
     std::vector<Vec3f> scales;
     std::vector<float> weights;
+
+    // Key times of every path once its keys are reduced, empty while the path has a key at every RawAnimation::times.
+    std::vector<float> translationTimes;
+    std::vector<float> rotationTimes;
+    std::vector<float> scaleTimes;
+    std::vector<float> weightTimes;
 };
 
 struct RawAnimation
@@ -380,6 +582,14 @@ struct RawCamera
     } orthographic;
 };
 
+// A surface drawn at a transform, baked into the geometry of another surface.
+struct RawSurfaceInstance
+{
+    int   surfaceIndex;
+    int   targetSurfaceIndex;
+    Mat4f transform;
+};
+
 struct RawNode
 {
     bool                     isJoint;
@@ -403,6 +613,8 @@ public:
     int AddVertex(const RawVertex &vertex);
     int AddTriangle(const int v0, const int v1, const int v2, const int materialIndex, const int surfaceIndex);
     int AddTexture(const std::string &name, const std::string &fileName, const std::string &fileLocation, RawTextureUsage usage);
+    // Adds a texture whose image properties are already known, or returns the one with the same name and usage.
+    int AddTexture(const RawTexture &texture);
     int AddMaterial(const RawMaterial &material);
     int AddMaterial(
         const char *name, const RawMaterialType materialType, const int textures[RAW_TEXTURE_USAGE_MAX],
@@ -420,21 +632,66 @@ public:
     void SetRootNode(const long nodeId) { rootNodeId = nodeId; }
     const long GetRootNode() const { return rootNodeId; }
 
+    // Append the vertices, triangles, textures, materials and surfaces of other, as if they had been added to this model
+    // one by one; nodes, animations and cameras of other are ignored.
+    void Append(const RawModel &other);
+
     // Remove unused vertices, textures or materials after removing vertex attributes, textures, materials or surfaces.
     void Condense();
 
-    void TransformGeometry(ComputeNormalsOption);
+    // Free the vertices and triangles once they have been exported, nodes, surfaces and materials are kept.
+    void ReleaseGeometry();
+
+    // Normals and tangents are computed on up to jobs threads, zero or less uses one per hardware thread.
+    void TransformGeometry(ComputeNormalsOption, ComputeTangentsOption = ComputeTangentsOption::NEVER, const int jobs = 1);
 
+    // Applies the transform to uv0 and uv1 in one pass over each stream.
+    void TransformTextures(const RawTextureTransform &transform);
+    // Arbitrary transforms, applied one after the other to every texture coordinate.
     void TransformTextures(const std::vector<std::function<Vec2f(Vec2f)>> &transforms);
 
-    size_t CalculateNormals(bool);
+    // Moves the triangles of every material with a remap entry of zero or more to that material, applying the uv0
+    // transform of their old material. Vertices shared with other triangles are duplicated, call Condense() afterwards
+    // to drop the ones no triangle uses anymore.
+    void RemapMaterials(const std::vector<int> &materialRemap, const std::vector<RawTextureTransform> &uvTransforms);
+
+    // Appends a copy of the triangles of every instance to its target surface, with the vertices transformed into the
+    // space of the target; mirroring transforms flip the winding. Afterwards the triangles of every surface flagged in
+    // removeSurfaces are dropped, call Condense() to drop the vertices no triangle uses anymore.
+    void BakeSurfaces(const std::vector<RawSurfaceInstance> &instances, const std::vector<bool> &removeSurfaces);
+
+    // Drops the nodes flagged in removeNodes, none of which may be animated, a camera or a joint.
+    void RemoveNodes(const std::vector<bool> &removeNodes);
+
+    // Merges every vertex into the first vertex within positionTolerance of it whose normals, binormals and tangents
+    // are within normalAngle degrees and texture coordinates within uvTolerance, all other attributes being equal.
+    // A grid hashes the positions, so the pass is linear in the vertex count. Welded vertices are left unused, call
+    // Condense() to drop them. Returns the number of vertices welded, none while positionTolerance isn't positive.
+    size_t WeldVertices(const float positionTolerance, const float normalAngle, const float uvTolerance);
+
+    // Drops the triangles that repeat a vertex, whose corners move together and have an area of at most minArea or an
+    // angle below minAngle degrees, and the repeats of a triangle with the same winding, material and surface.
+    // surfaceDropCounts receives the number dropped from every surface; call Condense() to drop the vertices no
+    // triangle uses anymore. Returns the number of triangles dropped.
+    size_t RemoveDegenerateTriangles(const float minArea, const float minAngle, std::vector<int> &surfaceDropCounts);
+
+    // Drops the animation keys that linear interpolation, or slerp, of their neighbours reproduces within tolerance.
+    // The position tolerance bounds, to first order, the summed error of all node paths in the world space positions
+    // of the nodes and of geometry within the shell distance of the leaves, for the largest scales and translations
+    // the nodes take. The weight tolerance bounds the error of every morph weight. Returns the number of keys dropped.
+    size_t ReduceKeyframes(const float positionTolerance, const float weightTolerance, const int jobs = 1);
+
+    size_t CalculateNormals(bool, const int jobs = 1);
+    // MikkTSpace style tangents: per corner tangents in the plane of the vertex normal, weighted by the corner angle.
+    size_t CalculateTangents(const int jobs = 1);
 
     // Get the attributes stored per vertex.
     int GetVertexAttributes() const { return vertexAttributes; }
 
     // Iterate over the vertices.
-    int GetVertexCount() const { return (int) vertices.size(); }
-    const RawVertex &GetVertex(const int index) const { return vertices[index]; }
+    int GetVertexCount() const { return (int) vertices.GetCount(); }
+    RawVertex GetVertex(const int index) const { return vertices.GetVertex(index); }
+    const RawVertexStreams &GetVertexStreams() const { return vertices; }
 
     // Iterate over the triangles.
     int GetTriangleCount() const { return (int) triangles.size(); }
@@ -476,16 +733,31 @@ public:
     // Create an array with a raw model for each material.
     // Multiple surfaces with the same material will turn into a single model.
     // However, surfaces that are marked as 'discrete' will turn into separate models.
+    // The models are built on up to jobs threads, zero or less uses one per hardware thread.
+    // With maxPaletteJoints a skinned model also ends before its surface would bind more joints than that; the
+    // surface of every model then only lists the joints it binds, and the joint indices of its vertices are local.
     void CreateMaterialModels(
-        std::vector<RawModel> &materialModels, bool shortIndices, const int keepAttribs, const bool forceDiscrete) const;
+        std::vector<RawModel> &materialModels, bool shortIndices, const int keepAttribs, const bool forceDiscrete,
+        const int jobs = 1, const int maxPaletteJoints = 0) const;
+
+    // Write everything the model holds to a binary snapshot that LoadSnapshot reads back without the FBX SDK. Vertex
+    // streams and other flat arrays are stored as they are in memory, so a snapshot is only read by a build with the
+    // same layout of the math types.
+    bool SaveSnapshot(const char *fileName) const;
+    // Replaces the model with the one in the snapshot; false, leaving the model as it was, if the file can't be read,
+    // is not a snapshot of this version and layout, or is inconsistent.
+    bool LoadSnapshot(const char *fileName);
 
 private:
-    Vec3f getFaceNormal(int verts[3]) const;
+    Vec3f getFaceNormal(const int verts[3]) const;
+    // The corners, 3 * triangle + corner, of every vertex in triangle order: [offsets[v], offsets[v + 1]) of corners.
+    void getVertexCorners(std::vector<int> &offsets, std::vector<int> &corners) const;
+    void RehashVertices();
 
     long                                             rootNodeId;
     int                                              vertexAttributes;
-    std::unordered_map<RawVertex, int, VertexHasher> vertexHash;
-    std::vector<RawVertex>                           vertices;
+    RawVertexMap                                     vertexMap;
+    RawVertexStreams                                 vertices;
     std::vector<RawTriangle>                         triangles;
     std::vector<RawTexture>                          textures;
     std::vector<RawMaterial>                         materials;
@@ -493,14 +765,18 @@ private:
     std::vector<RawAnimation>                        animations;
     std::vector<RawCamera>                           cameras;
     std::vector<RawNode>                             nodes;
+    std::unordered_map<long, int>                    surfaceIndices; // surface id to index of its first surface
+    std::unordered_map<long, int>                    nodeIndices;    // node id to index
 };
 
 template<typename _attrib_type_>
 void RawModel::GetAttributeArray(std::vector<_attrib_type_> &out, const _attrib_type_ RawVertex::* ptr) const
 {
-    out.resize(vertices.size());
-    for (size_t i = 0; i < vertices.size(); i++) {
-        out[i] = vertices[i].*ptr;
+    const std::vector<_attrib_type_> &stream = vertices.GetStream(ptr);
+    if (stream.empty()) {
+        out.assign(vertices.GetCount(), RawVertexStreams::defaultVertex.*ptr);
+    } else {
+        out = stream;
     }
 }
 
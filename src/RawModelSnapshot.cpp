@@ -0,0 +1,543 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+
+#include "FBX2glTF.h"
+#include "RawModel.h"
+
+/**
+ * A snapshot is a header followed by the model, field by field in the order SaveSnapshot writes them. Arrays are a
+ * uint64 count followed by the elements as they are in memory, strings a uint64 length followed by the characters,
+ * node and surface ids are int64, other integers and enums int32. The layout of the header:
+ *
+ *   uint32 magic       'RSNP'
+ *   uint32 version     SNAPSHOT_VERSION
+ *   uint32 layout[]    sizeof of every type that is stored as it is in memory, see GetSnapshotLayout()
+ */
+static const uint32_t SNAPSHOT_MAGIC   = 0x504e5352;
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+static std::vector<uint32_t> GetSnapshotLayout()
+{
+    return {
+        sizeof(Vec2f), sizeof(Vec3f), sizeof(Vec4f), sizeof(Vec4i), sizeof(Quatf), sizeof(Mat4f), sizeof(RawBlendDelta),
+        sizeof(RawBlendSpan), sizeof(RawTriangle), sizeof(RawCamera().perspective), sizeof(RawCamera().orthographic)
+    };
+}
+
+class SnapshotWriter
+{
+public:
+    template<typename _type_>
+    void Write(const _type_ &value) { Append(&value, sizeof(value)); }
+
+    template<typename _type_>
+    void WriteArray(const std::vector<_type_> &values)
+    {
+        Write((uint64_t) values.size());
+        Append(values.data(), values.size() * sizeof(_type_));
+    }
+
+    void WriteInt(const int value) { Write((int32_t) value); }
+    void WriteId(const long id) { Write((int64_t) id); }
+
+    void WriteIds(const std::vector<long> &ids)
+    {
+        Write((uint64_t) ids.size());
+        for (const long id : ids) {
+            WriteId(id);
+        }
+    }
+
+    void WriteString(const std::string &value)
+    {
+        Write((uint64_t) value.size());
+        Append(value.data(), value.size());
+    }
+
+    const std::vector<uint8_t> &GetData() const { return data; }
+
+private:
+    void Append(const void *bytes, const size_t size)
+    {
+        data.insert(data.end(), (const uint8_t *) bytes, (const uint8_t *) bytes + size);
+    }
+
+    std::vector<uint8_t> data;
+};
+
+// Reads past the end, or any read after it, fail the reader and read as zero, so counts of a truncated file are 0.
+class SnapshotReader
+{
+public:
+    SnapshotReader(const uint8_t *data, const size_t size)
+        : data(data), size(size), offset(0), failed(false)
+    {
+    }
+
+    template<typename _type_>
+    void Read(_type_ &value) { Take(&value, sizeof(value)); }
+
+    template<typename _type_>
+    void ReadArray(std::vector<_type_> &values)
+    {
+        const uint64_t count = ReadCount(sizeof(_type_));
+        values.resize((size_t) count);
+        Take(values.data(), (size_t) count * sizeof(_type_));
+    }
+
+    int ReadInt()
+    {
+        int32_t value = 0;
+        Read(value);
+        return value;
+    }
+
+    long ReadId()
+    {
+        int64_t id = 0;
+        Read(id);
+        return (long) id;
+    }
+
+    void ReadIds(std::vector<long> &ids)
+    {
+        const uint64_t count = ReadCount(sizeof(int64_t));
+        ids.resize((size_t) count);
+        for (long &id : ids) {
+            id = ReadId();
+        }
+    }
+
+    void ReadString(std::string &value)
+    {
+        const uint64_t length = ReadCount(1);
+        value.assign((const char *) data + offset, failed ? 0 : (size_t) length);
+        offset += failed ? 0 : (size_t) length;
+    }
+
+    // A count of elements of the given size, or 0 failing the reader if they can't fit in the rest of the file.
+    uint64_t ReadCount(const size_t elementSize)
+    {
+        uint64_t count = 0;
+        Read(count);
+        if (elementSize > 0 && count > (size - offset) / elementSize) {
+            failed = true;
+            return 0;
+        }
+        return count;
+    }
+
+    bool IsAtEnd() const { return offset == size; }
+    bool HasFailed() const { return failed; }
+
+private:
+    void Take(void *bytes, const size_t count)
+    {
+        if (count == 0) {
+            return;
+        }
+        if (failed || count > size - offset) {
+            failed = true;
+            memset(bytes, 0, count);
+            return;
+        }
+        memcpy(bytes, data + offset, count);
+        offset += count;
+    }
+
+    const uint8_t *data;
+    size_t        size;
+    size_t        offset;
+    bool          failed;
+};
+
+bool RawModel::SaveSnapshot(const char *fileName) const
+{
+    SnapshotWriter writer;
+    writer.Write(SNAPSHOT_MAGIC);
+    writer.Write(SNAPSHOT_VERSION);
+    for (const uint32_t size : GetSnapshotLayout()) {
+        writer.Write(size);
+    }
+
+    writer.WriteId(rootNodeId);
+    writer.WriteInt(vertexAttributes);
+
+    writer.Write((uint64_t) vertices.count);
+    writer.WriteArray(vertices.position);
+    writer.WriteArray(vertices.normal);
+    writer.WriteArray(vertices.binormal);
+    writer.WriteArray(vertices.tangent);
+    writer.WriteArray(vertices.color);
+    writer.WriteArray(vertices.uv0);
+    writer.WriteArray(vertices.uv1);
+    writer.WriteArray(vertices.jointIndices);
+    writer.WriteArray(vertices.jointWeights);
+    writer.WriteArray(vertices.blendSurfaceIx);
+    writer.WriteArray(vertices.blendSpans);
+    writer.WriteArray(vertices.blendArena);
+    writer.WriteArray(vertices.polarityUv0);
+
+    writer.WriteArray(triangles);
+
+    writer.Write((uint64_t) textures.size());
+    for (const RawTexture &texture : textures) {
+        writer.WriteString(texture.name);
+        writer.WriteInt(texture.width);
+        writer.WriteInt(texture.height);
+        writer.WriteInt(texture.mipLevels);
+        writer.WriteInt(texture.usage);
+        writer.WriteInt(texture.occlusion);
+        writer.WriteString(texture.fileName);
+        writer.WriteString(texture.fileLocation);
+    }
+
+    writer.Write((uint64_t) materials.size());
+    for (const RawMaterial &material : materials) {
+        writer.WriteString(material.name);
+        writer.WriteInt(material.type);
+        for (int usage = 0; usage < RAW_TEXTURE_USAGE_MAX; usage++) {
+            writer.WriteInt(material.textures[usage]);
+        }
+
+        // The properties are written as the shading model they were created for, with a tag for their type
+        const RawMatProps *info = material.info.get();
+        if (const RawTraditionalMatProps *props = dynamic_cast<const RawTraditionalMatProps *>(info)) {
+            writer.WriteInt(1);
+            writer.WriteInt(props->shadingModel);
+            writer.Write(props->ambientFactor);
+            writer.Write(props->diffuseFactor);
+            writer.Write(props->emissiveFactor);
+            writer.Write(props->specularFactor);
+            writer.Write(props->shininess);
+        } else if (const RawMetRoughMatProps *props = dynamic_cast<const RawMetRoughMatProps *>(info)) {
+            writer.WriteInt(2);
+            writer.WriteInt(props->shadingModel);
+            writer.Write(props->diffuseFactor);
+            writer.Write(props->emissiveFactor);
+            writer.Write(props->emissiveIntensity);
+            writer.Write(props->metallic);
+            writer.Write(props->roughness);
+        } else if (info != nullptr) {
+            writer.WriteInt(0);
+            writer.WriteInt(info->shadingModel);
+        } else {
+            writer.WriteInt(-1);
+        }
+    }
+
+    writer.Write((uint64_t) surfaces.size());
+    for (const RawSurface &surface : surfaces) {
+        writer.WriteId(surface.id);
+        writer.WriteString(surface.name);
+        writer.WriteId(surface.skeletonRootId);
+        writer.Write(surface.bounds.min);
+        writer.Write(surface.bounds.max);
+        writer.Write((uint8_t) surface.bounds.initialized);
+        writer.WriteIds(surface.jointIds);
+        writer.WriteArray(surface.jointGeometryMins);
+        writer.WriteArray(surface.jointGeometryMaxs);
+        writer.WriteArray(surface.inverseBindMatrices);
+        writer.Write((uint64_t) surface.blendChannels.size());
+        for (const RawBlendChannel &channel : surface.blendChannels) {
+            writer.Write(channel.defaultDeform);
+            writer.Write((uint8_t) channel.hasNormals);
+            writer.Write((uint8_t) channel.hasTangents);
+        }
+        writer.Write((uint8_t) surface.discrete);
+    }
+
+    writer.Write((uint64_t) animations.size());
+    for (const RawAnimation &animation : animations) {
+        writer.WriteString(animation.name);
+        writer.WriteArray(animation.times);
+        writer.Write((uint64_t) animation.channels.size());
+        for (const RawChannel &channel : animation.channels) {
+            writer.WriteInt(channel.nodeIndex);
+            writer.WriteArray(channel.translations);
+            writer.WriteArray(channel.rotations);
+            writer.WriteArray(channel.scales);
+            writer.WriteArray(channel.weights);
+            writer.WriteArray(channel.translationTimes);
+            writer.WriteArray(channel.rotationTimes);
+            writer.WriteArray(channel.scaleTimes);
+            writer.WriteArray(channel.weightTimes);
+        }
+    }
+
+    writer.Write((uint64_t) cameras.size());
+    for (const RawCamera &camera : cameras) {
+        writer.WriteString(camera.name);
+        writer.WriteId(camera.nodeId);
+        writer.WriteInt(camera.mode);
+        writer.Write(camera.perspective);
+        writer.Write(camera.orthographic);
+    }
+
+    writer.Write((uint64_t) nodes.size());
+    for (const RawNode &node : nodes) {
+        writer.Write((uint8_t) node.isJoint);
+        writer.WriteId(node.id);
+        writer.WriteString(node.name);
+        writer.WriteId(node.parentId);
+        writer.WriteIds(node.childIds);
+        writer.Write(node.translation);
+        writer.Write(node.rotation);
+        writer.Write(node.scale);
+        writer.WriteId(node.surfaceId);
+    }
+
+    FILE *file = fopen(fileName, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    const std::vector<uint8_t> &data = writer.GetData();
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return (fclose(file) == 0) && written;
+}
+
+bool RawModel::LoadSnapshot(const char *fileName)
+{
+    // The whole file is read at once, every array is then a single copy out of it
+    FILE *file = fopen(fileName, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> data;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        const long fileSize = ftell(file);
+        if (fileSize > 0 && fseek(file, 0, SEEK_SET) == 0) {
+            data.resize((size_t) fileSize);
+            data.resize(fread(data.data(), 1, data.size(), file));
+        }
+    }
+    fclose(file);
+
+    SnapshotReader reader(data.data(), data.size());
+    uint32_t magic, version;
+    reader.Read(magic);
+    reader.Read(version);
+    if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) {
+        return false;
+    }
+    for (const uint32_t expectedSize : GetSnapshotLayout()) {
+        uint32_t size;
+        reader.Read(size);
+        if (size != expectedSize) {
+            return false;
+        }
+    }
+
+    RawModel model;
+    model.rootNodeId = reader.ReadId();
+    model.vertexAttributes = reader.ReadInt();
+
+    RawVertexStreams &streams = model.vertices;
+    uint64_t vertexCount;
+    reader.Read(vertexCount);
+    streams.count = (size_t) vertexCount;
+    reader.ReadArray(streams.position);
+    reader.ReadArray(streams.normal);
+    reader.ReadArray(streams.binormal);
+    reader.ReadArray(streams.tangent);
+    reader.ReadArray(streams.color);
+    reader.ReadArray(streams.uv0);
+    reader.ReadArray(streams.uv1);
+    reader.ReadArray(streams.jointIndices);
+    reader.ReadArray(streams.jointWeights);
+    reader.ReadArray(streams.blendSurfaceIx);
+    reader.ReadArray(streams.blendSpans);
+    reader.ReadArray(streams.blendArena);
+    reader.ReadArray(streams.polarityUv0);
+
+    reader.ReadArray(model.triangles);
+
+    model.textures.resize((size_t) reader.ReadCount(1));
+    for (RawTexture &texture : model.textures) {
+        reader.ReadString(texture.name);
+        texture.width = reader.ReadInt();
+        texture.height = reader.ReadInt();
+        texture.mipLevels = reader.ReadInt();
+        texture.usage = (RawTextureUsage) reader.ReadInt();
+        texture.occlusion = (RawTextureOcclusion) reader.ReadInt();
+        reader.ReadString(texture.fileName);
+        reader.ReadString(texture.fileLocation);
+    }
+
+    model.materials.resize((size_t) reader.ReadCount(1));
+    for (RawMaterial &material : model.materials) {
+        reader.ReadString(material.name);
+        material.type = (RawMaterialType) reader.ReadInt();
+        for (int usage = 0; usage < RAW_TEXTURE_USAGE_MAX; usage++) {
+            material.textures[usage] = reader.ReadInt();
+        }
+
+        const int infoType = reader.ReadInt();
+        if (infoType == 1) {
+            const RawShadingModel shadingModel = (RawShadingModel) reader.ReadInt();
+            Vec3f ambientFactor, emissiveFactor, specularFactor;
+            Vec4f diffuseFactor;
+            float shininess;
+            reader.Read(ambientFactor);
+            reader.Read(diffuseFactor);
+            reader.Read(emissiveFactor);
+            reader.Read(specularFactor);
+            reader.Read(shininess);
+            material.info = std::make_shared<RawTraditionalMatProps>(
+                shadingModel, std::move(ambientFactor), std::move(diffuseFactor), std::move(emissiveFactor),
+                std::move(specularFactor), shininess);
+        } else if (infoType == 2) {
+            const RawShadingModel shadingModel = (RawShadingModel) reader.ReadInt();
+            Vec4f diffuseFactor;
+            Vec3f emissiveFactor;
+            float emissiveIntensity, metallic, roughness;
+            reader.Read(diffuseFactor);
+            reader.Read(emissiveFactor);
+            reader.Read(emissiveIntensity);
+            reader.Read(metallic);
+            reader.Read(roughness);
+            material.info = std::make_shared<RawMetRoughMatProps>(
+                shadingModel, std::move(diffuseFactor), std::move(emissiveFactor), emissiveIntensity, metallic, roughness);
+        } else if (infoType == 0) {
+            material.info = std::make_shared<RawMatProps>((RawShadingModel) reader.ReadInt());
+        }
+    }
+
+    model.surfaces.resize((size_t) reader.ReadCount(1));
+    for (RawSurface &surface : model.surfaces) {
+        uint8_t initialized, discrete;
+        surface.id = reader.ReadId();
+        reader.ReadString(surface.name);
+        surface.skeletonRootId = reader.ReadId();
+        reader.Read(surface.bounds.min);
+        reader.Read(surface.bounds.max);
+        reader.Read(initialized);
+        surface.bounds.initialized = initialized != 0;
+        reader.ReadIds(surface.jointIds);
+        reader.ReadArray(surface.jointGeometryMins);
+        reader.ReadArray(surface.jointGeometryMaxs);
+        reader.ReadArray(surface.inverseBindMatrices);
+        surface.blendChannels.resize((size_t) reader.ReadCount(sizeof(float) + 2));
+        for (RawBlendChannel &channel : surface.blendChannels) {
+            uint8_t hasNormals, hasTangents;
+            reader.Read(channel.defaultDeform);
+            reader.Read(hasNormals);
+            reader.Read(hasTangents);
+            channel.hasNormals = hasNormals != 0;
+            channel.hasTangents = hasTangents != 0;
+        }
+        reader.Read(discrete);
+        surface.discrete = discrete != 0;
+    }
+
+    model.animations.resize((size_t) reader.ReadCount(1));
+    for (RawAnimation &animation : model.animations) {
+        reader.ReadString(animation.name);
+        reader.ReadArray(animation.times);
+        animation.channels.resize((size_t) reader.ReadCount(1));
+        for (RawChannel &channel : animation.channels) {
+            channel.nodeIndex = reader.ReadInt();
+            reader.ReadArray(channel.translations);
+            reader.ReadArray(channel.rotations);
+            reader.ReadArray(channel.scales);
+            reader.ReadArray(channel.weights);
+            reader.ReadArray(channel.translationTimes);
+            reader.ReadArray(channel.rotationTimes);
+            reader.ReadArray(channel.scaleTimes);
+            reader.ReadArray(channel.weightTimes);
+        }
+    }
+
+    model.cameras.resize((size_t) reader.ReadCount(1));
+    for (RawCamera &camera : model.cameras) {
+        reader.ReadString(camera.name);
+        camera.nodeId = reader.ReadId();
+        camera.mode = (decltype(camera.mode)) reader.ReadInt();
+        reader.Read(camera.perspective);
+        reader.Read(camera.orthographic);
+    }
+
+    model.nodes.resize((size_t) reader.ReadCount(1));
+    for (RawNode &node : model.nodes) {
+        uint8_t isJoint;
+        reader.Read(isJoint);
+        node.isJoint = isJoint != 0;
+        node.id = reader.ReadId();
+        reader.ReadString(node.name);
+        node.parentId = reader.ReadId();
+        reader.ReadIds(node.childIds);
+        reader.Read(node.translation);
+        reader.Read(node.rotation);
+        reader.Read(node.scale);
+        node.surfaceId = reader.ReadId();
+    }
+
+    if (reader.HasFailed() || reader.IsAtEnd() == false) {
+        return false;
+    }
+
+    // Allocated streams hold every vertex, and everything indexed from the snapshot must be in it
+    const std::vector<size_t> streamSizes = {
+        streams.position.size(), streams.normal.size(), streams.binormal.size(), streams.tangent.size(),
+        streams.color.size(), streams.uv0.size(), streams.uv1.size(), streams.jointIndices.size(),
+        streams.jointWeights.size(), streams.blendSurfaceIx.size(), streams.blendSpans.size(), streams.polarityUv0.size()
+    };
+    for (const size_t streamSize : streamSizes) {
+        if (streamSize != 0 && streamSize != streams.count) {
+            return false;
+        }
+    }
+    for (const RawBlendSpan &span : streams.blendSpans) {
+        if (span.offset < 0 || span.count < 0 || (size_t) span.offset + span.count > streams.blendArena.size()) {
+            return false;
+        }
+    }
+    for (const RawTriangle &triangle : model.triangles) {
+        for (int corner = 0; corner < 3; corner++) {
+            if (triangle.verts[corner] < 0 || (size_t) triangle.verts[corner] >= streams.count) {
+                return false;
+            }
+        }
+        if (triangle.materialIndex < 0 || triangle.materialIndex >= (int) model.materials.size() ||
+            triangle.surfaceIndex < 0 || triangle.surfaceIndex >= (int) model.surfaces.size()) {
+            return false;
+        }
+    }
+    for (const RawMaterial &material : model.materials) {
+        for (int usage = 0; usage < RAW_TEXTURE_USAGE_MAX; usage++) {
+            if (material.textures[usage] < -1 || material.textures[usage] >= (int) model.textures.size()) {
+                return false;
+            }
+        }
+    }
+    for (const RawAnimation &animation : model.animations) {
+        for (const RawChannel &channel : animation.channels) {
+            if (channel.nodeIndex < 0 || channel.nodeIndex >= (int) model.nodes.size()) {
+                return false;
+            }
+        }
+    }
+
+    // The lookups are derived from what was read
+    for (size_t i = 0; i < model.surfaces.size(); i++) {
+        model.surfaceIndices.emplace(model.surfaces[i].id, (int) i);
+    }
+    for (size_t i = 0; i < model.nodes.size(); i++) {
+        model.nodeIndices.emplace(model.nodes[i].id, (int) i);
+    }
+    model.RehashVertices();
+
+    *this = std::move(model);
+    return true;
+}
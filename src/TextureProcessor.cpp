@@ -0,0 +1,244 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#include "TextureProcessor.h"
+
+// GL enums stored in the KTX header
+#define KTX_GL_UNSIGNED_BYTE                         0x1401
+#define KTX_GL_RGB                                   0x1907
+#define KTX_GL_RGBA                                  0x1908
+#define KTX_GL_RGBA8                                 0x8058
+#define KTX_GL_SRGB8_ALPHA8                          0x8C43
+#define KTX_GL_COMPRESSED_RGB_S3TC_DXT1_EXT          0x83F0
+#define KTX_GL_COMPRESSED_RGBA_S3TC_DXT5_EXT         0x83F3
+#define KTX_GL_COMPRESSED_SRGB_S3TC_DXT1_EXT         0x8C4C
+#define KTX_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT   0x8C4F
+
+#define SRGB_ENCODE_TABLE_SIZE 4096
+
+struct KTXHeader
+{
+	uint8_t identifier[12];
+	uint32_t endianness;
+	uint32_t glType;
+	uint32_t glTypeSize;
+	uint32_t glFormat;
+	uint32_t glInternalFormat;
+	uint32_t glBaseInternalFormat;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t numberOfArrayElements;
+	uint32_t numberOfFaces;
+	uint32_t numberOfMipmapLevels;
+	uint32_t bytesOfKeyValueData;
+};
+
+struct SRGBTables
+{
+	SRGBTables()
+	{
+		for (int index = 0; index < 256; index++) {
+			const float value = index / 255.0f;
+			decode[index] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int index = 0; index < SRGB_ENCODE_TABLE_SIZE; index++) {
+			const float value = index / (float)(SRGB_ENCODE_TABLE_SIZE - 1);
+			const float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+			encode[index] = (uint8_t)std::min(255.0f, roundf(srgb * 255.0f));
+		}
+	}
+
+	float decode[256];
+	uint8_t encode[SRGB_ENCODE_TABLE_SIZE];
+};
+
+static const SRGBTables &GetSRGBTables()
+{
+	static const SRGBTables tables;
+	return tables;
+}
+
+TextureMipLevel ExpandToRGBA(const ImagePixels &image)
+{
+	TextureMipLevel level;
+	level.width = image.width;
+	level.height = image.height;
+	level.pixels.resize((size_t)image.width * image.height * 4);
+
+	const size_t count = (size_t)image.width * image.height;
+	const uint8_t *src = image.pixels.data();
+	uint8_t *dst = level.pixels.data();
+
+	for (size_t index = 0; index < count; index++, src += image.channels, dst += 4) {
+		switch (image.channels) {
+		case 1:
+			dst[0] = dst[1] = dst[2] = src[0];
+			dst[3] = 255;
+			break;
+		case 2:
+			dst[0] = dst[1] = dst[2] = src[0];
+			dst[3] = src[1];
+			break;
+		case 3:
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+			dst[3] = 255;
+			break;
+		default:
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+			dst[3] = src[3];
+			break;
+		}
+	}
+
+	return level;
+}
+
+static TextureMipLevel Downsample(const TextureMipLevel &level, bool srgb)
+{
+	const SRGBTables &tables = GetSRGBTables();
+
+	TextureMipLevel next;
+	next.width = std::max(1, level.width / 2);
+	next.height = std::max(1, level.height / 2);
+	next.pixels.resize((size_t)next.width * next.height * 4);
+
+	for (int y = 0; y < next.height; y++) {
+		const int y0 = std::min(y * 2, level.height - 1);
+		const int y1 = std::min(y * 2 + 1, level.height - 1);
+
+		for (int x = 0; x < next.width; x++) {
+			const int x0 = std::min(x * 2, level.width - 1);
+			const int x1 = std::min(x * 2 + 1, level.width - 1);
+
+			const uint8_t *samples[4] = {
+				&level.pixels[((size_t)y0 * level.width + x0) * 4],
+				&level.pixels[((size_t)y0 * level.width + x1) * 4],
+				&level.pixels[((size_t)y1 * level.width + x0) * 4],
+				&level.pixels[((size_t)y1 * level.width + x1) * 4],
+			};
+			uint8_t *dst = &next.pixels[((size_t)y * next.width + x) * 4];
+
+			for (int channel = 0; channel < 3; channel++) {
+				if (srgb) {
+					const float linear = 0.25f * (tables.decode[samples[0][channel]] + tables.decode[samples[1][channel]] + tables.decode[samples[2][channel]] + tables.decode[samples[3][channel]]);
+					dst[channel] = tables.encode[(int)(linear * (SRGB_ENCODE_TABLE_SIZE - 1) + 0.5f)];
+				}
+				else {
+					dst[channel] = (uint8_t)((samples[0][channel] + samples[1][channel] + samples[2][channel] + samples[3][channel] + 2) / 4);
+				}
+			}
+			dst[3] = (uint8_t)((samples[0][3] + samples[1][3] + samples[2][3] + samples[3][3] + 2) / 4);
+		}
+	}
+
+	return next;
+}
+
+std::vector<TextureMipLevel> CreateMipChain(const ImagePixels &image, bool srgb)
+{
+	std::vector<TextureMipLevel> mips;
+	mips.push_back(ExpandToRGBA(image));
+
+	while (mips.back().width > 1 || mips.back().height > 1) {
+		mips.push_back(Downsample(mips.back(), srgb));
+	}
+
+	return mips;
+}
+
+// BC1/BC3 blocks of the level, edge pixels are repeated to fill partial blocks
+static std::vector<uint8_t> EncodeBC(const TextureMipLevel &level, bool alpha)
+{
+	const int blocksX = (level.width + 3) / 4;
+	const int blocksY = (level.height + 3) / 4;
+	const int blockSize = alpha ? 16 : 8;
+
+	std::vector<uint8_t> blocks((size_t)blocksX * blocksY * blockSize);
+	uint8_t *dst = blocks.data();
+
+	for (int by = 0; by < blocksY; by++) {
+		for (int bx = 0; bx < blocksX; bx++, dst += blockSize) {
+			uint8_t texels[16 * 4];
+			for (int y = 0; y < 4; y++) {
+				const int sy = std::min(by * 4 + y, level.height - 1);
+				for (int x = 0; x < 4; x++) {
+					const int sx = std::min(bx * 4 + x, level.width - 1);
+					memcpy(&texels[(y * 4 + x) * 4], &level.pixels[((size_t)sy * level.width + sx) * 4], 4);
+				}
+			}
+			stb_compress_dxt_block(dst, texels, alpha ? 1 : 0, STB_DXT_HIGHQUAL);
+		}
+	}
+
+	return blocks;
+}
+
+bool WriteTextureKTX(const char *szFileName, const std::vector<TextureMipLevel> &mips, TextureFormatOptions format, bool srgb, bool transparent)
+{
+	if (mips.empty() || format == TextureFormatOptions::NONE) {
+		return false;
+	}
+
+	static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	KTXHeader header = {};
+	memcpy(header.identifier, identifier, sizeof(identifier));
+	header.endianness = 0x04030201;
+	header.pixelWidth = mips[0].width;
+	header.pixelHeight = mips[0].height;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = (uint32_t)mips.size();
+
+	if (format == TextureFormatOptions::BC) {
+		header.glTypeSize = 1;
+		header.glBaseInternalFormat = transparent ? KTX_GL_RGBA : KTX_GL_RGB;
+		header.glInternalFormat = transparent ?
+			(srgb ? KTX_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : KTX_GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) :
+			(srgb ? KTX_GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : KTX_GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+	}
+	else {
+		header.glType = KTX_GL_UNSIGNED_BYTE;
+		header.glTypeSize = 1;
+		header.glFormat = KTX_GL_RGBA;
+		header.glBaseInternalFormat = KTX_GL_RGBA;
+		header.glInternalFormat = srgb ? KTX_GL_SRGB8_ALPHA8 : KTX_GL_RGBA8;
+	}
+
+	FILE *pFile = fopen(szFileName, "wb");
+	if (pFile == nullptr) {
+		return false;
+	}
+
+	bool success = fwrite(&header, sizeof(header), 1, pFile) == 1;
+
+	for (size_t level = 0; level < mips.size() && success; level++) {
+		// Both formats keep every level a multiple of 4 bytes, so no mip padding is needed
+		const std::vector<uint8_t> blocks = format == TextureFormatOptions::BC ? EncodeBC(mips[level], transparent) : std::vector<uint8_t>();
+		const std::vector<uint8_t> &data = format == TextureFormatOptions::BC ? blocks : mips[level].pixels;
+		const uint32_t imageSize = (uint32_t)data.size();
+
+		success = fwrite(&imageSize, sizeof(imageSize), 1, pFile) == 1 &&
+			fwrite(data.data(), 1, data.size(), pFile) == data.size();
+	}
+
+	return fclose(pFile) == 0 && success;
+}
@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef __TEXTUREPROCESSOR_H__
+#define __TEXTUREPROCESSOR_H__
+
+#include <cstdint>
+#include <vector>
+#include "utils/Image_Utils.h"
+
+/**
+ * GPU formats textures are converted to. Every format is written to a KTX 1.1 file with the
+ * full mip chain, so the runtime neither decodes PNG/JPG nor builds mips at load time.
+ */
+enum class TextureFormatOptions {
+	NONE,       // reference the source files as they are
+	RGBA8,      // uncompressed 8-bit RGBA, for targets without a supported block format
+	BC,         // BC1 for opaque and BC3 for transparent textures
+};
+
+struct TextureMipLevel
+{
+	int width;
+	int height;
+	std::vector<uint8_t> pixels;  // RGBA8, rows tightly packed
+};
+
+// The image with its channels expanded to RGBA8, grey is replicated and missing alpha is opaque.
+TextureMipLevel ExpandToRGBA(const ImagePixels &image);
+
+/**
+ * Expands the image to RGBA8 and box filters it down to 1x1. With srgb the color channels are
+ * averaged in linear space, alpha always is.
+ */
+std::vector<TextureMipLevel> CreateMipChain(const ImagePixels &image, bool srgb);
+
+// Encodes the mip chain in the format and writes it to a KTX 1.1 file. The file is written in place, callers sharing the
+// output with other writers pass a temporary file and rename it.
+bool WriteTextureKTX(const char *szFileName, const std::vector<TextureMipLevel> &mips, TextureFormatOptions format, bool srgb, bool transparent);
+
+#endif // !__TEXTUREPROCESSOR_H__
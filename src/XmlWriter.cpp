@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <cstring>
+#include <cstdarg>
+#include <algorithm>
+
+#include "XmlWriter.h"
+
+XmlWriter::XmlWriter(FILE *pFile)
+	: pFile(pFile)
+	, pString(nullptr)
+	, failed(pFile == nullptr)
+	, bufferSize(0)
+	, startTagOpen(false)
+{
+}
+
+XmlWriter::XmlWriter(std::string *pString)
+	: pFile(nullptr)
+	, pString(pString)
+	, failed(pString == nullptr)
+	, bufferSize(0)
+	, startTagOpen(false)
+{
+}
+
+XmlWriter::~XmlWriter()
+{
+	Finish();
+}
+
+void XmlWriter::Flush()
+{
+	if (bufferSize == 0) {
+		return;
+	}
+	if (pFile != nullptr) {
+		failed = fwrite(buffer, 1, bufferSize, pFile) != bufferSize || failed;
+	}
+	else if (pString != nullptr) {
+		pString->append(buffer, bufferSize);
+	}
+	bufferSize = 0;
+}
+
+void XmlWriter::Write(const char *szText, size_t length)
+{
+	while (length > 0) {
+		if (bufferSize == sizeof(buffer)) {
+			Flush();
+		}
+		const size_t count = std::min(length, sizeof(buffer) - bufferSize);
+		memcpy(buffer + bufferSize, szText, count);
+		bufferSize += count;
+		szText += count;
+		length -= count;
+	}
+}
+
+void XmlWriter::Write(const char *szText)
+{
+	Write(szText, strlen(szText));
+}
+
+void XmlWriter::WriteEscaped(const char *szText)
+{
+	// Same entities as TiXmlBase::EncodeString
+	const char *szRun = szText;
+	for (const char *c = szText; *c; c++) {
+		const char *szEntity = nullptr;
+		char szCode[8];
+
+		switch (*c) {
+		case '&':  szEntity = "&amp;"; break;
+		case '<':  szEntity = "&lt;"; break;
+		case '>':  szEntity = "&gt;"; break;
+		case '\"': szEntity = "&quot;"; break;
+		case '\'': szEntity = "&apos;"; break;
+		default:
+			if ((unsigned char)*c < 32) {
+				snprintf(szCode, sizeof(szCode), "&#x%02X;", (unsigned)(unsigned char)*c);
+				szEntity = szCode;
+			}
+			break;
+		}
+
+		if (szEntity != nullptr) {
+			Write(szRun, c - szRun);
+			Write(szEntity);
+			szRun = c + 1;
+		}
+	}
+	Write(szRun);
+}
+
+void XmlWriter::WriteIndent(size_t depth)
+{
+	for (size_t level = 0; level < depth; level++) {
+		Write("    ", 4);
+	}
+}
+
+void XmlWriter::CloseStartTag()
+{
+	if (startTagOpen) {
+		Write(">", 1);
+		startTagOpen = false;
+	}
+}
+
+void XmlWriter::BeginElement(const char *szName)
+{
+	if (elements.empty() == false) {
+		CloseStartTag();
+		Write("\n", 1);
+	}
+	WriteIndent(elements.size());
+	Write("<", 1);
+	Write(szName);
+
+	elements.push_back(szName);
+	startTagOpen = true;
+}
+
+void XmlWriter::EndElement()
+{
+	if (elements.empty()) {
+		return;
+	}
+
+	const char *szName = elements.back();
+	elements.pop_back();
+
+	if (startTagOpen) {
+		Write(" />", 3);
+		startTagOpen = false;
+	}
+	else {
+		Write("\n", 1);
+		WriteIndent(elements.size());
+		Write("</", 2);
+		Write(szName);
+		Write(">", 1);
+	}
+
+	// Top level elements end their line, like TiXmlDocument::Print
+	if (elements.empty()) {
+		Write("\n", 1);
+	}
+}
+
+void XmlWriter::Attribute(const char *szName, const char *szValue)
+{
+	if (startTagOpen == false) {
+		return;
+	}
+
+	const char *szQuote = strchr(szValue, '\"') != nullptr ? "'" : "\"";
+	Write(" ", 1);
+	WriteEscaped(szName);
+	Write("=", 1);
+	Write(szQuote, 1);
+	WriteEscaped(szValue);
+	Write(szQuote, 1);
+}
+
+void XmlWriter::Attribute(const char *szName, int value)
+{
+	char szValue[16];
+	snprintf(szValue, sizeof(szValue), "%d", value);
+	Attribute(szName, szValue);
+}
+
+void XmlWriter::AttributeFormat(const char *szName, const char *szFormat, ...)
+{
+	char szValue[1024];
+
+	va_list vaList;
+	va_start(vaList, szFormat);
+	vsnprintf(szValue, sizeof(szValue), szFormat, vaList);
+	va_end(vaList);
+
+	Attribute(szName, szValue);
+}
+
+bool XmlWriter::Finish()
+{
+	while (elements.empty() == false) {
+		EndElement();
+	}
+	Flush();
+	return failed == false;
+}
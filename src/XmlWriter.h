@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef __XMLWRITER_H__
+#define __XMLWRITER_H__
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Writes XML as it is produced, without building a document. The output matches what TinyXML
+ * prints for the same elements and attributes: four spaces of indentation per level, childless
+ * elements closed as <foo />, attribute values escaped the same way. Everything goes through a
+ * fixed scratch buffer that is flushed to the file, or appended to the string, when full.
+ * Element names must stay valid until the element ends.
+ */
+class XmlWriter
+{
+public:
+	explicit XmlWriter(FILE *pFile);
+	explicit XmlWriter(std::string *pString);
+	~XmlWriter();
+
+	void BeginElement(const char *szName);
+	void EndElement();
+
+	void Attribute(const char *szName, const char *szValue);
+	void Attribute(const char *szName, const std::string &value) { Attribute(szName, value.c_str()); }
+	void Attribute(const char *szName, int value);
+	// printf style, the formatted value is at most 1023 characters
+	void AttributeFormat(const char *szName, const char *szFormat, ...);
+
+	// Ends the open elements and flushes the scratch buffer; false if writing failed
+	bool Finish();
+
+private:
+	void Write(const char *szText, size_t length);
+	void Write(const char *szText);
+	void WriteEscaped(const char *szText);
+	void WriteIndent(size_t depth);
+	void CloseStartTag();
+	void Flush();
+
+	FILE *pFile;
+	std::string *pString;
+	bool failed;
+
+	char buffer[64 * 1024];
+	size_t bufferSize;
+
+	std::vector<const char *> elements;
+	bool startTagOpen;
+};
+
+#endif // !__XMLWRITER_H__
@@ -29,6 +29,14 @@ void AnimationData::AddNodeChannel(const NodeData &node, const AccessorData &acc
     samplers.emplace_back(sampler_t(timeAccessor, accessor.ix));
 }
 
+void AnimationData::AddNodeChannel(const NodeData &node, const AccessorData &timeAccessor, const AccessorData &accessor, std::string path)
+{
+    assert(channels.size() == samplers.size());
+    uint32_t ix = channels.size();
+    channels.emplace_back(channel_t(ix, node, std::move(path)));
+    samplers.emplace_back(sampler_t(timeAccessor.ix, accessor.ix));
+}
+
 json AnimationData::serialize() const
 {
     return {
@@ -19,6 +19,8 @@ struct AnimationData : Holdable
     // assumption: 1-to-1 relationship between channels and samplers; this is a simplification on what
     // glTF can express, but it means we can rely on samplerIx == channelIx throughout an animation
     void AddNodeChannel(const NodeData &node, const AccessorData &accessor, std::string path);
+    // as above, with key times of its own rather than those of the animation
+    void AddNodeChannel(const NodeData &node, const AccessorData &timeAccessor, const AccessorData &accessor, std::string path);
 
     json serialize() const override;
 
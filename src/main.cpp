@@ -39,7 +39,7 @@ int main(int argc, char *argv[])
     std::string inputPath;
     std::string outputPath;
 
-    std::vector<std::function<Vec2f(Vec2f)>> texturesTransforms;
+    RawTextureTransform texturesTransform;
 
     GltfOptions gltfOptions;
 
@@ -81,6 +81,12 @@ int main(int argc, char *argv[])
                (
                    "blend-shape-tangents", "Include blend shape tangents, if reported present by the FBX SDK.",
                    cxxopts::value<bool>(gltfOptions.useBlendShapeTangents))
+               (
+                   "anim-tolerance", "Largest position error animation keys may be dropped for, 0 keeps every key.",
+                   cxxopts::value<float>(gltfOptions.animationTolerance))
+               (
+                   "anim-weight-tolerance", "Largest morph weight error animation keys may be dropped for.",
+                   cxxopts::value<float>(gltfOptions.animationWeightTolerance))
                (
                    "k,keep-attribute", "Used repeatedly to build a limiting set of vertex attributes to keep.",
                    cxxopts::value<std::vector<std::string>>())
@@ -129,13 +135,13 @@ Copyright (c) 2016-2017 Oculus VR, LLC.
     }
 
     if (options.count("flip-u") > 0) {
-        texturesTransforms.emplace_back([](Vec2f uv) { return Vec2f(1.0f - uv[0], uv[1]); });
+        texturesTransform = texturesTransform.Then(RawTextureTransform::FlipU());
     }
     if (options.count("flip-v") > 0) {
         fmt::printf("Note: The --flip-v command switch is now default behaviour.\n");
     }
     if (options.count("no-flip-v") == 0) {
-        texturesTransforms.emplace_back([](Vec2f uv) { return Vec2f(uv[0], 1.0f - uv[1]); });
+        texturesTransform = texturesTransform.Then(RawTextureTransform::FlipV());
     } else if (verboseOutput) {
         fmt::printf("Suppressing --flip-v transformation of texture coordinates.\n");
     }
@@ -177,7 +183,7 @@ Copyright (c) 2016-2017 Oculus VR, LLC.
         for (std::string attribute : options["keep-attribute"].as<std::vector<std::string>>()) {
             if (attribute == "position") { gltfOptions.keepAttribs |= RAW_VERTEX_ATTRIBUTE_POSITION; }
             else if (attribute == "normal") { gltfOptions.keepAttribs |= RAW_VERTEX_ATTRIBUTE_NORMAL; }
-            else if (attribute == "tangent") { gltfOptions.keepAttribs |= RAW_VERTEX_ATTRIBUTE_TANGENT; }
+            else if (attribute == "tangent") { gltfOptions.keepAttribs |= RAW_VERTEX_ATTRIBUTE_BINORMAL; }
             else if (attribute == "binormal") { gltfOptions.keepAttribs |= RAW_VERTEX_ATTRIBUTE_BINORMAL; }
             else if (attribute == "color") { gltfOptions.keepAttribs |= RAW_VERTEX_ATTRIBUTE_COLOR; }
             else if (attribute == "uv0") { gltfOptions.keepAttribs |= RAW_VERTEX_ATTRIBUTE_UV0; }
@@ -226,8 +232,12 @@ Copyright (c) 2016-2017 Oculus VR, LLC.
         return 1;
     }
 
-    if (!texturesTransforms.empty()) {
-        raw.TransformTextures(texturesTransforms);
+    raw.TransformTextures(texturesTransform);
+    if (gltfOptions.animationTolerance > 0.0f) {
+        const size_t droppedKeys = raw.ReduceKeyframes(gltfOptions.animationTolerance, gltfOptions.animationWeightTolerance);
+        if (verboseOutput) {
+            fmt::printf("Dropped %zu animation keys\n", droppedKeys);
+        }
     }
     raw.Condense();
     raw.TransformGeometry(gltfOptions.computeNormals);
@@ -158,6 +158,61 @@ namespace FileUtils {
         return fileList;
     }
 
+    std::vector<std::string> ListFolderFolders(const char *folder)
+    {
+        std::vector<std::string> folderList;
+#if defined( __unix__ ) || defined( __APPLE__ )
+        DIR *dir = opendir(strlen(folder) > 0 ? folder : ".");
+        if (dir != nullptr) {
+            for (;;) {
+                struct dirent *dp = readdir(dir);
+                if (dp == nullptr) {
+                    break;
+                }
+
+                if (dp->d_type != DT_DIR || strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0) {
+                    continue;
+                }
+
+                folderList.emplace_back(dp->d_name);
+            }
+
+            closedir(dir);
+        }
+#else
+        std::string pathStr = folder;
+        pathStr += "*";
+
+        WIN32_FIND_DATA FindFileData;
+        HANDLE hFind = FindFirstFile( pathStr.c_str(), &FindFileData );
+        if ( hFind != INVALID_HANDLE_VALUE )
+        {
+            do
+            {
+                if ((FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 &&
+                    strcmp(FindFileData.cFileName, ".") != 0 && strcmp(FindFileData.cFileName, "..") != 0) {
+                    folderList.push_back(FindFileData.cFileName);
+                }
+            } while ( FindNextFile( hFind, &FindFileData ) );
+
+            FindClose( hFind );
+        }
+#endif
+        return folderList;
+    }
+
+    std::vector<std::string> ListFolderFilesRecursive(const char *folder, const char *matchExtensions)
+    {
+        std::vector<std::string> fileList = ListFolderFiles(folder, matchExtensions);
+        for (const std::string &subFolder : ListFolderFolders(folder)) {
+            const std::string subFolderPath = std::string(folder) + subFolder + "/";
+            for (const std::string &file : ListFolderFilesRecursive(subFolderPath.c_str(), matchExtensions)) {
+                fileList.push_back(subFolder + "/" + file);
+            }
+        }
+        return fileList;
+    }
+
     bool CreatePath(const char *path)
     {
 #if defined( __unix__ ) || defined( __APPLE__ )
@@ -206,4 +261,14 @@ namespace FileUtils {
         fmt::printf("Warning: Only copied %lu bytes to %s, when %s is %lu bytes long.\n", dstSize, dstFilename, srcFilename, srcSize);
         return false;
     }
+
+    bool RenameFile(const std::string &srcFilename, const std::string &dstFilename)
+    {
+        // replaces an existing destination, atomically where the file system allows it
+#if defined( __unix__ ) || defined( __APPLE__ )
+        return rename(srcFilename.c_str(), dstFilename.c_str()) == 0;
+#else
+        return MoveFileExA(srcFilename.c_str(), dstFilename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#endif
+    }
 }
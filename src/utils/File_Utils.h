@@ -18,10 +18,14 @@ namespace FileUtils {
 
     bool MatchExtension(const char *fileExtension, const char *matchExtensions);
     std::vector<std::string> ListFolderFiles(const char *folder, const char *matchExtensions);
+    std::vector<std::string> ListFolderFolders(const char *folder);
+    // Files in the folder and all of its subfolders, relative to the folder with '/' separators.
+    std::vector<std::string> ListFolderFilesRecursive(const char *folder, const char *matchExtensions);
 
     bool CreatePath(const char *path);
 
     bool CopyFile(const std::string &srcFilename, const std::string &dstFilename);
+    bool RenameFile(const std::string &srcFilename, const std::string &dstFilename);
 }
 
 #endif // !__FILE_UTILS_H__
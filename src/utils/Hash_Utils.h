@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef __HASH_UTILS_H__
+#define __HASH_UTILS_H__
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace HashUtils {
+    // 64-bit content hash, stable across runs, so it can name files shared between conversions.
+    inline uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        uint64_t       hash  = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL) ^ size;
+
+        size_t offset = 0;
+        for (; offset + 8 <= size; offset += 8) {
+            uint64_t word;
+            memcpy(&word, bytes + offset, sizeof(word));
+            hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+            hash ^= hash >> 29;
+        }
+        for (; offset < size; offset++) {
+            hash = (hash ^ bytes[offset]) * 0x100000001b3ULL;
+        }
+
+        // final avalanche, from MurmurHash3
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    inline uint64_t HashString(const std::string &string, uint64_t seed = 0)
+    {
+        return HashBytes(string.data(), string.size(), seed);
+    }
+
+    // Sixteen lower case hex digits.
+    inline std::string ToHexString(uint64_t hash)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string       result(16, '0');
+        for (int i = 15; i >= 0; i--, hash >>= 4) {
+            result[i] = digits[hash & 0xf];
+        }
+        return result;
+    }
+}
+
+#endif // !__HASH_UTILS_H__
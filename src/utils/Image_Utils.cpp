@@ -8,25 +8,133 @@
  */
 
 #include <string>
+#include <mutex>
+#include <fstream>
+#include <cstring>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_UTILS_SSE2 1
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 
+#include <json.hpp>
+
 #include "Image_Utils.h"
+#include "Hash_Utils.h"
+#include "Profile_Utils.h"
 
-static bool imageHasTransparentPixels(FILE *f) {
-    int width, height, channels;
-    // RGBA: we have to load the pixels to figure out if the image is fully opaque
-    uint8_t *pixels = stbi_load_from_file(f, &width, &height, &channels, 0);
-    if (pixels != nullptr) {
-        int pixelCount = width * height;
-        for (int ix = 0; ix < pixelCount; ix ++) {
-            // test fourth byte (alpha); 255 is 1.0
-            if (pixels[4*ix + 3] != 255) {
-                return true;
-            }
+static const int IMAGE_CACHE_VERSION = 1;
+
+struct ImageEntry
+{
+    std::mutex                         mutex;
+    bool                               hasProperties { false };
+    ImageProperties                    properties { 1, 1, IMAGE_OPAQUE };
+    bool                               hasHash { false };
+    uint64_t                           hash { 0 };
+    int64_t                            modified { -1 };
+    int64_t                            size { -1 };
+    std::shared_ptr<const ImagePixels> pixels;
+};
+
+static std::mutex                                                   cacheMutex;
+static std::unordered_map<std::string, std::unique_ptr<ImageEntry>> cacheEntries;
+
+static bool GetFileStamp(char const *filePath, int64_t &modified, int64_t &size)
+{
+    struct stat info;
+    if (stat(filePath, &info) != 0) {
+        return false;
+    }
+    modified = (int64_t) info.st_mtime;
+    size     = (int64_t) info.st_size;
+    return true;
+}
+
+static ImageEntry &GetImageEntry(const std::string &filePath)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::unique_ptr<ImageEntry> &entry = cacheEntries[filePath];
+    if (!entry) {
+        entry.reset(new ImageEntry());
+    }
+    return *entry;
+}
+
+// Forgets whatever the entry knows if the file changed since; the caller holds the entry lock.
+static bool ValidateImageEntry(ImageEntry &entry, char const *filePath)
+{
+    int64_t modified, size;
+    if (!GetFileStamp(filePath, modified, size)) {
+        entry.hasProperties = false;
+        entry.hasHash       = false;
+        entry.pixels.reset();
+        return false;
+    }
+    if (entry.modified != modified || entry.size != size) {
+        entry.hasProperties = false;
+        entry.hasHash       = false;
+        entry.pixels.reset();
+        entry.modified = modified;
+        entry.size     = size;
+    }
+    return true;
+}
+
+static std::shared_ptr<const ImagePixels> DecodeImage(char const *filePath)
+{
+    ProfileUtils::ScopedTimer timer("decodeImage");
+
+    std::shared_ptr<ImagePixels> image = std::make_shared<ImagePixels>();
+    uint8_t *pixels = stbi_load(filePath, &image->width, &image->height, &image->channels, 0);
+    if (pixels == nullptr) {
+        return nullptr;
+    }
+    image->pixels.assign(pixels, pixels + (size_t) image->width * image->height * image->channels);
+    stbi_image_free(pixels);
+    return image;
+}
+
+bool ImageHasTransparentPixels(const uint8_t *pixels, size_t pixelCount)
+{
+    size_t ix = 0;
+#if IMAGE_UTILS_SSE2
+    // 16 pixels per iteration; AND the four vectors together so one compare covers every alpha byte
+    const __m128i opaque = _mm_set1_epi8((char) 0xFF);
+    for (; ix + 16 <= pixelCount; ix += 16) {
+        const __m128i *block = reinterpret_cast<const __m128i *>(pixels + 4 * ix);
+        const __m128i  a     = _mm_and_si128(_mm_loadu_si128(block + 0), _mm_loadu_si128(block + 1));
+        const __m128i  b     = _mm_and_si128(_mm_loadu_si128(block + 2), _mm_loadu_si128(block + 3));
+        const int      mask  = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(a, b), opaque));
+        if ((mask & 0x8888) != 0x8888) {
+            return true;
+        }
+    }
+#else
+    // two pixels per 64-bit word; the mask is built from bytes so it holds for either endianness
+    const uint8_t alphaBytes[8] = { 0, 0, 0, 0xFF, 0, 0, 0, 0xFF };
+    uint64_t      alphaMask;
+    memcpy(&alphaMask, alphaBytes, sizeof(alphaMask));
+    for (; ix + 2 <= pixelCount; ix += 2) {
+        uint64_t word;
+        memcpy(&word, pixels + 4 * ix, sizeof(word));
+        if ((word & alphaMask) != alphaMask) {
+            return true;
+        }
+    }
+#endif
+    for (; ix < pixelCount; ix++) {
+        // test fourth byte (alpha); 255 is 1.0
+        if (pixels[4 * ix + 3] != 255) {
+            return true;
         }
     }
     return false;
@@ -40,17 +148,148 @@ ImageProperties GetImageProperties(char const *filePath)
         IMAGE_OPAQUE,
     };
 
-    FILE *f = fopen(filePath, "rb");
-    if (f == nullptr) {
+    ImageEntry &entry = GetImageEntry(filePath);
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    if (!ValidateImageEntry(entry, filePath)) {
         return result;
     }
+    if (entry.hasProperties) {
+        return entry.properties;
+    }
 
     int channels;
-    int success = stbi_info_from_file(f, &result.width, &result.height, &channels);
-
-    if (success && channels == 4 && imageHasTransparentPixels(f)) {
-        result.occlusion = IMAGE_TRANSPARENT;
+    if (stbi_info(filePath, &result.width, &result.height, &channels) == 0) {
+        return result;
+    }
+    if (channels == 4) {
+        // RGBA: we have to load the pixels to figure out if the image is fully opaque
+        if (!entry.pixels) {
+            entry.pixels = DecodeImage(filePath);
+        }
+        if (entry.pixels && entry.pixels->channels == 4 &&
+            ImageHasTransparentPixels(entry.pixels->pixels.data(), (size_t) entry.pixels->width * entry.pixels->height)) {
+            result.occlusion = IMAGE_TRANSPARENT;
+        }
     }
+    entry.properties    = result;
+    entry.hasProperties = true;
     return result;
 }
 
+std::shared_ptr<const ImagePixels> GetImagePixels(char const *filePath)
+{
+    ImageEntry &entry = GetImageEntry(filePath);
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    if (!ValidateImageEntry(entry, filePath)) {
+        return nullptr;
+    }
+    if (!entry.pixels) {
+        entry.pixels = DecodeImage(filePath);
+    }
+    return entry.pixels;
+}
+
+bool GetImageHash(char const *filePath, uint64_t &hash)
+{
+    ImageEntry &entry = GetImageEntry(filePath);
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    if (!ValidateImageEntry(entry, filePath)) {
+        return false;
+    }
+    if (!entry.hasHash) {
+        if (!entry.pixels) {
+            entry.pixels = DecodeImage(filePath);
+        }
+        if (!entry.pixels) {
+            return false;
+        }
+        const int layout[3] = { entry.pixels->width, entry.pixels->height, entry.pixels->channels };
+        entry.hash    = HashUtils::HashBytes(entry.pixels->pixels.data(), entry.pixels->pixels.size(),
+                                             HashUtils::HashBytes(layout, sizeof(layout)));
+        entry.hasHash = true;
+    }
+    hash = entry.hash;
+    return true;
+}
+
+void ClearImagePixels()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (auto &it : cacheEntries) {
+        std::lock_guard<std::mutex> entryLock(it.second->mutex);
+        it.second->pixels.reset();
+    }
+}
+
+bool LoadImageCache(char const *fileName)
+{
+    std::ifstream stream(fileName);
+    if (!stream.good()) {
+        return false;
+    }
+    nlohmann::json cache;
+    try {
+        stream >> cache;
+    } catch (const std::exception &) {
+        return false;
+    }
+    if (!cache.is_object() || cache.value("version", 0) != IMAGE_CACHE_VERSION || !cache["images"].is_array()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (const nlohmann::json &image : cache["images"]) {
+        std::unique_ptr<ImageEntry> &entry = cacheEntries[image.value("path", std::string())];
+        if (entry) {
+            continue;
+        }
+        entry.reset(new ImageEntry());
+        entry->modified             = image.value("modified", (int64_t) -1);
+        entry->size                 = image.value("size", (int64_t) -1);
+        entry->properties.width     = image.value("width", 1);
+        entry->properties.height    = image.value("height", 1);
+        entry->properties.occlusion = image.value("transparent", false) ? IMAGE_TRANSPARENT : IMAGE_OPAQUE;
+        entry->hasProperties        = true;
+        if (image.count("hash") > 0) {
+            entry->hash    = std::stoull(image["hash"].get<std::string>(), nullptr, 16);
+            entry->hasHash = true;
+        }
+    }
+    return true;
+}
+
+bool SaveImageCache(char const *fileName)
+{
+    nlohmann::json images = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (const auto &it : cacheEntries) {
+            std::lock_guard<std::mutex> entryLock(it.second->mutex);
+            const ImageEntry &entry = *it.second;
+            if (!entry.hasProperties) {
+                continue;
+            }
+            nlohmann::json image = {
+                { "path", it.first },
+                { "modified", entry.modified },
+                { "size", entry.size },
+                { "width", entry.properties.width },
+                { "height", entry.properties.height },
+                { "transparent", entry.properties.occlusion == IMAGE_TRANSPARENT }
+            };
+            if (entry.hasHash) {
+                image["hash"] = HashUtils::ToHexString(entry.hash);
+            }
+            images.push_back(image);
+        }
+    }
+
+    const nlohmann::json cache = {
+        { "version", IMAGE_CACHE_VERSION },
+        { "images", images }
+    };
+
+    std::ofstream stream(fileName, std::ios::trunc);
+    stream << cache.dump(1) << std::endl;
+    return stream.good();
+}
@@ -11,6 +11,10 @@
 #define __IMAGE_UTILS_H__
 
 #include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
 
 enum ImageOcclusion
 {
@@ -25,8 +29,42 @@ struct ImageProperties
     ImageOcclusion occlusion;
 };
 
+struct ImagePixels
+{
+    int                  width;
+    int                  height;
+    int                  channels;
+    std::vector<uint8_t> pixels;
+};
+
+/**
+ * Dimensions and occlusion of the image. Results are cached by path, modification time and size, so
+ * an image is only decoded the first time it is seen; the decoded pixels are kept for GetImagePixels().
+ */
 ImageProperties GetImageProperties(char const *filePath);
 
+/**
+ * The decoded image in its own channel count, or null if it can't be read. Every image is decoded at most
+ * once until ClearImagePixels() is called.
+ */
+std::shared_ptr<const ImagePixels> GetImagePixels(char const *filePath);
+
+/**
+ * Hash of the decoded pixels and their layout, so the same image stored in different files or formats hashes the
+ * same. Cached and persisted with the image properties; false if the image can't be read.
+ */
+bool GetImageHash(char const *filePath, uint64_t &hash);
+
+// Releases the decoded pixels; the cached image properties stay.
+void ClearImagePixels();
+
+// True if any pixel of the RGBA buffer has an alpha below 255. Stops at the first one.
+bool ImageHasTransparentPixels(const uint8_t *pixels, size_t pixelCount);
+
+// Reads and writes the image property cache so later runs can skip decoding unchanged images.
+bool LoadImageCache(char const *fileName);
+bool SaveImageCache(char const *fileName);
+
 /**
  * Very simple method for mapping filename suffix to mime type. The glTF 2.0 spec only accepts values
  * "image/jpeg" and "image/png" so we don't need to get too fancy.
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+
+#if defined( _WIN32 )
+#include <windows.h>
+#include <psapi.h>
+#elif defined( __APPLE__ )
+#include <sys/resource.h>
+#include <mach/mach.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "Memory_Utils.h"
+
+namespace MemoryUtils {
+
+    size_t GetResidentSize()
+    {
+#if defined( _WIN32 )
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE) {
+            return 0;
+        }
+        return counters.WorkingSetSize;
+#elif defined( __APPLE__ )
+        mach_task_basic_info_data_t info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) != KERN_SUCCESS) {
+            return 0;
+        }
+        return info.resident_size;
+#else
+        // The second field of statm is the resident size in pages
+        FILE *pFile = fopen("/proc/self/statm", "r");
+        if (pFile == nullptr) {
+            return 0;
+        }
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        const int count = fscanf(pFile, "%lu %lu", &size, &resident);
+        fclose(pFile);
+        return count == 2 ? resident * (size_t) sysconf(_SC_PAGESIZE) : 0;
+#endif
+    }
+
+    size_t GetPeakResidentSize()
+    {
+#if defined( _WIN32 )
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE) {
+            return 0;
+        }
+        return counters.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+#if defined( __APPLE__ )
+        // Bytes on macOS, kilobytes everywhere else
+        return (size_t) usage.ru_maxrss;
+#else
+        return (size_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+    }
+
+    static std::atomic<bool>   allocationCounting(false);
+    static std::atomic<size_t> allocationCount(0);
+
+    void SetAllocationCounting(bool enable)
+    {
+        allocationCounting.store(enable, std::memory_order_relaxed);
+    }
+
+    size_t GetAllocationCount()
+    {
+        return allocationCount.load(std::memory_order_relaxed);
+    }
+}
+
+// Every allocation through new is counted while counting is enabled, the rest of the program is unaware of the
+// replacement
+void *operator new(size_t size)
+{
+    if (MemoryUtils::allocationCounting.load(std::memory_order_relaxed)) {
+        MemoryUtils::allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    void *ptr = malloc(size > 0 ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
@@ -0,0 +1,29 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef __MEMORY_UTILS_H__
+#define __MEMORY_UTILS_H__
+
+#include <cstddef>
+
+namespace MemoryUtils {
+    // Bytes of physical memory the process uses right now, zero when the platform can't tell.
+    size_t GetResidentSize();
+
+    // Largest resident size the process reached so far, zero when the platform can't tell.
+    size_t GetPeakResidentSize();
+
+    // Allocations are only counted while counting is enabled, until then operator new costs a relaxed load.
+    void SetAllocationCounting(bool enable);
+
+    // Number of allocations made through operator new while counting was enabled.
+    size_t GetAllocationCount();
+}
+
+#endif // !__MEMORY_UTILS_H__
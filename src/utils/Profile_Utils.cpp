@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <unordered_map>
+
+#include <json.hpp>
+
+#include "Memory_Utils.h"
+#include "Profile_Utils.h"
+
+namespace ProfileUtils {
+
+    struct PhaseTime
+    {
+        std::string name;
+        int64_t     count;
+        double      total;
+        double      min;
+        double      max;
+    };
+
+    static std::atomic<bool>                       enabled(false);
+    static std::mutex                              mutex;
+    static std::vector<PhaseTime>                  phases;
+    static std::unordered_map<std::string, size_t> phaseIndices;
+    static std::vector<std::pair<std::string, int64_t>> counters;
+    static std::unordered_map<std::string, size_t> counterIndices;
+
+    void SetEnabled(bool enable)
+    {
+        enabled = enable;
+        MemoryUtils::SetAllocationCounting(enable);
+    }
+
+    bool IsEnabled()
+    {
+        return enabled;
+    }
+
+    void AddPhaseTime(const char *phase, double seconds)
+    {
+        if (!enabled) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = phaseIndices.emplace(phase, phases.size());
+        if (it.second) {
+            phases.push_back(PhaseTime { phase, 0, 0.0, seconds, seconds });
+        }
+        PhaseTime &phaseTime = phases[it.first->second];
+        phaseTime.count++;
+        phaseTime.total += seconds;
+        phaseTime.min = std::min(phaseTime.min, seconds);
+        phaseTime.max = std::max(phaseTime.max, seconds);
+    }
+
+    void AddCount(const char *counter, int64_t value)
+    {
+        if (!enabled) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = counterIndices.emplace(counter, counters.size());
+        if (it.second) {
+            counters.emplace_back(counter, 0);
+        }
+        counters[it.first->second].second += value;
+    }
+
+    bool WriteReport(const char *fileName, const std::string &asset)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        nlohmann::json phaseList = nlohmann::json::array();
+        for (const PhaseTime &phaseTime : phases) {
+            phaseList.push_back({
+                { "name", phaseTime.name },
+                { "count", phaseTime.count },
+                { "totalSeconds", phaseTime.total },
+                { "minSeconds", phaseTime.min },
+                { "maxSeconds", phaseTime.max }
+            });
+        }
+
+        nlohmann::json counterList = nlohmann::json::object();
+        for (const auto &counter : counters) {
+            counterList[counter.first] = counter.second;
+        }
+        counterList["allocations"] = MemoryUtils::GetAllocationCount();
+        counterList["peakResidentBytes"] = MemoryUtils::GetPeakResidentSize();
+
+        const nlohmann::json report = {
+            { "asset", asset },
+            { "phases", phaseList },
+            { "counters", counterList }
+        };
+
+        std::ofstream stream(fileName, std::ios::trunc);
+        stream << report.dump(2) << std::endl;
+        return stream.good();
+    }
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef __PROFILE_UTILS_H__
+#define __PROFILE_UTILS_H__
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace ProfileUtils {
+    // Nothing is recorded until profiling is enabled, which also counts allocations; timers and counters then cost a
+    // branch.
+    void SetEnabled(bool enabled);
+    bool IsEnabled();
+
+    // Adds one run of a phase, a phase that runs more than once keeps the count, total, min and max of its runs.
+    // Safe to call from any thread.
+    void AddPhaseTime(const char *phase, double seconds);
+
+    // Adds to a named counter. Safe to call from any thread.
+    void AddCount(const char *counter, int64_t value);
+
+    // Writes the phases in the order they first ran and the counters as JSON, along with the number of
+    // allocations and the peak resident size of the process.
+    bool WriteReport(const char *fileName, const std::string &asset);
+
+    // Times its scope as one run of the phase.
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(const char *phase) : phase(IsEnabled() ? phase : nullptr), start(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer()
+        {
+            if (phase != nullptr) {
+                AddPhaseTime(phase, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+
+    private:
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+        const char                                  *phase;
+        const std::chrono::steady_clock::time_point start;
+    };
+}
+
+#endif // !__PROFILE_UTILS_H__
@@ -14,6 +14,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdarg>
+#include <cctype>
 
 #if defined( _MSC_VER )
 #define strncasecmp _strnicmp
@@ -86,6 +87,16 @@ namespace StringUtils {
         return strncasecmp(s1.c_str(), s2.c_str(), MAX_PATH_LENGTH);
     }
 
+    // Case folded copy, for keys that compare like CompareNoCase.
+    inline std::string ToLower(const std::string &s)
+    {
+        std::string lower = s;
+        for (char &c : lower) {
+            c = (char) tolower((unsigned char) c);
+        }
+        return lower;
+    }
+
 } // StringUtils
 #endif // _STRING_UTILS_H__
 
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "Thread_Utils.h"
+
+namespace ThreadUtils {
+
+    int GetJobCount(int jobs)
+    {
+        if (jobs > 0) {
+            return jobs;
+        }
+        return std::max((int) std::thread::hardware_concurrency(), 1);
+    }
+
+    void ParallelFor(int count, int jobs, const std::function<void(int)> &function)
+    {
+        ParallelForWorker(count, jobs, [&](int index, int) {
+            function(index);
+        });
+    }
+
+    void ParallelForWorker(int count, int jobs, const std::function<void(int, int)> &function)
+    {
+        jobs = std::min(GetJobCount(jobs), count);
+
+        if (jobs <= 1) {
+            for (int index = 0; index < count; index++) {
+                function(index, 0);
+            }
+            return;
+        }
+
+        std::atomic<int> next(0);
+        auto worker = [&](int workerIndex) {
+            for (int index = next++; index < count; index = next++) {
+                function(index, workerIndex);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < jobs; i++) {
+            threads.emplace_back(worker, i);
+        }
+        worker(0);
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+}
@@ -0,0 +1,28 @@
+/**
+ * Copyright (c) 2014-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#ifndef __THREAD_UTILS_H__
+#define __THREAD_UTILS_H__
+
+#include <functional>
+
+namespace ThreadUtils {
+    // Resolves a user supplied job count, zero or less means one job per hardware thread.
+    int GetJobCount(int jobs);
+
+    // Calls function(index) for every index in [0, count) on up to jobs threads, the calling thread included.
+    // The order in which indices are processed is unspecified, results must be written to per index slots.
+    void ParallelFor(int count, int jobs, const std::function<void(int)> &function);
+
+    // Like ParallelFor, also passing the worker in [0, GetJobCount(jobs)) that runs the index, the calling thread
+    // being worker 0. Indices of one worker run one after the other, so it can own per worker state.
+    void ParallelForWorker(int count, int jobs, const std::function<void(int, int)> &function);
+}
+
+#endif // !__THREAD_UTILS_H__